@@ -270,6 +270,62 @@ xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx*/
      PyAPI_FUNC(PyObject *) _Py_CheckFunctionResult(PyObject *func,
                                                     PyObject *result,
                                                     const char *where);
+
+     PyAPI_FUNC(PyObject *) _PyObject_Vectorcall(PyObject *callable,
+                                                 PyObject **args,
+                                                 Py_ssize_t nargs,
+                                                 PyObject *kwnames);
+
+       /*
+     Call a callable object with the nargs positional arguments in
+     args, followed by the values of the keyword arguments named in
+     the tuple kwnames, which is NULL if there are none:  the
+     vectorcall protocol (see vectorcallfunc in object.h).  Objects
+     which don't support it are called with tp_call, on a tuple and
+     a dict made of the arguments.
+       */
+
+     PyAPI_FUNC(PyObject *) _PyObject_VectorcallDict(PyObject *callable,
+                                                     PyObject **args,
+                                                     Py_ssize_t nargs,
+                                                     PyObject *kwargs);
+
+       /*
+     Same as _PyObject_Vectorcall(), with the keyword arguments in the
+     dict kwargs, which may be NULL.
+       */
+
+     PyAPI_FUNC(PyObject *) _PyObject_MakeTpCall(PyObject *callable,
+                                                 PyObject **args,
+                                                 Py_ssize_t nargs,
+                                                 PyObject *kwnames);
+
+       /*
+     Call a callable object with tp_call, on a tuple and a dict made of
+     the arguments of a vectorcall.  This is what _PyObject_Vectorcall()
+     does for objects without a vectorcall.
+       */
+
+     PyAPI_FUNC(PyObject *) _PyVectorcall_Call(PyObject *callable,
+                                               PyObject *args,
+                                               PyObject *kwargs);
+
+       /*
+     The tp_call of the types which support the vectorcall protocol:
+     call the vectorcall of callable on the items of the tuple args and
+     the dict kwargs, which may be NULL.
+       */
+
+     PyAPI_FUNC(PyObject *) _PyStack_AsTuple(PyObject **stack,
+                                             Py_ssize_t nargs);
+
+     PyAPI_FUNC(PyObject *) _PyStack_AsDict(PyObject **values,
+                                            PyObject *kwnames);
+
+       /*
+     Make a tuple of the nargs objects of stack, or a dict of the
+     keyword arguments named by kwnames, with their values.
+       */
 #endif
 
        /*
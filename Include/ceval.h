@@ -23,6 +23,7 @@ PyAPI_FUNC(PyObject *) PyEval_CallMethod(PyObject *obj,
 #ifndef Py_LIMITED_API
 PyAPI_FUNC(void) PyEval_SetProfile(Py_tracefunc, PyObject *);
 PyAPI_FUNC(void) PyEval_SetTrace(Py_tracefunc, PyObject *);
+PyAPI_FUNC(void) PyEval_SetInstrumentation(Py_tracefunc, PyObject *);
 PyAPI_FUNC(void) _PyEval_SetCoroutineWrapper(PyObject *);
 PyAPI_FUNC(PyObject *) _PyEval_GetCoroutineWrapper(void);
 #endif
@@ -43,6 +44,62 @@ PyAPI_FUNC(int) PyEval_MergeCompilerFlags(PyCompilerFlags *cf);
 
 PyAPI_FUNC(int) Py_AddPendingCall(int (*func)(void *), void *arg);
 PyAPI_FUNC(int) Py_MakePendingCalls(void);
+#ifndef Py_LIMITED_API
+/* Like Py_AddPendingCall(), but fails instead of allocating memory when the
+   queue is full:  for signal handlers. */
+PyAPI_FUNC(int) _Py_AddPendingCallNoAlloc(int (*func)(void *), void *arg);
+
+typedef struct {
+    Py_ssize_t depth;       /* calls waiting to run */
+    size_t added;           /* calls queued since startup */
+    size_t overflowed;      /* ... of which didn't fit in the ring */
+    size_t dropped;         /* calls refused */
+} _PyEval_PendingCallStats;
+
+PyAPI_FUNC(void) _PyEval_GetPendingCallStats(_PyEval_PendingCallStats *);
+
+typedef struct {
+    const char *name;       /* the specialized form, e.g. "BINARY_ADD_INT" */
+    size_t specialized;     /* instructions rewritten into it */
+    size_t hits;            /* runs which found the types it is for */
+    size_t misses;          /* ... which didn't, and rewrote it back */
+} _PyEval_SpecializationStats;
+
+/* Fill in the counts of up to n specialized forms, and return the number of
+   forms.  See ceval.c. */
+PyAPI_FUNC(int) _PyEval_GetSpecializationStats(
+    _PyEval_SpecializationStats *stats, int n);
+
+typedef struct {
+    PY_UINT64_T count;      /* instructions sampled */
+    PY_UINT64_T timed;      /* ... of which were timed */
+    PY_UINT64_T ticks;      /* timestamp counter ticks of the timed ones */
+} _PyEval_OpcodeProfile;
+
+typedef struct {
+    PyObject *code;         /* the code object, borrowed */
+    _PyEval_OpcodeProfile profile;
+} _PyEval_CodeProfile;
+
+/* Sample one in 'period' of the instructions which the running thread
+   runs:  count it by opcode and by code object, and time it.  Stop for a
+   period of 0.  See ceval.c.  Returns -1 with an exception set on failure. */
+PyAPI_FUNC(int) _PyEval_SetOpcodeProfile(int period);
+
+/* Fill in the profile of the running thread:  256 counts by opcode in
+   'opcodes', and up to n counts by code object in 'codes', whose code
+   objects stay alive until the profile is reset or stopped.  Returns the
+   number of code objects, or -1 if the thread has no profile. */
+PyAPI_FUNC(Py_ssize_t) _PyEval_GetOpcodeProfile(
+    _PyEval_OpcodeProfile *opcodes, _PyEval_CodeProfile *codes,
+    Py_ssize_t n);
+
+/* Start the profile of the running thread over */
+PyAPI_FUNC(void) _PyEval_ResetOpcodeProfile(void);
+
+/* Stop the profile of a thread state which is cleared */
+PyAPI_FUNC(void) _PyEval_ClearOpcodeProfile(PyThreadState *tstate);
+#endif
 
 /* Protection against deeply nested recursive calls
 
@@ -7,6 +7,61 @@
 extern "C" {
 #endif
 
+/* Inline cache of a LOAD_GLOBAL instruction:  the object found under the
+   name, valid while f_globals and f_builtins keep the versions it was found
+   with.  The reference is borrowed:  the dict holding it can't have dropped
+   it without changing its version. */
+typedef struct {
+    PyObject *ptr;
+    PY_UINT64_T globals_ver;
+    PY_UINT64_T builtins_ver;
+} _PyOpcache_LoadGlobal;
+
+/* Inline cache of a LOAD_ATTR or STORE_ATTR instruction, valid for the
+   instances of 'type' while it has the version tag the cache was filled
+   with.  'kind' tells how the attribute was found (see ceval.c):  'hint' is
+   the index of the name in the instance dict, or the offset of the slot, and
+   'descr' is borrowed from the type, which can't drop it without getting a
+   new version tag. */
+typedef struct {
+    PyTypeObject *type;
+    unsigned int tp_version_tag;
+    int kind;
+    Py_ssize_t hint;
+    PyObject *descr;
+} _PyOpcache_Attr;
+
+/* State of a BINARY_ADD, INPLACE_ADD, BINARY_SUBSCR or COMPARE_OP
+   instruction, which the eval loop specializes:  the times it ran generic
+   since it was last rewritten. */
+typedef struct {
+    unsigned int counter;
+} _PyOpcache_Adaptive;
+
+typedef struct {
+    union {
+        _PyOpcache_LoadGlobal lg;
+        _PyOpcache_Attr attr;
+        _PyOpcache_Adaptive adaptive;
+    } u;
+    char optimized;             /* the cache has been filled */
+    unsigned char misses;       /* times it didn't apply, up to a limit */
+} _PyOpcache;
+
+/* A try block of the exception table of a code object (see codeobject.c):
+   the instructions from 'start' to its POP_BLOCK at 'end', both included,
+   run with no block set up.  An exception or a return, break or continue
+   in them unwinds the stack down to 'level' and goes on with the handler of
+   its SETUP_EXCEPT or SETUP_FINALLY 'type' at 'handler', as if the block was
+   on the block stack.  The block of a with statement is a SETUP_FINALLY. */
+typedef struct {
+    int start;
+    int end;
+    int handler;
+    int level;
+    int type;
+} _PyExceptionTableEntry;
+
 /* Bytecode object */
 typedef struct {
     PyObject_HEAD
@@ -35,6 +90,28 @@ typedef struct {
 				   Objects/lnotab_notes.txt for details. */
     void *co_zombieframe;     /* for optimization only (see frameobject.c) */
     PyObject *co_weakreflist;   /* to support weakrefs to code objects */
+    /* Inline caches of the instructions, made once the code is hot:  until
+       then co_opcache_flag counts runs, see ceval.c.  co_opcache_map maps
+       the offset of each instruction to its 1-based index in co_opcache, or
+       to 0 for no cache;  it is NULL if no instruction has one.  The eval
+       loop then runs co_quickened, a copy of co_code with superinstructions,
+       in which it rewrites instructions into specialized forms. */
+    unsigned char *co_opcache_map;
+    _PyOpcache *co_opcache;
+    int co_opcache_flag;
+    unsigned char co_opcache_size;
+    unsigned char *co_quickened;
+    /* The try blocks which don't go through the block stack, sorted by
+       start, or NULL for none */
+    _PyExceptionTableEntry *co_exceptiontable;
+    int co_exceptiontable_size;
+    /* The PyCode_INSTRUMENT_... events of the code, see
+       PyCode_SetInstrumentation().  With line events, co_instrumented maps
+       the offset of the first instruction of each line to the instruction
+       which INSTRUMENTED_LINE replaces in co_quickened, and other offsets
+       to 0;  it is NULL otherwise. */
+    int co_instrumentation;
+    unsigned char *co_instrumented;
 } PyCodeObject;
 
 /* Masks for co_flags above */
@@ -116,6 +193,29 @@ PyAPI_FUNC(int) _PyCode_CheckLineNumber(PyCodeObject* co,
                                         int lasti, PyAddrPair *bounds);
 #endif
 
+/* Create the inline caches of a code object.  Returns -1 with an exception
+   set on failure. */
+PyAPI_FUNC(int) _PyCode_InitOpcache(PyCodeObject *co);
+
+/* Events of PyCode_SetInstrumentation() */
+#define PyCode_INSTRUMENT_CALL      (1 << PyTrace_CALL)
+#define PyCode_INSTRUMENT_LINE      (1 << PyTrace_LINE)
+#define PyCode_INSTRUMENT_RETURN    (1 << PyTrace_RETURN)
+
+/* Report the given events of a code object, or none for 0, to the function
+   of PyEval_SetInstrumentation() of the running thread:  the calls of the
+   code, the first instruction of each of its lines and its returns.  Unlike
+   PyEval_SetTrace(), it costs nothing to the other code objects.  A frame
+   which runs the code uncached when its line events are set sees them once
+   it goes on in co_quickened, at its next backward jump.  Returns -1 with an
+   exception set on failure. */
+PyAPI_FUNC(int) PyCode_SetInstrumentation(PyCodeObject *co, int events);
+
+/* The innermost try block of the exception table of a code object around the
+   instruction at 'offset' which starts before 'bound', or NULL. */
+PyAPI_FUNC(const _PyExceptionTableEntry *) _PyCode_FindTryBlock(
+    PyCodeObject *co, int offset, int bound);
+
 PyAPI_FUNC(PyObject*) PyCode_Optimize(PyObject *code, PyObject* consts,
                                       PyObject *names, PyObject *lineno_obj);
 
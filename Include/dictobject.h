@@ -19,12 +19,16 @@ typedef struct _dictkeysobject PyDictKeysObject;
 
 /* The ma_values pointer is NULL for a combined table
  * or points to an array of PyObject* for a split table
+ *
+ * ma_version_tag is unique among all dicts, and changes whenever the dict
+ * is modified:  caches of lookups compare it instead of looking again.
  */
 typedef struct {
     PyObject_HEAD
     Py_ssize_t ma_used;
     PyDictKeysObject *ma_keys;
     PyObject **ma_values;
+    PY_UINT64_T ma_version_tag;
 } PyDictObject;
 
 typedef struct {
@@ -84,6 +88,7 @@ PyDictKeysObject *_PyDict_NewKeysForClass(void);
 PyAPI_FUNC(PyObject *) PyObject_GenericGetDict(PyObject *, void *);
 PyAPI_FUNC(int) _PyDict_Next(
     PyObject *mp, Py_ssize_t *pos, PyObject **key, PyObject **value, Py_hash_t *hash);
+PyAPI_FUNC(int) _PyDictIter_Next(PyObject *it, PyObject **pitem);
 PyObject *_PyDictView_New(PyObject *, PyTypeObject *);
 #endif
 PyAPI_FUNC(PyObject *) PyDict_Keys(PyObject *mp);
@@ -140,9 +145,13 @@ PyAPI_FUNC(int) PyDict_DelItemString(PyObject *dp, const char *key);
 #ifndef Py_LIMITED_API
 PyAPI_FUNC(int) _PyDict_DelItemId(PyObject *mp, struct _Py_Identifier *key);
 PyAPI_FUNC(void) _PyDict_DebugMallocStats(FILE *out);
+PyAPI_FUNC(int) _PyDict_NumFree(void);
 
 int _PyObjectDict_SetItem(PyTypeObject *tp, PyObject **dictptr, PyObject *name, PyObject *value);
 PyObject *_PyDict_LoadGlobal(PyDictObject *, PyDictObject *, PyObject *);
+Py_ssize_t _PyDict_GetItemHint(PyDictObject *, PyObject *, Py_ssize_t,
+                               PyObject **);
+int _PyDict_SetItemHint(PyDictObject *, PyObject *, Py_ssize_t, PyObject *);
 #endif
 
 #ifdef __cplusplus
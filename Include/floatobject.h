@@ -111,6 +111,7 @@ PyAPI_FUNC(double) _PyFloat_Unpack8(const unsigned char *p, int le);
 PyAPI_FUNC(int) PyFloat_ClearFreeList(void);
 
 PyAPI_FUNC(void) _PyFloat_DebugMallocStats(FILE* out);
+PyAPI_FUNC(int) _PyFloat_NumFree(void);
 
 /* Format the object based on the format_spec, as defined in PEP 3101
    (Advanced String Formatting). */
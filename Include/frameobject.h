@@ -16,9 +16,16 @@ typedef struct {
     int b_level;                /* value stack level to pop to */
 } PyTryBlock;
 
-typedef struct _frame {
-    PyObject_VAR_HEAD
-    struct _frame *f_back;      /* previous frame, or NULL */
+/* The state of a running or suspended call.  Most of these live on a
+   per-thread stack of frames (see _PyFrame_Push()), and get a frame object
+   only when something asks for one: a traceback, a trace function,
+   PyEval_GetFrame().  Generator frames live in their frame object. */
+typedef struct _interpreter_frame {
+    struct _interpreter_frame *f_previous;  /* calling frame while running */
+    /* The frame object of the frame, or NULL.  A strong reference while the
+       frame is on the frame stack, a borrowed one once the frame object
+       owns the frame. */
+    struct _frame *f_frame_obj;
     PyCodeObject *f_code;       /* code segment */
     PyObject *f_builtins;       /* builtin symbol table (PyDictObject) */
     PyObject *f_globals;        /* global symbol table (PyDictObject) */
@@ -52,6 +59,15 @@ typedef struct _frame {
     char f_executing;           /* whether the frame is still executing */
     PyTryBlock f_blockstack[CO_MAXBLOCKS]; /* for try and loop blocks */
     PyObject *f_localsplus[1];  /* locals+stack, dynamically sized */
+} _PyInterpreterFrame;
+
+typedef struct _frame {
+    PyObject_VAR_HEAD
+    _PyInterpreterFrame *f_frame;   /* on the frame stack, or f_owned */
+    /* previous frame, once this one has left the frame stack; while it is
+       running, f_frame->f_previous is */
+    struct _frame *f_back;
+    _PyInterpreterFrame f_owned;    /* dynamically sized */
 } PyFrameObject;
 
 
@@ -86,10 +102,29 @@ PyAPI_FUNC(void) PyFrame_FastToLocals(PyFrameObject *);
 PyAPI_FUNC(int) PyFrame_ClearFreeList(void);
 
 PyAPI_FUNC(void) _PyFrame_DebugMallocStats(FILE *out);
+PyAPI_FUNC(int) _PyFrame_NumFree(void);
 
 /* Return the line of code the frame is currently executing. */
 PyAPI_FUNC(int) PyFrame_GetLineNumber(PyFrameObject *);
 
+/* The per-thread frame stack */
+
+PyAPI_FUNC(_PyInterpreterFrame *) _PyFrame_Push(PyThreadState *,
+                                                PyCodeObject *,
+                                                PyObject *, PyObject *);
+PyAPI_FUNC(void) _PyFrame_Pop(PyThreadState *, _PyInterpreterFrame *);
+PyAPI_FUNC(void) _PyFrame_ClearThreadStack(PyThreadState *);
+
+/* Return the frame object of a frame, making it if need be:  a borrowed
+   reference, or NULL with an exception set. */
+PyAPI_FUNC(PyFrameObject *) _PyFrame_GetFrameObject(_PyInterpreterFrame *);
+
+PyAPI_FUNC(void) _PyFrame_BlockSetup(_PyInterpreterFrame *, int, int, int);
+PyAPI_FUNC(PyTryBlock *) _PyFrame_BlockPop(_PyInterpreterFrame *);
+PyAPI_FUNC(void) _PyFrame_LocalsToFast(_PyInterpreterFrame *, int);
+PyAPI_FUNC(int) _PyFrame_FastToLocalsWithError(_PyInterpreterFrame *);
+PyAPI_FUNC(int) _PyFrame_GetLineNumber(_PyInterpreterFrame *);
+
 #ifdef __cplusplus
 }
 #endif
@@ -38,6 +38,13 @@ typedef struct {
      */
     Py_ssize_t allocated;
 } PyListObject;
+
+/* The iterator of a list, which FOR_ITER steps inline */
+typedef struct {
+    PyObject_HEAD
+    Py_ssize_t it_index;
+    PyListObject *it_seq; /* Set to NULL when iterator is exhausted */
+} _PyListIterObject;
 #endif
 
 PyAPI_DATA(PyTypeObject) PyList_Type;
@@ -65,6 +72,7 @@ PyAPI_FUNC(PyObject *) _PyList_Extend(PyListObject *, PyObject *);
 
 PyAPI_FUNC(int) PyList_ClearFreeList(void);
 PyAPI_FUNC(void) _PyList_DebugMallocStats(FILE *out);
+PyAPI_FUNC(int) _PyList_NumFree(void);
 #endif
 
 /* Macro, trading safety for speed */
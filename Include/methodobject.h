@@ -19,6 +19,11 @@ typedef PyObject *(*PyCFunction)(PyObject *, PyObject *);
 typedef PyObject *(*PyCFunctionWithKeywords)(PyObject *, PyObject *,
                                              PyObject *);
 typedef PyObject *(*PyNoArgsFunction)(PyObject *);
+#ifndef Py_LIMITED_API
+typedef PyObject *(*_PyCFunctionFast)(PyObject *, PyObject **, Py_ssize_t);
+typedef PyObject *(*_PyCFunctionFastWithKeywords)(PyObject *, PyObject **,
+                                                  Py_ssize_t, PyObject *);
+#endif
 
 PyAPI_FUNC(PyCFunction) PyCFunction_GetFunction(PyObject *);
 PyAPI_FUNC(PyObject *) PyCFunction_GetSelf(PyObject *);
@@ -71,6 +76,15 @@ PyAPI_FUNC(PyObject *) PyCFunction_NewEx(PyMethodDef *, PyObject *,
 
 #define METH_COEXIST   0x0040
 
+#ifndef Py_LIMITED_API
+/* METH_FASTCALL takes the arguments as a C array, the way the vectorcall
+   protocol passes them:  the function is a _PyCFunctionFast, or with
+   METH_KEYWORDS a _PyCFunctionFastWithKeywords, which gets the values of
+   the keyword arguments after the positional ones, and the tuple of their
+   names (or NULL). */
+#define METH_FASTCALL  0x0080
+#endif
+
 #ifndef Py_LIMITED_API
 typedef struct {
     PyObject_HEAD
@@ -78,7 +92,16 @@ typedef struct {
     PyObject    *m_self; /* Passed as 'self' arg to the C func, can be NULL */
     PyObject    *m_module; /* The __module__ attribute, can be anything */
     PyObject    *m_weakreflist; /* List of weak references */
+    vectorcallfunc vectorcall;
 } PyCFunctionObject;
+
+/* Call the C function of 'method' with 'self' and the arguments of a
+   vectorcall, according to its METH_xxx flags */
+PyAPI_FUNC(PyObject *) _PyMethodDef_Vectorcall(PyMethodDef *method,
+                                               PyObject *self,
+                                               PyObject **args,
+                                               Py_ssize_t nargs,
+                                               PyObject *kwnames);
 #endif
 
 PyAPI_FUNC(int) PyCFunction_ClearFreeList(void);
@@ -337,6 +337,15 @@ typedef int (*initproc)(PyObject *, PyObject *, PyObject *);
 typedef PyObject *(*newfunc)(struct _typeobject *, PyObject *, PyObject *);
 typedef PyObject *(*allocfunc)(struct _typeobject *, Py_ssize_t);
 
+#ifndef Py_LIMITED_API
+/* The vectorcall protocol:  call 'callable' with the 'nargs' positional
+   arguments of the array 'args', followed by the values of the keyword
+   arguments named in the tuple 'kwnames', which is NULL if there are none.
+   The arguments are borrowed.  See _PyObject_Vectorcall(). */
+typedef PyObject *(*vectorcallfunc)(PyObject *callable, PyObject **args,
+                                    Py_ssize_t nargs, PyObject *kwnames);
+#endif
+
 #ifdef Py_LIMITED_API
 typedef struct _typeobject PyTypeObject; /* opaque */
 #else
@@ -348,7 +357,9 @@ typedef struct _typeobject {
     /* Methods to implement standard operations */
 
     destructor tp_dealloc;
-    printfunc tp_print;
+    /* Offset of the vectorcallfunc of the instances, if the type has
+       Py_TPFLAGS_HAVE_VECTORCALL.  This was tp_print, unused since 3.0. */
+    Py_ssize_t tp_vectorcall_offset;
     getattrfunc tp_getattr;
     setattrfunc tp_setattr;
     PyAsyncMethods *tp_as_async; /* formerly known as tp_compare (Python 2)
@@ -421,6 +432,10 @@ typedef struct _typeobject {
 
     destructor tp_finalize;
 
+    /* Vectorcall of the type itself, for calls of the type:  found through
+       the tp_vectorcall_offset of its metatype.  Not inherited. */
+    vectorcallfunc tp_vectorcall;
+
 #ifdef COUNT_ALLOCS
     /* these must be last and never explicitly initialized */
     Py_ssize_t tp_allocs;
@@ -564,6 +579,9 @@ _PyObject_GenericGetAttrWithDict(PyObject *, PyObject *, PyObject *);
 PyAPI_FUNC(int)
 _PyObject_GenericSetAttrWithDict(PyObject *, PyObject *,
                                  PyObject *, PyObject *);
+#ifndef Py_LIMITED_API
+PyAPI_FUNC(int) _PyObject_GetMethod(PyObject *, PyObject *, PyObject **);
+#endif
 
 /* Helper to look up a builtin object */
 #ifndef Py_LIMITED_API
@@ -615,6 +633,11 @@ given type object has a specified feature.
 /* Set if the type allows subclassing */
 #define Py_TPFLAGS_BASETYPE (1UL << 10)
 
+/* Set if the instances can be called with the vectorcall protocol, through
+   the function at tp_vectorcall_offset:  when it is NULL, they are called
+   with tp_call.  Not inherited, since a subclass may override __call__. */
+#define Py_TPFLAGS_HAVE_VECTORCALL (1UL << 11)
+
 /* Set if the type is 'ready' -- fully initialized */
 #define Py_TPFLAGS_READY (1UL << 12)
 
@@ -708,7 +731,6 @@ you can count such references to the type object.)
 PyAPI_DATA(Py_ssize_t) _Py_RefTotal;
 PyAPI_FUNC(void) _Py_NegativeRefcount(const char *fname,
                                             int lineno, PyObject *op);
-PyAPI_FUNC(PyObject *) _PyDict_Dummy(void);
 PyAPI_FUNC(Py_ssize_t) _Py_GetRefTotal(void);
 #define _Py_INC_REFTOTAL        _Py_RefTotal++
 #define _Py_DEC_REFTOTAL        _Py_RefTotal--
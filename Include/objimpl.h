@@ -109,6 +109,68 @@ PyAPI_FUNC(void) _PyObject_DebugMallocStats(FILE *out);
 #endif /* #ifndef Py_LIMITED_API */
 #endif
 
+#ifndef Py_LIMITED_API
+/* A snapshot of the state of the object allocator and of the free lists of
+   the builtin types, filled in by _PyObject_GetMallocStats().  Unlike
+   _PyObject_DebugMallocStats(), taking one doesn't visit every pool, so it
+   can be polled periodically (with the GIL held).  Without pymalloc, only
+   the free list counts are filled in. */
+#define _PyObject_MAX_SIZE_CLASSES 128
+#define _PyObject_MAX_NUMA_NODES 64
+
+typedef struct {
+    size_t block_size;          /* bytes per block in this class */
+    size_t num_pools;           /* pools holding blocks of this class */
+    size_t used_blocks;         /* blocks handed out */
+    size_t free_blocks;         /* blocks left in those pools */
+    size_t cached_blocks;       /* free blocks held by thread caches */
+} _PyObject_SizeClassStats;
+
+typedef struct {
+    size_t arenas;              /* arenas allocated for this node */
+    size_t used_pools;          /* their pools holding blocks */
+    size_t free_pools;          /* their empty pools */
+} _PyObject_NumaNodeStats;
+
+typedef struct {
+    unsigned int num_size_classes;
+    _PyObject_SizeClassStats size_classes[_PyObject_MAX_SIZE_CLASSES];
+    Py_ssize_t allocated_blocks;        /* see _Py_GetAllocatedBlocks() */
+    size_t arenas;                      /* arenas currently allocated */
+    size_t arenas_allocated_total;
+    size_t arenas_highwater;
+    size_t free_pools;                  /* empty pools in those arenas */
+    size_t released_pools;              /* ... whose memory was released */
+    size_t released_bytes_total;
+    size_t region_pools;                /* pools owned by object regions */
+    /* arenas per NUMA node, see _PyObject_SetNumaArenas() */
+    unsigned int num_numa_nodes;
+    _PyObject_NumaNodeStats numa_nodes[_PyObject_MAX_NUMA_NODES];
+    /* objects kept in the free lists of the builtin types */
+    int free_tuples;
+    int free_floats;
+    int free_frames;
+    int free_lists;
+    int free_dicts;
+} _PyObject_MallocStats;
+
+PyAPI_FUNC(void) _PyObject_GetMallocStats(_PyObject_MallocStats *stats);
+
+/* Object regions, for objects which die together.
+
+   Between _PyObject_RegionBegin() and the matching _PyObject_RegionEnd(),
+   the small blocks allocated by PyObject_Malloc() and friends in the
+   calling thread are carved from the region's own memory:  allocating them
+   is cheaper, freeing them is almost free, and the region's memory is given
+   back at once when it ends.  Objects may outlive their region; they just
+   keep a piece of its memory alive until they are freed.  Regions nest, and
+   must be ended in the reverse order, by the thread which began them.
+   _PyObject_RegionBegin() returns NULL with an exception set on failure. */
+typedef struct _PyObjectRegion _PyObjectRegion;
+PyAPI_FUNC(_PyObjectRegion *) _PyObject_RegionBegin(void);
+PyAPI_FUNC(void) _PyObject_RegionEnd(_PyObjectRegion *region);
+#endif /* #ifndef Py_LIMITED_API */
+
 /* Macros */
 #define PyObject_MALLOC         PyObject_Malloc
 #define PyObject_REALLOC        PyObject_Realloc
@@ -216,6 +278,29 @@ PyAPI_FUNC(void) PyObject_GetArenaAllocator(PyObjectArenaAllocator *allocator);
 
 /* Set the arena allocator. */
 PyAPI_FUNC(void) PyObject_SetArenaAllocator(PyObjectArenaAllocator *allocator);
+
+typedef enum {
+    /* one mmap() per arena */
+    PYMEM_HUGEPAGES_OFF,
+
+    /* arenas carved from 2 MB regions advised with MADV_HUGEPAGE */
+    PYMEM_HUGEPAGES_THP,
+
+    /* regions mapped with MAP_HUGETLB, falling back to PYMEM_HUGEPAGES_THP
+       if no huge page is available */
+    PYMEM_HUGEPAGES_HUGETLB
+} _PyObject_HugePageMode;
+
+/* Select how the default arena allocator backs new arenas with huge pages.
+   Arenas which are already allocated are not affected.  Return 0 on success,
+   or -1 if the mode is not supported on this platform. */
+PyAPI_FUNC(int) _PyObject_SetHugePageArenas(_PyObject_HugePageMode mode);
+
+/* Keep separate arenas per NUMA node, and serve the small-object allocations
+   of a thread from the arenas of the node it runs on.  Off by default.  On a
+   single-node machine, turning it on succeeds but changes nothing.  Return 0
+   on success, or -1 if the platform can't tell nodes apart. */
+PyAPI_FUNC(int) _PyObject_SetNumaArenas(int enable);
 #endif
 
 
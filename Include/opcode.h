@@ -122,6 +122,48 @@ extern "C" {
 #define BUILD_TUPLE_UNPACK      152
 #define BUILD_SET_UNPACK        153
 #define SETUP_ASYNC_WITH        154
+#define LOAD_METHOD             160
+#define CALL_METHOD             161
+
+/* Specialized forms, which the compiler never emits:  the eval loop rewrites
+   hot BINARY_ADD, INPLACE_ADD, BINARY_SUBSCR, COMPARE_OP and FOR_ITER
+   instructions into them, see ceval.c.  A form takes an argument if the instruction it
+   replaces does. */
+#define BINARY_ADD_INT           30
+#define BINARY_ADD_FLOAT         31
+#define BINARY_SUBSCR_LIST_INT   32
+#define COMPARE_OP_INT          170
+#define COMPARE_OP_FLOAT        171
+#define COMPARE_OP_STR          172
+#define FOR_ITER_LIST           180
+#define FOR_ITER_TUPLE          181
+#define FOR_ITER_RANGE          182
+#define FOR_ITER_DICT           183
+
+/* Superinstructions, which the compiler never emits either:  when the code
+   gets its caches, the first instruction of a frequent pair is rewritten into
+   one, which runs both, see ceval.c.  The second instruction stays in place
+   after it. */
+#define LOAD_FAST__LOAD_FAST    173
+#define LOAD_FAST__LOAD_CONST   174
+#define LOAD_FAST__LOAD_ATTR    175
+#define STORE_FAST__LOAD_FAST   176
+#define LOAD_CONST__RETURN_VALUE 177
+#define COMPARE_OP__POP_JUMP_IF_FALSE 178
+#define COMPARE_OP__POP_JUMP_IF_TRUE 179
+#define BUILD_TUPLE__UNPACK_SEQUENCE 184
+#define BUILD_LIST__UNPACK_SEQUENCE 185
+
+/* The SETUP_WITH of a with statement of the exception table of a code object
+   is rewritten into ENTER_WITH in co_quickened:  it calls __enter__ without
+   setting up a block, see codeobject.c. */
+#define ENTER_WITH              186
+
+/* The first instruction of each line of a code object with line events is
+   rewritten into INSTRUMENTED_LINE in co_quickened, see
+   PyCode_SetInstrumentation().  It takes no argument, whatever the
+   instruction it replaces. */
+#define INSTRUMENTED_LINE        33
 
 /* EXCEPT_HANDLER is a special, implicit block type which is created when
    entering an except handler. It is not an opcode but we define it here
@@ -49,6 +49,12 @@ typedef struct _Py_atomic_int {
 #define _Py_atomic_load_explicit(ATOMIC_VAL, ORDER) \
     atomic_load_explicit(&(ATOMIC_VAL)->_value, ORDER)
 
+#define _Py_atomic_compare_exchange(ATOMIC_VAL, EXPECTED, DESIRED) \
+    atomic_compare_exchange_strong(&(ATOMIC_VAL)->_value, EXPECTED, DESIRED)
+
+#define _Py_atomic_fetch_add(ATOMIC_VAL, VAL) \
+    atomic_fetch_add(&(ATOMIC_VAL)->_value, VAL)
+
 /* Use builtin atomic operations in GCC >= 4.7 */
 #elif defined(HAVE_BUILTIN_ATOMIC)
 
@@ -87,6 +93,13 @@ typedef struct _Py_atomic_int {
             || (ORDER) == __ATOMIC_CONSUME),                  \
      __atomic_load_n(&(ATOMIC_VAL)->_value, ORDER))
 
+#define _Py_atomic_compare_exchange(ATOMIC_VAL, EXPECTED, DESIRED) \
+    __atomic_compare_exchange_n(&(ATOMIC_VAL)->_value, EXPECTED, DESIRED, 0, \
+                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+#define _Py_atomic_fetch_add(ATOMIC_VAL, VAL) \
+    __atomic_fetch_add(&(ATOMIC_VAL)->_value, VAL, __ATOMIC_SEQ_CST)
+
 #else
 
 typedef enum _Py_memory_order {
@@ -219,6 +232,20 @@ _Py_ANNOTATE_MEMORY_ORDER(const volatile void *address, _Py_memory_order order)
         result; \
     })
 
+/* The __sync builtins are full barriers, like seq_cst */
+#define _Py_atomic_compare_exchange(ATOMIC_VAL, EXPECTED, DESIRED) \
+    __extension__ ({ \
+        __typeof__(ATOMIC_VAL) atomic_val = ATOMIC_VAL; \
+        __typeof__(atomic_val->_value) *atomic_expected = EXPECTED; \
+        __typeof__(atomic_val->_value) atomic_old = *atomic_expected; \
+        *atomic_expected = __sync_val_compare_and_swap( \
+            &atomic_val->_value, atomic_old, DESIRED); \
+        *atomic_expected == atomic_old; \
+    })
+
+#define _Py_atomic_fetch_add(ATOMIC_VAL, VAL) \
+    __sync_fetch_and_add(&(ATOMIC_VAL)->_value, VAL)
+
 #else  /* !gcc x86 */
 /* Fall back to other compilers and processors by assuming that simple
    volatile accesses are atomic.  This is false, so people should port
@@ -230,9 +257,56 @@ _Py_ANNOTATE_MEMORY_ORDER(const volatile void *address, _Py_memory_order order)
 #define _Py_atomic_load_explicit(ATOMIC_VAL, ORDER) \
     ((ATOMIC_VAL)->_value)
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+
+/* The Interlocked intrinsics are full barriers, like seq_cst.  The generic
+   compare-exchange picks the long or the pointer flavour by size:  on 32-bit
+   Windows both are the same. */
+static __inline int
+_Py_atomic_cas_long(volatile long *value, long *expected, long desired)
+{
+    long old = *expected;
+    *expected = _InterlockedCompareExchange(value, desired, old);
+    return *expected == old;
+}
+
+static __inline int
+_Py_atomic_cas_pointer(void *volatile *value, void **expected, void *desired)
+{
+    void *old = *expected;
+    *expected = _InterlockedCompareExchangePointer(value, desired, old);
+    return *expected == old;
+}
+
+#define _Py_atomic_compare_exchange(ATOMIC_VAL, EXPECTED, DESIRED) \
+    (sizeof((ATOMIC_VAL)->_value) == sizeof(long) \
+     ? _Py_atomic_cas_long((volatile long *)&(ATOMIC_VAL)->_value, \
+                           (long *)(EXPECTED), (long)(DESIRED)) \
+     : _Py_atomic_cas_pointer((void *volatile *)&(ATOMIC_VAL)->_value, \
+                              (void **)(EXPECTED), (void *)(DESIRED)))
+
+#define _Py_atomic_fetch_add(ATOMIC_VAL, VAL) \
+    _InterlockedExchangeAdd((volatile long *)&(ATOMIC_VAL)->_value, VAL)
+#else
+/* Not atomic either, see above */
+#define _Py_atomic_compare_exchange(ATOMIC_VAL, EXPECTED, DESIRED) \
+    ((ATOMIC_VAL)->_value == *(EXPECTED) \
+     ? ((ATOMIC_VAL)->_value = (DESIRED), 1) \
+     : (*(EXPECTED) = (ATOMIC_VAL)->_value, 0))
+#define _Py_atomic_fetch_add(ATOMIC_VAL, VAL) \
+    (((ATOMIC_VAL)->_value += (VAL)) - (VAL))
+#endif
+
 #endif  /* !gcc x86 */
 #endif
 
+/* _Py_atomic_compare_exchange(ATOMIC_VAL, EXPECTED, DESIRED) is C11's
+   atomic_compare_exchange_strong():  if the value equals *EXPECTED, store
+   DESIRED and return 1, else copy the value to *EXPECTED and return 0.
+   _Py_atomic_fetch_add(ATOMIC_VAL, VAL) adds VAL to a _Py_atomic_int and
+   returns the old value.  Both are seq_cst. */
+
 /* Standardized shortcuts. */
 #define _Py_atomic_store(ATOMIC_VAL, NEW_VAL) \
     _Py_atomic_store_explicit(ATOMIC_VAL, NEW_VAL, _Py_memory_order_seq_cst)
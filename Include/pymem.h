@@ -179,6 +179,23 @@ PyAPI_FUNC(void) PyMem_SetAllocator(PyMemAllocatorDomain domain,
 
    The function does nothing if Python is not compiled is debug mode. */
 PyAPI_FUNC(void) PyMem_SetupDebugHooks(void);
+
+/* Sampling allocation profiler, see Python/memsampler.c.
+
+   _PyMem_StartSampling() hooks the PyMem_Malloc() and PyObject_Malloc()
+   allocators to record the Python stack, up to max_frames frames deep, of
+   about one allocation every sample_bytes bytes.  Samples are aggregated by
+   stack into a table of at most max_stacks entries.  Return 0 on success,
+   or raise an exception and return -1.
+
+   _PyMem_DumpSamples() writes the stacks to out, the ones with the most
+   samples first.  Call them with the GIL held. */
+PyAPI_FUNC(int) _PyMem_StartSampling(size_t sample_bytes,
+                                     int max_frames,
+                                     size_t max_stacks);
+PyAPI_FUNC(void) _PyMem_StopSampling(void);
+PyAPI_FUNC(void) _PyMem_ClearSamples(void);
+PyAPI_FUNC(void) _PyMem_DumpSamples(FILE *out);
 #endif
 
 #ifdef __cplusplus
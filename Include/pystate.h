@@ -36,9 +36,6 @@ typedef struct _is {
 #ifdef HAVE_DLOPEN
     int dlopenflags;
 #endif
-#ifdef WITH_TSC
-    int tscdump;
-#endif
 
     PyObject *builtins_copy;
 } PyInterpreterState;
@@ -48,6 +45,7 @@ typedef struct _is {
 /* State unique per thread */
 
 struct _frame; /* Avoid including frameobject.h */
+struct _interpreter_frame;
 
 #ifndef Py_LIMITED_API
 /* Py_tracefunc return -1 when raising an exception, or 0 for success. */
@@ -73,7 +71,7 @@ typedef struct _ts {
     struct _ts *next;
     PyInterpreterState *interp;
 
-    struct _frame *frame;
+    struct _interpreter_frame *frame;   /* innermost running frame */
     int recursion_depth;
     char overflowed; /* The stack has overflowed. Allow 50 more calls
                         to handle the runtime error. */
@@ -89,6 +87,14 @@ typedef struct _ts {
     Py_tracefunc c_tracefunc;
     PyObject *c_profileobj;
     PyObject *c_traceobj;
+    /* Called for the events of the code objects which have them, see
+       PyCode_SetInstrumentation() */
+    Py_tracefunc c_instrfunc;
+    PyObject *c_instrobj;
+    /* The counts of _PyEval_SetOpcodeProfile(), or NULL */
+    struct _opcode_profile *opcode_profile;
+    /* Instructions until the eval loop calls the opcode profile */
+    int opcode_countdown;
 
     PyObject *curexc_type;
     PyObject *curexc_value;
@@ -137,6 +143,16 @@ typedef struct _ts {
     PyObject *coroutine_wrapper;
     int in_coroutine_wrapper;
 
+    /* Free small-object blocks owned by this thread, see obmalloc.c */
+    struct _obmalloc_tcache *obmalloc_tcache;
+    /* Innermost object region, see _PyObject_RegionBegin() */
+    struct _PyObjectRegion *obmalloc_region;
+    /* The frame stack:  frames of calls are pushed between frame_top and
+       frame_limit in frame_chunk, see frameobject.c */
+    struct _PyFrameChunk *frame_chunk;
+    PyObject **frame_top;
+    PyObject **frame_limit;
+
     /* XXX signal handlers should also be here */
 
 } PyThreadState;
@@ -163,6 +179,10 @@ PyAPI_FUNC(void) _PyThreadState_Init(PyThreadState *);
 PyAPI_FUNC(void) PyThreadState_Clear(PyThreadState *);
 PyAPI_FUNC(void) PyThreadState_Delete(PyThreadState *);
 PyAPI_FUNC(void) _PyThreadState_DeleteExcept(PyThreadState *tstate);
+#ifndef Py_LIMITED_API
+/* Give the blocks cached by a thread state back to obmalloc's pools */
+PyAPI_FUNC(void) _PyObject_ClearThreadCache(PyThreadState *tstate);
+#endif
 #ifdef WITH_THREAD
 PyAPI_FUNC(void) PyThreadState_DeleteCurrent(void);
 PyAPI_FUNC(void) _PyGILState_Reinit(void);
@@ -21,6 +21,20 @@ PyAPI_DATA(PyTypeObject) PyLongRangeIter_Type;
 
 #define PyRange_Check(op) (Py_TYPE(op) == &PyRange_Type)
 
+#ifndef Py_LIMITED_API
+/* The iterator of a range within the bounds of a C long, which FOR_ITER
+   steps inline */
+typedef struct {
+    PyObject_HEAD
+    long index;
+    long start;
+    long step;
+    long len;
+} _PyRangeIterObject;
+
+PyAPI_FUNC(int) _PyLongRangeIter_Next(PyObject *it, PyObject **pitem);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
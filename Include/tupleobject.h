@@ -31,6 +31,13 @@ typedef struct {
      * the tuple is not yet visible outside the function that builds it.
      */
 } PyTupleObject;
+
+/* The iterator of a tuple, which FOR_ITER steps inline */
+typedef struct {
+    PyObject_HEAD
+    Py_ssize_t it_index;
+    PyTupleObject *it_seq; /* Set to NULL when iterator is exhausted */
+} _PyTupleIterObject;
 #endif
 
 PyAPI_DATA(PyTypeObject) PyTuple_Type;
@@ -65,6 +72,7 @@ PyAPI_FUNC(void) _PyTuple_MaybeUntrack(PyObject *);
 PyAPI_FUNC(int) PyTuple_ClearFreeList(void);
 #ifndef Py_LIMITED_API
 PyAPI_FUNC(void) _PyTuple_DebugMallocStats(FILE *out);
+PyAPI_FUNC(int) _PyTuple_NumFree(void);
 #endif /* Py_LIMITED_API */
 
 #ifdef __cplusplus
@@ -2012,6 +2012,12 @@ PyAPI_FUNC(int) _PyUnicode_CompareWithId(
     PyObject *left,             /* Left string */
     _Py_Identifier *right       /* Right identifier */
     );
+
+/* Return 1 if two ready strings are equal, 0 if not.  It can't fail. */
+PyAPI_FUNC(int) _PyUnicode_EQ(
+    PyObject *left,             /* Left string */
+    PyObject *right             /* Right string */
+    );
 #endif
 
 PyAPI_FUNC(int) PyUnicode_CompareWithASCIIString(
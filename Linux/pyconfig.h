@@ -0,0 +1,147 @@
+#ifndef Py_CONFIG_H
+#define Py_CONFIG_H
+
+/* pyconfig.h.  NOT Generated automatically by configure.
+
+This is a manually maintained version used for gcc and clang on Linux with
+glibc, the counterpart of PC/pyconfig.h for Linux/Makefile.  It only covers
+what the object core needs:  there is no threading, dynamic loading or
+posix module in this tree.
+
+Type sizes and byte order come from the compiler's predefined macros, so the
+same file serves 32-bit and 64-bit, little- and big-endian targets.
+*/
+
+#ifndef __linux__
+#error "Linux/pyconfig.h is for Linux; use PC/pyconfig.h on Windows"
+#endif
+
+/* Expose the GNU and POSIX interfaces of glibc (sched_getcpu(), memrchr(),
+   mremap(), ...), and 64-bit file offsets on 32-bit targets.  This must come
+   before any system header. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+#define _FILE_OFFSET_BITS 64
+#define _LARGEFILE_SOURCE 1
+
+#define PLATFORM "linux"
+
+#if defined(__clang__)
+#define COMPILER "[Clang " __clang_version__ "]"
+#elif defined(__GNUC__)
+#define COMPILER "[GCC " __VERSION__ "]"
+#endif
+
+/* ------------------------------------------------------------------------*/
+/* Type sizes */
+
+#define SIZEOF_SHORT            __SIZEOF_SHORT__
+#define SIZEOF_INT              __SIZEOF_INT__
+#define SIZEOF_LONG             __SIZEOF_LONG__
+#define SIZEOF_LONG_LONG        __SIZEOF_LONG_LONG__
+#define SIZEOF_FLOAT            __SIZEOF_FLOAT__
+#define SIZEOF_DOUBLE           __SIZEOF_DOUBLE__
+#define SIZEOF_LONG_DOUBLE      __SIZEOF_LONG_DOUBLE__
+#define SIZEOF_VOID_P           __SIZEOF_POINTER__
+#define SIZEOF_SIZE_T           __SIZEOF_SIZE_T__
+#define SIZEOF_UINTPTR_T        __SIZEOF_POINTER__
+#define SIZEOF_WCHAR_T          __SIZEOF_WCHAR_T__
+#define SIZEOF__BOOL            1
+#define SIZEOF_PID_T            4
+#define SIZEOF_OFF_T            8
+#define SIZEOF_TIME_T           __SIZEOF_LONG__
+#define SIZEOF_PTHREAD_T        __SIZEOF_LONG__
+#define SIZEOF_FPOS_T           16
+
+#define HAVE_LONG_LONG 1
+#define HAVE_C99_BOOL 1
+#define HAVE_SSIZE_T 1
+#define HAVE_UINTPTR_T 1
+#define HAVE_INTPTR_T 1
+#define HAVE_UINT32_T 1
+#define HAVE_UINT64_T 1
+#define HAVE_INT32_T 1
+#define HAVE_INT64_T 1
+
+#if SIZEOF_OFF_T > SIZEOF_LONG
+#define HAVE_LARGEFILE_SUPPORT 1
+#endif
+
+#define PY_FORMAT_SIZE_T "z"
+#define PY_FORMAT_LONG_LONG "ll"
+
+/* x86-64 and powerpc pass va_list as a pointer to an array */
+#if defined(__x86_64__) || defined(__powerpc__)
+#define VA_LIST_IS_ARRAY 1
+#endif
+
+/* ------------------------------------------------------------------------*/
+/* Floating point */
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define WORDS_BIGENDIAN 1
+#define DOUBLE_IS_BIG_ENDIAN_IEEE754 1
+#else
+#define DOUBLE_IS_LITTLE_ENDIAN_IEEE754 1
+#endif
+
+/* HAVE_GCC_ASM_FOR_X87 is left undefined:  _Py_set_387controlword() lives in
+   Python/pymath.c, which isn't part of this tree.  x87-only i386 builds fall
+   back to the old float repr. */
+#if defined(__i386__) && !defined(__SSE2_MATH__)
+#define X87_DOUBLE_ROUNDING 1
+#endif
+
+#define HAVE_COPYSIGN 1
+#define HAVE_HYPOT 1
+#define HAVE_ROUND 1
+#define HAVE_DECL_ISFINITE 1
+#define HAVE_DECL_ISINF 1
+#define HAVE_DECL_ISNAN 1
+
+/* ------------------------------------------------------------------------*/
+/* Headers and functions of glibc */
+
+#define STDC_HEADERS 1
+#define HAVE_STDARG_PROTOTYPES 1
+#define HAVE_PROTOTYPES 1
+#define HAVE_ERRNO_H 1
+#define HAVE_FCNTL_H 1
+#define HAVE_INTTYPES_H 1
+#define HAVE_LANGINFO_H 1
+#define HAVE_SIGNAL_H 1
+#define HAVE_STDDEF_H 1
+#define HAVE_STDINT_H 1
+#define HAVE_SYS_STAT_H 1
+#define HAVE_SYS_TIME_H 1
+#define HAVE_SYS_TYPES_H 1
+#define HAVE_UNISTD_H 1
+#define HAVE_WCHAR_H 1
+
+#define HAVE_CLOCK_GETTIME 1
+#define HAVE_GETC_UNLOCKED 1
+#define HAVE_MBRTOWC 1
+#define HAVE_MEMRCHR 1
+#define HAVE_MMAP 1
+#define HAVE_READLINK 1
+#define HAVE_REALPATH 1
+#define HAVE_SNPRINTF 1
+#define HAVE_SYSCONF 1
+#define HAVE_WMEMCMP 1
+
+/* ------------------------------------------------------------------------*/
+/* Compiler features */
+
+#define HAVE_BUILTIN_ATOMIC 1
+/* Python/opcode_targets.h isn't part of this tree, so ceval.c keeps its
+   switch dispatch:  HAVE_COMPUTED_GOTOS is left undefined. */
+
+/* ------------------------------------------------------------------------*/
+/* Python features */
+
+#define WITH_DOC_STRINGS 1
+#define WITH_PYMALLOC 1
+/* #define WITH_THREAD 1 */
+
+#endif /* !Py_CONFIG_H */
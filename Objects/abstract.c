@@ -2169,6 +2169,205 @@ PyObject_Call(PyObject *func, PyObject *arg, PyObject *kw)
     return _Py_CheckFunctionResult(func, result, NULL);
 }
 
+/* The vectorcall of callable, or NULL if it has none */
+static vectorcallfunc
+vectorcall_function(PyObject *callable)
+{
+    PyTypeObject *tp = Py_TYPE(callable);
+
+    if (!PyType_HasFeature(tp, Py_TPFLAGS_HAVE_VECTORCALL))
+        return NULL;
+    assert(tp->tp_vectorcall_offset > 0);
+    return *(vectorcallfunc *)((char *)callable + tp->tp_vectorcall_offset);
+}
+
+PyObject *
+_PyObject_Vectorcall(PyObject *callable, PyObject **args, Py_ssize_t nargs,
+                     PyObject *kwnames)
+{
+    vectorcallfunc func;
+    PyObject *result;
+
+    /* _PyObject_Vectorcall() must not be called with an exception set,
+       because it may clear it (directly or indirectly) and so the
+       caller loses its exception */
+    assert(!PyErr_Occurred());
+    assert(nargs >= 0);
+    assert(kwnames == NULL || PyTuple_CheckExact(kwnames));
+
+    func = vectorcall_function(callable);
+    if (func == NULL)
+        return _PyObject_MakeTpCall(callable, args, nargs, kwnames);
+    result = func(callable, args, nargs, kwnames);
+    return _Py_CheckFunctionResult(callable, result, NULL);
+}
+
+PyObject *
+_PyObject_MakeTpCall(PyObject *callable, PyObject **args, Py_ssize_t nargs,
+                     PyObject *kwnames)
+{
+    PyObject *argstuple, *kwdict = NULL, *result;
+
+    argstuple = _PyStack_AsTuple(args, nargs);
+    if (argstuple == NULL)
+        return NULL;
+    if (kwnames != NULL && PyTuple_GET_SIZE(kwnames) > 0) {
+        kwdict = _PyStack_AsDict(args + nargs, kwnames);
+        if (kwdict == NULL) {
+            Py_DECREF(argstuple);
+            return NULL;
+        }
+    }
+    result = PyObject_Call(callable, argstuple, kwdict);
+    Py_DECREF(argstuple);
+    Py_XDECREF(kwdict);
+    return result;
+}
+
+/* Make the arguments of a vectorcall of the nargs arguments in args and the
+   keyword arguments in the dict kwargs, which must not be empty:  the new
+   array *p_stack and the tuple *p_kwnames.  The positional arguments stay
+   borrowed, but the array holds references to the values of kwargs, since
+   the callee may change the dict.  Release them with
+   stack_unpack_dict_free(). */
+static int
+stack_unpack_dict(PyObject **args, Py_ssize_t nargs, PyObject *kwargs,
+                  PyObject ***p_stack, PyObject **p_kwnames)
+{
+    PyObject **stack, *kwnames, *key, *value;
+    Py_ssize_t nkwargs = PyDict_Size(kwargs), pos = 0, i = 0;
+
+    assert(nkwargs > 0);
+    if ((size_t)nargs > PY_SSIZE_T_MAX / sizeof(PyObject *) - nkwargs) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    stack = PyMem_Malloc((nargs + nkwargs) * sizeof(PyObject *));
+    if (stack == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    kwnames = PyTuple_New(nkwargs);
+    if (kwnames == NULL) {
+        PyMem_Free(stack);
+        return -1;
+    }
+    memcpy(stack, args, nargs * sizeof(PyObject *));
+    while (PyDict_Next(kwargs, &pos, &key, &value)) {
+        Py_INCREF(key);
+        Py_INCREF(value);
+        PyTuple_SET_ITEM(kwnames, i, key);
+        stack[nargs + i] = value;
+        i++;
+    }
+    *p_stack = stack;
+    *p_kwnames = kwnames;
+    return 0;
+}
+
+static void
+stack_unpack_dict_free(PyObject **stack, Py_ssize_t nargs, PyObject *kwnames)
+{
+    Py_ssize_t i;
+
+    for (i = 0; i < PyTuple_GET_SIZE(kwnames); i++)
+        Py_DECREF(stack[nargs + i]);
+    PyMem_Free(stack);
+    Py_DECREF(kwnames);
+}
+
+PyObject *
+_PyObject_VectorcallDict(PyObject *callable, PyObject **args,
+                         Py_ssize_t nargs, PyObject *kwargs)
+{
+    vectorcallfunc func;
+    PyObject **stack, *kwnames, *result;
+
+    assert(!PyErr_Occurred());
+    assert(nargs >= 0);
+    assert(kwargs == NULL || PyDict_Check(kwargs));
+
+    func = vectorcall_function(callable);
+    if (func == NULL) {
+        PyObject *argstuple = _PyStack_AsTuple(args, nargs);
+        if (argstuple == NULL)
+            return NULL;
+        result = PyObject_Call(callable, argstuple, kwargs);
+        Py_DECREF(argstuple);
+        return result;
+    }
+    if (kwargs == NULL || PyDict_Size(kwargs) == 0)
+        result = func(callable, args, nargs, NULL);
+    else {
+        if (stack_unpack_dict(args, nargs, kwargs, &stack, &kwnames) < 0)
+            return NULL;
+        result = func(callable, stack, nargs, kwnames);
+        stack_unpack_dict_free(stack, nargs, kwnames);
+    }
+    return _Py_CheckFunctionResult(callable, result, NULL);
+}
+
+PyObject *
+_PyVectorcall_Call(PyObject *callable, PyObject *args, PyObject *kwargs)
+{
+    vectorcallfunc func = vectorcall_function(callable);
+    Py_ssize_t nargs;
+    PyObject **stack, *kwnames, *result;
+
+    if (func == NULL) {
+        PyErr_Format(PyExc_TypeError,
+                     "'%.200s' object does not support vectorcall",
+                     Py_TYPE(callable)->tp_name);
+        return NULL;
+    }
+    assert(PyTuple_Check(args));
+    nargs = PyTuple_GET_SIZE(args);
+    if (kwargs == NULL || PyDict_Size(kwargs) == 0)
+        return func(callable, &PyTuple_GET_ITEM(args, 0), nargs, NULL);
+    if (stack_unpack_dict(&PyTuple_GET_ITEM(args, 0), nargs, kwargs,
+                          &stack, &kwnames) < 0)
+        return NULL;
+    result = func(callable, stack, nargs, kwnames);
+    stack_unpack_dict_free(stack, nargs, kwnames);
+    return result;
+}
+
+PyObject *
+_PyStack_AsTuple(PyObject **stack, Py_ssize_t nargs)
+{
+    PyObject *args;
+    Py_ssize_t i;
+
+    args = PyTuple_New(nargs);
+    if (args == NULL)
+        return NULL;
+    for (i = 0; i < nargs; i++) {
+        PyObject *item = stack[i];
+        Py_INCREF(item);
+        PyTuple_SET_ITEM(args, i, item);
+    }
+    return args;
+}
+
+PyObject *
+_PyStack_AsDict(PyObject **values, PyObject *kwnames)
+{
+    Py_ssize_t i, nkwargs = PyTuple_GET_SIZE(kwnames);
+    PyObject *kwdict;
+
+    kwdict = _PyDict_NewPresized(nkwargs);
+    if (kwdict == NULL)
+        return NULL;
+    for (i = 0; i < nkwargs; i++) {
+        if (PyDict_SetItem(kwdict, PyTuple_GET_ITEM(kwnames, i),
+                           values[i]) < 0) {
+            Py_DECREF(kwdict);
+            return NULL;
+        }
+    }
+    return kwdict;
+}
+
 static PyObject*
 call_function_tail(PyObject *callable, PyObject *args)
 {
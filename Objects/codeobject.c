@@ -1,5 +1,6 @@
 #include "Python.h"
 #include "code.h"
+#include "opcode.h"
 #include "structmember.h"
 
 #define NAME_CHARS \
@@ -47,6 +48,421 @@ intern_strings(PyObject *tuple)
 }
 
 
+/* Exception table
+
+   The compiler brackets the body of a try statement with a SETUP_EXCEPT or
+   SETUP_FINALLY and a POP_BLOCK, which push and pop a block on the block
+   stack of the frame each time the body runs, whether it raises or not.
+   The body of a with statement is the same, with a SETUP_WITH or a
+   SETUP_ASYNC_WITH which set up a 'finally' block under the result of
+   __enter__, to run __exit__.  A block whose stack level is the same
+   whichever path the code takes to it doesn't need that:
+   build_exception_table() puts it in co_exceptiontable, the eval loop
+   doesn't set it up or pop it, and it searches the table when it unwinds
+   only.  The SETUP_WITH of a with statement still calls __enter__.
+
+   The stack levels come from a walk of the code along the paths which don't
+   raise, see walk_code().  A 'finally' clause is walked from the end of its
+   try body, where it gets a None:  the try blocks inside it, which a return
+   or an exception gets to with more on the stack, stay on the block stack,
+   as do those of code which doesn't look like the compiler's.
+*/
+
+#define STACK_EFFECT_UNKNOWN 1000
+
+/* What an instruction does to the stack level when it goes on with the next
+   one, and doesn't raise;  the jumps are in walk_code() */
+static int
+stack_effect(int opcode, int oparg)
+{
+#define NARGS(o) (((o) & 0xff) + 2 * (((o) >> 8) & 0xff))
+    switch (opcode) {
+    case NOP:
+    case ROT_TWO:
+    case ROT_THREE:
+    case UNARY_POSITIVE:
+    case UNARY_NEGATIVE:
+    case UNARY_NOT:
+    case UNARY_INVERT:
+    case GET_ITER:
+    case GET_YIELD_FROM_ITER:
+    case GET_AITER:
+    case GET_AWAITABLE:
+    case YIELD_VALUE:
+    case POP_BLOCK:
+    case SETUP_LOOP:
+    case SETUP_EXCEPT:
+    case SETUP_FINALLY:
+    case SETUP_ASYNC_WITH:
+    case LOAD_ATTR:
+    case DELETE_NAME:
+    case DELETE_GLOBAL:
+    case DELETE_FAST:
+    case DELETE_DEREF:
+        return 0;
+
+    case DUP_TOP:
+    case GET_ANEXT:
+    case BEFORE_ASYNC_WITH:
+    case LOAD_BUILD_CLASS:
+    case IMPORT_FROM:
+    case LOAD_CONST:
+    case LOAD_NAME:
+    case LOAD_GLOBAL:
+    case LOAD_FAST:
+    case LOAD_CLOSURE:
+    case LOAD_DEREF:
+    case LOAD_CLASSDEREF:
+    case LOAD_METHOD:
+    case SETUP_WITH:            /* the __exit__ and the result of __enter__ */
+    case WITH_CLEANUP_START:    /* takes the __exit__ off, pushes two */
+        return 1;
+    case DUP_TOP_TWO:
+        return 2;
+
+    case POP_TOP:
+    case BINARY_MATRIX_MULTIPLY:
+    case INPLACE_MATRIX_MULTIPLY:
+    case BINARY_POWER:
+    case BINARY_MULTIPLY:
+    case BINARY_MODULO:
+    case BINARY_ADD:
+    case BINARY_SUBTRACT:
+    case BINARY_SUBSCR:
+    case BINARY_FLOOR_DIVIDE:
+    case BINARY_TRUE_DIVIDE:
+    case INPLACE_FLOOR_DIVIDE:
+    case INPLACE_TRUE_DIVIDE:
+    case INPLACE_ADD:
+    case INPLACE_SUBTRACT:
+    case INPLACE_MULTIPLY:
+    case INPLACE_MODULO:
+    case BINARY_LSHIFT:
+    case BINARY_RSHIFT:
+    case BINARY_AND:
+    case BINARY_XOR:
+    case BINARY_OR:
+    case INPLACE_POWER:
+    case INPLACE_LSHIFT:
+    case INPLACE_RSHIFT:
+    case INPLACE_AND:
+    case INPLACE_XOR:
+    case INPLACE_OR:
+    case PRINT_EXPR:
+    case YIELD_FROM:
+    case IMPORT_STAR:
+    case END_FINALLY:           /* None */
+    case STORE_NAME:
+    case DELETE_ATTR:
+    case STORE_GLOBAL:
+    case COMPARE_OP:
+    case IMPORT_NAME:
+    case STORE_FAST:
+    case STORE_DEREF:
+    case LIST_APPEND:
+    case SET_ADD:
+        return -1;
+    case DELETE_SUBSCR:
+    case STORE_ATTR:
+    case MAP_ADD:
+    case WITH_CLEANUP_FINISH:   /* the None of __exit__ and its result */
+        return -2;
+    case STORE_SUBSCR:
+    case POP_EXCEPT:            /* the exception it saved */
+        return -3;
+
+    case UNPACK_SEQUENCE:
+        return oparg - 1;
+    case UNPACK_EX:
+        return (oparg & 0xff) + (oparg >> 8);
+    case BUILD_TUPLE:
+    case BUILD_LIST:
+    case BUILD_SET:
+    case BUILD_LIST_UNPACK:
+    case BUILD_TUPLE_UNPACK:
+    case BUILD_SET_UNPACK:
+    case BUILD_MAP_UNPACK:
+        return 1 - oparg;
+    case BUILD_MAP_UNPACK_WITH_CALL:
+        return 1 - (oparg & 0xff);
+    case BUILD_MAP:
+        return 1 - 2 * oparg;
+    case BUILD_SLICE:
+        return oparg == 3 ? -2 : -1;
+    case CALL_FUNCTION:
+        return -NARGS(oparg);
+    case CALL_FUNCTION_VAR:
+    case CALL_FUNCTION_KW:
+        return -NARGS(oparg) - 1;
+    case CALL_FUNCTION_VAR_KW:
+        return -NARGS(oparg) - 2;
+    case CALL_METHOD:
+        return -oparg - 1;
+    case MAKE_FUNCTION:
+        return -1 - NARGS(oparg) - ((oparg >> 16) & 0xffff);
+    case MAKE_CLOSURE:
+        return -2 - NARGS(oparg) - ((oparg >> 16) & 0xffff);
+    default:
+        return STACK_EFFECT_UNKNOWN;
+    }
+#undef NARGS
+}
+
+/* What the walk knows of the stack before an instruction */
+typedef struct {
+    int level;      /* -1 while no path got to the instruction */
+    int exc;        /* the level with the exception an except clause is
+                       matching on top, while the stack is as high;  else 0 */
+    int fin;        /* the level of the None of the 'finally' clause the
+                       instruction is in, while the stack is as high;  else 0 */
+} walk_state;
+
+#define WALK_INSTR 1    /* an instruction starts at the offset */
+#define WALK_FIN   2    /* the handler of a SETUP_FINALLY, SETUP_WITH or
+                           SETUP_ASYNC_WITH starts at the offset */
+
+/* Walk the code from its start and fill 'states', given the 'flags' of the
+   offsets.  Returns 0 if the paths disagree on a level, or the code is odd
+   in some other way. */
+static int
+walk_code(const unsigned char *code, int size, int stacksize,
+          const char *flags, walk_state *states, int *pending)
+{
+    int npending = 0;
+    int i;
+
+    for (i = 0; i < size; i++)
+        states[i].level = -1;
+    states[0].level = 0;
+    states[0].exc = states[0].fin = 0;
+    pending[npending++] = 0;
+
+#define GOTO(target, lvl, ex) \
+    do { \
+        walk_state s_; \
+        int t_ = (target); \
+        s_.level = (lvl); \
+        s_.exc = (ex); \
+        s_.fin = st.fin; \
+        if (t_ < 0 || t_ >= size || !(flags[t_] & WALK_INSTR) || \
+            s_.level < 0 || s_.level > stacksize) \
+            return 0; \
+        if (s_.exc > s_.level) \
+            s_.exc = 0; \
+        if (s_.fin > s_.level) \
+            s_.fin = 0; \
+        if ((flags[t_] & WALK_FIN) && s_.fin == 0) \
+            s_.fin = s_.level; \
+        if (states[t_].level < 0) { \
+            states[t_] = s_; \
+            pending[npending++] = t_; \
+        } \
+        else if (states[t_].level != s_.level || \
+                 states[t_].exc != s_.exc || states[t_].fin != s_.fin) \
+            return 0; \
+    } while (0)
+
+    while (npending > 0) {
+        walk_state st = states[i = pending[--npending]];
+        int opcode = code[i], oparg = 0, next = i + 1, effect;
+
+        if (HAS_ARG(opcode)) {
+            next = i + 3;
+            if (next > size)
+                return 0;
+            oparg = (code[i + 2] << 8) + code[i + 1];
+        }
+        switch (opcode) {
+        case JUMP_FORWARD:
+            GOTO(next + oparg, st.level, st.exc);
+            break;
+        case JUMP_ABSOLUTE:
+            GOTO(oparg, st.level, st.exc);
+            break;
+        case POP_JUMP_IF_FALSE:
+        case POP_JUMP_IF_TRUE:
+            GOTO(oparg, st.level - 1, st.exc);
+            GOTO(next, st.level - 1, st.exc);
+            break;
+        case JUMP_IF_FALSE_OR_POP:
+        case JUMP_IF_TRUE_OR_POP:
+            GOTO(oparg, st.level, st.exc);
+            GOTO(next, st.level - 1, st.exc);
+            break;
+        case FOR_ITER:
+            GOTO(next + oparg, st.level - 1, st.exc);
+            GOTO(next, st.level + 1, st.exc);
+            break;
+        case SETUP_LOOP:
+            /* where a break goes */
+            GOTO(next + oparg, st.level, st.exc);
+            GOTO(next, st.level, st.exc);
+            break;
+        case SETUP_EXCEPT:
+            /* the saved exception and the one raised */
+            GOTO(next + oparg, st.level + 6, st.level + 6);
+            GOTO(next, st.level, st.exc);
+            break;
+        case RETURN_VALUE:
+        case RAISE_VARARGS:
+        case BREAK_LOOP:
+        case CONTINUE_LOOP:
+            break;
+        case END_FINALLY:
+            /* re-raises the exception no except clause matched */
+            if (st.exc == 0)
+                GOTO(next, st.level - 1, 0);
+            break;
+        default:
+            effect = stack_effect(opcode, oparg);
+            if (effect == STACK_EFFECT_UNKNOWN)
+                return 0;
+            GOTO(next, st.level + effect, st.exc);
+            break;
+        }
+    }
+#undef GOTO
+    return 1;
+}
+
+/* Fill co_exceptiontable, see above.  Returns -1 with an exception set on
+   failure. */
+static int
+build_exception_table(PyCodeObject *co)
+{
+    const unsigned char *code;
+    walk_state *states = NULL;
+    int *pending = NULL;
+    char *flags = NULL;
+    _PyExceptionTableEntry *table = NULL;
+    int *nest = NULL;
+    int size, i, n, ntries = 0, nnest;
+
+    co->co_exceptiontable = NULL;
+    co->co_exceptiontable_size = 0;
+    if (!PyBytes_Check(co->co_code) ||
+        PyBytes_GET_SIZE(co->co_code) > INT_MAX)
+        return 0;
+    code = (const unsigned char *)PyBytes_AS_STRING(co->co_code);
+    size = (int)PyBytes_GET_SIZE(co->co_code);
+    for (i = 0; i < size; i += HAS_ARG(code[i]) ? 3 : 1) {
+        if (code[i] == SETUP_EXCEPT || code[i] == SETUP_FINALLY ||
+            code[i] == SETUP_WITH || code[i] == SETUP_ASYNC_WITH)
+            ntries++;
+        else if (code[i] == EXTENDED_ARG)
+            return 0;
+    }
+    if (ntries == 0)
+        return 0;
+
+    states = PyMem_NEW(walk_state, size);
+    pending = PyMem_NEW(int, size);
+    flags = (char *)PyMem_Calloc(size, 1);
+    if (states == NULL || pending == NULL || flags == NULL)
+        goto nomemory;
+    for (i = 0; i < size; i += HAS_ARG(code[i]) ? 3 : 1)
+        flags[i] |= WALK_INSTR;
+    for (i = 0; i + 2 < size; i += HAS_ARG(code[i]) ? 3 : 1) {
+        if (code[i] == SETUP_FINALLY || code[i] == SETUP_WITH ||
+            code[i] == SETUP_ASYNC_WITH) {
+            int handler = i + 3 + (code[i + 2] << 8) + code[i + 1];
+            if (handler < size)
+                flags[handler] |= WALK_FIN;
+        }
+    }
+    if (!walk_code(code, size, co->co_stacksize, flags, states, pending))
+        goto done;
+
+    table = PyMem_NEW(_PyExceptionTableEntry, ntries);
+    nest = PyMem_NEW(int, ntries);
+    if (table == NULL || nest == NULL)
+        goto nomemory;
+    n = nnest = 0;
+    for (i = 0; i < size; i += HAS_ARG(code[i]) ? 3 : 1) {
+        int start = i + 3, handler, end, level;
+        walk_state *st = &states[i];
+
+        if (st->level < 0 || st->exc != 0 || st->fin != 0)
+            continue;
+        /* The level of the block:  a SETUP_WITH replaces the context
+           manager with its __exit__, a SETUP_ASYNC_WITH sets the block up
+           under the result of __aenter__ */
+        if (code[i] == SETUP_EXCEPT || code[i] == SETUP_FINALLY ||
+            code[i] == SETUP_WITH)
+            level = st->level;
+        else if (code[i] == SETUP_ASYNC_WITH)
+            level = st->level - 1;
+        else
+            continue;
+        handler = start + (code[i + 2] << 8) + code[i + 1];
+        if (handler > size)
+            continue;
+        /* The body ends with POP_BLOCK, then a jump over the except
+           clauses, or the None for the 'finally' clause or __exit__;  the
+           one which deletes the name of an except clause has a POP_EXCEPT
+           first */
+        end = handler - 4;
+        if (code[i] == SETUP_FINALLY && end > start &&
+            code[end] == POP_EXCEPT && (flags[end] & WALK_INSTR))
+            end--;
+        if (end < start || !(flags[end] & WALK_INSTR) ||
+            code[end] != POP_BLOCK || !(flags[handler - 3] & WALK_INSTR) ||
+            code[handler - 3] != (code[i] == SETUP_EXCEPT ? JUMP_FORWARD
+                                                          : LOAD_CONST) ||
+            (states[end].level >= 0 && states[end].level != level))
+            continue;
+        /* The try blocks have to nest */
+        while (nnest > 0 && table[nest[nnest - 1]].end < start)
+            nnest--;
+        if (nnest > 0 && table[nest[nnest - 1]].end < end)
+            goto done;
+        nest[nnest++] = n;
+        table[n].start = start;
+        table[n].end = end;
+        table[n].handler = handler;
+        table[n].level = level;
+        table[n].type = code[i] == SETUP_EXCEPT ? SETUP_EXCEPT : SETUP_FINALLY;
+        n++;
+    }
+    if (n > 0) {
+        co->co_exceptiontable = table;
+        co->co_exceptiontable_size = n;
+        table = NULL;
+    }
+  done:
+    PyMem_FREE(states);
+    PyMem_FREE(pending);
+    PyMem_FREE(flags);
+    PyMem_FREE(table);
+    PyMem_FREE(nest);
+    return 0;
+
+  nomemory:
+    PyMem_FREE(states);
+    PyMem_FREE(pending);
+    PyMem_FREE(flags);
+    PyMem_FREE(table);
+    PyMem_FREE(nest);
+    PyErr_NoMemory();
+    return -1;
+}
+
+const _PyExceptionTableEntry *
+_PyCode_FindTryBlock(PyCodeObject *co, int offset, int bound)
+{
+    int i;
+
+    /* Sorted by start and nesting, the first one around the offset from
+       the end is the innermost */
+    for (i = co->co_exceptiontable_size; --i >= 0; ) {
+        const _PyExceptionTableEntry *entry = &co->co_exceptiontable[i];
+        if (entry->start <= offset && offset <= entry->end &&
+            entry->start < bound)
+            return entry;
+    }
+    return NULL;
+}
+
 PyCodeObject *
 PyCode_New(int argcount, int kwonlyargcount,
            int nlocals, int stacksize, int flags,
@@ -152,6 +568,17 @@ PyCode_New(int argcount, int kwonlyargcount,
     co->co_lnotab = lnotab;
     co->co_zombieframe = NULL;
     co->co_weakreflist = NULL;
+    co->co_opcache_map = NULL;
+    co->co_opcache = NULL;
+    co->co_opcache_flag = 0;
+    co->co_opcache_size = 0;
+    co->co_quickened = NULL;
+    co->co_instrumentation = 0;
+    co->co_instrumented = NULL;
+    if (build_exception_table(co) < 0) {
+        Py_DECREF(co);
+        return NULL;
+    }
     return co;
 }
 
@@ -358,6 +785,217 @@ code_new(PyTypeObject *type, PyObject *args, PyObject *kw)
     return co;
 }
 
+/* The instructions which get an inline cache */
+#define OPCODE_HAS_CACHE(op) \
+    ((op) == LOAD_GLOBAL || (op) == LOAD_ATTR || (op) == STORE_ATTR || \
+     (op) == LOAD_METHOD || (op) == BINARY_ADD || (op) == INPLACE_ADD || \
+     (op) == BINARY_SUBSCR || (op) == COMPARE_OP || (op) == FOR_ITER)
+
+/* Pairs of instructions which often run one after the other, according to
+   the DXPAIRS counts of ceval.c, or which make a tuple or list only to
+   unpack it, and the superinstruction which runs both */
+static const struct {
+    unsigned char first;
+    unsigned char second;
+    unsigned char fused;
+} superinstructions[] = {
+    {LOAD_FAST, LOAD_FAST, LOAD_FAST__LOAD_FAST},
+    {LOAD_FAST, LOAD_CONST, LOAD_FAST__LOAD_CONST},
+    {LOAD_FAST, LOAD_ATTR, LOAD_FAST__LOAD_ATTR},
+    {STORE_FAST, LOAD_FAST, STORE_FAST__LOAD_FAST},
+    {LOAD_CONST, RETURN_VALUE, LOAD_CONST__RETURN_VALUE},
+    {COMPARE_OP, POP_JUMP_IF_FALSE, COMPARE_OP__POP_JUMP_IF_FALSE},
+    {COMPARE_OP, POP_JUMP_IF_TRUE, COMPARE_OP__POP_JUMP_IF_TRUE},
+    {BUILD_TUPLE, UNPACK_SEQUENCE, BUILD_TUPLE__UNPACK_SEQUENCE},
+    {BUILD_LIST, UNPACK_SEQUENCE, BUILD_LIST__UNPACK_SEQUENCE},
+};
+
+/* The superinstruction which runs 'first' and 'second', or 0 */
+static int
+superinstruction(int first, int second)
+{
+    size_t k;
+
+    for (k = 0; k < Py_ARRAY_LENGTH(superinstructions); k++) {
+        if (first == superinstructions[k].first &&
+            second == superinstructions[k].second)
+            return superinstructions[k].fused;
+    }
+    return 0;
+}
+
+/* Rewrite the first instruction of each of these pairs of 'code' into the
+   superinstruction, in its copy 'quickened'.  The second instruction stays,
+   for the jumps to it. */
+static void
+fuse_superinstructions(const unsigned char *code, unsigned char *quickened,
+                       Py_ssize_t size)
+{
+    Py_ssize_t i, next;
+    int fused;
+
+    for (i = 0; i < size; i = next) {
+        next = i + (HAS_ARG(code[i]) ? 3 : 1);
+        if (next >= size)
+            break;
+        fused = superinstruction(code[i], code[next]);
+        if (fused != 0)
+            quickened[i] = (unsigned char)fused;
+    }
+}
+
+int
+_PyCode_InitOpcache(PyCodeObject *co)
+{
+    unsigned char *code = (unsigned char *)PyBytes_AS_STRING(co->co_code);
+    Py_ssize_t i, size = PyBytes_GET_SIZE(co->co_code);
+    int ncaches = 0;
+
+    /* Line events make the caches before the code is hot */
+    if (co->co_quickened != NULL)
+        return 0;
+    /* The map has a byte per byte of code, so that the eval loop finds the
+       cache of an instruction from its offset */
+    co->co_opcache_map = (unsigned char *)PyMem_Calloc(size, 1);
+    co->co_quickened = (unsigned char *)PyMem_Malloc(size);
+    if (co->co_quickened == NULL || co->co_opcache_map == NULL)
+        goto nomemory;
+    memcpy(co->co_quickened, code, size);
+    fuse_superinstructions(code, co->co_quickened, size);
+    /* The SETUP and POP_BLOCK of the blocks of the exception table do
+       nothing, but for the call of __enter__ */
+    for (i = 0; i < co->co_exceptiontable_size; i++) {
+        _PyExceptionTableEntry *entry = &co->co_exceptiontable[i];
+        if (code[entry->start - 3] == SETUP_WITH) {
+            co->co_quickened[entry->start - 3] = ENTER_WITH;
+        }
+        else {
+            co->co_quickened[entry->start - 3] = JUMP_FORWARD;
+            co->co_quickened[entry->start - 2] = 0;
+            co->co_quickened[entry->start - 1] = 0;
+        }
+        co->co_quickened[entry->end] = NOP;
+    }
+
+    for (i = 0; i < size; i += HAS_ARG(code[i]) ? 3 : 1) {
+        if (OPCODE_HAS_CACHE(code[i]) && ncaches < 255)
+            co->co_opcache_map[i] = (unsigned char)++ncaches;
+    }
+    if (ncaches == 0) {
+        PyMem_FREE(co->co_opcache_map);
+        co->co_opcache_map = NULL;
+        return 0;
+    }
+    co->co_opcache = (_PyOpcache *)PyMem_Calloc(ncaches, sizeof(_PyOpcache));
+    if (co->co_opcache == NULL)
+        goto nomemory;
+    co->co_opcache_size = (unsigned char)ncaches;
+    return 0;
+
+  nomemory:
+    PyMem_FREE(co->co_quickened);
+    PyMem_FREE(co->co_opcache_map);
+    co->co_quickened = NULL;
+    co->co_opcache_map = NULL;
+    PyErr_NoMemory();
+    return -1;
+}
+
+/* Instrumentation
+
+   Line events rewrite the first instruction of each line in co_quickened
+   into INSTRUMENTED_LINE, which reports the line and runs the instruction
+   it replaces, kept in co_instrumented;  specialization rewrites that one
+   instead while the line is instrumented.  A superinstruction runs its
+   second instruction without dispatching it, so the one before the first
+   instruction of a line is split back into its first instruction.  The
+   calls and returns are a test of co_instrumentation on the way in and out
+   of the eval loop, under the one of tstate->use_tracing, so that it's only
+   made in threads with an instrumentation function. */
+
+/* Mark the first instruction of each line in 'starts', as in
+   _PyCode_CheckLineNumber() */
+static void
+mark_line_starts(PyCodeObject *co, unsigned char *starts)
+{
+    Py_ssize_t size = PyBytes_GET_SIZE(co->co_code);
+    Py_ssize_t n = PyBytes_GET_SIZE(co->co_lnotab) / 2;
+    const unsigned char *p =
+        (const unsigned char *)PyBytes_AS_STRING(co->co_lnotab);
+    Py_ssize_t addr = 0;
+
+    if (size > 0)
+        starts[0] = 1;
+    for (; n > 0; n--, p += 2) {
+        addr += p[0];
+        if (p[1] != 0 && addr < size)
+            starts[addr] = 1;
+    }
+}
+
+/* Split or fuse again the superinstructions which run the instruction
+   before the first one of a line */
+static void
+split_line_superinstructions(PyCodeObject *co, int split)
+{
+    unsigned char *code = (unsigned char *)PyBytes_AS_STRING(co->co_code);
+    Py_ssize_t i, prev, size = PyBytes_GET_SIZE(co->co_code);
+    int fused;
+
+    for (prev = 0, i = 0; i < size; prev = i, i += HAS_ARG(code[i]) ? 3 : 1) {
+        if (i == 0 || !co->co_instrumented[i])
+            continue;
+        fused = superinstruction(code[prev], code[i]);
+        if (fused == 0)
+            continue;
+        if (split && co->co_quickened[prev] == fused)
+            co->co_quickened[prev] = code[prev];
+        else if (!split && co->co_quickened[prev] == code[prev])
+            co->co_quickened[prev] = (unsigned char)fused;
+    }
+}
+
+int
+PyCode_SetInstrumentation(PyCodeObject *co, int events)
+{
+    Py_ssize_t i, size = PyBytes_GET_SIZE(co->co_code);
+
+    if (events & ~(PyCode_INSTRUMENT_CALL | PyCode_INSTRUMENT_LINE |
+                   PyCode_INSTRUMENT_RETURN)) {
+        PyErr_SetString(PyExc_ValueError, "unknown instrumentation events");
+        return -1;
+    }
+    if ((events & PyCode_INSTRUMENT_LINE) && co->co_instrumented == NULL) {
+        if (_PyCode_InitOpcache(co) < 0)
+            return -1;
+        co->co_instrumented = (unsigned char *)PyMem_Calloc(size, 1);
+        if (co->co_instrumented == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        mark_line_starts(co, co->co_instrumented);
+        split_line_superinstructions(co, 1);
+        for (i = 0; i < size; i++) {
+            if (co->co_instrumented[i]) {
+                co->co_instrumented[i] = co->co_quickened[i];
+                co->co_quickened[i] = INSTRUMENTED_LINE;
+            }
+        }
+    }
+    else if (!(events & PyCode_INSTRUMENT_LINE) &&
+             co->co_instrumented != NULL) {
+        for (i = 0; i < size; i++) {
+            if (co->co_instrumented[i])
+                co->co_quickened[i] = co->co_instrumented[i];
+        }
+        split_line_superinstructions(co, 0);
+        PyMem_FREE(co->co_instrumented);
+        co->co_instrumented = NULL;
+    }
+    co->co_instrumentation = events;
+    return 0;
+}
+
 static void
 code_dealloc(PyCodeObject *co)
 {
@@ -374,6 +1012,16 @@ code_dealloc(PyCodeObject *co)
         PyMem_FREE(co->co_cell2arg);
     if (co->co_zombieframe != NULL)
         PyObject_GC_Del(co->co_zombieframe);
+    if (co->co_opcache_map != NULL) {
+        PyMem_FREE(co->co_opcache_map);
+        PyMem_FREE(co->co_opcache);
+    }
+    if (co->co_quickened != NULL)
+        PyMem_FREE(co->co_quickened);
+    if (co->co_exceptiontable != NULL)
+        PyMem_FREE(co->co_exceptiontable);
+    if (co->co_instrumented != NULL)
+        PyMem_FREE(co->co_instrumented);
     if (co->co_weakreflist != NULL)
         PyObject_ClearWeakRefs((PyObject*)co);
     PyObject_DEL(co);
@@ -387,6 +1035,15 @@ code_sizeof(PyCodeObject *co, void *unused)
     res = sizeof(PyCodeObject);
     if (co->co_cell2arg != NULL && co->co_cellvars != NULL)
         res += PyTuple_GET_SIZE(co->co_cellvars) * sizeof(unsigned char);
+    if (co->co_quickened != NULL)
+        res += PyBytes_GET_SIZE(co->co_code);
+    res += co->co_exceptiontable_size * sizeof(_PyExceptionTableEntry);
+    if (co->co_instrumented != NULL)
+        res += PyBytes_GET_SIZE(co->co_code);
+    if (co->co_opcache_map != NULL) {
+        res += PyBytes_GET_SIZE(co->co_code);
+        res += co->co_opcache_size * sizeof(_PyOpcache);
+    }
     return PyLong_FromSsize_t(res);
 }
 
@@ -8,15 +8,29 @@ typedef struct {
     PyObject *me_value; /* This field is only meaningful for combined tables */
 } PyDictKeyEntry;
 
-typedef PyDictKeyEntry *(*dict_lookup_func)
-(PyDictObject *mp, PyObject *key, Py_hash_t hash, PyObject ***value_addr);
+/* dict_lookup_func() returns the index of the entry of the key, to be used
+ * as DK_ENTRIES(dk)[index], DKIX_EMPTY if there is none, or DKIX_ERROR if a
+ * comparison raised.  *hashpos is set to the slot of the hash table which
+ * holds the index, or in which it would be inserted.
+ */
+typedef Py_ssize_t (*dict_lookup_func)
+(PyDictObject *mp, PyObject *key, Py_hash_t hash, PyObject ***value_addr,
+ Py_ssize_t *hashpos);
 
+#define DKIX_EMPTY (-1)
+#define DKIX_DUMMY (-2)  /* Used internally */
+#define DKIX_ERROR (-3)
+
+/* See dictobject.c for the layout which starts at dk_indices */
 struct _dictkeysobject {
     Py_ssize_t dk_refcnt;
-    Py_ssize_t dk_size;
+    Py_ssize_t dk_size;     /* Size of the hash table dk_indices */
     dict_lookup_func dk_lookup;
-    Py_ssize_t dk_usable;
-    PyDictKeyEntry dk_entries[1];
+    Py_ssize_t dk_usable;   /* Number of usable entries in dk_entries */
+    Py_ssize_t dk_nentries; /* Number of used entries in dk_entries */
+    /* The index array and the entries:  char, so as not to break strict
+       aliasing.  The control bytes come before the header */
+    char dk_indices[];
 };
 
 #endif
@@ -9,45 +9,82 @@
 
 
 /*
+The keys of a dict are a PyDictKeysObject:  a hash table of dk_size indices,
+followed by a dense array of the entries in the order they were inserted.
+
++---------------+
+| dk_ctrl       |
+|               |
++---------------+  <- the PyDictKeysObject *
+| dk_refcnt     |
+| dk_size       |
+| dk_lookup     |
+| dk_usable     |
+| dk_nentries   |
++---------------+
+| dk_indices    |
+|               |
++---------------+
+| dk_entries    |
+|               |
++---------------+
+
+dk_indices is the hash table itself.  Each slot holds the index of an entry
+in dk_entries, DKIX_EMPTY (-1) or DKIX_DUMMY (-2).  The slots are int8 for
+tables of up to 128 slots, int16 up to 2**15 slots, int32 up to 2**31, and
+int64 beyond, so that a small dict pays a byte for each slot rather than a
+whole entry.
+
+dk_ctrl holds a control byte for each slot of dk_indices:  7 bits of the
+hash of the key the slot points to, DK_CTRL_EMPTY or DK_CTRL_DUMMY.  Lookups
+compare a group of 16 control bytes with the hash at once, and only read the
+index and entry of the slots which match; see "Group probing" below.  Only
+the tables of at least DK_GROUP_MIN_SIZE slots have a dk_ctrl.  It sits in
+the same block, just before the header, so that dk_indices and dk_entries
+are at the same offsets with or without it, and lookups find it with a
+subtraction.  new_keys_object() and dk_free() allocate and free the block.
+
+dk_entries has room for USABLE_FRACTION(dk_size) entries, of which the first
+dk_nentries are used.  A deleted entry is not reused until the next resize,
+so iterating over a dict is a linear scan of its entries in insertion order.
+
 There are four kinds of slots in the table:
 
-1. Unused.  me_key == me_value == NULL
+1. Unused.  index == DKIX_EMPTY
    Does not hold an active (key, value) pair now and never did.  Unused can
-   transition to Active upon key insertion.  This is the only case in which
-   me_key is NULL, and is each slot's initial state.
+   transition to Active upon key insertion.  This is each slot's initial
+   state.
 
-2. Active.  me_key != NULL and me_key != dummy and me_value != NULL
-   Holds an active (key, value) pair.  Active can transition to Dummy or
-   Pending upon key deletion (for combined and split tables respectively).
-   This is the only case in which me_value != NULL.
+2. Active.  index >= 0, me_key != NULL and me_value != NULL
+   Holds an active (key, value) pair.  Active can transition to Dummy upon
+   key deletion.  This is the only case in which me_value != NULL.
 
-3. Dummy.  me_key == dummy and me_value == NULL
+3. Dummy.  index == DKIX_DUMMY  (combined tables only)
    Previously held an active (key, value) pair, but that was deleted and an
    active pair has not yet overwritten the slot.  Dummy can transition to
-   Active upon key insertion.  Dummy slots cannot be made Unused again
-   (cannot have me_key set to NULL), else the probe sequence in case of
-   collision would have no way to know they were once active.
+   Active upon key insertion.  Dummy slots cannot be made Unused again,
+   else the probe sequence in case of collision would have no way to know
+   they were once active (a deletion may leave an Unused slot in the first
+   place, though, see "Group probing").  The entry of a deleted key has its me_key and
+   me_value set to NULL.
 
-4. Pending. Not yet inserted or deleted from a split-table.
-   key != NULL, key != dummy and value == NULL
+4. Pending. index >= 0, key != NULL, and value == NULL  (split tables only)
+   Not yet inserted in a split table.
 
 The DictObject can be in one of two forms.
 Either:
   A combined table:
     ma_values == NULL, dk_refcnt == 1.
     Values are stored in the me_value field of the PyDictKeysObject.
-    Slot kind 4 is not allowed i.e.
-        key != NULL, key != dummy and value == NULL is illegal.
+    Slot kind 4 is not allowed.
 Or:
   A split table:
     ma_values != NULL, dk_refcnt >= 1
-    Values are stored in the ma_values array.
-    Only string (unicode) keys are allowed, no <dummy> keys are present.
-
-Note: .popitem() abuses the me_hash field of an Unused or Dummy slot to
-hold a search finger.  The me_hash field of Unused or Dummy slots has no
-meaning otherwise. As a consequence of this popitem always converts the dict
-to the combined-table form.
+    Values are stored in the ma_values array, by entry index.
+    Only string (unicode) keys are allowed, no Dummy slots are present.
+    A split table keeps its values in the order of the shared entries, so
+    that it too iterates in insertion order:  setting a value out of that
+    order, or deleting one, converts the table to the combined form.
 */
 
 /* PyDict_MINSIZE_SPLIT is the minimum size of a split dictionary.
@@ -78,7 +115,7 @@ class dict "PyDictObject *" "&PyDict_Type"
 
 /*
 To ensure the lookup algorithm terminates, there must be at least one Unused
-slot (NULL key) in the table.
+slot (DKIX_EMPTY) in the table.
 To avoid slowing down lookups on a near-full table, we resize the table when
 it's USABLE_FRACTION (currently two-thirds) full.
 */
@@ -178,34 +215,80 @@ masked); and the PyDictObject struct required a member to hold the table's
 polynomial.  In Tim's experiments the current scheme ran faster, produced
 equally good collision statistics, needed less code & used less memory.
 
-*/
+Group probing.  A table of at least DK_GROUP_MIN_SIZE slots isn't probed one
+slot at a time as described above, but a group of DK_GROUP_WIDTH (16)
+consecutive slots at a time, in the manner of Abseil's SwissTable.  Groups
+are chosen by the higher bits of the hash, for which int hashes are far too
+regular, so the hash is first mixed by dk_mix().  The low 7 bits x of the
+result are kept in the control byte of the slot the key goes to, and the
+others select the first group to probe:
+
+    g = (mixed hash >> 7) mod (number of groups)
+
+followed by g+1, g+3, g+6, ... (still mod the number of groups), which visits
+every group once since the number of groups is a power of 2.  The 16 control
+bytes of a group are compared with x in one SSE2 instruction (a loop on other
+machines), and only the slots which match -- the key itself, and 1 in 128 of
+the others -- cost a read of dk_indices and dk_entries.  The probe ends at the
+first group with an Unused slot.  So a miss usually costs the read of one
+group of control bytes, where the scheme above reads the index and the entry
+of every colliding slot.
+
+A hit pays for this with the mixing of the hash and one more read, of the
+control bytes.  In a small table, whose slots, entries and keys are all in
+the cache, the key is nearly always in the first slot probed, and the
+collisions saved don't make up for that.  In a large one, the control bytes
+are read while the slots of their group are being loaded (see
+DK_PREFETCH_GROUP), and every collision saved is a cache miss saved.  So the
+smaller tables are still probed one slot at a time:  each lookup function
+hands a table of DK_GROUP_MIN_SIZE slots or more to its *_groups version, and
+a table keeps its layout until it is resized.
+
+Deleting a key leaves a Dummy slot only if its group has no Unused slot.  A
+probe only passes a group which was full when the key it is looking for was
+inserted, and a group which gets full never has an Unused slot again until
+the table is resized:  so a group with an Unused slot is the end of all the
+probes which reach it, and the deleted slot can be made Unused too.
 
-/* Object used as dummy key to fill deleted entries
- * This could be any unique object,
- * use a custom type in order to minimise coupling.
 */
-static PyObject _dummy_struct;
 
-#define dummy (&_dummy_struct)
-
-#ifdef Py_REF_DEBUG
-PyObject *
-_PyDict_Dummy(void)
-{
-    return dummy;
-}
+/* The smallest table probed by groups:  below 2048 slots, bench_dict finds
+ * hits slower by groups, and the misses saved don't make up for them.  It
+ * must be at least DK_GROUP_WIDTH slots, and more than the 8 of
+ * Py_EMPTY_KEYS, which has no control bytes.  Define DICT_PERTURB_PROBE to
+ * probe every table one slot at a time, as Python 3.5 does;
+ * bench_dict_perturb compares the two. */
+#ifndef DK_GROUP_MIN_SIZE
+#define DK_GROUP_MIN_SIZE 2048
+#endif
+#ifdef DICT_PERTURB_PROBE
+#define DK_GROUPED_SIZE(n) 0
+#else
+#define DK_GROUPED_SIZE(n) ((n) >= DK_GROUP_MIN_SIZE)
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DK_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
 #endif
 
 /* forward declarations */
-static PyDictKeyEntry *lookdict(PyDictObject *mp, PyObject *key,
-                                Py_hash_t hash, PyObject ***value_addr);
-static PyDictKeyEntry *lookdict_unicode(PyDictObject *mp, PyObject *key,
-                                        Py_hash_t hash, PyObject ***value_addr);
-static PyDictKeyEntry *
+static Py_ssize_t lookdict(PyDictObject *mp, PyObject *key,
+                           Py_hash_t hash, PyObject ***value_addr,
+                           Py_ssize_t *hashpos);
+static Py_ssize_t lookdict_unicode(PyDictObject *mp, PyObject *key,
+                                   Py_hash_t hash, PyObject ***value_addr,
+                                   Py_ssize_t *hashpos);
+static Py_ssize_t
 lookdict_unicode_nodummy(PyDictObject *mp, PyObject *key,
-                         Py_hash_t hash, PyObject ***value_addr);
-static PyDictKeyEntry *lookdict_split(PyDictObject *mp, PyObject *key,
-                                      Py_hash_t hash, PyObject ***value_addr);
+                         Py_hash_t hash, PyObject ***value_addr,
+                         Py_ssize_t *hashpos);
+static Py_ssize_t lookdict_split(PyDictObject *mp, PyObject *key,
+                                 Py_hash_t hash, PyObject ***value_addr,
+                                 Py_ssize_t *hashpos);
 
 static int dictresize(PyDictObject *mp, Py_ssize_t minused);
 
@@ -239,6 +322,13 @@ _PyDict_DebugMallocStats(FILE *out)
                            "free PyDictObject", numfree, sizeof(PyDictObject));
 }
 
+/* Number of objects in the free list */
+int
+_PyDict_NumFree(void)
+{
+    return numfree;
+}
+
 
 void
 PyDict_Fini(void)
@@ -252,15 +342,223 @@ PyDict_Fini(void)
 #define DK_INCREF(dk) (DK_DEBUG_INCREF ++(dk)->dk_refcnt)
 #define DK_DECREF(dk) if (DK_DEBUG_DECREF (--(dk)->dk_refcnt) == 0) free_keys_object(dk)
 #define DK_SIZE(dk) ((dk)->dk_size)
+#if SIZEOF_VOID_P > 4
+#define DK_IXSIZE(dk)                          \
+    (DK_SIZE(dk) <= 0xff ?                     \
+        1 : DK_SIZE(dk) <= 0xffff ?            \
+            2 : DK_SIZE(dk) <= 0xffffffff ?    \
+                4 : sizeof(int64_t))
+#else
+#define DK_IXSIZE(dk)                          \
+    (DK_SIZE(dk) <= 0xff ?                     \
+        1 : DK_SIZE(dk) <= 0xffff ?            \
+            2 : sizeof(int32_t))
+#endif
+/* The index array is padded to keep the entries which follow it aligned;
+   only the 4 int8 slots of the smallest split table need it. */
+#define DK_INDICES_SIZE(dk) \
+    _Py_SIZE_ROUND_UP(DK_SIZE(dk) * DK_IXSIZE(dk), SIZEOF_VOID_P)
+#define DK_GROUP_WIDTH 16
+#define DK_GROUPED(dk) DK_GROUPED_SIZE(DK_SIZE(dk))
+/* Control bytes, as int8_t:  0 to 0x7f for the slots in use */
+#define DK_CTRL_EMPTY (-128)
+#define DK_CTRL_DUMMY (-2)
+/* A control byte per slot of a table probed by groups */
+#define DK_CTRL_SIZE(dk) (DK_GROUPED(dk) ? DK_SIZE(dk) : 0)
+#define DK_CTRL(dk) ((int8_t *)(dk) - DK_SIZE(dk))
+#define DK_GROUP_MASK(dk) ((size_t)(DK_SIZE(dk) - 1) / DK_GROUP_WIDTH)
+#define DK_INDICES(dk) ((int8_t *)(dk)->dk_indices)
+#define DK_ENTRIES(dk) \
+    ((PyDictKeyEntry*)(&(dk)->dk_indices[DK_INDICES_SIZE(dk)]))
 #define DK_MASK(dk) (((dk)->dk_size)-1)
 #define IS_POWER_OF_2(x) (((x) & (x-1)) == 0)
 
+/* Lookup the index stored in slot i:  DKIX_EMPTY, DKIX_DUMMY or ix >= 0 */
+Py_LOCAL_INLINE(Py_ssize_t)
+dk_get_index(PyDictKeysObject *keys, Py_ssize_t i)
+{
+    Py_ssize_t s = DK_SIZE(keys);
+    int8_t *indices = DK_INDICES(keys);
+    Py_ssize_t ix;
+
+    if (s <= 0xff) {
+        ix = indices[i];
+    }
+    else if (s <= 0xffff) {
+        ix = ((int16_t *)indices)[i];
+    }
+#if SIZEOF_VOID_P > 4
+    else if (s <= 0xffffffff) {
+        ix = ((int32_t *)indices)[i];
+    }
+    else {
+        ix = ((int64_t *)indices)[i];
+    }
+#else
+    else {
+        ix = ((int32_t *)indices)[i];
+    }
+#endif
+    assert(ix >= DKIX_DUMMY);
+    return ix;
+}
+
+/* Write ix to slot i */
+Py_LOCAL_INLINE(void)
+dk_set_index(PyDictKeysObject *keys, Py_ssize_t i, Py_ssize_t ix)
+{
+    Py_ssize_t s = DK_SIZE(keys);
+    int8_t *indices = DK_INDICES(keys);
+
+    assert(ix >= DKIX_DUMMY);
+    if (s <= 0xff) {
+        assert(ix <= 0x7f);
+        indices[i] = (int8_t)ix;
+    }
+    else if (s <= 0xffff) {
+        assert(ix <= 0x7fff);
+        ((int16_t *)indices)[i] = (int16_t)ix;
+    }
+#if SIZEOF_VOID_P > 4
+    else if (s <= 0xffffffff) {
+        assert(ix <= 0x7fffffff);
+        ((int32_t *)indices)[i] = (int32_t)ix;
+    }
+    else {
+        ((int64_t *)indices)[i] = ix;
+    }
+#else
+    else {
+        ((int32_t *)indices)[i] = (int32_t)ix;
+    }
+#endif
+}
+
+/* Mix the bits of a hash:  the low 7 go to the control byte of the slot of
+   the key (DK_H2), the others choose the first group to probe (DK_H1). */
+Py_LOCAL_INLINE(size_t)
+dk_mix(Py_hash_t hash)
+{
+#if SIZEOF_SIZE_T > 4
+    size_t x = (size_t)hash * (size_t)0x9e3779b97f4a7c15ULL;
+    return x ^ (x >> 32);
+#else
+    size_t x = (size_t)hash * (size_t)0x9e3779b9UL;
+    return x ^ (x >> 16);
+#endif
+}
+
+#define DK_H1(x) ((x) >> 7)
+#define DK_H2(x) ((int8_t)((x) & 0x7f))
+
+/* The slots of a group whose control byte is h2, as a bit mask */
+Py_LOCAL_INLINE(unsigned int)
+dk_group_match(const int8_t *group, int8_t h2)
+{
+#ifdef DK_SSE2
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return (unsigned int)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)h2)));
+#else
+    unsigned int m = 0;
+    int j;
+    for (j = 0; j < DK_GROUP_WIDTH; j++)
+        m |= (unsigned int)(group[j] == h2) << j;
+    return m;
+#endif
+}
+
+/* The Unused slots of a group */
+#define dk_group_match_empty(group) dk_group_match(group, DK_CTRL_EMPTY)
+
+/* The Unused and Dummy slots of a group:  those of the negative control
+   bytes */
+Py_LOCAL_INLINE(unsigned int)
+dk_group_match_free(const int8_t *group)
+{
+#ifdef DK_SSE2
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return (unsigned int)_mm_movemask_epi8(ctrl);
+#else
+    unsigned int m = 0;
+    int j;
+    for (j = 0; j < DK_GROUP_WIDTH; j++)
+        m |= (unsigned int)(group[j] < 0) << j;
+    return m;
+#endif
+}
+
+/* Start loading the slots of dk_indices of group g, which the control bytes
+   of the group only tell us which of to read:  on a large table, that saves
+   a cache miss on each lookup. */
+#ifdef DK_SSE2
+#define DK_PREFETCH_GROUP(dk, g) \
+    _mm_prefetch((const char *)&DK_INDICES(dk)[ \
+                     (g) * DK_GROUP_WIDTH * DK_IXSIZE(dk)], _MM_HINT_T0)
+#elif defined(__GNUC__)
+#define DK_PREFETCH_GROUP(dk, g) \
+    __builtin_prefetch(&DK_INDICES(dk)[(g) * DK_GROUP_WIDTH * DK_IXSIZE(dk)])
+#else
+#define DK_PREFETCH_GROUP(dk, g)
+#endif
+
+/* The index of the lowest bit set in m, which isn't 0 */
+Py_LOCAL_INLINE(Py_ssize_t)
+dk_lowest_bit(unsigned int m)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(m);
+#elif defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return (Py_ssize_t)i;
+#else
+    Py_ssize_t i = 0;
+    assert(m != 0);
+    for (; !(m & 1); m >>= 1)
+        i++;
+    return i;
+#endif
+}
+
+/* Point slot i at the entry ix, whose key has the given hash */
+Py_LOCAL_INLINE(void)
+dk_set_entry(PyDictKeysObject *keys, Py_ssize_t i, Py_ssize_t ix,
+             Py_hash_t hash)
+{
+    assert(ix >= 0);
+    dk_set_index(keys, i, ix);
+    if (DK_GROUPED(keys))
+        DK_CTRL(keys)[i] = DK_H2(dk_mix(hash));
+}
+
+/* Remove the entry of slot i from the hash table */
+Py_LOCAL_INLINE(void)
+dk_clear_slot(PyDictKeysObject *keys, Py_ssize_t i)
+{
+    if (DK_GROUPED(keys)) {
+        int8_t *ctrl = DK_CTRL(keys);
+        if (dk_group_match_empty(
+                ctrl + (i & ~(Py_ssize_t)(DK_GROUP_WIDTH - 1)))) {
+            /* No probe goes beyond this group, see "Group probing" */
+            ctrl[i] = DK_CTRL_EMPTY;
+            dk_set_index(keys, i, DKIX_EMPTY);
+            return;
+        }
+        ctrl[i] = DK_CTRL_DUMMY;
+    }
+    dk_set_index(keys, i, DKIX_DUMMY);
+}
+
+
 /* USABLE_FRACTION is the maximum dictionary load.
  * Currently set to (2n+1)/3. Increasing this ratio makes dictionaries more
  * dense resulting in more collisions.  Decreasing it improves sparseness
  * at the expense of spreading entries over more cache lines and at the
  * cost of total memory consumed.
  *
+ * It is also the number of entries a table of n slots has room for.
+ *
  * USABLE_FRACTION must obey the following:
  *     (0 < USABLE_FRACTION(n) < n) for all n >= 2
  *
@@ -294,6 +592,20 @@ PyDict_Fini(void)
  */
 #define GROWTH_RATE(d) (((d)->ma_used*2)+((d)->ma_keys->dk_size>>1))
 
+/* ESTIMATE_SIZE(n) is the largest table size whose USABLE_FRACTION is less
+ * than n, so that dictresize(mp, ESTIMATE_SIZE(n)) makes room for n items,
+ * in a table just large enough.
+ */
+#define ESTIMATE_SIZE(n) ((((n)*3) >> 1) - 1)
+
+/* Source of ma_version_tag:  bumped whenever a dict is created or one of
+ * its values is set or deleted, so that a version identifies one state of
+ * one dict.  At a billion mutations per second, 64 bits last 584 years.
+ */
+static PY_UINT64_T pydict_global_version = 0;
+
+#define DICT_NEXT_VERSION() (++pydict_global_version)
+
 #define ENSURE_ALLOWS_DELETIONS(d) \
     if ((d)->ma_keys->dk_lookup == lookdict_unicode_nodummy) { \
         (d)->ma_keys->dk_lookup = lookdict_unicode; \
@@ -303,57 +615,85 @@ PyDict_Fini(void)
  * (which cannot fail and thus can do no allocation).
  */
 static PyDictKeysObject empty_keys_struct = {
-        2, /* dk_refcnt 1 for this struct, 1 for dummy_struct */
-        1, /* dk_size */
+        1, /* dk_refcnt */
+        8, /* dk_size */
         lookdict_split, /* dk_lookup */
         0, /* dk_usable (immutable) */
-        {
-            { 0, 0, 0 } /* dk_entries (empty) */
-        }
+        0, /* dk_nentries */
+        {DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY,
+         DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY}, /* dk_indices */
 };
 
-static PyObject *empty_values[1] = { NULL };
+/* The values of a cleared split dict, as many as Py_EMPTY_KEYS has usable
+ * entries:  PyDict_Copy() and other walks of a split table visit all of them.
+ */
+static PyObject *empty_values[USABLE_FRACTION(8)] = { NULL };
 
 #define Py_EMPTY_KEYS &empty_keys_struct
 
 static PyDictKeysObject *new_keys_object(Py_ssize_t size)
 {
     PyDictKeysObject *dk;
-    Py_ssize_t i;
-    PyDictKeyEntry *ep0;
+    Py_ssize_t es, usable, ctrl_size;
+    char *block;
 
     assert(size >= PyDict_MINSIZE_SPLIT);
     assert(IS_POWER_OF_2(size));
-    dk = PyMem_MALLOC(sizeof(PyDictKeysObject) +
-                      sizeof(PyDictKeyEntry) * (size-1));
-    if (dk == NULL) {
+
+    usable = USABLE_FRACTION(size);
+    if (size <= 0xff) {
+        es = 1;
+    }
+    else if (size <= 0xffff) {
+        es = 2;
+    }
+#if SIZEOF_VOID_P > 4
+    else if (size <= 0xffffffff) {
+        es = 4;
+    }
+#endif
+    else {
+        es = sizeof(Py_ssize_t);
+    }
+
+    ctrl_size = DK_GROUPED_SIZE(size) ? size : 0;
+    block = PyMem_MALLOC(ctrl_size +
+                         offsetof(PyDictKeysObject, dk_indices) +
+                         _Py_SIZE_ROUND_UP(es * size, SIZEOF_VOID_P) +
+                         sizeof(PyDictKeyEntry) * usable);
+    if (block == NULL) {
         PyErr_NoMemory();
         return NULL;
     }
+    memset(block, DK_CTRL_EMPTY, ctrl_size);
+    dk = (PyDictKeysObject *)(block + ctrl_size);
     DK_DEBUG_INCREF dk->dk_refcnt = 1;
     dk->dk_size = size;
-    dk->dk_usable = USABLE_FRACTION(size);
-    ep0 = &dk->dk_entries[0];
-    /* Hash value of slot 0 is used by popitem, so it must be initialized */
-    ep0->me_hash = 0;
-    for (i = 0; i < size; i++) {
-        ep0[i].me_key = NULL;
-        ep0[i].me_value = NULL;
-    }
+    dk->dk_usable = usable;
     dk->dk_lookup = lookdict_unicode_nodummy;
+    dk->dk_nentries = 0;
+    memset(DK_INDICES(dk), 0xff, es * size);
+    memset(DK_ENTRIES(dk), 0, sizeof(PyDictKeyEntry) * usable);
     return dk;
 }
 
+/* Free the block of a keys object, its control bytes included */
+Py_LOCAL_INLINE(void)
+dk_free(PyDictKeysObject *keys)
+{
+    PyMem_FREE((char *)keys - DK_CTRL_SIZE(keys));
+}
+
 static void
 free_keys_object(PyDictKeysObject *keys)
 {
-    PyDictKeyEntry *entries = &keys->dk_entries[0];
+    PyDictKeyEntry *entries = DK_ENTRIES(keys);
     Py_ssize_t i, n;
-    for (i = 0, n = DK_SIZE(keys); i < n; i++) {
+    for (i = 0, n = keys->dk_nentries; i < n; i++) {
         Py_XDECREF(entries[i].me_key);
         Py_XDECREF(entries[i].me_value);
     }
-    PyMem_FREE(keys);
+    dk_free(keys);
 }
 
 #define new_values(size) PyMem_NEW(PyObject *, size)
@@ -383,6 +723,7 @@ new_dict(PyDictKeysObject *keys, PyObject **values)
     mp->ma_keys = keys;
     mp->ma_values = values;
     mp->ma_used = 0;
+    mp->ma_version_tag = DICT_NEXT_VERSION();
     return (PyObject *)mp;
 }
 
@@ -393,7 +734,7 @@ new_dict_with_shared_keys(PyDictKeysObject *keys)
     PyObject **values;
     Py_ssize_t i, size;
 
-    size = DK_SIZE(keys);
+    size = USABLE_FRACTION(DK_SIZE(keys));
     values = new_values(size);
     if (values == NULL) {
         DK_DECREF(keys);
@@ -420,8 +761,7 @@ This is based on Algorithm D from Knuth Vol. 3, Sec. 6.4.
 Open addressing is preferred over chaining since the link overhead for
 chaining would be substantial (100% with typical malloc overhead).
 
-The initial probe index is computed as hash mod the table size. Subsequent
-probe indices are computed as explained earlier.
+The probe sequence, of slots or of groups of slots, is explained earlier.
 
 All arithmetic on hash should ignore overflow.
 
@@ -429,52 +769,443 @@ The details in this version are due to Tim Peters, building on many past
 contributions by Reimer Behrends, Jyrki Alakuijala, Vladimir Marangozov and
 Christian Tismer.
 
-lookdict() is general-purpose, and may return NULL if (and only if) a
+lookdict() is general-purpose, and may return DKIX_ERROR if (and only if) a
 comparison raises an exception (this was new in Python 2.5).
 lookdict_unicode() below is specialized to string keys, comparison of which can
-never raise an exception; that function can never return NULL.
-lookdict_unicode_nodummy is further specialized for string keys that cannot be
-the <dummy> value.
-For both, when the key isn't found a PyDictEntry* is returned
-where the key would have been found, *value_addr points to the matching value
-slot.
+never raise an exception; that function can never return DKIX_ERROR.
+lookdict_unicode_nodummy is further specialized for string keys in a table
+without Dummy slots.
+For both, when the key is found the index of its entry is returned and
+*value_addr points to the matching value slot.  When it isn't, DKIX_EMPTY is
+returned, *value_addr is set to NULL and *hashpos, if hashpos isn't NULL,
+to the slot where the key would be inserted.
 */
-static PyDictKeyEntry *
+
+/* First the versions for the tables probed by groups, which the functions of
+   the same names without "_groups", further down, call on such a table.  They
+   aren't inlined there, so that a lookup in a small table doesn't pay for
+   saving the registers they use. */
+#if defined(__GNUC__)
+#define DK_NOINLINE __attribute__((__noinline__))
+#elif defined(_MSC_VER)
+#define DK_NOINLINE __declspec(noinline)
+#else
+#define DK_NOINLINE
+#endif
+
+/* Search the slot of the hash table which holds the entry index 'index' */
+static DK_NOINLINE Py_ssize_t
+lookdict_index_groups(PyDictKeysObject *k, Py_hash_t hash, Py_ssize_t index)
+{
+    size_t x = dk_mix(hash);
+    size_t gmask = DK_GROUP_MASK(k);
+    size_t g = DK_H1(x) & gmask;
+    size_t step = 0;
+    int8_t *ctrl = DK_CTRL(k);
+    unsigned int m;
+    Py_ssize_t i;
+
+    for (;;) {
+        int8_t *group = ctrl + g * DK_GROUP_WIDTH;
+        for (m = dk_group_match(group, DK_H2(x)); m; m &= m - 1) {
+            i = g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+            if (dk_get_index(k, i) == index)
+                return i;
+        }
+        if (dk_group_match_empty(group))
+            return DKIX_EMPTY;
+        g = (g + ++step) & gmask;
+    }
+    assert(0);          /* NOT REACHED */
+    return DKIX_ERROR;
+}
+
+static DK_NOINLINE Py_ssize_t
+lookdict_groups(PyDictObject *mp, PyObject *key,
+         Py_hash_t hash, PyObject ***value_addr, Py_ssize_t *hashpos)
+{
+    size_t x = dk_mix(hash);
+    size_t g, gmask, step;
+    Py_ssize_t i, freeslot;
+    PyDictKeysObject *dk;
+    PyDictKeyEntry *ep0;
+    PyDictKeyEntry *ep;
+    int8_t *ctrl, *group;
+    unsigned int m;
+    Py_ssize_t ix;
+    int cmp;
+    PyObject *startkey;
+
+top:
+    dk = mp->ma_keys;
+    if (!DK_GROUPED(dk))
+        return lookdict(mp, key, hash, value_addr, hashpos);
+    gmask = DK_GROUP_MASK(dk);
+    g = DK_H1(x) & gmask;
+    step = 0;
+    ctrl = DK_CTRL(dk);
+    ep0 = DK_ENTRIES(dk);
+    freeslot = -1;
+    DK_PREFETCH_GROUP(dk, g);
+    for (;;) {
+        group = ctrl + g * DK_GROUP_WIDTH;
+        for (m = dk_group_match(group, DK_H2(x)); m; m &= m - 1) {
+            i = g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+            ix = dk_get_index(dk, i);
+            if (ix < 0) {
+                /* deleted by one of the comparisons below */
+                continue;
+            }
+            ep = &ep0[ix];
+            assert(ep->me_key != NULL);
+            if (ep->me_key == key) {
+                *value_addr = &ep->me_value;
+                if (hashpos != NULL)
+                    *hashpos = i;
+                return ix;
+            }
+            if (ep->me_hash == hash) {
+                startkey = ep->me_key;
+                Py_INCREF(startkey);
+                cmp = PyObject_RichCompareBool(startkey, key, Py_EQ);
+                Py_DECREF(startkey);
+                if (cmp < 0) {
+                    *value_addr = NULL;
+                    return DKIX_ERROR;
+                }
+                if (dk == mp->ma_keys && ep->me_key == startkey) {
+                    if (cmp > 0) {
+                        *value_addr = &ep->me_value;
+                        if (hashpos != NULL)
+                            *hashpos = i;
+                        return ix;
+                    }
+                }
+                else {
+                    /* The dict was mutated, restart */
+                    goto top;
+                }
+            }
+        }
+        if (freeslot == -1 && (m = dk_group_match_free(group)) != 0)
+            freeslot = g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+        if (dk_group_match_empty(group)) {
+            if (hashpos != NULL)
+                *hashpos = freeslot;
+            *value_addr = NULL;
+            return DKIX_EMPTY;
+        }
+        g = (g + ++step) & gmask;
+    }
+    assert(0);          /* NOT REACHED */
+    return 0;
+}
+
+/* Specialized version for string-only keys */
+static DK_NOINLINE Py_ssize_t
+lookdict_unicode_groups(PyDictObject *mp, PyObject *key,
+                 Py_hash_t hash, PyObject ***value_addr, Py_ssize_t *hashpos)
+{
+    PyDictKeysObject *dk = mp->ma_keys;
+    size_t x = dk_mix(hash);
+    size_t gmask = DK_GROUP_MASK(dk);
+    size_t g = DK_H1(x) & gmask;
+    size_t step = 0;
+    int8_t *ctrl = DK_CTRL(dk);
+    PyDictKeyEntry *ep0 = DK_ENTRIES(dk);
+    PyDictKeyEntry *ep;
+    Py_ssize_t i, ix, freeslot = -1;
+    unsigned int m;
+
+    /* Make sure this function doesn't have to handle non-unicode keys,
+       including subclasses of str; e.g., one reason to subclass
+       unicodes is to override __eq__, and for speed we don't cater to
+       that here. */
+    if (!PyUnicode_CheckExact(key)) {
+        mp->ma_keys->dk_lookup = lookdict;
+        return lookdict(mp, key, hash, value_addr, hashpos);
+    }
+    DK_PREFETCH_GROUP(dk, g);
+    /* Most lookups find the key itself in the first slot which matches */
+    m = dk_group_match(ctrl + g * DK_GROUP_WIDTH, DK_H2(x));
+    if (m != 0) {
+        i = g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+        ix = dk_get_index(dk, i);
+        if (ep0[ix].me_key == key) {
+            if (hashpos != NULL)
+                *hashpos = i;
+            *value_addr = &ep0[ix].me_value;
+            return ix;
+        }
+    }
+    for (;;) {
+        int8_t *group = ctrl + g * DK_GROUP_WIDTH;
+        for (m = dk_group_match(group, DK_H2(x)); m; m &= m - 1) {
+            i = g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+            ix = dk_get_index(dk, i);
+            assert(ix >= 0);
+            ep = &ep0[ix];
+            assert(ep->me_key != NULL);
+            if (ep->me_key == key
+                || (ep->me_hash == hash && unicode_eq(ep->me_key, key))) {
+                *value_addr = &ep->me_value;
+                if (hashpos != NULL)
+                    *hashpos = i;
+                return ix;
+            }
+        }
+        if (freeslot == -1 && (m = dk_group_match_free(group)) != 0)
+            freeslot = g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+        if (dk_group_match_empty(group)) {
+            if (hashpos != NULL)
+                *hashpos = freeslot;
+            *value_addr = NULL;
+            return DKIX_EMPTY;
+        }
+        g = (g + ++step) & gmask;
+    }
+    assert(0);          /* NOT REACHED */
+    return 0;
+}
+
+/* Faster version of lookdict_unicode when it is known that no DKIX_DUMMY
+ * slots will be present. */
+static DK_NOINLINE Py_ssize_t
+lookdict_unicode_nodummy_groups(PyDictObject *mp, PyObject *key,
+                         Py_hash_t hash, PyObject ***value_addr,
+                         Py_ssize_t *hashpos)
+{
+    PyDictKeysObject *dk = mp->ma_keys;
+    size_t x = dk_mix(hash);
+    size_t gmask = DK_GROUP_MASK(dk);
+    size_t g = DK_H1(x) & gmask;
+    size_t step = 0;
+    int8_t *ctrl = DK_CTRL(dk);
+    PyDictKeyEntry *ep0 = DK_ENTRIES(dk);
+    PyDictKeyEntry *ep;
+    Py_ssize_t i, ix;
+    unsigned int m;
+
+    /* Make sure this function doesn't have to handle non-unicode keys,
+       including subclasses of str; e.g., one reason to subclass
+       unicodes is to override __eq__, and for speed we don't cater to
+       that here. */
+    if (!PyUnicode_CheckExact(key)) {
+        mp->ma_keys->dk_lookup = lookdict;
+        return lookdict(mp, key, hash, value_addr, hashpos);
+    }
+    DK_PREFETCH_GROUP(dk, g);
+    /* Most lookups find the key itself in the first slot which matches */
+    m = dk_group_match(ctrl + g * DK_GROUP_WIDTH, DK_H2(x));
+    if (m != 0) {
+        i = g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+        ix = dk_get_index(dk, i);
+        if (ep0[ix].me_key == key) {
+            if (hashpos != NULL)
+                *hashpos = i;
+            *value_addr = &ep0[ix].me_value;
+            return ix;
+        }
+    }
+    for (;;) {
+        int8_t *group = ctrl + g * DK_GROUP_WIDTH;
+        for (m = dk_group_match(group, DK_H2(x)); m; m &= m - 1) {
+            i = g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+            ix = dk_get_index(dk, i);
+            assert(ix >= 0);
+            ep = &ep0[ix];
+            assert(ep->me_key != NULL && PyUnicode_CheckExact(ep->me_key));
+            if (ep->me_key == key ||
+                (ep->me_hash == hash && unicode_eq(ep->me_key, key))) {
+                if (hashpos != NULL)
+                    *hashpos = i;
+                *value_addr = &ep->me_value;
+                return ix;
+            }
+        }
+        if ((m = dk_group_match_empty(group)) != 0) {
+            if (hashpos != NULL)
+                *hashpos = g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+            *value_addr = NULL;
+            return DKIX_EMPTY;
+        }
+        g = (g + ++step) & gmask;
+    }
+    assert(0);          /* NOT REACHED */
+    return 0;
+}
+
+/* Version of lookdict for split tables.
+ * All split tables and only split tables use this lookup function.
+ * Split tables only contain unicode keys and no dummy slots,
+ * so algorithm is the same as lookdict_unicode_nodummy.
+ */
+static DK_NOINLINE Py_ssize_t
+lookdict_split_groups(PyDictObject *mp, PyObject *key,
+               Py_hash_t hash, PyObject ***value_addr, Py_ssize_t *hashpos)
+{
+    PyDictKeysObject *dk = mp->ma_keys;
+    size_t x;
+    size_t gmask = DK_GROUP_MASK(dk);
+    size_t g;
+    size_t step = 0;
+    int8_t *ctrl = DK_CTRL(dk);
+    PyDictKeyEntry *ep0 = DK_ENTRIES(dk);
+    PyDictKeyEntry *ep;
+    Py_ssize_t i, ix;
+    unsigned int m;
+
+    if (!PyUnicode_CheckExact(key)) {
+        ix = lookdict(mp, key, hash, value_addr, hashpos);
+        /* lookdict expects a combined-table, so fix value_addr */
+        if (ix >= 0)
+            *value_addr = &mp->ma_values[ix];
+        return ix;
+    }
+    x = dk_mix(hash);
+    g = DK_H1(x) & gmask;
+    DK_PREFETCH_GROUP(dk, g);
+    m = dk_group_match(ctrl + g * DK_GROUP_WIDTH, DK_H2(x));
+    if (m != 0) {
+        i = g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+        ix = dk_get_index(dk, i);
+        if (ep0[ix].me_key == key) {
+            if (hashpos != NULL)
+                *hashpos = i;
+            *value_addr = &mp->ma_values[ix];
+            return ix;
+        }
+    }
+    for (;;) {
+        int8_t *group = ctrl + g * DK_GROUP_WIDTH;
+        for (m = dk_group_match(group, DK_H2(x)); m; m &= m - 1) {
+            i = g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+            ix = dk_get_index(dk, i);
+            assert(ix >= 0);
+            ep = &ep0[ix];
+            assert(ep->me_key != NULL && PyUnicode_CheckExact(ep->me_key));
+            if (ep->me_key == key ||
+                (ep->me_hash == hash && unicode_eq(ep->me_key, key))) {
+                if (hashpos != NULL)
+                    *hashpos = i;
+                *value_addr = &mp->ma_values[ix];
+                return ix;
+            }
+        }
+        if ((m = dk_group_match_empty(group)) != 0) {
+            if (hashpos != NULL)
+                *hashpos = g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+            *value_addr = NULL;
+            return DKIX_EMPTY;
+        }
+        g = (g + ++step) & gmask;
+    }
+    assert(0);          /* NOT REACHED */
+    return 0;
+}
+
+/* The first Unused slot in the probe sequence of hash */
+static DK_NOINLINE Py_ssize_t
+dk_find_empty_groups(PyDictKeysObject *k, Py_hash_t hash)
+{
+    size_t x = dk_mix(hash);
+    size_t gmask = DK_GROUP_MASK(k);
+    size_t g = DK_H1(x) & gmask;
+    size_t step = 0;
+    int8_t *ctrl = DK_CTRL(k);
+    unsigned int m;
+
+    while ((m = dk_group_match_empty(ctrl + g * DK_GROUP_WIDTH)) == 0)
+        g = (g + ++step) & gmask;
+    return g * DK_GROUP_WIDTH + dk_lowest_bit(m);
+}
+
+
+/* Search the slot of the hash table which holds the entry index 'index' */
+static Py_ssize_t
+lookdict_index(PyDictKeysObject *k, Py_hash_t hash, Py_ssize_t index)
+{
+    size_t i;
+    size_t perturb;
+    size_t mask = DK_MASK(k);
+    Py_ssize_t ix;
+    if (DK_GROUPED(k))
+        return lookdict_index_groups(k, hash, index);
+
+    i = (size_t)hash & mask;
+    ix = dk_get_index(k, i);
+    if (ix == index)
+        return i;
+    if (ix == DKIX_EMPTY)
+        return DKIX_EMPTY;
+
+    for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
+        i = (i << 2) + i + perturb + 1;
+        ix = dk_get_index(k, i & mask);
+        if (ix == index)
+            return i & mask;
+        if (ix == DKIX_EMPTY)
+            return DKIX_EMPTY;
+    }
+    assert(0);          /* NOT REACHED */
+    return DKIX_ERROR;
+}
+
+static Py_ssize_t
 lookdict(PyDictObject *mp, PyObject *key,
-         Py_hash_t hash, PyObject ***value_addr)
+         Py_hash_t hash, PyObject ***value_addr, Py_ssize_t *hashpos)
 {
     size_t i;
     size_t perturb;
-    PyDictKeyEntry *freeslot;
+    Py_ssize_t freeslot;
     size_t mask;
+    PyDictKeysObject *dk;
     PyDictKeyEntry *ep0;
     PyDictKeyEntry *ep;
+    Py_ssize_t ix;
     int cmp;
     PyObject *startkey;
 
 top:
-    mask = DK_MASK(mp->ma_keys);
-    ep0 = &mp->ma_keys->dk_entries[0];
+    dk = mp->ma_keys;
+    if (DK_GROUPED(dk))
+        return lookdict_groups(mp, key, hash, value_addr, hashpos);
+    mask = DK_MASK(dk);
+    ep0 = DK_ENTRIES(dk);
     i = (size_t)hash & mask;
-    ep = &ep0[i];
-    if (ep->me_key == NULL || ep->me_key == key) {
-        *value_addr = &ep->me_value;
-        return ep;
-    }
-    if (ep->me_key == dummy)
-        freeslot = ep;
+    ix = dk_get_index(dk, i);
+    if (ix == DKIX_EMPTY) {
+        if (hashpos != NULL)
+            *hashpos = i;
+        *value_addr = NULL;
+        return DKIX_EMPTY;
+    }
+    if (ix == DKIX_DUMMY)
+        freeslot = i;
     else {
+        ep = &ep0[ix];
+        assert(ep->me_key != NULL);
+        if (ep->me_key == key) {
+            *value_addr = &ep->me_value;
+            if (hashpos != NULL)
+                *hashpos = i;
+            return ix;
+        }
         if (ep->me_hash == hash) {
             startkey = ep->me_key;
             Py_INCREF(startkey);
             cmp = PyObject_RichCompareBool(startkey, key, Py_EQ);
             Py_DECREF(startkey);
-            if (cmp < 0)
-                return NULL;
-            if (ep0 == mp->ma_keys->dk_entries && ep->me_key == startkey) {
+            if (cmp < 0) {
+                *value_addr = NULL;
+                return DKIX_ERROR;
+            }
+            if (dk == mp->ma_keys && ep->me_key == startkey) {
                 if (cmp > 0) {
                     *value_addr = &ep->me_value;
-                    return ep;
+                    if (hashpos != NULL)
+                        *hashpos = i;
+                    return ix;
                 }
             }
             else {
@@ -482,40 +1213,48 @@ top:
                 goto top;
             }
         }
-        freeslot = NULL;
+        freeslot = -1;
     }
 
-    /* In the loop, me_key == dummy is by far (factor of 100s) the
-       least likely outcome, so test for that last. */
+    /* In the loop, DKIX_DUMMY is by far (factor of 100s) the least likely
+       outcome, so test for that last. */
     for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
         i = (i << 2) + i + perturb + 1;
-        ep = &ep0[i & mask];
-        if (ep->me_key == NULL) {
-            if (freeslot == NULL) {
-                *value_addr = &ep->me_value;
-                return ep;
-            } else {
-                *value_addr = &freeslot->me_value;
-                return freeslot;
-            }
+        ix = dk_get_index(dk, i & mask);
+        if (ix == DKIX_EMPTY) {
+            if (hashpos != NULL)
+                *hashpos = (freeslot == -1) ? (Py_ssize_t)(i & mask) : freeslot;
+            *value_addr = NULL;
+            return DKIX_EMPTY;
         }
+        if (ix == DKIX_DUMMY) {
+            if (freeslot == -1)
+                freeslot = i & mask;
+            continue;
+        }
+        ep = &ep0[ix];
+        assert(ep->me_key != NULL);
         if (ep->me_key == key) {
             *value_addr = &ep->me_value;
-            return ep;
+            if (hashpos != NULL)
+                *hashpos = i & mask;
+            return ix;
         }
-        if (ep->me_hash == hash && ep->me_key != dummy) {
+        if (ep->me_hash == hash) {
             startkey = ep->me_key;
             Py_INCREF(startkey);
             cmp = PyObject_RichCompareBool(startkey, key, Py_EQ);
             Py_DECREF(startkey);
             if (cmp < 0) {
                 *value_addr = NULL;
-                return NULL;
+                return DKIX_ERROR;
             }
-            if (ep0 == mp->ma_keys->dk_entries && ep->me_key == startkey) {
+            if (dk == mp->ma_keys && ep->me_key == startkey) {
                 if (cmp > 0) {
                     *value_addr = &ep->me_value;
-                    return ep;
+                    if (hashpos != NULL)
+                        *hashpos = i & mask;
+                    return ix;
                 }
             }
             else {
@@ -523,24 +1262,25 @@ top:
                 goto top;
             }
         }
-        else if (ep->me_key == dummy && freeslot == NULL)
-            freeslot = ep;
     }
     assert(0);          /* NOT REACHED */
     return 0;
 }
 
 /* Specialized version for string-only keys */
-static PyDictKeyEntry *
+static Py_ssize_t
 lookdict_unicode(PyDictObject *mp, PyObject *key,
-                 Py_hash_t hash, PyObject ***value_addr)
+                 Py_hash_t hash, PyObject ***value_addr, Py_ssize_t *hashpos)
 {
     size_t i;
     size_t perturb;
-    PyDictKeyEntry *freeslot;
+    Py_ssize_t freeslot;
     size_t mask = DK_MASK(mp->ma_keys);
-    PyDictKeyEntry *ep0 = &mp->ma_keys->dk_entries[0];
+    PyDictKeyEntry *ep0 = DK_ENTRIES(mp->ma_keys);
     PyDictKeyEntry *ep;
+    Py_ssize_t ix;
+    if (DK_GROUPED(mp->ma_keys))
+        return lookdict_unicode_groups(mp, key, hash, value_addr, hashpos);
 
     /* Make sure this function doesn't have to handle non-unicode keys,
        including subclasses of str; e.g., one reason to subclass
@@ -548,63 +1288,77 @@ lookdict_unicode(PyDictObject *mp, PyObject *key,
        that here. */
     if (!PyUnicode_CheckExact(key)) {
         mp->ma_keys->dk_lookup = lookdict;
-        return lookdict(mp, key, hash, value_addr);
+        return lookdict(mp, key, hash, value_addr, hashpos);
     }
     i = (size_t)hash & mask;
-    ep = &ep0[i];
-    if (ep->me_key == NULL || ep->me_key == key) {
-        *value_addr = &ep->me_value;
-        return ep;
-    }
-    if (ep->me_key == dummy)
-        freeslot = ep;
+    ix = dk_get_index(mp->ma_keys, i);
+    if (ix == DKIX_EMPTY) {
+        if (hashpos != NULL)
+            *hashpos = i;
+        *value_addr = NULL;
+        return DKIX_EMPTY;
+    }
+    if (ix == DKIX_DUMMY)
+        freeslot = i;
     else {
-        if (ep->me_hash == hash && unicode_eq(ep->me_key, key)) {
+        ep = &ep0[ix];
+        assert(ep->me_key != NULL);
+        if (ep->me_key == key
+            || (ep->me_hash == hash && unicode_eq(ep->me_key, key))) {
+            if (hashpos != NULL)
+                *hashpos = i;
             *value_addr = &ep->me_value;
-            return ep;
+            return ix;
         }
-        freeslot = NULL;
+        freeslot = -1;
     }
 
-    /* In the loop, me_key == dummy is by far (factor of 100s) the
-       least likely outcome, so test for that last. */
+    /* In the loop, DKIX_DUMMY is by far (factor of 100s) the least likely
+       outcome, so test for that last. */
     for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
         i = (i << 2) + i + perturb + 1;
-        ep = &ep0[i & mask];
-        if (ep->me_key == NULL) {
-            if (freeslot == NULL) {
-                *value_addr = &ep->me_value;
-                return ep;
-            } else {
-                *value_addr = &freeslot->me_value;
-                return freeslot;
-            }
+        ix = dk_get_index(mp->ma_keys, i & mask);
+        if (ix == DKIX_EMPTY) {
+            if (hashpos != NULL)
+                *hashpos = (freeslot == -1) ? (Py_ssize_t)(i & mask) : freeslot;
+            *value_addr = NULL;
+            return DKIX_EMPTY;
+        }
+        if (ix == DKIX_DUMMY) {
+            if (freeslot == -1)
+                freeslot = i & mask;
+            continue;
         }
+        ep = &ep0[ix];
+        assert(ep->me_key != NULL);
         if (ep->me_key == key
-            || (ep->me_hash == hash
-            && ep->me_key != dummy
-            && unicode_eq(ep->me_key, key))) {
+            || (ep->me_hash == hash && unicode_eq(ep->me_key, key))) {
             *value_addr = &ep->me_value;
-            return ep;
+            if (hashpos != NULL)
+                *hashpos = i & mask;
+            return ix;
         }
-        if (ep->me_key == dummy && freeslot == NULL)
-            freeslot = ep;
     }
     assert(0);          /* NOT REACHED */
     return 0;
 }
 
-/* Faster version of lookdict_unicode when it is known that no <dummy> keys
- * will be present. */
-static PyDictKeyEntry *
+/* Faster version of lookdict_unicode when it is known that no DKIX_DUMMY
+ * slots will be present. */
+static Py_ssize_t
 lookdict_unicode_nodummy(PyDictObject *mp, PyObject *key,
-                         Py_hash_t hash, PyObject ***value_addr)
+                         Py_hash_t hash, PyObject ***value_addr,
+                         Py_ssize_t *hashpos)
 {
     size_t i;
     size_t perturb;
     size_t mask = DK_MASK(mp->ma_keys);
-    PyDictKeyEntry *ep0 = &mp->ma_keys->dk_entries[0];
+    PyDictKeyEntry *ep0 = DK_ENTRIES(mp->ma_keys);
     PyDictKeyEntry *ep;
+    Py_ssize_t ix;
+    if (DK_GROUPED(mp->ma_keys))
+        return lookdict_unicode_nodummy_groups(mp, key, hash, value_addr,
+                                               hashpos);
 
     /* Make sure this function doesn't have to handle non-unicode keys,
        including subclasses of str; e.g., one reason to subclass
@@ -612,25 +1366,28 @@ lookdict_unicode_nodummy(PyDictObject *mp, PyObject *key,
        that here. */
     if (!PyUnicode_CheckExact(key)) {
         mp->ma_keys->dk_lookup = lookdict;
-        return lookdict(mp, key, hash, value_addr);
+        return lookdict(mp, key, hash, value_addr, hashpos);
     }
     i = (size_t)hash & mask;
-    ep = &ep0[i];
-    assert(ep->me_key == NULL || PyUnicode_CheckExact(ep->me_key));
-    if (ep->me_key == NULL || ep->me_key == key ||
-        (ep->me_hash == hash && unicode_eq(ep->me_key, key))) {
-        *value_addr = &ep->me_value;
-        return ep;
-    }
     for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
-        i = (i << 2) + i + perturb + 1;
-        ep = &ep0[i & mask];
-        assert(ep->me_key == NULL || PyUnicode_CheckExact(ep->me_key));
-        if (ep->me_key == NULL || ep->me_key == key ||
+        ix = dk_get_index(mp->ma_keys, i & mask);
+        assert (ix != DKIX_DUMMY);
+        if (ix == DKIX_EMPTY) {
+            if (hashpos != NULL)
+                *hashpos = i & mask;
+            *value_addr = NULL;
+            return DKIX_EMPTY;
+        }
+        ep = &ep0[ix];
+        assert(ep->me_key != NULL && PyUnicode_CheckExact(ep->me_key));
+        if (ep->me_key == key ||
             (ep->me_hash == hash && unicode_eq(ep->me_key, key))) {
+            if (hashpos != NULL)
+                *hashpos = i & mask;
             *value_addr = &ep->me_value;
-            return ep;
+            return ix;
         }
+        i = (i << 2) + i + perturb + 1;
     }
     assert(0);          /* NOT REACHED */
     return 0;
@@ -638,48 +1395,73 @@ lookdict_unicode_nodummy(PyDictObject *mp, PyObject *key,
 
 /* Version of lookdict for split tables.
  * All split tables and only split tables use this lookup function.
- * Split tables only contain unicode keys and no dummy keys,
+ * Split tables only contain unicode keys and no dummy slots,
  * so algorithm is the same as lookdict_unicode_nodummy.
  */
-static PyDictKeyEntry *
+static Py_ssize_t
 lookdict_split(PyDictObject *mp, PyObject *key,
-               Py_hash_t hash, PyObject ***value_addr)
+               Py_hash_t hash, PyObject ***value_addr, Py_ssize_t *hashpos)
 {
     size_t i;
     size_t perturb;
     size_t mask = DK_MASK(mp->ma_keys);
-    PyDictKeyEntry *ep0 = &mp->ma_keys->dk_entries[0];
+    PyDictKeyEntry *ep0 = DK_ENTRIES(mp->ma_keys);
     PyDictKeyEntry *ep;
+    Py_ssize_t ix;
+    if (DK_GROUPED(mp->ma_keys))
+        return lookdict_split_groups(mp, key, hash, value_addr, hashpos);
 
     if (!PyUnicode_CheckExact(key)) {
-        ep = lookdict(mp, key, hash, value_addr);
+        ix = lookdict(mp, key, hash, value_addr, hashpos);
         /* lookdict expects a combined-table, so fix value_addr */
-        i = ep - ep0;
-        *value_addr = &mp->ma_values[i];
-        return ep;
+        if (ix >= 0)
+            *value_addr = &mp->ma_values[ix];
+        return ix;
     }
     i = (size_t)hash & mask;
-    ep = &ep0[i];
-    assert(ep->me_key == NULL || PyUnicode_CheckExact(ep->me_key));
-    if (ep->me_key == NULL || ep->me_key == key ||
-        (ep->me_hash == hash && unicode_eq(ep->me_key, key))) {
-        *value_addr = &mp->ma_values[i];
-        return ep;
-    }
     for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
-        i = (i << 2) + i + perturb + 1;
-        ep = &ep0[i & mask];
-        assert(ep->me_key == NULL || PyUnicode_CheckExact(ep->me_key));
-        if (ep->me_key == NULL || ep->me_key == key ||
+        ix = dk_get_index(mp->ma_keys, i & mask);
+        assert (ix != DKIX_DUMMY);
+        if (ix == DKIX_EMPTY) {
+            if (hashpos != NULL)
+                *hashpos = i & mask;
+            *value_addr = NULL;
+            return DKIX_EMPTY;
+        }
+        ep = &ep0[ix];
+        assert(ep->me_key != NULL && PyUnicode_CheckExact(ep->me_key));
+        if (ep->me_key == key ||
             (ep->me_hash == hash && unicode_eq(ep->me_key, key))) {
-            *value_addr = &mp->ma_values[i & mask];
-            return ep;
+            if (hashpos != NULL)
+                *hashpos = i & mask;
+            *value_addr = &mp->ma_values[ix];
+            return ix;
         }
+        i = (i << 2) + i + perturb + 1;
     }
     assert(0);          /* NOT REACHED */
     return 0;
 }
 
+/* The first Unused slot in the probe sequence of hash */
+static Py_ssize_t
+dk_find_empty(PyDictKeysObject *k, Py_hash_t hash)
+{
+    size_t mask = DK_MASK(k);
+    size_t i = (size_t)hash & mask;
+    size_t perturb;
+    if (DK_GROUPED(k))
+        return dk_find_empty_groups(k, hash);
+
+    for (perturb = hash; dk_get_index(k, i) != DKIX_EMPTY;
+         perturb >>= PERTURB_SHIFT) {
+        i = (i << 2) + i + perturb + 1;
+        i &= mask;
+    }
+    return i;
+}
+
+
 int
 _PyDict_HasOnlyStringKeys(PyObject *dict)
 {
@@ -710,27 +1492,27 @@ _PyDict_MaybeUntrack(PyObject *op)
 {
     PyDictObject *mp;
     PyObject *value;
-    Py_ssize_t i, size;
+    Py_ssize_t i, numentries;
+    PyDictKeyEntry *ep0;
 
     if (!PyDict_CheckExact(op) || !_PyObject_GC_IS_TRACKED(op))
         return;
 
     mp = (PyDictObject *) op;
-    size = DK_SIZE(mp->ma_keys);
+    ep0 = DK_ENTRIES(mp->ma_keys);
+    numentries = mp->ma_keys->dk_nentries;
     if (_PyDict_HasSplitTable(mp)) {
-        for (i = 0; i < size; i++) {
+        for (i = 0; i < numentries; i++) {
             if ((value = mp->ma_values[i]) == NULL)
                 continue;
             if (_PyObject_GC_MAY_BE_TRACKED(value)) {
-                assert(!_PyObject_GC_MAY_BE_TRACKED(
-                    mp->ma_keys->dk_entries[i].me_key));
+                assert(!_PyObject_GC_MAY_BE_TRACKED(ep0[i].me_key));
                 return;
             }
         }
     }
     else {
-        PyDictKeyEntry *ep0 = &mp->ma_keys->dk_entries[0];
-        for (i = 0; i < size; i++) {
+        for (i = 0; i < numentries; i++) {
             if ((value = ep0[i].me_value) == NULL)
                 continue;
             if (_PyObject_GC_MAY_BE_TRACKED(value) ||
@@ -743,32 +1525,22 @@ _PyDict_MaybeUntrack(PyObject *op)
 
 /* Internal function to find slot for an item from its hash
  * when it is known that the key is not present in the dict.
- */
-static PyDictKeyEntry *
+ *
+ * The dict must be combined. */
+static void
 find_empty_slot(PyDictObject *mp, PyObject *key, Py_hash_t hash,
-                PyObject ***value_addr)
+                PyObject ***value_addr, Py_ssize_t *hashpos)
 {
-    size_t i;
-    size_t perturb;
-    size_t mask = DK_MASK(mp->ma_keys);
-    PyDictKeyEntry *ep0 = &mp->ma_keys->dk_entries[0];
-    PyDictKeyEntry *ep;
+    PyDictKeyEntry *ep0 = DK_ENTRIES(mp->ma_keys);
 
+    assert(!_PyDict_HasSplitTable(mp));
+    assert(hashpos != NULL);
     assert(key != NULL);
     if (!PyUnicode_CheckExact(key))
         mp->ma_keys->dk_lookup = lookdict;
-    i = hash & mask;
-    ep = &ep0[i];
-    for (perturb = hash; ep->me_key != NULL; perturb >>= PERTURB_SHIFT) {
-        i = (i << 2) + i + perturb + 1;
-        ep = &ep0[i & mask];
-    }
-    assert(ep->me_value == NULL);
-    if (mp->ma_values)
-        *value_addr = &mp->ma_values[i & mask];
-    else
-        *value_addr = &ep->me_value;
-    return ep;
+    assert(ep0[mp->ma_keys->dk_nentries].me_value == NULL);
+    *hashpos = dk_find_empty(mp->ma_keys, hash);
+    *value_addr = &ep0[mp->ma_keys->dk_nentries].me_value;
 }
 
 static int
@@ -777,6 +1549,44 @@ insertion_resize(PyDictObject *mp)
     return dictresize(mp, GROWTH_RATE(mp));
 }
 
+/* Add the new entry (key, value) to the end of the entries, at the slot
+ * hashpos of the hash table.  The caller has made room for it.
+ * Steals a reference to value, but not to key.
+ */
+static void
+append_entry(PyDictObject *mp, PyObject *key, Py_hash_t hash,
+             PyObject *value, Py_ssize_t hashpos)
+{
+    PyDictKeysObject *k = mp->ma_keys;
+    PyDictKeyEntry *ep = &DK_ENTRIES(k)[k->dk_nentries];
+
+    assert(k->dk_usable > 0);
+    dk_set_entry(k, hashpos, k->dk_nentries, hash);
+    Py_INCREF(key);
+    ep->me_key = key;
+    ep->me_hash = hash;
+    if (mp->ma_values) {
+        assert(mp->ma_values[k->dk_nentries] == NULL);
+        mp->ma_values[k->dk_nentries] = value;
+    }
+    else {
+        ep->me_value = value;
+    }
+    mp->ma_used++;
+    mp->ma_version_tag = DICT_NEXT_VERSION();
+    k->dk_usable--;
+    k->dk_nentries++;
+}
+
+/* A split table takes values only in the order of its shared entries, so
+ * that it iterates in insertion order:  a new key must be the next entry,
+ * and a pending value the next one to be set.
+ */
+#define SPLIT_OUT_OF_ORDER(mp, ix, value_addr) \
+    (_PyDict_HasSplitTable(mp) && \
+     (((ix) >= 0 && *(value_addr) == NULL && (mp)->ma_used != (ix)) || \
+      ((ix) == DKIX_EMPTY && (mp)->ma_used != (mp)->ma_keys->dk_nentries)))
+
 /*
 Internal routine to insert a new item into the table.
 Used both by the internal resize routine and by the public insert routine.
@@ -787,57 +1597,53 @@ insertdict(PyDictObject *mp, PyObject *key, Py_hash_t hash, PyObject *value)
 {
     PyObject *old_value;
     PyObject **value_addr;
-    PyDictKeyEntry *ep;
-    assert(key != dummy);
+    Py_ssize_t ix, hashpos;
 
     if (mp->ma_values != NULL && !PyUnicode_CheckExact(key)) {
         if (insertion_resize(mp) < 0)
             return -1;
     }
 
-    ep = mp->ma_keys->dk_lookup(mp, key, hash, &value_addr);
-    if (ep == NULL) {
+    ix = mp->ma_keys->dk_lookup(mp, key, hash, &value_addr, &hashpos);
+    if (ix == DKIX_ERROR) {
         return -1;
     }
     assert(PyUnicode_CheckExact(key) || mp->ma_keys->dk_lookup == lookdict);
     Py_INCREF(value);
     MAINTAIN_TRACKING(mp, key, value);
+
+    if (SPLIT_OUT_OF_ORDER(mp, ix, value_addr)) {
+        if (insertion_resize(mp) < 0) {
+            Py_DECREF(value);
+            return -1;
+        }
+        find_empty_slot(mp, key, hash, &value_addr, &hashpos);
+        ix = DKIX_EMPTY;
+    }
+
+    if (ix == DKIX_EMPTY) {
+        if (mp->ma_keys->dk_usable <= 0) {
+            /* Need to resize. */
+            if (insertion_resize(mp) < 0) {
+                Py_DECREF(value);
+                return -1;
+            }
+            find_empty_slot(mp, key, hash, &value_addr, &hashpos);
+        }
+        append_entry(mp, key, hash, value, hashpos);
+        return 0;
+    }
+
     old_value = *value_addr;
+    *value_addr = value;
+    mp->ma_version_tag = DICT_NEXT_VERSION();
     if (old_value != NULL) {
-        assert(ep->me_key != NULL && ep->me_key != dummy);
-        *value_addr = value;
         Py_DECREF(old_value); /* which **CAN** re-enter (see issue #22653) */
     }
     else {
-        if (ep->me_key == NULL) {
-            Py_INCREF(key);
-            if (mp->ma_keys->dk_usable <= 0) {
-                /* Need to resize. */
-                if (insertion_resize(mp) < 0) {
-                    Py_DECREF(key);
-                    Py_DECREF(value);
-                    return -1;
-                }
-                ep = find_empty_slot(mp, key, hash, &value_addr);
-            }
-            mp->ma_keys->dk_usable--;
-            assert(mp->ma_keys->dk_usable >= 0);
-            ep->me_key = key;
-            ep->me_hash = hash;
-        }
-        else {
-            if (ep->me_key == dummy) {
-                Py_INCREF(key);
-                ep->me_key = key;
-                ep->me_hash = hash;
-                Py_DECREF(dummy);
-            } else {
-                assert(_PyDict_HasSplitTable(mp));
-            }
-        }
+        /* a pending value of a split table */
+        assert(_PyDict_HasSplitTable(mp) && ix == mp->ma_used);
         mp->ma_used++;
-        *value_addr = value;
-        assert(ep->me_key != NULL && ep->me_key != dummy);
     }
     return 0;
 }
@@ -856,30 +1662,44 @@ static void
 insertdict_clean(PyDictObject *mp, PyObject *key, Py_hash_t hash,
                  PyObject *value)
 {
-    size_t i;
-    size_t perturb;
     PyDictKeysObject *k = mp->ma_keys;
-    size_t mask = (size_t)DK_SIZE(k)-1;
-    PyDictKeyEntry *ep0 = &k->dk_entries[0];
     PyDictKeyEntry *ep;
 
     assert(k->dk_lookup != NULL);
     assert(value != NULL);
     assert(key != NULL);
-    assert(key != dummy);
     assert(PyUnicode_CheckExact(key) || k->dk_lookup == lookdict);
-    i = hash & mask;
-    ep = &ep0[i];
-    for (perturb = hash; ep->me_key != NULL; perturb >>= PERTURB_SHIFT) {
-        i = (i << 2) + i + perturb + 1;
-        ep = &ep0[i & mask];
-    }
+    ep = &DK_ENTRIES(k)[k->dk_nentries];
     assert(ep->me_value == NULL);
+    dk_set_entry(k, dk_find_empty(k, hash), k->dk_nentries, hash);
+    k->dk_nentries++;
     ep->me_key = key;
     ep->me_hash = hash;
     ep->me_value = value;
 }
 
+/*
+Add the item (key, value) to a combined dict which has room for it, when the
+key is known to be absent:  it is appended with no lookup and no comparison.
+New references to key and value are taken, and ma_used and dk_usable are
+updated, but not ma_version_tag;  the caller bumps it once for all the items.
+*/
+static void
+insert_new_item(PyDictObject *mp, PyObject *key, Py_hash_t hash,
+                PyObject *value)
+{
+    assert(mp->ma_values == NULL);
+    assert(mp->ma_keys->dk_usable > 0);
+    if (!PyUnicode_CheckExact(key))
+        mp->ma_keys->dk_lookup = lookdict;
+    Py_INCREF(key);
+    Py_INCREF(value);
+    MAINTAIN_TRACKING(mp, key, value);
+    insertdict_clean(mp, key, hash, value);
+    mp->ma_used++;
+    mp->ma_keys->dk_usable--;
+}
+
 /*
 Restructure the table by allocating a new table and reinserting all
 items again.  When entries have been deleted, the new table may
@@ -896,7 +1716,8 @@ dictresize(PyDictObject *mp, Py_ssize_t minused)
     Py_ssize_t newsize;
     PyDictKeysObject *oldkeys;
     PyObject **oldvalues;
-    Py_ssize_t i, oldsize;
+    PyDictKeyEntry *ep0;
+    Py_ssize_t i, oldnentries;
 
 /* Find the smallest table size > minused. */
     for (newsize = PyDict_MINSIZE_COMBINED;
@@ -917,56 +1738,60 @@ dictresize(PyDictObject *mp, Py_ssize_t minused)
     }
     if (oldkeys->dk_lookup == lookdict)
         mp->ma_keys->dk_lookup = lookdict;
-    oldsize = DK_SIZE(oldkeys);
     mp->ma_values = NULL;
-    /* If empty then nothing to copy so just return */
-    if (oldsize == 1) {
-        assert(oldkeys == Py_EMPTY_KEYS);
-        DK_DECREF(oldkeys);
-        return 0;
-    }
+    ep0 = DK_ENTRIES(oldkeys);
+    oldnentries = oldkeys->dk_nentries;
     /* Main loop below assumes we can transfer refcount to new keys
      * and that value is stored in me_value.
      * Increment ref-counts and copy values here to compensate
      * This (resizing a split table) should be relatively rare */
     if (oldvalues != NULL) {
-        for (i = 0; i < oldsize; i++) {
+        for (i = 0; i < oldnentries; i++) {
             if (oldvalues[i] != NULL) {
-                Py_INCREF(oldkeys->dk_entries[i].me_key);
-                oldkeys->dk_entries[i].me_value = oldvalues[i];
+                Py_INCREF(ep0[i].me_key);
+                ep0[i].me_value = oldvalues[i];
             }
         }
     }
-    /* Main loop */
-    for (i = 0; i < oldsize; i++) {
-        PyDictKeyEntry *ep = &oldkeys->dk_entries[i];
+    /* Main loop:  the entries keep their order, without the deleted ones */
+    for (i = 0; i < oldnentries; i++) {
+        PyDictKeyEntry *ep = &ep0[i];
         if (ep->me_value != NULL) {
-            assert(ep->me_key != dummy);
             insertdict_clean(mp, ep->me_key, ep->me_hash, ep->me_value);
         }
     }
     mp->ma_keys->dk_usable -= mp->ma_used;
     if (oldvalues != NULL) {
         /* NULL out me_value slot in oldkeys, in case it was shared */
-        for (i = 0; i < oldsize; i++)
-            oldkeys->dk_entries[i].me_value = NULL;
-        assert(oldvalues != empty_values);
-        free_values(oldvalues);
+        for (i = 0; i < oldnentries; i++)
+            ep0[i].me_value = NULL;
         DK_DECREF(oldkeys);
+        if (oldvalues != empty_values) {
+            free_values(oldvalues);
+        }
     }
     else {
         assert(oldkeys->dk_lookup != lookdict_split);
-        if (oldkeys->dk_lookup != lookdict_unicode_nodummy) {
-            PyDictKeyEntry *ep0 = &oldkeys->dk_entries[0];
-            for (i = 0; i < oldsize; i++) {
-                if (ep0[i].me_key == dummy)
-                    Py_DECREF(dummy);
-            }
-        }
         assert(oldkeys->dk_refcnt == 1);
-        DK_DEBUG_DECREF PyMem_FREE(oldkeys);
+        DK_DEBUG_DECREF dk_free(oldkeys);
+    }
+    return 0;
+}
+
+/* Make room for n more items in mp with at most one resize, so that
+ * inserting them doesn't resize again.  A table which has room already is
+ * left as it is, even a split one.
+ */
+static int
+dict_presize(PyDictObject *mp, Py_ssize_t n)
+{
+    if (n <= mp->ma_keys->dk_usable)
+        return 0;
+    if (n > PY_SSIZE_T_MAX / 3 - mp->ma_used) {
+        PyErr_NoMemory();
+        return -1;
     }
-    return 0;
+    return dictresize(mp, ESTIMATE_SIZE(mp->ma_used + n));
 }
 
 /* Returns NULL if unable to split table.
@@ -988,14 +1813,14 @@ make_keys_shared(PyObject *op)
             return NULL;
         }
         else if (mp->ma_keys->dk_lookup == lookdict_unicode) {
-            /* Remove dummy keys */
+            /* Remove dummy slots */
             if (dictresize(mp, DK_SIZE(mp->ma_keys)))
                 return NULL;
         }
         assert(mp->ma_keys->dk_lookup == lookdict_unicode_nodummy);
         /* Copy values into a new array */
-        ep0 = &mp->ma_keys->dk_entries[0];
-        size = DK_SIZE(mp->ma_keys);
+        ep0 = DK_ENTRIES(mp->ma_keys);
+        size = USABLE_FRACTION(DK_SIZE(mp->ma_keys));
         values = new_values(size);
         if (values == NULL) {
             PyErr_SetString(PyExc_MemoryError,
@@ -1018,8 +1843,12 @@ _PyDict_NewPresized(Py_ssize_t minused)
 {
     Py_ssize_t newsize;
     PyDictKeysObject *new_keys;
+
+    if (minused > PY_SSIZE_T_MAX / 3)
+        return PyErr_NoMemory();
+    /* Room for minused items, without a resize on the last ones */
     for (newsize = PyDict_MINSIZE_COMBINED;
-         newsize <= minused && newsize > 0;
+         newsize <= ESTIMATE_SIZE(minused) && newsize > 0;
          newsize <<= 1)
         ;
     new_keys = new_keys_object(newsize);
@@ -1043,7 +1872,7 @@ PyDict_GetItem(PyObject *op, PyObject *key)
 {
     Py_hash_t hash;
     PyDictObject *mp = (PyDictObject *)op;
-    PyDictKeyEntry *ep;
+    Py_ssize_t ix;
     PyThreadState *tstate;
     PyObject **value_addr;
 
@@ -1070,15 +1899,15 @@ PyDict_GetItem(PyObject *op, PyObject *key)
         /* preserve the existing exception */
         PyObject *err_type, *err_value, *err_tb;
         PyErr_Fetch(&err_type, &err_value, &err_tb);
-        ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
+        ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, NULL);
         /* ignore errors */
         PyErr_Restore(err_type, err_value, err_tb);
-        if (ep == NULL)
+        if (ix < 0)
             return NULL;
     }
     else {
-        ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
-        if (ep == NULL) {
+        ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, NULL);
+        if (ix < 0) {
             PyErr_Clear();
             return NULL;
         }
@@ -1090,7 +1919,7 @@ PyObject *
 _PyDict_GetItem_KnownHash(PyObject *op, PyObject *key, Py_hash_t hash)
 {
     PyDictObject *mp = (PyDictObject *)op;
-    PyDictKeyEntry *ep;
+    Py_ssize_t ix;
     PyThreadState *tstate;
     PyObject **value_addr;
 
@@ -1108,15 +1937,15 @@ _PyDict_GetItem_KnownHash(PyObject *op, PyObject *key, Py_hash_t hash)
         /* preserve the existing exception */
         PyObject *err_type, *err_value, *err_tb;
         PyErr_Fetch(&err_type, &err_value, &err_tb);
-        ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
+        ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, NULL);
         /* ignore errors */
         PyErr_Restore(err_type, err_value, err_tb);
-        if (ep == NULL)
+        if (ix < 0)
             return NULL;
     }
     else {
-        ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
-        if (ep == NULL) {
+        ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, NULL);
+        if (ix < 0) {
             PyErr_Clear();
             return NULL;
         }
@@ -1133,7 +1962,7 @@ PyDict_GetItemWithError(PyObject *op, PyObject *key)
 {
     Py_hash_t hash;
     PyDictObject*mp = (PyDictObject *)op;
-    PyDictKeyEntry *ep;
+    Py_ssize_t ix;
     PyObject **value_addr;
 
     if (!PyDict_Check(op)) {
@@ -1149,8 +1978,8 @@ PyDict_GetItemWithError(PyObject *op, PyObject *key)
         }
     }
 
-    ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
-    if (ep == NULL)
+    ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, NULL);
+    if (ix < 0)
         return NULL;
     return *value_addr;
 }
@@ -1176,16 +2005,17 @@ _PyDict_LoadGlobal(PyDictObject *globals, PyDictObject *builtins, PyObject *key)
         PyObject **value_addr;
         Py_hash_t hash = ((PyASCIIObject *)key)->hash;
         if (hash != -1) {
-            PyDictKeyEntry *e;
-            e = globals->ma_keys->dk_lookup(globals, key, hash, &value_addr);
-            if (e == NULL) {
+            Py_ssize_t ix;
+            ix = globals->ma_keys->dk_lookup(globals, key, hash, &value_addr,
+                                             NULL);
+            if (ix == DKIX_ERROR) {
                 return NULL;
             }
-            x = *value_addr;
-            if (x != NULL)
+            if (ix >= 0 && (x = *value_addr) != NULL)
                 return x;
-            e = builtins->ma_keys->dk_lookup(builtins, key, hash, &value_addr);
-            if (e == NULL) {
+            ix = builtins->ma_keys->dk_lookup(builtins, key, hash,
+                                              &value_addr, NULL);
+            if (ix < 0) {
                 return NULL;
             }
             x = *value_addr;
@@ -1200,6 +2030,86 @@ _PyDict_LoadGlobal(PyDictObject *globals, PyDictObject *builtins, PyObject *key)
     return PyDict_GetItemWithError((PyObject *)builtins, key);
 }
 
+/* Lookup of an attribute in an instance dict, for the attribute caches of
+ * ceval.c.  'hint' is where the key was found last time:  the index of its
+ * entry, which is also the index of its value in a split table.  If the
+ * entry there doesn't hold 'key' itself, the dict is searched as usual.
+ *
+ * Returns the index of the entry of 'key', or -1 if there is none, and sets
+ * *value to the value (borrowed), or to NULL if the key is missing.  A split
+ * table may have an entry for a key without a value.  Like PyDict_GetItem(),
+ * errors are suppressed.
+ */
+Py_ssize_t
+_PyDict_GetItemHint(PyDictObject *mp, PyObject *key, Py_ssize_t hint,
+                    PyObject **value)
+{
+    PyDictKeysObject *dk = mp->ma_keys;
+    PyDictKeyEntry *ep;
+    PyObject **value_addr;
+    Py_hash_t hash;
+    Py_ssize_t ix;
+
+    if (hint >= 0 && hint < dk->dk_nentries) {
+        ep = &DK_ENTRIES(dk)[hint];
+        if (ep->me_key == key) {
+            *value = mp->ma_values ? mp->ma_values[hint] : ep->me_value;
+            return hint;
+        }
+    }
+
+    *value = NULL;
+    if (!PyUnicode_CheckExact(key) ||
+        (hash = ((PyASCIIObject *)key)->hash) == -1) {
+        hash = PyObject_Hash(key);
+        if (hash == -1) {
+            PyErr_Clear();
+            return -1;
+        }
+    }
+    ix = (dk->dk_lookup)(mp, key, hash, &value_addr, NULL);
+    if (ix < 0) {
+        if (ix == DKIX_ERROR)
+            PyErr_Clear();
+        return -1;
+    }
+    *value = *value_addr;
+    return ix;
+}
+
+/* Set the value of 'key' to 'value', for the attribute caches of ceval.c,
+ * if the entry at 'hint' holds the key itself:  a split table may have the
+ * key without a value yet, which it takes only in the order of its entries.
+ * Returns 0 if it did, 1 if the caller must use PyDict_SetItem().
+ */
+int
+_PyDict_SetItemHint(PyDictObject *mp, PyObject *key, Py_ssize_t hint,
+                    PyObject *value)
+{
+    PyDictKeysObject *dk = mp->ma_keys;
+    PyDictKeyEntry *ep;
+    PyObject **value_addr, *old_value;
+
+    if (hint < 0 || hint >= dk->dk_nentries)
+        return 1;
+    ep = &DK_ENTRIES(dk)[hint];
+    if (ep->me_key != key)
+        return 1;
+    value_addr = mp->ma_values ? &mp->ma_values[hint] : &ep->me_value;
+    old_value = *value_addr;
+    if (old_value == NULL && (mp->ma_values == NULL || hint != mp->ma_used))
+        return 1;
+    Py_INCREF(value);
+    MAINTAIN_TRACKING(mp, key, value);
+    *value_addr = value;
+    mp->ma_version_tag = DICT_NEXT_VERSION();
+    if (old_value == NULL)
+        mp->ma_used++;
+    else
+        Py_DECREF(old_value); /* which **CAN** re-enter (see issue #22653) */
+    return 0;
+}
+
 /* CAUTION: PyDict_SetItem() must guarantee that it won't resize the
  * dictionary if it's merely replacing the value for an existing key.
  * This means that it's safe to loop over a dictionary with PyDict_Next()
@@ -1249,19 +2159,44 @@ _PyDict_SetItem_KnownHash(PyObject *op, PyObject *key, PyObject *value,
     return insertdict(mp, key, hash, value);
 }
 
+/* Remove the entry 'ix' found at slot 'hashpos' of the table, and return
+ * the value it held (a new reference), or NULL if it was a pending value.
+ * A split table is combined first, since it can't delete its shared keys.
+ * Returns NULL with an exception set on error.
+ */
+static PyObject *
+delitem_common(PyDictObject *mp, PyObject *key, Py_hash_t hash,
+               Py_ssize_t ix, Py_ssize_t hashpos, PyObject **value_addr)
+{
+    PyObject *old_key, *old_value;
+    PyDictKeyEntry *ep;
+
+    if (_PyDict_HasSplitTable(mp)) {
+        if (dictresize(mp, DK_SIZE(mp->ma_keys)))
+            return NULL;
+        ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+        assert(ix >= 0);
+    }
+    assert(dk_get_index(mp->ma_keys, hashpos) == ix);
+    old_value = *value_addr;
+    assert(old_value != NULL);
+    *value_addr = NULL;
+    mp->ma_used--;
+    mp->ma_version_tag = DICT_NEXT_VERSION();
+    ep = &DK_ENTRIES(mp->ma_keys)[ix];
+    dk_clear_slot(mp->ma_keys, hashpos);
+    ENSURE_ALLOWS_DELETIONS(mp);
+    old_key = ep->me_key;
+    ep->me_key = NULL;
+    Py_DECREF(old_key);
+    return old_value;
+}
+
 int
 PyDict_DelItem(PyObject *op, PyObject *key)
 {
-    PyDictObject *mp;
     Py_hash_t hash;
-    PyDictKeyEntry *ep;
-    PyObject *old_key, *old_value;
-    PyObject **value_addr;
 
-    if (!PyDict_Check(op)) {
-        PyErr_BadInternalCall();
-        return -1;
-    }
     assert(key);
     if (!PyUnicode_CheckExact(key) ||
         (hash = ((PyASCIIObject *) key)->hash) == -1) {
@@ -1269,34 +2204,15 @@ PyDict_DelItem(PyObject *op, PyObject *key)
         if (hash == -1)
             return -1;
     }
-    mp = (PyDictObject *)op;
-    ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
-    if (ep == NULL)
-        return -1;
-    if (*value_addr == NULL) {
-        _PyErr_SetKeyError(key);
-        return -1;
-    }
-    old_value = *value_addr;
-    *value_addr = NULL;
-    mp->ma_used--;
-    if (!_PyDict_HasSplitTable(mp)) {
-        ENSURE_ALLOWS_DELETIONS(mp);
-        old_key = ep->me_key;
-        Py_INCREF(dummy);
-        ep->me_key = dummy;
-        Py_DECREF(old_key);
-    }
-    Py_DECREF(old_value);
-    return 0;
+    return _PyDict_DelItem_KnownHash(op, key, hash);
 }
 
 int
 _PyDict_DelItem_KnownHash(PyObject *op, PyObject *key, Py_hash_t hash)
 {
     PyDictObject *mp;
-    PyDictKeyEntry *ep;
-    PyObject *old_key, *old_value;
+    Py_ssize_t ix, hashpos;
+    PyObject *old_value;
     PyObject **value_addr;
 
     if (!PyDict_Check(op)) {
@@ -1306,23 +2222,16 @@ _PyDict_DelItem_KnownHash(PyObject *op, PyObject *key, Py_hash_t hash)
     assert(key);
     assert(hash != -1);
     mp = (PyDictObject *)op;
-    ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
-    if (ep == NULL)
+    ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+    if (ix == DKIX_ERROR)
         return -1;
-    if (*value_addr == NULL) {
+    if (ix == DKIX_EMPTY || *value_addr == NULL) {
         _PyErr_SetKeyError(key);
         return -1;
     }
-    old_value = *value_addr;
-    *value_addr = NULL;
-    mp->ma_used--;
-    if (!_PyDict_HasSplitTable(mp)) {
-        ENSURE_ALLOWS_DELETIONS(mp);
-        old_key = ep->me_key;
-        Py_INCREF(dummy);
-        ep->me_key = dummy;
-        Py_DECREF(old_key);
-    }
+    old_value = delitem_common(mp, key, hash, ix, hashpos, value_addr);
+    if (old_value == NULL)
+        return -1;
     Py_DECREF(old_value);
     return 0;
 }
@@ -1347,9 +2256,10 @@ PyDict_Clear(PyObject *op)
     mp->ma_keys = Py_EMPTY_KEYS;
     mp->ma_values = empty_values;
     mp->ma_used = 0;
+    mp->ma_version_tag = DICT_NEXT_VERSION();
     /* ...then clear the keys and values */
     if (oldvalues != NULL) {
-        n = DK_SIZE(oldkeys);
+        n = oldkeys->dk_nentries;
         for (i = 0; i < n; i++)
             Py_CLEAR(oldvalues[i]);
         free_values(oldvalues);
@@ -1367,33 +2277,38 @@ PyDict_Clear(PyObject *op)
 Py_LOCAL_INLINE(Py_ssize_t)
 dict_next(PyObject *op, Py_ssize_t i, PyObject **pvalue)
 {
-    Py_ssize_t mask, offset;
+    Py_ssize_t n;
     PyDictObject *mp;
-    PyObject **value_ptr;
-
+    PyObject *value;
 
     if (!PyDict_Check(op))
         return -1;
     mp = (PyDictObject *)op;
-    if (i < 0)
+    n = mp->ma_keys->dk_nentries;
+    if (i < 0 || i >= n)
         return -1;
     if (mp->ma_values) {
-        value_ptr = &mp->ma_values[i];
-        offset = sizeof(PyObject *);
+        PyObject **value_ptr = &mp->ma_values[i];
+        while (i < n && *value_ptr == NULL) {
+            value_ptr++;
+            i++;
+        }
+        if (i >= n)
+            return -1;
+        value = *value_ptr;
     }
     else {
-        value_ptr = &mp->ma_keys->dk_entries[i].me_value;
-        offset = sizeof(PyDictKeyEntry);
-    }
-    mask = DK_MASK(mp->ma_keys);
-    while (i <= mask && *value_ptr == NULL) {
-        value_ptr = (PyObject **)(((char *)value_ptr) + offset);
-        i++;
+        PyDictKeyEntry *ep = &DK_ENTRIES(mp->ma_keys)[i];
+        while (i < n && ep->me_value == NULL) {
+            ep++;
+            i++;
+        }
+        if (i >= n)
+            return -1;
+        value = ep->me_value;
     }
-    if (i > mask)
-        return -1;
     if (pvalue)
-        *pvalue = *value_ptr;
+        *pvalue = value;
     return i;
 }
 
@@ -1422,7 +2337,7 @@ PyDict_Next(PyObject *op, Py_ssize_t *ppos, PyObject **pkey, PyObject **pvalue)
     mp = (PyDictObject *)op;
     *ppos = i+1;
     if (pkey)
-        *pkey = mp->ma_keys->dk_entries[i].me_key;
+        *pkey = DK_ENTRIES(mp->ma_keys)[i].me_key;
     return 1;
 }
 
@@ -1434,14 +2349,16 @@ _PyDict_Next(PyObject *op, Py_ssize_t *ppos, PyObject **pkey,
              PyObject **pvalue, Py_hash_t *phash)
 {
     PyDictObject *mp;
+    PyDictKeyEntry *ep;
     Py_ssize_t i = dict_next(op, *ppos, pvalue);
     if (i < 0)
         return 0;
     mp = (PyDictObject *)op;
+    ep = &DK_ENTRIES(mp->ma_keys)[i];
     *ppos = i+1;
-    *phash = mp->ma_keys->dk_entries[i].me_hash;
+    *phash = ep->me_hash;
     if (pkey)
-        *pkey = mp->ma_keys->dk_entries[i].me_key;
+        *pkey = ep->me_key;
     return 1;
 }
 
@@ -1450,8 +2367,7 @@ PyObject *
 _PyDict_Pop(PyDictObject *mp, PyObject *key, PyObject *deflt)
 {
     Py_hash_t hash;
-    PyObject *old_value, *old_key;
-    PyDictKeyEntry *ep;
+    Py_ssize_t ix, hashpos;
     PyObject **value_addr;
 
     if (mp->ma_used == 0) {
@@ -1468,11 +2384,10 @@ _PyDict_Pop(PyDictObject *mp, PyObject *key, PyObject *deflt)
         if (hash == -1)
             return NULL;
     }
-    ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
-    if (ep == NULL)
+    ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+    if (ix == DKIX_ERROR)
         return NULL;
-    old_value = *value_addr;
-    if (old_value == NULL) {
+    if (ix == DKIX_EMPTY || *value_addr == NULL) {
         if (deflt) {
             Py_INCREF(deflt);
             return deflt;
@@ -1480,16 +2395,7 @@ _PyDict_Pop(PyDictObject *mp, PyObject *key, PyObject *deflt)
         _PyErr_SetKeyError(key);
         return NULL;
     }
-    *value_addr = NULL;
-    mp->ma_used--;
-    if (!_PyDict_HasSplitTable(mp)) {
-        ENSURE_ALLOWS_DELETIONS(mp);
-        old_key = ep->me_key;
-        Py_INCREF(dummy);
-        ep->me_key = dummy;
-        Py_DECREF(old_key);
-    }
-    return old_value;
+    return delitem_common(mp, key, hash, ix, hashpos, value_addr);
 }
 
 /* Internal version of dict.from_keys().  It is subclass-friendly. */
@@ -1505,7 +2411,10 @@ _PyDict_FromKeys(PyObject *cls, PyObject *iterable, PyObject *value)
     if (d == NULL)
         return NULL;
 
-    if (PyDict_CheckExact(d) && ((PyDictObject *)d)->ma_used == 0) {
+    /* The keys of a dict or a set are unique:  they are appended to the
+       empty dict, in a table just large enough, without lookups. */
+    if (PyDict_CheckExact(d) && ((PyDictObject *)d)->ma_used == 0 &&
+        ((PyDictObject *)d)->ma_values == NULL) {
         if (PyDict_CheckExact(iterable)) {
             PyDictObject *mp = (PyDictObject *)d;
             PyObject *oldvalue;
@@ -1513,17 +2422,14 @@ _PyDict_FromKeys(PyObject *cls, PyObject *iterable, PyObject *value)
             PyObject *key;
             Py_hash_t hash;
 
-            if (dictresize(mp, Py_SIZE(iterable))) {
+            if (dict_presize(mp, ((PyDictObject *)iterable)->ma_used)) {
                 Py_DECREF(d);
                 return NULL;
             }
 
-            while (_PyDict_Next(iterable, &pos, &key, &oldvalue, &hash)) {
-                if (insertdict(mp, key, hash, value)) {
-                    Py_DECREF(d);
-                    return NULL;
-                }
-            }
+            while (_PyDict_Next(iterable, &pos, &key, &oldvalue, &hash))
+                insert_new_item(mp, key, hash, value);
+            mp->ma_version_tag = DICT_NEXT_VERSION();
             return d;
         }
         if (PyAnySet_CheckExact(iterable)) {
@@ -1532,17 +2438,14 @@ _PyDict_FromKeys(PyObject *cls, PyObject *iterable, PyObject *value)
             PyObject *key;
             Py_hash_t hash;
 
-            if (dictresize(mp, PySet_GET_SIZE(iterable))) {
+            if (dict_presize(mp, PySet_GET_SIZE(iterable))) {
                 Py_DECREF(d);
                 return NULL;
             }
 
-            while (_PySet_NextEntry(iterable, &pos, &key, &hash)) {
-                if (insertdict(mp, key, hash, value)) {
-                    Py_DECREF(d);
-                    return NULL;
-                }
-            }
+            while (_PySet_NextEntry(iterable, &pos, &key, &hash))
+                insert_new_item(mp, key, hash, value);
+            mp->ma_version_tag = DICT_NEXT_VERSION();
             return d;
         }
     }
@@ -1554,6 +2457,10 @@ _PyDict_FromKeys(PyObject *cls, PyObject *iterable, PyObject *value)
     }
 
     if (PyDict_CheckExact(d)) {
+        /* Presize for as many keys as the iterable says it has */
+        Py_ssize_t n = PyObject_LengthHint(iterable, 0);
+        if (n < 0 || dict_presize((PyDictObject *)d, n) < 0)
+            goto Fail;
         while ((key = PyIter_Next(it)) != NULL) {
             status = PyDict_SetItem(d, key, value);
             Py_DECREF(key);
@@ -1592,7 +2499,7 @@ dict_dealloc(PyDictObject *mp)
     Py_TRASHCAN_SAFE_BEGIN(mp)
     if (values != NULL) {
         if (values != empty_values) {
-            for (i = 0, n = DK_SIZE(mp->ma_keys); i < n; i++) {
+            for (i = 0, n = mp->ma_keys->dk_nentries; i < n; i++) {
                 Py_XDECREF(values[i]);
             }
             free_values(values);
@@ -1705,7 +2612,7 @@ dict_subscript(PyDictObject *mp, PyObject *key)
 {
     PyObject *v;
     Py_hash_t hash;
-    PyDictKeyEntry *ep;
+    Py_ssize_t ix;
     PyObject **value_addr;
 
     if (!PyUnicode_CheckExact(key) ||
@@ -1714,10 +2621,10 @@ dict_subscript(PyDictObject *mp, PyObject *key)
         if (hash == -1)
             return NULL;
     }
-    ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
-    if (ep == NULL)
+    ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, NULL);
+    if (ix == DKIX_ERROR)
         return NULL;
-    v = *value_addr;
+    v = ix == DKIX_EMPTY ? NULL : *value_addr;
     if (v == NULL) {
         if (!PyDict_CheckExact(mp)) {
             /* Look up __missing__ method if we're a subclass. */
@@ -1777,8 +2684,8 @@ dict_keys(PyDictObject *mp)
         Py_DECREF(v);
         goto again;
     }
-    ep = &mp->ma_keys->dk_entries[0];
-    size = DK_SIZE(mp->ma_keys);
+    ep = DK_ENTRIES(mp->ma_keys);
+    size = mp->ma_keys->dk_nentries;
     if (mp->ma_values) {
         value_ptr = mp->ma_values;
         offset = sizeof(PyObject *);
@@ -1820,13 +2727,13 @@ dict_values(PyDictObject *mp)
         Py_DECREF(v);
         goto again;
     }
-    size = DK_SIZE(mp->ma_keys);
+    size = mp->ma_keys->dk_nentries;
     if (mp->ma_values) {
         value_ptr = mp->ma_values;
         offset = sizeof(PyObject *);
     }
     else {
-        value_ptr = &mp->ma_keys->dk_entries[0].me_value;
+        value_ptr = &DK_ENTRIES(mp->ma_keys)[0].me_value;
         offset = sizeof(PyDictKeyEntry);
     }
     for (i = 0, j = 0; i < size; i++) {
@@ -1877,8 +2784,8 @@ dict_items(PyDictObject *mp)
         goto again;
     }
     /* Nothing we do below makes any function calls. */
-    ep = mp->ma_keys->dk_entries;
-    size = DK_SIZE(mp->ma_keys);
+    ep = DK_ENTRIES(mp->ma_keys);
+    size = mp->ma_keys->dk_nentries;
     if (mp->ma_values) {
         value_ptr = mp->ma_values;
         offset = sizeof(PyObject *);
@@ -1932,7 +2839,13 @@ dict_update_common(PyObject *self, PyObject *args, PyObject *kwds, char *methnam
 
     else if (arg != NULL) {
         _Py_IDENTIFIER(keys);
-        if (_PyObject_HasAttrId(arg, &PyId_keys))
+        /* Make room for the keyword arguments too at once */
+        if (kwds != NULL && PyDict_Check(arg) &&
+            dict_presize((PyDictObject *)self,
+                         ((PyDictObject *)arg)->ma_used +
+                         ((PyDictObject *)kwds)->ma_used) < 0)
+            result = -1;
+        else if (_PyObject_HasAttrId(arg, &PyId_keys))
             result = PyDict_Merge(self, arg, 1);
         else
             result = PyDict_MergeFromSeq2(self, arg, 1);
@@ -1971,11 +2884,17 @@ PyDict_MergeFromSeq2(PyObject *d, PyObject *seq2, int override)
     Py_ssize_t i;       /* index into seq2 of current element */
     PyObject *item;     /* seq2[i] */
     PyObject *fast;     /* item as a 2-tuple or 2-list */
+    Py_ssize_t hint;    /* expected length of seq2 */
 
     assert(d != NULL);
     assert(PyDict_Check(d));
     assert(seq2 != NULL);
 
+    /* Presize for as many new keys as seq2 says it has pairs */
+    hint = PyObject_LengthHint(seq2, 0);
+    if (hint < 0 || dict_presize((PyDictObject *)d, hint) < 0)
+        return -1;
+
     it = PyObject_GetIter(seq2);
     if (it == NULL)
         return -1;
@@ -2034,6 +2953,38 @@ Return:
     return Py_SAFE_DOWNCAST(i, Py_ssize_t, int);
 }
 
+/* A copy of the keys of orig, a combined dict with no deleted entries,
+ * which holds new references to its keys and values.
+ */
+static PyDictKeysObject *
+clone_combined_keys(PyDictObject *orig)
+{
+    PyDictKeysObject *keys = orig->ma_keys;
+    Py_ssize_t size = _PyDict_KeysSize(keys);
+    Py_ssize_t ctrl_size = DK_CTRL_SIZE(keys);
+    PyDictKeysObject *copy;
+    PyDictKeyEntry *ep;
+    Py_ssize_t i, n;
+    char *block;
+
+    assert(orig->ma_values == NULL);
+    assert(orig->ma_used == keys->dk_nentries);
+    block = PyMem_MALLOC(size);
+    if (block == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    memcpy(block, (char *)keys - ctrl_size, size);
+    copy = (PyDictKeysObject *)(block + ctrl_size);
+    DK_DEBUG_INCREF copy->dk_refcnt = 1;
+    ep = DK_ENTRIES(copy);
+    for (i = 0, n = copy->dk_nentries; i < n; i++) {
+        Py_INCREF(ep[i].me_key);
+        Py_INCREF(ep[i].me_value);
+    }
+    return copy;
+}
+
 int
 PyDict_Update(PyObject *a, PyObject *b)
 {
@@ -2062,23 +3013,61 @@ PyDict_Merge(PyObject *a, PyObject *b, int override)
         if (other == mp || other->ma_used == 0)
             /* a.update(a) or a.update({}); nothing to do */
             return 0;
-        if (mp->ma_used == 0)
+        if (mp->ma_used == 0) {
             /* Since the target dict is empty, PyDict_GetItem()
              * always returns NULL.  Setting override to 1
              * skips the unnecessary test.
              */
             override = 1;
+            /* If the keys of other make a table with no deleted entries
+             * and no more than twice too large, and a would have to
+             * resize anyway, a takes a copy of the table as it is.
+             */
+            if (PyDict_CheckExact(b) && mp->ma_values == NULL &&
+                other->ma_values == NULL &&
+                mp->ma_keys->dk_usable < other->ma_used &&
+                other->ma_used == other->ma_keys->dk_nentries &&
+                (DK_SIZE(other->ma_keys) == PyDict_MINSIZE_COMBINED ||
+                 USABLE_FRACTION(DK_SIZE(other->ma_keys) / 2) <
+                 other->ma_used)) {
+                PyDictKeysObject *keys = clone_combined_keys(other);
+                if (keys == NULL)
+                    return -1;
+                DK_DECREF(mp->ma_keys);
+                mp->ma_keys = keys;
+                mp->ma_used = other->ma_used;
+                mp->ma_version_tag = DICT_NEXT_VERSION();
+                if (_PyObject_GC_IS_TRACKED(other) &&
+                    !_PyObject_GC_IS_TRACKED(mp))
+                    _PyObject_GC_TRACK(mp);
+                return 0;
+            }
+        }
         /* Do one big resize at the start, rather than
          * incrementally resizing as we insert new items.  Expect
          * that there will be no (or few) overlapping keys.
          */
-        if (mp->ma_keys->dk_usable * 3 < other->ma_used * 2)
-            if (dictresize(mp, (mp->ma_used + other->ma_used)*2) != 0)
-               return -1;
-        for (i = 0, n = DK_SIZE(other->ma_keys); i < n; i++) {
+        if (dict_presize(mp, other->ma_used) != 0)
+            return -1;
+        if (mp->ma_used == 0 && mp->ma_values == NULL) {
+            /* The keys of other are unique and no code runs while they
+             * are appended, so they need neither lookups nor checks for
+             * a mutation of other. */
+            PyObject **values = other->ma_values;
+            entry = DK_ENTRIES(other->ma_keys);
+            for (i = 0, n = other->ma_keys->dk_nentries; i < n; i++) {
+                PyObject *value = values ? values[i] : entry[i].me_value;
+                if (value != NULL)
+                    insert_new_item(mp, entry[i].me_key, entry[i].me_hash,
+                                    value);
+            }
+            mp->ma_version_tag = DICT_NEXT_VERSION();
+            return 0;
+        }
+        for (i = 0, n = other->ma_keys->dk_nentries; i < n; i++) {
             PyObject *key, *value;
             Py_hash_t hash;
-            entry = &other->ma_keys->dk_entries[i];
+            entry = &DK_ENTRIES(other->ma_keys)[i];
             key = entry->me_key;
             hash = entry->me_hash;
             if (other->ma_values)
@@ -2097,7 +3086,7 @@ PyDict_Merge(PyObject *a, PyObject *b, int override)
                 if (err != 0)
                     return -1;
 
-                if (n != DK_SIZE(other->ma_keys)) {
+                if (n != other->ma_keys->dk_nentries) {
                     PyErr_SetString(PyExc_RuntimeError,
                                     "dict mutated during update");
                     return -1;
@@ -2172,7 +3161,8 @@ PyDict_Copy(PyObject *o)
     mp = (PyDictObject *)o;
     if (_PyDict_HasSplitTable(mp)) {
         PyDictObject *split_copy;
-        PyObject **newvalues = new_values(DK_SIZE(mp->ma_keys));
+        Py_ssize_t size = USABLE_FRACTION(DK_SIZE(mp->ma_keys));
+        PyObject **newvalues = new_values(size);
         if (newvalues == NULL)
             return PyErr_NoMemory();
         split_copy = PyObject_GC_New(PyDictObject, &PyDict_Type);
@@ -2183,8 +3173,9 @@ PyDict_Copy(PyObject *o)
         split_copy->ma_values = newvalues;
         split_copy->ma_keys = mp->ma_keys;
         split_copy->ma_used = mp->ma_used;
+        split_copy->ma_version_tag = DICT_NEXT_VERSION();
         DK_INCREF(mp->ma_keys);
-        for (i = 0, n = DK_SIZE(mp->ma_keys); i < n; i++) {
+        for (i = 0, n = size; i < n; i++) {
             PyObject *value = mp->ma_values[i];
             Py_XINCREF(value);
             split_copy->ma_values[i] = value;
@@ -2255,8 +3246,8 @@ dict_equal(PyDictObject *a, PyDictObject *b)
         /* can't be equal if # of entries differ */
         return 0;
     /* Same # of entries -- check all of 'em.  Exit early on any diff. */
-    for (i = 0; i < DK_SIZE(a->ma_keys); i++) {
-        PyDictKeyEntry *ep = &a->ma_keys->dk_entries[i];
+    for (i = 0; i < a->ma_keys->dk_nentries; i++) {
+        PyDictKeyEntry *ep = &DK_ENTRIES(a->ma_keys)[i];
         PyObject *aval;
         if (a->ma_values)
             aval = a->ma_values[i];
@@ -2273,7 +3264,7 @@ dict_equal(PyDictObject *a, PyDictObject *b)
             /* ditto for key */
             Py_INCREF(key);
             /* reuse the known hash value */
-            if ((b->ma_keys->dk_lookup)(b, key, ep->me_hash, &vaddr) == NULL)
+            if ((b->ma_keys->dk_lookup)(b, key, ep->me_hash, &vaddr, NULL) < 0)
                 bval = NULL;
             else
                 bval = *vaddr;
@@ -2331,7 +3322,7 @@ dict___contains__(PyDictObject *self, PyObject *key)
 {
     register PyDictObject *mp = self;
     Py_hash_t hash;
-    PyDictKeyEntry *ep;
+    Py_ssize_t ix;
     PyObject **value_addr;
 
     if (!PyUnicode_CheckExact(key) ||
@@ -2340,23 +3331,23 @@ dict___contains__(PyDictObject *self, PyObject *key)
         if (hash == -1)
             return NULL;
     }
-    ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
-    if (ep == NULL)
+    ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, NULL);
+    if (ix == DKIX_ERROR)
         return NULL;
-    return PyBool_FromLong(*value_addr != NULL);
+    return PyBool_FromLong(ix != DKIX_EMPTY && *value_addr != NULL);
 }
 
 static PyObject *
-dict_get(PyDictObject *mp, PyObject *args)
+dict_get(PyDictObject *mp, PyObject **args, Py_ssize_t nargs)
 {
     PyObject *key;
     PyObject *failobj = Py_None;
     PyObject *val = NULL;
     Py_hash_t hash;
-    PyDictKeyEntry *ep;
+    Py_ssize_t ix;
     PyObject **value_addr;
 
-    if (!PyArg_UnpackTuple(args, "get", 1, 2, &key, &failobj))
+    if (!_PyArg_UnpackStack(args, nargs, "get", 1, 2, &key, &failobj))
         return NULL;
 
     if (!PyUnicode_CheckExact(key) ||
@@ -2365,10 +3356,11 @@ dict_get(PyDictObject *mp, PyObject *args)
         if (hash == -1)
             return NULL;
     }
-    ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
-    if (ep == NULL)
+    ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, NULL);
+    if (ix == DKIX_ERROR)
         return NULL;
-    val = *value_addr;
+    if (ix != DKIX_EMPTY)
+        val = *value_addr;
     if (val == NULL)
         val = failobj;
     Py_INCREF(val);
@@ -2381,7 +3373,7 @@ PyDict_SetDefault(PyObject *d, PyObject *key, PyObject *defaultobj)
     PyDictObject *mp = (PyDictObject *)d;
     PyObject *val = NULL;
     Py_hash_t hash;
-    PyDictKeyEntry *ep;
+    Py_ssize_t ix, hashpos;
     PyObject **value_addr;
 
     if (!PyDict_Check(d)) {
@@ -2394,37 +3386,53 @@ PyDict_SetDefault(PyObject *d, PyObject *key, PyObject *defaultobj)
         if (hash == -1)
             return NULL;
     }
-    ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
-    if (ep == NULL)
+    if (mp->ma_values != NULL && !PyUnicode_CheckExact(key)) {
+        if (insertion_resize(mp) < 0)
+            return NULL;
+    }
+    ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, &hashpos);
+    if (ix == DKIX_ERROR)
         return NULL;
-    val = *value_addr;
-    if (val == NULL) {
+    if (ix >= 0 && (val = *value_addr) != NULL)
+        return val;
+
+    if (SPLIT_OUT_OF_ORDER(mp, ix, value_addr)) {
+        if (insertion_resize(mp) < 0)
+            return NULL;
+        find_empty_slot(mp, key, hash, &value_addr, &hashpos);
+        ix = DKIX_EMPTY;
+    }
+    val = defaultobj;
+    if (ix == DKIX_EMPTY) {
         if (mp->ma_keys->dk_usable <= 0) {
             /* Need to resize. */
             if (insertion_resize(mp) < 0)
                 return NULL;
-            ep = find_empty_slot(mp, key, hash, &value_addr);
+            find_empty_slot(mp, key, hash, &value_addr, &hashpos);
         }
-        Py_INCREF(defaultobj);
-        Py_INCREF(key);
-        MAINTAIN_TRACKING(mp, key, defaultobj);
-        ep->me_key = key;
-        ep->me_hash = hash;
-        *value_addr = defaultobj;
-        val = defaultobj;
-        mp->ma_keys->dk_usable--;
+        Py_INCREF(val);
+        MAINTAIN_TRACKING(mp, key, val);
+        append_entry(mp, key, hash, val, hashpos);
+    }
+    else {
+        /* a pending value of a split table */
+        assert(_PyDict_HasSplitTable(mp) && ix == mp->ma_used);
+        Py_INCREF(val);
+        MAINTAIN_TRACKING(mp, key, val);
+        *value_addr = val;
         mp->ma_used++;
+        mp->ma_version_tag = DICT_NEXT_VERSION();
     }
     return val;
 }
 
 static PyObject *
-dict_setdefault(PyDictObject *mp, PyObject *args)
+dict_setdefault(PyDictObject *mp, PyObject **args, Py_ssize_t nargs)
 {
     PyObject *key, *val;
     PyObject *defaultobj = Py_None;
 
-    if (!PyArg_UnpackTuple(args, "setdefault", 1, 2, &key, &defaultobj))
+    if (!_PyArg_UnpackStack(args, nargs, "setdefault", 1, 2, &key, &defaultobj))
         return NULL;
 
     val = PyDict_SetDefault((PyObject *)mp, key, defaultobj);
@@ -2440,11 +3448,11 @@ dict_clear(PyDictObject *mp)
 }
 
 static PyObject *
-dict_pop(PyDictObject *mp, PyObject *args)
+dict_pop(PyDictObject *mp, PyObject **args, Py_ssize_t nargs)
 {
     PyObject *key, *deflt = NULL;
 
-    if(!PyArg_UnpackTuple(args, "pop", 1, 2, &key, &deflt))
+    if(!_PyArg_UnpackStack(args, nargs, "pop", 1, 2, &key, &deflt))
         return NULL;
 
     return _PyDict_Pop(mp, key, deflt);
@@ -2453,8 +3461,8 @@ dict_pop(PyDictObject *mp, PyObject *args)
 static PyObject *
 dict_popitem(PyDictObject *mp)
 {
-    Py_hash_t i = 0;
-    PyDictKeyEntry *ep;
+    Py_ssize_t i, j;
+    PyDictKeyEntry *ep0, *ep;
     PyObject *res;
 
 
@@ -2484,37 +3492,29 @@ dict_popitem(PyDictObject *mp)
         }
     }
     ENSURE_ALLOWS_DELETIONS(mp);
-    /* Set ep to "the first" dict entry with a value.  We abuse the hash
-     * field of slot 0 to hold a search finger:
-     * If slot 0 has a value, use slot 0.
-     * Else slot 0 is being used to hold a search finger,
-     * and we use its hash value as the first index to look.
-     */
-    ep = &mp->ma_keys->dk_entries[0];
-    if (ep->me_value == NULL) {
-        Py_ssize_t mask = DK_MASK(mp->ma_keys);
-        i = ep->me_hash;
-        /* The hash field may be a real hash value, or it may be a
-         * legit search finger, or it may be a once-legit search
-         * finger that's out of bounds now because it wrapped around
-         * or the table shrunk -- simply make sure it's in bounds now.
-         */
-        if (i > mask || i < 1)
-            i = 1;              /* skip slot 0 */
-        while ((ep = &mp->ma_keys->dk_entries[i])->me_value == NULL) {
-            i++;
-            if (i > mask)
-                i = 1;
-        }
+
+    /* Pop the last item */
+    ep0 = DK_ENTRIES(mp->ma_keys);
+    i = mp->ma_keys->dk_nentries - 1;
+    while (i >= 0 && ep0[i].me_value == NULL) {
+        i--;
     }
+    assert(i >= 0);
+
+    ep = &ep0[i];
+    j = lookdict_index(mp->ma_keys, ep->me_hash, i);
+    assert(j >= 0);
+    dk_clear_slot(mp->ma_keys, j);
+
     PyTuple_SET_ITEM(res, 0, ep->me_key);
     PyTuple_SET_ITEM(res, 1, ep->me_value);
-    Py_INCREF(dummy);
-    ep->me_key = dummy;
+    ep->me_key = NULL;
     ep->me_value = NULL;
+    /* The entries after the popped one are free again, but not dk_usable
+       since the slot of the popped entry holds a DKIX_DUMMY now */
+    mp->ma_keys->dk_nentries = i;
     mp->ma_used--;
-    assert(mp->ma_keys->dk_entries[0].me_value == NULL);
-    mp->ma_keys->dk_entries[0].me_hash = i + 1;  /* next place to start */
+    mp->ma_version_tag = DICT_NEXT_VERSION();
     return res;
 }
 
@@ -2523,22 +3523,24 @@ dict_traverse(PyObject *op, visitproc visit, void *arg)
 {
     Py_ssize_t i, n;
     PyDictObject *mp = (PyDictObject *)op;
-    if (mp->ma_keys->dk_lookup == lookdict) {
-        for (i = 0; i < DK_SIZE(mp->ma_keys); i++) {
-            if (mp->ma_keys->dk_entries[i].me_value != NULL) {
-                Py_VISIT(mp->ma_keys->dk_entries[i].me_value);
-                Py_VISIT(mp->ma_keys->dk_entries[i].me_key);
+    PyDictKeysObject *keys = mp->ma_keys;
+    PyDictKeyEntry *entries = DK_ENTRIES(keys);
+    if (keys->dk_lookup == lookdict) {
+        for (i = 0, n = keys->dk_nentries; i < n; i++) {
+            if (entries[i].me_value != NULL) {
+                Py_VISIT(entries[i].me_value);
+                Py_VISIT(entries[i].me_key);
             }
         }
     } else {
         if (mp->ma_values != NULL) {
-            for (i = 0, n = DK_SIZE(mp->ma_keys); i < n; i++) {
+            for (i = 0, n = keys->dk_nentries; i < n; i++) {
                 Py_VISIT(mp->ma_values[i]);
             }
         }
         else {
-            for (i = 0, n = DK_SIZE(mp->ma_keys); i < n; i++) {
-                Py_VISIT(mp->ma_keys->dk_entries[i].me_value);
+            for (i = 0, n = keys->dk_nentries; i < n; i++) {
+                Py_VISIT(entries[i].me_value);
             }
         }
     }
@@ -2562,18 +3564,20 @@ _PyDict_SizeOf(PyDictObject *mp)
     size = DK_SIZE(mp->ma_keys);
     res = sizeof(PyDictObject);
     if (mp->ma_values)
-        res += size * sizeof(PyObject*);
+        res += USABLE_FRACTION(size) * sizeof(PyObject*);
     /* If the dictionary is split, the keys portion is accounted-for
        in the type object. */
     if (mp->ma_keys->dk_refcnt == 1)
-        res += sizeof(PyDictKeysObject) + (size-1) * sizeof(PyDictKeyEntry);
+        res += _PyDict_KeysSize(mp->ma_keys);
     return PyLong_FromSsize_t(res);
 }
 
 Py_ssize_t
 _PyDict_KeysSize(PyDictKeysObject *keys)
 {
-    return sizeof(PyDictKeysObject) + (DK_SIZE(keys)-1) * sizeof(PyDictKeyEntry);
+    return offsetof(PyDictKeysObject, dk_indices) + DK_CTRL_SIZE(keys) +
+           DK_INDICES_SIZE(keys) +
+           USABLE_FRACTION(DK_SIZE(keys)) * sizeof(PyDictKeyEntry);
 }
 
 PyDoc_STRVAR(getitem__doc__, "x.__getitem__(y) <==> x[y]");
@@ -2625,11 +3629,11 @@ static PyMethodDef mapp_methods[] = {
      getitem__doc__},
     {"__sizeof__",      (PyCFunction)_PyDict_SizeOf,       METH_NOARGS,
      sizeof__doc__},
-    {"get",         (PyCFunction)dict_get,          METH_VARARGS,
+    {"get",         (PyCFunction)dict_get,          METH_FASTCALL,
      get__doc__},
-    {"setdefault",  (PyCFunction)dict_setdefault,   METH_VARARGS,
+    {"setdefault",  (PyCFunction)dict_setdefault,   METH_FASTCALL,
      setdefault_doc__},
-    {"pop",         (PyCFunction)dict_pop,          METH_VARARGS,
+    {"pop",         (PyCFunction)dict_pop,          METH_FASTCALL,
      pop__doc__},
     {"popitem",         (PyCFunction)dict_popitem,      METH_NOARGS,
      popitem__doc__},
@@ -2655,7 +3659,7 @@ PyDict_Contains(PyObject *op, PyObject *key)
 {
     Py_hash_t hash;
     PyDictObject *mp = (PyDictObject *)op;
-    PyDictKeyEntry *ep;
+    Py_ssize_t ix;
     PyObject **value_addr;
 
     if (!PyUnicode_CheckExact(key) ||
@@ -2664,8 +3668,10 @@ PyDict_Contains(PyObject *op, PyObject *key)
         if (hash == -1)
             return -1;
     }
-    ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
-    return (ep == NULL) ? -1 : (*value_addr != NULL);
+    ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, NULL);
+    if (ix == DKIX_ERROR)
+        return -1;
+    return (ix != DKIX_EMPTY && *value_addr != NULL);
 }
 
 /* Internal version of PyDict_Contains used when the hash value is already known */
@@ -2673,11 +3679,13 @@ int
 _PyDict_Contains(PyObject *op, PyObject *key, Py_hash_t hash)
 {
     PyDictObject *mp = (PyDictObject *)op;
-    PyDictKeyEntry *ep;
+    Py_ssize_t ix;
     PyObject **value_addr;
 
-    ep = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr);
-    return (ep == NULL) ? -1 : (*value_addr != NULL);
+    ix = (mp->ma_keys->dk_lookup)(mp, key, hash, &value_addr, NULL);
+    if (ix == DKIX_ERROR)
+        return -1;
+    return (ix != DKIX_EMPTY && *value_addr != NULL);
 }
 
 /* Hack to implement "key in dict" */
@@ -2711,6 +3719,7 @@ dict_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
         _PyObject_GC_UNTRACK(d);
 
     d->ma_used = 0;
+    d->ma_version_tag = DICT_NEXT_VERSION();
     d->ma_keys = new_keys_object(PyDict_MINSIZE_COMBINED);
     if (d->ma_keys == NULL) {
         Py_DECREF(self);
@@ -2939,10 +3948,9 @@ static PyMethodDef dictiter_methods[] = {
 static PyObject *dictiter_iternextkey(dictiterobject *di)
 {
     PyObject *key;
-    Py_ssize_t i, mask, offset;
+    Py_ssize_t i, n;
     PyDictKeysObject *k;
     PyDictObject *d = di->di_dict;
-    PyObject **value_ptr;
 
     if (d == NULL)
         return NULL;
@@ -2956,27 +3964,32 @@ static PyObject *dictiter_iternextkey(dictiterobject *di)
     }
 
     i = di->di_pos;
-    if (i < 0)
-        goto fail;
     k = d->ma_keys;
+    n = k->dk_nentries;
+    if (i < 0 || i >= n)
+        goto fail;
     if (d->ma_values) {
-        value_ptr = &d->ma_values[i];
-        offset = sizeof(PyObject *);
+        PyObject **value_ptr = &d->ma_values[i];
+        while (i < n && *value_ptr == NULL) {
+            value_ptr++;
+            i++;
+        }
+        if (i >= n)
+            goto fail;
+        key = DK_ENTRIES(k)[i].me_key;
     }
     else {
-        value_ptr = &k->dk_entries[i].me_value;
-        offset = sizeof(PyDictKeyEntry);
-    }
-    mask = DK_SIZE(k)-1;
-    while (i <= mask && *value_ptr == NULL) {
-        value_ptr = (PyObject **)(((char *)value_ptr) + offset);
-        i++;
+        PyDictKeyEntry *entry_ptr = &DK_ENTRIES(k)[i];
+        while (i < n && entry_ptr->me_value == NULL) {
+            entry_ptr++;
+            i++;
+        }
+        if (i >= n)
+            goto fail;
+        key = entry_ptr->me_key;
     }
     di->di_pos = i+1;
-    if (i > mask)
-        goto fail;
     di->len--;
-    key = k->dk_entries[i].me_key;
     Py_INCREF(key);
     return key;
 
@@ -3022,9 +4035,8 @@ PyTypeObject PyDictIterKey_Type = {
 static PyObject *dictiter_iternextvalue(dictiterobject *di)
 {
     PyObject *value;
-    Py_ssize_t i, mask, offset;
+    Py_ssize_t i, n;
     PyDictObject *d = di->di_dict;
-    PyObject **value_ptr;
 
     if (d == NULL)
         return NULL;
@@ -3038,26 +4050,31 @@ static PyObject *dictiter_iternextvalue(dictiterobject *di)
     }
 
     i = di->di_pos;
-    mask = DK_SIZE(d->ma_keys)-1;
-    if (i < 0 || i > mask)
+    n = d->ma_keys->dk_nentries;
+    if (i < 0 || i >= n)
         goto fail;
     if (d->ma_values) {
-        value_ptr = &d->ma_values[i];
-        offset = sizeof(PyObject *);
+        PyObject **value_ptr = &d->ma_values[i];
+        while (i < n && *value_ptr == NULL) {
+            value_ptr++;
+            i++;
+        }
+        if (i >= n)
+            goto fail;
+        value = *value_ptr;
     }
     else {
-        value_ptr = &d->ma_keys->dk_entries[i].me_value;
-        offset = sizeof(PyDictKeyEntry);
-    }
-    while (i <= mask && *value_ptr == NULL) {
-        value_ptr = (PyObject **)(((char *)value_ptr) + offset);
-        i++;
-        if (i > mask)
+        PyDictKeyEntry *entry_ptr = &DK_ENTRIES(d->ma_keys)[i];
+        while (i < n && entry_ptr->me_value == NULL) {
+            entry_ptr++;
+            i++;
+        }
+        if (i >= n)
             goto fail;
+        value = entry_ptr->me_value;
     }
     di->di_pos = i+1;
     di->len--;
-    value = *value_ptr;
     Py_INCREF(value);
     return value;
 
@@ -3103,9 +4120,8 @@ PyTypeObject PyDictIterValue_Type = {
 static PyObject *dictiter_iternextitem(dictiterobject *di)
 {
     PyObject *key, *value, *result = di->di_result;
-    Py_ssize_t i, mask, offset;
+    Py_ssize_t i, n;
     PyDictObject *d = di->di_dict;
-    PyObject **value_ptr;
 
     if (d == NULL)
         return NULL;
@@ -3119,24 +4135,32 @@ static PyObject *dictiter_iternextitem(dictiterobject *di)
     }
 
     i = di->di_pos;
-    if (i < 0)
+    n = d->ma_keys->dk_nentries;
+    if (i < 0 || i >= n)
         goto fail;
-    mask = DK_SIZE(d->ma_keys)-1;
     if (d->ma_values) {
-        value_ptr = &d->ma_values[i];
-        offset = sizeof(PyObject *);
+        PyObject **value_ptr = &d->ma_values[i];
+        while (i < n && *value_ptr == NULL) {
+            value_ptr++;
+            i++;
+        }
+        if (i >= n)
+            goto fail;
+        key = DK_ENTRIES(d->ma_keys)[i].me_key;
+        value = *value_ptr;
     }
     else {
-        value_ptr = &d->ma_keys->dk_entries[i].me_value;
-        offset = sizeof(PyDictKeyEntry);
-    }
-    while (i <= mask && *value_ptr == NULL) {
-        value_ptr = (PyObject **)(((char *)value_ptr) + offset);
-        i++;
+        PyDictKeyEntry *entry_ptr = &DK_ENTRIES(d->ma_keys)[i];
+        while (i < n && entry_ptr->me_value == NULL) {
+            entry_ptr++;
+            i++;
+        }
+        if (i >= n)
+            goto fail;
+        key = entry_ptr->me_key;
+        value = entry_ptr->me_value;
     }
     di->di_pos = i+1;
-    if (i > mask)
-        goto fail;
 
     if (result->ob_refcnt == 1) {
         Py_INCREF(result);
@@ -3148,8 +4172,6 @@ static PyObject *dictiter_iternextitem(dictiterobject *di)
             return NULL;
     }
     di->len--;
-    key = d->ma_keys->dk_entries[i].me_key;
-    value = *value_ptr;
     Py_INCREF(key);
     Py_INCREF(value);
     PyTuple_SET_ITEM(result, 0, key);  /* steals reference */
@@ -3195,6 +4217,29 @@ PyTypeObject PyDictIterItem_Type = {
     0,
 };
 
+/* The next item of the key, value or item iterator 'it' in *pitem, for
+   FOR_ITER:  1 for an item, 0 at the end, without an exception, or -1 for
+   an error.  An iterator which failed keeps its dict. */
+int
+_PyDictIter_Next(PyObject *it, PyObject **pitem)
+{
+    dictiterobject *di = (dictiterobject *)it;
+    PyObject *item;
+
+    if (Py_TYPE(it) == &PyDictIterKey_Type)
+        item = dictiter_iternextkey(di);
+    else if (Py_TYPE(it) == &PyDictIterValue_Type)
+        item = dictiter_iternextvalue(di);
+    else {
+        assert(Py_TYPE(it) == &PyDictIterItem_Type);
+        item = dictiter_iternextitem(di);
+    }
+    if (item == NULL)
+        return di->di_dict == NULL ? 0 : -1;
+    *pitem = item;
+    return 1;
+}
+
 
 static PyObject *
 dictiter_reduce(dictiterobject *di)
@@ -3884,50 +4929,3 @@ _PyDictKeys_DecRef(PyDictKeysObject *keys)
 {
     DK_DECREF(keys);
 }
-
-
-/* ARGSUSED */
-static PyObject *
-dummy_repr(PyObject *op)
-{
-    return PyUnicode_FromString("<dummy key>");
-}
-
-/* ARGUSED */
-static void
-dummy_dealloc(PyObject* ignore)
-{
-    /* This should never get called, but we also don't want to SEGV if
-     * we accidentally decref dummy-key out of existence.
-     */
-    Py_FatalError("deallocating <dummy key>");
-}
-
-static PyTypeObject PyDictDummy_Type = {
-    PyVarObject_HEAD_INIT(&PyType_Type, 0)
-    "<dummy key> type",
-    0,
-    0,
-    dummy_dealloc,      /*tp_dealloc*/ /*never called*/
-    0,                  /*tp_print*/
-    0,                  /*tp_getattr*/
-    0,                  /*tp_setattr*/
-    0,                  /*tp_reserved*/
-    dummy_repr,         /*tp_repr*/
-    0,                  /*tp_as_number*/
-    0,                  /*tp_as_sequence*/
-    0,                  /*tp_as_mapping*/
-    0,                  /*tp_hash */
-    0,                  /*tp_call */
-    0,                  /*tp_str */
-    0,                  /*tp_getattro */
-    0,                  /*tp_setattro */
-    0,                  /*tp_as_buffer */
-    Py_TPFLAGS_DEFAULT, /*tp_flags */
-};
-
-static PyObject _dummy_struct = {
-  _PyObject_EXTRA_INIT
-  2, &PyDictDummy_Type
-};
-
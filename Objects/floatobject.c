@@ -1964,6 +1964,13 @@ _PyFloat_DebugMallocStats(FILE *out)
                            numfree, sizeof(PyFloatObject));
 }
 
+/* Number of objects in the free list */
+int
+_PyFloat_NumFree(void)
+{
+    return numfree;
+}
+
 
 /*----------------------------------------------------------------------------
  * _PyFloat_{Pack,Unpack}{4,8}.  See floatobject.h.
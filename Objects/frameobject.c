@@ -7,28 +7,61 @@
 #include "opcode.h"
 #include "structmember.h"
 
-#define OFF(x) offsetof(PyFrameObject, x)
-
-static PyMemberDef frame_memberlist[] = {
-    {"f_back",          T_OBJECT,       OFF(f_back),      READONLY},
-    {"f_code",          T_OBJECT,       OFF(f_code),      READONLY},
-    {"f_builtins",      T_OBJECT,       OFF(f_builtins),  READONLY},
-    {"f_globals",       T_OBJECT,       OFF(f_globals),   READONLY},
-    {"f_lasti",         T_INT,          OFF(f_lasti),     READONLY},
-    {NULL}      /* Sentinel */
-};
+static PyObject *
+frame_getback(PyFrameObject *fo, void *closure)
+{
+    PyObject *back = (PyObject *)fo->f_back;
+
+    /* A running frame finds its caller on the frame stack */
+    if (fo->f_frame->f_previous != NULL) {
+        back = (PyObject *)_PyFrame_GetFrameObject(fo->f_frame->f_previous);
+        if (back == NULL)
+            return NULL;
+    }
+    if (back == NULL)
+        back = Py_None;
+    Py_INCREF(back);
+    return back;
+}
+
+static PyObject *
+frame_getcode(PyFrameObject *fo, void *closure)
+{
+    Py_INCREF(fo->f_frame->f_code);
+    return (PyObject *)fo->f_frame->f_code;
+}
+
+static PyObject *
+frame_getbuiltins(PyFrameObject *fo, void *closure)
+{
+    Py_INCREF(fo->f_frame->f_builtins);
+    return fo->f_frame->f_builtins;
+}
+
+static PyObject *
+frame_getglobals(PyFrameObject *fo, void *closure)
+{
+    Py_INCREF(fo->f_frame->f_globals);
+    return fo->f_frame->f_globals;
+}
+
+static PyObject *
+frame_getlasti(PyFrameObject *fo, void *closure)
+{
+    return PyLong_FromLong(fo->f_frame->f_lasti);
+}
 
 static PyObject *
 frame_getlocals(PyFrameObject *f, void *closure)
 {
     if (PyFrame_FastToLocalsWithError(f) < 0)
         return NULL;
-    Py_INCREF(f->f_locals);
-    return f->f_locals;
+    Py_INCREF(f->f_frame->f_locals);
+    return f->f_frame->f_locals;
 }
 
 int
-PyFrame_GetLineNumber(PyFrameObject *f)
+_PyFrame_GetLineNumber(_PyInterpreterFrame *f)
 {
     if (f->f_trace)
         return f->f_lineno;
@@ -36,6 +69,12 @@ PyFrame_GetLineNumber(PyFrameObject *f)
         return PyCode_Addr2Line(f->f_code, f->f_lasti);
 }
 
+int
+PyFrame_GetLineNumber(PyFrameObject *f)
+{
+    return _PyFrame_GetLineNumber(f->f_frame);
+}
+
 static PyObject *
 frame_getlineno(PyFrameObject *f, void *closure)
 {
@@ -58,8 +97,9 @@ frame_getlineno(PyFrameObject *f, void *closure)
  *    iterator needs to be on the stack.
  */
 static int
-frame_setlineno(PyFrameObject *f, PyObject* p_new_lineno)
+frame_setlineno(PyFrameObject *fo, PyObject* p_new_lineno)
 {
+    _PyInterpreterFrame *f = fo->f_frame;
     int new_lineno = 0;                 /* The new value of f_lineno */
     long l_new_lineno;
     int overflow;
@@ -279,17 +319,25 @@ frame_setlineno(PyFrameObject *f, PyObject* p_new_lineno)
     delta_iblock = 0;
     for (addr = min_addr; addr < max_addr; addr++) {
         unsigned char op = code[addr];
+        const _PyExceptionTableEntry *entry;
         switch (op) {
-        case SETUP_LOOP:
         case SETUP_EXCEPT:
         case SETUP_FINALLY:
         case SETUP_WITH:
         case SETUP_ASYNC_WITH:
+            /* Not the blocks of the exception table */
+            entry = _PyCode_FindTryBlock(f->f_code, addr + 3, INT_MAX);
+            if (entry != NULL && entry->start == addr + 3)
+                break;
+            /* fall through */
+        case SETUP_LOOP:
             delta_iblock++;
             break;
 
         case POP_BLOCK:
-            delta_iblock--;
+            entry = _PyCode_FindTryBlock(f->f_code, addr, INT_MAX);
+            if (entry == NULL || entry->end != addr)
+                delta_iblock--;
             break;
         }
 
@@ -323,7 +371,7 @@ frame_setlineno(PyFrameObject *f, PyObject* p_new_lineno)
         PyTryBlock *b = &f->f_blockstack[--f->f_iblock];
         while ((f->f_stacktop - f->f_valuestack) > b->b_level) {
             PyObject *v = (*--f->f_stacktop);
-            Py_DECREF(v);
+            Py_XDECREF(v);   /* LOAD_METHOD may have pushed NULL */
         }
     }
 
@@ -334,9 +382,9 @@ frame_setlineno(PyFrameObject *f, PyObject* p_new_lineno)
 }
 
 static PyObject *
-frame_gettrace(PyFrameObject *f, void *closure)
+frame_gettrace(PyFrameObject *fo, void *closure)
 {
-    PyObject* trace = f->f_trace;
+    PyObject* trace = fo->f_frame->f_trace;
 
     if (trace == NULL)
         trace = Py_None;
@@ -347,12 +395,13 @@ frame_gettrace(PyFrameObject *f, void *closure)
 }
 
 static int
-frame_settrace(PyFrameObject *f, PyObject* v, void *closure)
+frame_settrace(PyFrameObject *fo, PyObject* v, void *closure)
 {
+    _PyInterpreterFrame *f = fo->f_frame;
     PyObject* old_value;
 
     /* We rely on f_lineno being accurate when f_trace is set. */
-    f->f_lineno = PyFrame_GetLineNumber(f);
+    f->f_lineno = _PyFrame_GetLineNumber(f);
 
     old_value = f->f_trace;
     Py_XINCREF(v);
@@ -364,6 +413,11 @@ frame_settrace(PyFrameObject *f, PyObject* v, void *closure)
 
 
 static PyGetSetDef frame_getsetlist[] = {
+    {"f_back",          (getter)frame_getback, NULL, NULL},
+    {"f_code",          (getter)frame_getcode, NULL, NULL},
+    {"f_builtins",      (getter)frame_getbuiltins, NULL, NULL},
+    {"f_globals",       (getter)frame_getglobals, NULL, NULL},
+    {"f_lasti",         (getter)frame_getlasti, NULL, NULL},
     {"f_locals",        (getter)frame_getlocals, NULL, NULL},
     {"f_lineno",        (getter)frame_getlineno,
                     (setter)frame_setlineno, NULL},
@@ -371,47 +425,38 @@ static PyGetSetDef frame_getsetlist[] = {
     {0}
 };
 
-/* Stack frames are allocated and deallocated at a considerable rate.
-   In an attempt to improve the speed of function calls, we:
-
-   1. Hold a single "zombie" frame on each code object. This retains
-   the allocated and initialised frame object from an invocation of
-   the code object. The zombie is reanimated the next time we need a
-   frame object for that code object. Doing this saves the malloc/
-   realloc required when using a free_list frame that isn't the
-   correct size. It also saves some field initialisation.
+/* The frames of calls live on a stack of their own in each thread, a list of
+   chunks of memory in which _PyFrame_Push() and _PyFrame_Pop() just move
+   tstate->frame_top.  A frame there has its locals, cells and value stack
+   right after it, and holds the references a frame object used to.
 
-   In zombie mode, no field of PyFrameObject holds a reference, but
-   the following fields are still valid:
+   A frame object is made for such a frame only when something asks for it
+   (see _PyFrame_GetFrameObject()), and points at it with f_frame.  If the
+   frame object outlives the call, as the frame object of a traceback does,
+   _PyFrame_Pop() moves the frame into the frame object's f_owned.  Frames
+   made by PyFrame_New(), those of generators and coroutines, are owned by
+   their frame object from the start.
 
-     * ob_type, ob_size, f_code, f_valuestack;
+   Frame objects are still allocated and deallocated at a considerable rate,
+   for generators and tracebacks.  So, we:
 
-     * f_locals, f_trace,
-       f_exc_type, f_exc_value, f_exc_traceback are NULL;
+   1. Hold a single "zombie" frame object on each code object, big enough
+   for a frame of it.  The zombie is reanimated the next time we need a
+   frame object for that code object, which saves the malloc/realloc
+   required when using a free_list frame that isn't the correct size.
+   A zombie holds no references.
 
-     * f_localsplus does not require re-allocation and
-       the local variables in f_localsplus are NULL.
-
-   2. We also maintain a separate free list of stack frames (just like
+   2. We also maintain a separate free list of frame objects (just like
    floats are allocated in a special way -- see floatobject.c).  When
-   a stack frame is on the free list, only the following members have
+   a frame object is on the free list, only the following members have
    a meaning:
     ob_type             == &Frametype
     f_back              next item on free list, or NULL
-    f_stacksize         size of value stack
     ob_size             size of localsplus
-   Note that the value and block stacks are preserved -- this can save
-   another malloc() call or two (and two free() calls as well!).
-   Also note that, unlike for integers, each frame object is a
-   malloc'ed object in its own right -- it is only the actual calls to
-   malloc() that we are trying to save here, not the administration.
-   After all, while a typical program may make millions of calls, a
-   call depth of more than 20 or 30 is probably already exceptional
-   unless the program contains run-away recursion.  I hope.
-
-   Later, PyFrame_MAXFREELIST was added to bound the # of frames saved on
-   free_list.  Else programs creating lots of cyclic trash involving
-   frames could provoke free_list into growing without bound.
+
+   PyFrame_MAXFREELIST bounds the # of frames saved on free_list.  Else
+   programs creating lots of cyclic trash involving frames could provoke
+   free_list into growing without bound.
 */
 
 static PyFrameObject *free_list = NULL;
@@ -419,14 +464,26 @@ static int numfree = 0;         /* number of frames currently in free_list */
 /* max value for numfree */
 #define PyFrame_MAXFREELIST 200
 
+/* Number of slots for the locals, cells, free variables and value stack of
+   a frame of code */
+#define FRAME_NSLOTS(code) ((code)->co_nlocals + \
+                            PyTuple_GET_SIZE((code)->co_cellvars) + \
+                            PyTuple_GET_SIZE((code)->co_freevars) + \
+                            (code)->co_stacksize)
+
+/* Size of a frame of code on the frame stack, in slots */
+#define FRAME_SIZE(code) \
+    (offsetof(_PyInterpreterFrame, f_localsplus) / sizeof(PyObject *) + \
+     FRAME_NSLOTS(code))
+
+#define FRAME_IS_OWNED(fo) ((fo)->f_frame == &(fo)->f_owned)
+
+/* Drop the references of a frame, but that to its code */
 static void
-frame_dealloc(PyFrameObject *f)
+frame_clear_references(_PyInterpreterFrame *f)
 {
     PyObject **p, **valuestack;
-    PyCodeObject *co;
 
-    PyObject_GC_UnTrack(f);
-    Py_TRASHCAN_SAFE_BEGIN(f)
     /* Kill all local variables */
     valuestack = f->f_valuestack;
     for (p = f->f_localsplus; p < valuestack; p++)
@@ -438,7 +495,6 @@ frame_dealloc(PyFrameObject *f)
             Py_XDECREF(*p);
     }
 
-    Py_XDECREF(f->f_back);
     Py_DECREF(f->f_builtins);
     Py_DECREF(f->f_globals);
     Py_CLEAR(f->f_locals);
@@ -446,29 +502,47 @@ frame_dealloc(PyFrameObject *f)
     Py_CLEAR(f->f_exc_type);
     Py_CLEAR(f->f_exc_value);
     Py_CLEAR(f->f_exc_traceback);
+}
 
-    co = f->f_code;
-    if (co->co_zombieframe == NULL)
-        co->co_zombieframe = f;
+static void
+frame_dealloc(PyFrameObject *fo)
+{
+    PyCodeObject *co = NULL;
+
+    PyObject_GC_UnTrack(fo);
+    Py_TRASHCAN_SAFE_BEGIN(fo)
+    /* The frame of a frame object which doesn't own it has left the frame
+       stack already */
+    if (FRAME_IS_OWNED(fo)) {
+        co = fo->f_owned.f_code;
+        frame_clear_references(&fo->f_owned);
+    }
+    Py_CLEAR(fo->f_back);
+
+    if (co != NULL && co->co_zombieframe == NULL)
+        co->co_zombieframe = fo;
     else if (numfree < PyFrame_MAXFREELIST) {
         ++numfree;
-        f->f_back = free_list;
-        free_list = f;
+        fo->f_back = free_list;
+        free_list = fo;
     }
     else
-        PyObject_GC_Del(f);
+        PyObject_GC_Del(fo);
 
-    Py_DECREF(co);
-    Py_TRASHCAN_SAFE_END(f)
+    Py_XDECREF(co);
+    Py_TRASHCAN_SAFE_END(fo)
 }
 
 static int
-frame_traverse(PyFrameObject *f, visitproc visit, void *arg)
+frame_traverse(PyFrameObject *fo, visitproc visit, void *arg)
 {
+    _PyInterpreterFrame *f = &fo->f_owned;
     PyObject **fastlocals, **p;
     Py_ssize_t i, slots;
 
-    Py_VISIT(f->f_back);
+    Py_VISIT(fo->f_back);
+    if (!FRAME_IS_OWNED(fo))
+        return 0;
     Py_VISIT(f->f_code);
     Py_VISIT(f->f_builtins);
     Py_VISIT(f->f_globals);
@@ -493,11 +567,16 @@ frame_traverse(PyFrameObject *f, visitproc visit, void *arg)
 }
 
 static void
-frame_tp_clear(PyFrameObject *f)
+frame_tp_clear(PyFrameObject *fo)
 {
+    _PyInterpreterFrame *f = &fo->f_owned;
     PyObject **fastlocals, **p, **oldtop;
     Py_ssize_t i, slots;
 
+    /* The frame stack holds the references of a frame on it */
+    if (!FRAME_IS_OWNED(fo))
+        return;
+
     /* Before anything else, make sure that this frame is clearly marked
      * as being defunct!  Else, e.g., a generator reachable from this
      * frame may also point to this frame, believe itself to still be
@@ -526,9 +605,11 @@ frame_tp_clear(PyFrameObject *f)
 }
 
 static PyObject *
-frame_clear(PyFrameObject *f)
+frame_clear(PyFrameObject *fo)
 {
-    if (f->f_executing) {
+    _PyInterpreterFrame *f = fo->f_frame;
+
+    if (f->f_executing || !FRAME_IS_OWNED(fo)) {
         PyErr_SetString(PyExc_RuntimeError,
                         "cannot clear an executing frame");
         return NULL;
@@ -537,7 +618,7 @@ frame_clear(PyFrameObject *f)
         _PyGen_Finalize(f->f_gen);
         assert(f->f_gen == NULL);
     }
-    frame_tp_clear(f);
+    frame_tp_clear(fo);
     Py_RETURN_NONE;
 }
 
@@ -545,8 +626,9 @@ PyDoc_STRVAR(clear__doc__,
 "F.clear(): clear most references held by the frame");
 
 static PyObject *
-frame_sizeof(PyFrameObject *f)
+frame_sizeof(PyFrameObject *fo)
 {
+    _PyInterpreterFrame *f = fo->f_frame;
     Py_ssize_t res, extras, ncells, nfrees;
 
     ncells = PyTuple_GET_SIZE(f->f_code->co_cellvars);
@@ -599,7 +681,7 @@ PyTypeObject PyFrame_Type = {
     0,                                          /* tp_iter */
     0,                                          /* tp_iternext */
     frame_methods,                              /* tp_methods */
-    frame_memberlist,                           /* tp_members */
+    0,                                          /* tp_members */
     frame_getsetlist,                           /* tp_getset */
     0,                                          /* tp_base */
     0,                                          /* tp_dict */
@@ -615,20 +697,21 @@ int _PyFrame_Init()
     return 1;
 }
 
-PyFrameObject *
-PyFrame_New(PyThreadState *tstate, PyCodeObject *code, PyObject *globals,
-            PyObject *locals)
+/* Set up a new frame of code, with no locals yet.  Return 0, or -1 with an
+   exception set and nothing held. */
+static int
+frame_init(_PyInterpreterFrame *f, PyThreadState *tstate, PyCodeObject *code,
+           PyObject *globals, PyObject *locals)
 {
-    PyFrameObject *back = tstate->frame;
-    PyFrameObject *f;
+    _PyInterpreterFrame *back = tstate->frame;
     PyObject *builtins;
-    Py_ssize_t i;
+    Py_ssize_t i, extras;
 
 #ifdef Py_DEBUG
     if (code == NULL || globals == NULL || !PyDict_Check(globals) ||
         (locals != NULL && !PyMapping_Check(locals))) {
         PyErr_BadInternalCall();
-        return NULL;
+        return -1;
     }
 #endif
     if (back == NULL || back->f_globals != globals) {
@@ -643,10 +726,12 @@ PyFrame_New(PyThreadState *tstate, PyCodeObject *code, PyObject *globals,
             /* No builtins!              Make up a minimal one
                Give them 'None', at least. */
             builtins = PyDict_New();
-            if (builtins == NULL ||
-                PyDict_SetItemString(
-                    builtins, "None", Py_None) < 0)
-                return NULL;
+            if (builtins == NULL)
+                return -1;
+            if (PyDict_SetItemString(builtins, "None", Py_None) < 0) {
+                Py_DECREF(builtins);
+                return -1;
+            }
         }
         else
             Py_INCREF(builtins);
@@ -659,92 +744,298 @@ PyFrame_New(PyThreadState *tstate, PyCodeObject *code, PyObject *globals,
         assert(builtins != NULL);
         Py_INCREF(builtins);
     }
-    if (code->co_zombieframe != NULL) {
-        f = code->co_zombieframe;
-        code->co_zombieframe = NULL;
-        _Py_NewReference((PyObject *)f);
-        assert(f->f_code == code);
-    }
-    else {
-        Py_ssize_t extras, ncells, nfrees;
-        ncells = PyTuple_GET_SIZE(code->co_cellvars);
-        nfrees = PyTuple_GET_SIZE(code->co_freevars);
-        extras = code->co_stacksize + code->co_nlocals + ncells +
-            nfrees;
-        if (free_list == NULL) {
-            f = PyObject_GC_NewVar(PyFrameObject, &PyFrame_Type,
-            extras);
-            if (f == NULL) {
-                Py_DECREF(builtins);
-                return NULL;
-            }
-        }
-        else {
-            assert(numfree > 0);
-            --numfree;
-            f = free_list;
-            free_list = free_list->f_back;
-            if (Py_SIZE(f) < extras) {
-                PyFrameObject *new_f = PyObject_GC_Resize(PyFrameObject, f, extras);
-                if (new_f == NULL) {
-                    PyObject_GC_Del(f);
-                    Py_DECREF(builtins);
-                    return NULL;
-                }
-                f = new_f;
-            }
-            _Py_NewReference((PyObject *)f);
-        }
-
-        f->f_code = code;
-        extras = code->co_nlocals + ncells + nfrees;
-        f->f_valuestack = f->f_localsplus + extras;
-        for (i=0; i<extras; i++)
-            f->f_localsplus[i] = NULL;
-        f->f_locals = NULL;
-        f->f_trace = NULL;
-        f->f_exc_type = f->f_exc_value = f->f_exc_traceback = NULL;
-    }
-    f->f_stacktop = f->f_valuestack;
-    f->f_builtins = builtins;
-    Py_XINCREF(back);
-    f->f_back = back;
-    Py_INCREF(code);
-    Py_INCREF(globals);
-    f->f_globals = globals;
     /* Most functions have CO_NEWLOCALS and CO_OPTIMIZED set. */
     if ((code->co_flags & (CO_NEWLOCALS | CO_OPTIMIZED)) ==
         (CO_NEWLOCALS | CO_OPTIMIZED))
-        ; /* f_locals = NULL; will be set by PyFrame_FastToLocals() */
+        locals = NULL; /* will be set by PyFrame_FastToLocals() */
     else if (code->co_flags & CO_NEWLOCALS) {
         locals = PyDict_New();
         if (locals == NULL) {
-            Py_DECREF(f);
-            return NULL;
+            Py_DECREF(builtins);
+            return -1;
         }
-        f->f_locals = locals;
     }
     else {
         if (locals == NULL)
             locals = globals;
         Py_INCREF(locals);
-        f->f_locals = locals;
     }
 
+    f->f_previous = NULL;
+    f->f_frame_obj = NULL;
+    Py_INCREF(code);
+    f->f_code = code;
+    f->f_builtins = builtins;
+    Py_INCREF(globals);
+    f->f_globals = globals;
+    f->f_locals = locals;
+    extras = code->co_nlocals + PyTuple_GET_SIZE(code->co_cellvars) +
+        PyTuple_GET_SIZE(code->co_freevars);
+    f->f_valuestack = f->f_localsplus + extras;
+    for (i=0; i<extras; i++)
+        f->f_localsplus[i] = NULL;
+    f->f_stacktop = f->f_valuestack;
+    f->f_trace = NULL;
+    f->f_exc_type = f->f_exc_value = f->f_exc_traceback = NULL;
+    f->f_gen = NULL;
     f->f_lasti = -1;
     f->f_lineno = code->co_firstlineno;
     f->f_iblock = 0;
     f->f_executing = 0;
-    f->f_gen = NULL;
+    return 0;
+}
+
+/* Return a new frame object with room for a frame of code, which neither
+   owns a frame nor is tracked yet */
+static PyFrameObject *
+frame_alloc(PyCodeObject *code)
+{
+    PyFrameObject *fo;
+    Py_ssize_t extras = FRAME_NSLOTS(code);
+
+    if (code->co_zombieframe != NULL) {
+        fo = code->co_zombieframe;
+        code->co_zombieframe = NULL;
+        assert(Py_SIZE(fo) >= extras);
+        _Py_NewReference((PyObject *)fo);
+    }
+    else if (free_list == NULL) {
+        fo = PyObject_GC_NewVar(PyFrameObject, &PyFrame_Type, extras);
+        if (fo == NULL)
+            return NULL;
+    }
+    else {
+        assert(numfree > 0);
+        --numfree;
+        fo = free_list;
+        free_list = free_list->f_back;
+        if (Py_SIZE(fo) < extras) {
+            PyFrameObject *new_fo = PyObject_GC_Resize(PyFrameObject, fo, extras);
+            if (new_fo == NULL) {
+                PyObject_GC_Del(fo);
+                return NULL;
+            }
+            fo = new_fo;
+        }
+        _Py_NewReference((PyObject *)fo);
+    }
+    fo->f_frame = NULL;
+    fo->f_back = NULL;
+    return fo;
+}
+
+PyFrameObject *
+PyFrame_New(PyThreadState *tstate, PyCodeObject *code, PyObject *globals,
+            PyObject *locals)
+{
+    PyFrameObject *fo = frame_alloc(code);
+
+    if (fo == NULL)
+        return NULL;
+    if (frame_init(&fo->f_owned, tstate, code, globals, locals) < 0) {
+        Py_DECREF(fo);
+        return NULL;
+    }
+    fo->f_frame = &fo->f_owned;
+    fo->f_owned.f_frame_obj = fo;
+    _PyObject_GC_TRACK(fo);
+    return fo;
+}
+
+PyFrameObject *
+_PyFrame_GetFrameObject(_PyInterpreterFrame *f)
+{
+    PyFrameObject *fo = f->f_frame_obj;
+    PyObject *error_type, *error_value, *error_traceback;
+
+    if (fo != NULL)
+        return fo;
+    /* Tracebacks ask for frame objects while an exception is raised */
+    PyErr_Fetch(&error_type, &error_value, &error_traceback);
+    fo = frame_alloc(f->f_code);
+    if (fo == NULL) {
+        Py_XDECREF(error_type);
+        Py_XDECREF(error_value);
+        Py_XDECREF(error_traceback);
+        return NULL;
+    }
+    PyErr_Restore(error_type, error_value, error_traceback);
+    fo->f_frame = f;
+    f->f_frame_obj = fo;
+    _PyObject_GC_TRACK(fo);
+    return fo;
+}
+
+/* Move the frame f, leaving the frame stack, into its frame object fo.
+   tstate->frame is the caller of f by then:  it becomes f_back. */
+static void
+frame_take_ownership(PyThreadState *tstate, PyFrameObject *fo,
+                     _PyInterpreterFrame *f)
+{
+    _PyInterpreterFrame *owned = &fo->f_owned;
+    PyObject *error_type, *error_value, *error_traceback;
+    PyFrameObject *back;
+
+    assert(fo->f_frame == f && Py_SIZE(fo) >= FRAME_NSLOTS(f->f_code));
+    memcpy(owned, f, FRAME_SIZE(f->f_code) * sizeof(PyObject *));
+    owned->f_valuestack = owned->f_localsplus +
+        (f->f_valuestack - f->f_localsplus);
+    if (f->f_stacktop != NULL)
+        owned->f_stacktop = owned->f_localsplus +
+            (f->f_stacktop - f->f_localsplus);
+    owned->f_previous = NULL;
+    owned->f_frame_obj = fo;
+    fo->f_frame = owned;
+
+    if (tstate->frame != NULL) {
+        PyErr_Fetch(&error_type, &error_value, &error_traceback);
+        back = _PyFrame_GetFrameObject(tstate->frame);
+        if (back == NULL)
+            /* The frame just ends up without f_back */
+            PyErr_Clear();
+        else {
+            Py_INCREF(back);
+            fo->f_back = back;
+        }
+        PyErr_Restore(error_type, error_value, error_traceback);
+    }
+}
+
+/* The frame stack */
+
+#define FRAME_CHUNK_SIZE (64 * 1024)
+
+typedef struct _PyFrameChunk {
+    struct _PyFrameChunk *previous;
+    /* The chunk after this one, kept for reuse when the stack shrinks back
+       into this chunk;  it has no next chunk itself. */
+    struct _PyFrameChunk *next;
+    PyObject **saved_top;       /* frame_top in previous */
+    PyObject **limit;
+    PyObject *data[1];
+} _PyFrameChunk;
+
+/* Switch the frame stack to a chunk with room for size slots.  Return the
+   start of the chunk, or NULL with an exception set. */
+static PyObject **
+frame_stack_grow(PyThreadState *tstate, Py_ssize_t size)
+{
+    _PyFrameChunk *chunk = tstate->frame_chunk;
+    _PyFrameChunk *next = chunk != NULL ? chunk->next : NULL;
+
+    if (next != NULL && next->limit - next->data < size) {
+        chunk->next = NULL;
+        PyMem_RawFree(next);
+        next = NULL;
+    }
+    if (next == NULL) {
+        size_t nbytes = offsetof(_PyFrameChunk, data) +
+                        size * sizeof(PyObject *);
+        if (nbytes < FRAME_CHUNK_SIZE)
+            nbytes = FRAME_CHUNK_SIZE;
+        next = (_PyFrameChunk *)PyMem_RawMalloc(nbytes);
+        if (next == NULL) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+        next->previous = chunk;
+        next->next = NULL;
+        next->limit = next->data +
+            (nbytes - offsetof(_PyFrameChunk, data)) / sizeof(PyObject *);
+        if (chunk != NULL)
+            chunk->next = next;
+    }
+    next->saved_top = tstate->frame_top;
+    tstate->frame_chunk = next;
+    tstate->frame_top = next->data;
+    tstate->frame_limit = next->limit;
+    return next->data;
+}
+
+/* Pop the frame stack down to top */
+static void
+frame_stack_release(PyThreadState *tstate, PyObject **top)
+{
+    _PyFrameChunk *chunk = tstate->frame_chunk;
 
-    _PyObject_GC_TRACK(f);
-    return f;
+    tstate->frame_top = top;
+    if (top == chunk->data && chunk->previous != NULL) {
+        if (chunk->next != NULL) {
+            PyMem_RawFree(chunk->next);
+            chunk->next = NULL;
+        }
+        tstate->frame_chunk = chunk->previous;
+        tstate->frame_top = chunk->saved_top;
+        tstate->frame_limit = chunk->previous->limit;
+    }
+}
+
+_PyInterpreterFrame *
+_PyFrame_Push(PyThreadState *tstate, PyCodeObject *code, PyObject *globals,
+              PyObject *locals)
+{
+    Py_ssize_t size = FRAME_SIZE(code);
+    PyObject **top = tstate->frame_top;
+
+    if (tstate->frame_limit - top < size) {
+        top = frame_stack_grow(tstate, size);
+        if (top == NULL)
+            return NULL;
+    }
+    if (frame_init((_PyInterpreterFrame *)top, tstate, code,
+                   globals, locals) < 0) {
+        frame_stack_release(tstate, top);
+        return NULL;
+    }
+    tstate->frame_top = top + size;
+    return (_PyInterpreterFrame *)top;
+}
+
+void
+_PyFrame_Pop(PyThreadState *tstate, _PyInterpreterFrame *f)
+{
+    PyFrameObject *fo = f->f_frame_obj;
+
+    assert(tstate->frame_top == (PyObject **)f + FRAME_SIZE(f->f_code));
+    if (fo != NULL) {
+        f->f_frame_obj = NULL;
+        if (Py_REFCNT(fo) > 1) {
+            frame_take_ownership(tstate, fo, f);
+            Py_DECREF(fo);
+            frame_stack_release(tstate, (PyObject **)f);
+            return;
+        }
+        Py_DECREF(fo);
+    }
+    /* This may run code, which pushes its frames above f */
+    frame_clear_references(f);
+    Py_DECREF(f->f_code);
+    frame_stack_release(tstate, (PyObject **)f);
+}
+
+void
+_PyFrame_ClearThreadStack(PyThreadState *tstate)
+{
+    _PyFrameChunk *chunk = tstate->frame_chunk, *next;
+
+    if (chunk == NULL)
+        return;
+    while (chunk->previous != NULL)
+        chunk = chunk->previous;
+    while (chunk != NULL) {
+        next = chunk->next;
+        PyMem_RawFree(chunk);
+        chunk = next;
+    }
+    tstate->frame_chunk = NULL;
+    tstate->frame_top = NULL;
+    tstate->frame_limit = NULL;
 }
 
 /* Block management */
 
 void
-PyFrame_BlockSetup(PyFrameObject *f, int type, int handler, int level)
+_PyFrame_BlockSetup(_PyInterpreterFrame *f, int type, int handler, int level)
 {
     PyTryBlock *b;
     if (f->f_iblock >= CO_MAXBLOCKS)
@@ -756,7 +1047,7 @@ PyFrame_BlockSetup(PyFrameObject *f, int type, int handler, int level)
 }
 
 PyTryBlock *
-PyFrame_BlockPop(PyFrameObject *f)
+_PyFrame_BlockPop(_PyInterpreterFrame *f)
 {
     PyTryBlock *b;
     if (f->f_iblock <= 0)
@@ -765,6 +1056,18 @@ PyFrame_BlockPop(PyFrameObject *f)
     return b;
 }
 
+void
+PyFrame_BlockSetup(PyFrameObject *f, int type, int handler, int level)
+{
+    _PyFrame_BlockSetup(f->f_frame, type, handler, level);
+}
+
+PyTryBlock *
+PyFrame_BlockPop(PyFrameObject *f)
+{
+    return _PyFrame_BlockPop(f->f_frame);
+}
+
 /* Convert between "fast" version of locals and dictionary version.
 
    map and values are input arguments.  map is a tuple of strings.
@@ -865,7 +1168,7 @@ dict_to_map(PyObject *map, Py_ssize_t nmap, PyObject *dict, PyObject **values,
 }
 
 int
-PyFrame_FastToLocalsWithError(PyFrameObject *f)
+_PyFrame_FastToLocalsWithError(_PyInterpreterFrame *f)
 {
     /* Merge fast locals into f->f_locals */
     PyObject *locals, *map;
@@ -924,6 +1227,16 @@ PyFrame_FastToLocalsWithError(PyFrameObject *f)
     return 0;
 }
 
+int
+PyFrame_FastToLocalsWithError(PyFrameObject *f)
+{
+    if (f == NULL) {
+        PyErr_BadInternalCall();
+        return -1;
+    }
+    return _PyFrame_FastToLocalsWithError(f->f_frame);
+}
+
 void
 PyFrame_FastToLocals(PyFrameObject *f)
 {
@@ -937,7 +1250,7 @@ PyFrame_FastToLocals(PyFrameObject *f)
 }
 
 void
-PyFrame_LocalsToFast(PyFrameObject *f, int clear)
+_PyFrame_LocalsToFast(_PyInterpreterFrame *f, int clear)
 {
     /* Merge f->f_locals into fast locals */
     PyObject *locals, *map;
@@ -977,6 +1290,14 @@ PyFrame_LocalsToFast(PyFrameObject *f, int clear)
     PyErr_Restore(error_type, error_value, error_traceback);
 }
 
+void
+PyFrame_LocalsToFast(PyFrameObject *f, int clear)
+{
+    if (f == NULL)
+        return;
+    _PyFrame_LocalsToFast(f->f_frame, clear);
+}
+
 /* Clear out the free list */
 int
 PyFrame_ClearFreeList(void)
@@ -1008,3 +1329,10 @@ _PyFrame_DebugMallocStats(FILE *out)
                            numfree, sizeof(PyFrameObject));
 }
 
+/* Number of objects in the free list */
+int
+_PyFrame_NumFree(void)
+{
+    return numfree;
+}
+
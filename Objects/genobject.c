@@ -29,14 +29,14 @@ _PyGen_Finalize(PyObject *self)
     if (gen->gi_code != NULL
             && ((PyCodeObject *)gen->gi_code)->co_flags & CO_COROUTINE
             && gen->gi_frame != NULL
-            && gen->gi_frame->f_lasti == -1
+            && gen->gi_frame->f_frame->f_lasti == -1
             && !PyErr_Occurred()
             && PyErr_WarnFormat(PyExc_RuntimeWarning, 1,
                                 "coroutine '%.50S' was never awaited",
                                 gen->gi_qualname))
         return;
 
-    if (gen->gi_frame == NULL || gen->gi_frame->f_stacktop == NULL)
+    if (gen->gi_frame == NULL || gen->gi_frame->f_frame->f_stacktop == NULL)
         /* Generator isn't paused, so no need to close */
         return;
 
@@ -80,8 +80,8 @@ gen_dealloc(PyGenObject *gen)
 static PyObject *
 gen_send_ex(PyGenObject *gen, PyObject *arg, int exc)
 {
-    PyThreadState *tstate = PyThreadState_GET();
-    PyFrameObject *f = gen->gi_frame;
+    PyFrameObject *fo = gen->gi_frame;
+    _PyInterpreterFrame *f = fo != NULL ? fo->f_frame : NULL;
     PyObject *result;
 
     if (gen->gi_running) {
@@ -116,21 +116,12 @@ gen_send_ex(PyGenObject *gen, PyObject *arg, int exc)
     }
 
     /* Generators always return to their most recent caller, not
-     * necessarily their creator. */
-    Py_XINCREF(tstate->frame);
-    assert(f->f_back == NULL);
-    f->f_back = tstate->frame;
-
+     * necessarily their creator:  eval links the frame to the caller's
+     * only while it runs. */
     gen->gi_running = 1;
-    result = PyEval_EvalFrameEx(f, exc);
+    result = PyEval_EvalFrameEx(fo, exc);
     gen->gi_running = 0;
 
-    /* Don't keep the reference to f_back any longer than necessary.  It
-     * may keep a chain of frames alive or it could create a reference
-     * cycle. */
-    assert(f->f_back == tstate->frame);
-    Py_CLEAR(f->f_back);
-
     /* If the generator just returned (as opposed to yielding), signal
      * that the generator is exhausted. */
     if (result && f->f_stacktop == NULL) {
@@ -205,9 +196,9 @@ gen_send_ex(PyGenObject *gen, PyObject *arg, int exc)
         Py_XDECREF(t);
         Py_XDECREF(v);
         Py_XDECREF(tb);
-        gen->gi_frame->f_gen = NULL;
+        f->f_gen = NULL;
         gen->gi_frame = NULL;
-        Py_DECREF(f);
+        Py_DECREF(fo);
     }
 
     return result;
@@ -262,7 +253,7 @@ static PyObject *
 gen_yf(PyGenObject *gen)
 {
     PyObject *yf = NULL;
-    PyFrameObject *f = gen->gi_frame;
+    _PyInterpreterFrame *f = gen->gi_frame ? gen->gi_frame->f_frame : NULL;
 
     if (f && f->f_stacktop) {
         PyObject *bytecode = f->f_code->co_code;
@@ -363,11 +354,11 @@ gen_throw(PyGenObject *gen, PyObject *args)
         if (!ret) {
             PyObject *val;
             /* Pop subiterator from stack */
-            ret = *(--gen->gi_frame->f_stacktop);
+            ret = *(--gen->gi_frame->f_frame->f_stacktop);
             assert(ret == yf);
             Py_DECREF(ret);
             /* Termination repetition of YIELD_FROM */
-            gen->gi_frame->f_lasti++;
+            gen->gi_frame->f_frame->f_lasti++;
             if (_PyGen_FetchStopIterationValue(&val) == 0) {
                 ret = gen_send_ex(gen, val, 0);
                 Py_DECREF(val);
@@ -649,9 +640,9 @@ gen_new_with_qualname(PyTypeObject *type, PyFrameObject *f,
         return NULL;
     }
     gen->gi_frame = f;
-    f->f_gen = (PyObject *) gen;
-    Py_INCREF(f->f_code);
-    gen->gi_code = (PyObject *)(f->f_code);
+    f->f_frame->f_gen = (PyObject *) gen;
+    Py_INCREF(f->f_frame->f_code);
+    gen->gi_code = (PyObject *)(f->f_frame->f_code);
     gen->gi_running = 0;
     gen->gi_weakreflist = NULL;
     if (name != NULL)
@@ -684,7 +675,7 @@ int
 PyGen_NeedsFinalizing(PyGenObject *gen)
 {
     int i;
-    PyFrameObject *f = gen->gi_frame;
+    _PyInterpreterFrame *f = gen->gi_frame ? gen->gi_frame->f_frame : NULL;
 
     if (f == NULL || f->f_stacktop == NULL)
         return 0; /* no frame or empty blockstack == no finalization */
@@ -693,6 +684,10 @@ PyGen_NeedsFinalizing(PyGenObject *gen)
     for (i = 0; i < f->f_iblock; i++)
         if (f->f_blockstack[i].b_type != SETUP_LOOP)
             return 1;
+    /* So does a try block of the exception table */
+    if (f->f_lasti >= 0 &&
+        _PyCode_FindTryBlock(f->f_code, f->f_lasti, INT_MAX) != NULL)
+        return 1;
 
     /* No blocks except loops, it's safe to skip finalization. */
     return 0;
@@ -126,6 +126,13 @@ _PyList_DebugMallocStats(FILE *out)
                            numfree, sizeof(PyListObject));
 }
 
+/* Number of objects in the free list */
+int
+_PyList_NumFree(void)
+{
+    return numfree;
+}
+
 PyObject *
 PyList_New(Py_ssize_t size)
 {
@@ -2319,6 +2326,28 @@ list_init(PyListObject *self, PyObject *args, PyObject *kw)
     return 0;
 }
 
+/* list() and list(iterable), called on the list type itself */
+static PyObject *
+list_vectorcall(PyObject *type, PyObject **args, Py_ssize_t nargs,
+                PyObject *kwnames)
+{
+    PyObject *list, *rv;
+
+    assert(type == (PyObject *)&PyList_Type);
+    if (nargs > 1 || (kwnames != NULL && PyTuple_GET_SIZE(kwnames) != 0))
+        return _PyObject_MakeTpCall(type, args, nargs, kwnames);
+    list = PyList_New(0);
+    if (list == NULL || nargs == 0)
+        return list;
+    rv = listextend((PyListObject *)list, args[0]);
+    if (rv == NULL) {
+        Py_DECREF(list);
+        return NULL;
+    }
+    Py_DECREF(rv);
+    return list;
+}
+
 static PyObject *
 list_sizeof(PyListObject *self)
 {
@@ -2664,16 +2693,22 @@ PyTypeObject PyList_Type = {
     PyType_GenericAlloc,                        /* tp_alloc */
     PyType_GenericNew,                          /* tp_new */
     PyObject_GC_Del,                            /* tp_free */
+    0,                                          /* tp_is_gc */
+    0,                                          /* tp_bases */
+    0,                                          /* tp_mro */
+    0,                                          /* tp_cache */
+    0,                                          /* tp_subclasses */
+    0,                                          /* tp_weaklist */
+    0,                                          /* tp_del */
+    0,                                          /* tp_version_tag */
+    0,                                          /* tp_finalize */
+    list_vectorcall,                            /* tp_vectorcall */
 };
 
 
 /*********************** List Iterator **************************/
 
-typedef struct {
-    PyObject_HEAD
-    Py_ssize_t it_index;
-    PyListObject *it_seq; /* Set to NULL when iterator is exhausted */
-} listiterobject;
+typedef _PyListIterObject listiterobject;
 
 static PyObject *list_iter(PyObject *);
 static void listiter_dealloc(listiterobject *);
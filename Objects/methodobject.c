@@ -13,6 +13,9 @@ static int numfree = 0;
 #define PyCFunction_MAXFREELIST 256
 #endif
 
+static PyObject *cfunction_vectorcall(PyObject *, PyObject **, Py_ssize_t,
+                                      PyObject *);
+
 /* undefine macro trampoline to PyCFunction_NewEx */
 #undef PyCFunction_New
 
@@ -43,6 +46,7 @@ PyCFunction_NewEx(PyMethodDef *ml, PyObject *self, PyObject *module)
     op->m_self = self;
     Py_XINCREF(module);
     op->m_module = module;
+    op->vectorcall = cfunction_vectorcall;
     _PyObject_GC_TRACK(op);
     return (PyObject *)op;
 }
@@ -94,7 +98,11 @@ PyCFunction_Call(PyObject *func, PyObject *args, PyObject *kwds)
 
     flags = PyCFunction_GET_FLAGS(func) & ~(METH_CLASS | METH_STATIC | METH_COEXIST);
 
-    if (flags == (METH_VARARGS | METH_KEYWORDS)) {
+    if (flags & METH_FASTCALL) {
+        /* on the items of args, without a new tuple */
+        res = _PyVectorcall_Call(func, args, kwds);
+    }
+    else if (flags == (METH_VARARGS | METH_KEYWORDS)) {
         res = (*(PyCFunctionWithKeywords)meth)(self, args, kwds);
     }
     else {
@@ -145,6 +153,98 @@ PyCFunction_Call(PyObject *func, PyObject *args, PyObject *kwds)
     return _Py_CheckFunctionResult(func, res, NULL);
 }
 
+PyObject *
+_PyMethodDef_Vectorcall(PyMethodDef *method, PyObject *self,
+                        PyObject **args, Py_ssize_t nargs, PyObject *kwnames)
+{
+    PyCFunction meth = method->ml_meth;
+    int flags = method->ml_flags & ~(METH_CLASS | METH_STATIC | METH_COEXIST);
+    Py_ssize_t nkwargs = kwnames == NULL ? 0 : PyTuple_GET_SIZE(kwnames);
+    PyObject *argstuple, *kwdict = NULL, *res;
+
+    /* _PyMethodDef_Vectorcall() must not be called with an exception set,
+       because it may clear it (directly or indirectly) and so the
+       caller loses its exception */
+    assert(!PyErr_Occurred());
+
+    switch (flags) {
+    case METH_NOARGS:
+        if (nkwargs != 0)
+            goto no_keywords;
+        if (nargs != 0) {
+            PyErr_Format(PyExc_TypeError,
+                "%.200s() takes no arguments (%zd given)",
+                method->ml_name, nargs);
+            return NULL;
+        }
+        return (*meth)(self, NULL);
+
+    case METH_O:
+        if (nkwargs != 0)
+            goto no_keywords;
+        if (nargs != 1) {
+            PyErr_Format(PyExc_TypeError,
+                "%.200s() takes exactly one argument (%zd given)",
+                method->ml_name, nargs);
+            return NULL;
+        }
+        return (*meth)(self, args[0]);
+
+    case METH_FASTCALL:
+        if (nkwargs != 0)
+            goto no_keywords;
+        return (*(_PyCFunctionFast)meth)(self, args, nargs);
+
+    case METH_FASTCALL | METH_KEYWORDS:
+        return (*(_PyCFunctionFastWithKeywords)meth)(
+            self, args, nargs, nkwargs != 0 ? kwnames : NULL);
+
+    case METH_VARARGS:
+        if (nkwargs != 0)
+            goto no_keywords;
+        /* fall through */
+    case METH_VARARGS | METH_KEYWORDS:
+        /* The function takes the arguments in a tuple, and a dict */
+        argstuple = _PyStack_AsTuple(args, nargs);
+        if (argstuple == NULL)
+            return NULL;
+        if (nkwargs != 0) {
+            kwdict = _PyStack_AsDict(args + nargs, kwnames);
+            if (kwdict == NULL) {
+                Py_DECREF(argstuple);
+                return NULL;
+            }
+        }
+        if (flags & METH_KEYWORDS)
+            res = (*(PyCFunctionWithKeywords)meth)(self, argstuple, kwdict);
+        else
+            res = (*meth)(self, argstuple);
+        Py_DECREF(argstuple);
+        Py_XDECREF(kwdict);
+        return res;
+
+    default:
+        PyErr_SetString(PyExc_SystemError,
+                        "Bad call flags in _PyMethodDef_Vectorcall. "
+                        "METH_OLDARGS is no longer supported!");
+        return NULL;
+    }
+
+  no_keywords:
+    PyErr_Format(PyExc_TypeError, "%.200s() takes no keyword arguments",
+                 method->ml_name);
+    return NULL;
+}
+
+static PyObject *
+cfunction_vectorcall(PyObject *func, PyObject **args, Py_ssize_t nargs,
+                     PyObject *kwnames)
+{
+    return _PyMethodDef_Vectorcall(((PyCFunctionObject *)func)->m_ml,
+                                   PyCFunction_GET_SELF(func),
+                                   args, nargs, kwnames);
+}
+
 /* Methods (the standard built-in methods, that is) */
 
 static void
@@ -340,7 +440,7 @@ PyTypeObject PyCFunction_Type = {
     sizeof(PyCFunctionObject),
     0,
     (destructor)meth_dealloc,                   /* tp_dealloc */
-    0,                                          /* tp_print */
+    offsetof(PyCFunctionObject, vectorcall),    /* tp_vectorcall_offset */
     0,                                          /* tp_getattr */
     0,                                          /* tp_setattr */
     0,                                          /* tp_reserved */
@@ -354,7 +454,8 @@ PyTypeObject PyCFunction_Type = {
     PyObject_GenericGetAttr,                    /* tp_getattro */
     0,                                          /* tp_setattro */
     0,                                          /* tp_as_buffer */
-    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,/* tp_flags */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC |
+        Py_TPFLAGS_HAVE_VECTORCALL,             /* tp_flags */
     0,                                          /* tp_doc */
     (traverseproc)meth_traverse,                /* tp_traverse */
     0,                                          /* tp_clear */
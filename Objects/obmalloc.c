@@ -1,4 +1,5 @@
 #include "Python.h"
+#include "frameobject.h"
 
 /* Python's malloc wrappers (see pymem.h) */
 
@@ -40,6 +41,16 @@ static void _PyMem_DebugCheckAddress(char api_id, const void *p);
 #  endif
 #endif
 
+#ifdef MS_WINDOWS
+#  define ARENAS_USE_NUMA
+#elif defined(ARENAS_USE_MMAP) && defined(__linux__) && defined(_GNU_SOURCE)
+#  include <sched.h>
+#  include <sys/syscall.h>
+#  ifdef SYS_mbind
+#    define ARENAS_USE_NUMA
+#  endif
+#endif
+
 #ifdef WITH_PYMALLOC
 /* Forward declaration */
 static void* _PyObject_Malloc(void *ctx, size_t size);
@@ -90,10 +101,169 @@ _PyMem_RawFree(void *ctx, void *ptr)
 }
 
 
+#ifdef ARENAS_USE_NUMA
+/* NUMA placement of arenas.
+
+   On a machine with several NUMA nodes, memory attached to one node is
+   slower to reach from the CPUs of the others.  With NUMA arenas on (see
+   _PyObject_SetNumaArenas() and "NUMA nodes" below), obmalloc keeps the
+   arenas of each node apart and serves a thread from the node it runs on.
+   This part tells the nodes apart and places the memory:  numa_arena_node
+   is the node the arena being allocated is for, or -1 if it may come from
+   anywhere, and the default arena allocators ask the system for memory of
+   that node.  Arena allocators installed with PyObject_SetArenaAllocator()
+   don't see the hint; the first touch of each pool, made by a thread of the
+   node the pool is carved for, places their pages most of the time.
+*/
+
+/* Number of nodes of the machine, at most _PyObject_MAX_NUMA_NODES, or 0
+ * until numa_probe() was called.
+ */
+static int numa_nnodes = 0;
+static int numa_arena_node = -1;
+
+#ifdef MS_WINDOWS
+static int
+numa_probe(void)
+{
+    ULONG highest;
+
+    if (!GetNumaHighestNodeNumber(&highest))
+        return 1;
+    if (highest >= _PyObject_MAX_NUMA_NODES)
+        return _PyObject_MAX_NUMA_NODES;
+    return (int)highest + 1;
+}
+
+/* Return the node of the CPU the calling thread runs on. */
+static int
+numa_current_node(void)
+{
+    UCHAR node;
+
+    if (!GetNumaProcessorNode((UCHAR)GetCurrentProcessorNumber(), &node) ||
+        node >= numa_nnodes)
+        return 0;
+    return node;
+}
+
+#else   /* Linux */
+
+/* CPUs beyond NUMA_MAX_CPUS are taken to be on node 0. */
+#define NUMA_MAX_CPUS           4096
+#define NUMA_MPOL_PREFERRED     1       /* MPOL_PREFERRED of <numaif.h> */
+
+static unsigned char numa_cpu_node[NUMA_MAX_CPUS];
+
+/* Read a list of numbers like "0-3,8,10-11" from the sysfs file PATH, and set
+ * the bits of the ones below NBITS in the bit vector SET.  Return the highest
+ * number in the list plus one, or 0 if the file can't be read.
+ */
+static int
+numa_read_list(const char *path, unsigned char *set, int nbits)
+{
+    char buf[4096];
+    char *s, *end;
+    long lo, hi, highest = -1;
+    size_t n;
+    FILE *fp;
+
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return 0;
+    n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+
+    for (s = buf; ; s = end + 1) {
+        lo = hi = strtol(s, &end, 10);
+        if (end == s)
+            break;
+        if (*end == '-') {
+            s = end + 1;
+            hi = strtol(s, &end, 10);
+            if (end == s)
+                break;
+        }
+        if (hi > highest)
+            highest = hi;
+        for (; lo <= hi && lo < nbits; ++lo)
+            if (lo >= 0)
+                set[lo / 8] |= 1 << (lo % 8);
+        if (*end != ',')
+            break;
+    }
+    return (int)(highest + 1);
+}
+
+static int
+numa_probe(void)
+{
+    unsigned char nodes[_PyObject_MAX_NUMA_NODES / 8];
+    unsigned char cpus[NUMA_MAX_CPUS / 8];
+    char path[64];
+    int nnodes, node, cpu;
+
+    /* Kernels built without NUMA support have no node directory. */
+    memset(nodes, 0, sizeof(nodes));
+    nnodes = numa_read_list("/sys/devices/system/node/online",
+                            nodes, _PyObject_MAX_NUMA_NODES);
+    if (nnodes > _PyObject_MAX_NUMA_NODES)
+        nnodes = _PyObject_MAX_NUMA_NODES;
+    for (node = 1; node < nnodes; ++node) {
+        if (!(nodes[node / 8] & (1 << (node % 8))))
+            continue;
+        memset(cpus, 0, sizeof(cpus));
+        PyOS_snprintf(path, sizeof(path),
+                      "/sys/devices/system/node/node%d/cpulist", node);
+        (void)numa_read_list(path, cpus, NUMA_MAX_CPUS);
+        for (cpu = 0; cpu < NUMA_MAX_CPUS; ++cpu)
+            if (cpus[cpu / 8] & (1 << (cpu % 8)))
+                numa_cpu_node[cpu] = (unsigned char)node;
+    }
+    return nnodes > 0 ? nnodes : 1;
+}
+
+/* Return the node of the CPU the calling thread runs on.  sched_getcpu()
+ * doesn't enter the kernel on the common platforms.
+ */
+static int
+numa_current_node(void)
+{
+    int cpu = sched_getcpu();
+
+    if (cpu < 0 || cpu >= NUMA_MAX_CPUS)
+        return 0;
+    return numa_cpu_node[cpu];
+}
+
+/* Prefer memory of NODE for the pages of [ptr, ptr+size), which must not
+ * have been touched yet.  The kernel falls back to the other nodes when
+ * NODE runs out of memory, and we ignore errors:  the pages then land
+ * wherever they are first touched.
+ */
+static void
+numa_bind(void *ptr, size_t size, int node)
+{
+    unsigned long mask[_PyObject_MAX_NUMA_NODES / (8 * sizeof(long))];
+
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(long))] = 1UL << (node % (8 * sizeof(long)));
+    /* maxnode counts one bit more than the kernel reads */
+    (void)syscall(SYS_mbind, ptr, size, NUMA_MPOL_PREFERRED, mask,
+                  (unsigned long)_PyObject_MAX_NUMA_NODES + 1, 0);
+}
+#endif
+#endif   /* ARENAS_USE_NUMA */
+
 #ifdef MS_WINDOWS
 static void *
 _PyObject_ArenaVirtualAlloc(void *ctx, size_t size)
 {
+    if (numa_arena_node >= 0)
+        return VirtualAllocExNuma(GetCurrentProcess(), NULL, size,
+                                  MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE,
+                                  (DWORD)numa_arena_node);
     return VirtualAlloc(NULL, size,
                         MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
 }
@@ -104,25 +274,284 @@ _PyObject_ArenaVirtualFree(void *ctx, void *ptr, size_t size)
     VirtualFree(ptr, 0, MEM_RELEASE);
 }
 
+/* Discard the contents of [ptr, ptr+size) inside an arena, which stays
+ * committed.  The pages are dropped from the working set when memory gets
+ * tight, and may read as zeroes or as their old contents afterwards.
+ * Return the number of bytes given back.
+ */
+static size_t
+_PyObject_ArenaVirtualReset(void *ptr, size_t size)
+{
+    if (VirtualAlloc(ptr, size, MEM_RESET, PAGE_READWRITE) == NULL)
+        return 0;
+    return size;
+}
+
+#define ARENAS_DEFAULT_FREE     _PyObject_ArenaVirtualFree
+#define ARENAS_RELEASE_PAGES    _PyObject_ArenaVirtualReset
+
 #elif defined(ARENAS_USE_MMAP)
+
+#if defined(MAP_HUGETLB) || defined(MADV_HUGEPAGE)
+#  define ARENAS_USE_HUGE_PAGES
+#endif
+
+#ifdef ARENAS_USE_HUGE_PAGES
+/* Huge-page backed arenas.
+
+   A heap of millions of small objects spread over hundreds of arenas thrashes
+   the TLB long before it thrashes the caches.  Unless huge_page_mode is
+   PYMEM_HUGEPAGES_OFF, arenas are therefore not mapped one by one but carved
+   out of HUGE_REGION_SIZE regions, aligned on a huge page boundary and backed
+   by huge pages:  either explicitly with MAP_HUGETLB, which needs huge pages
+   reserved by the administrator (vm.nr_hugepages), or transparently by asking
+   the kernel with madvise(MADV_HUGEPAGE).  Arenas and pools keep their usual
+   sizes inside a region.
+
+   A region is only unmapped once all of its arenas are free:  a MAP_HUGETLB
+   mapping can't be partially unmapped, and punching a hole into a transparent
+   huge page would split it anyway.  When several regions have room, the
+   fullest one is used, so that the others get a chance to become empty.
+   With NUMA arenas on, a region only holds arenas of the node it was mapped
+   for.
+
+   The default compile-time mode can be changed with -DPYMALLOC_HUGE_PAGES=
+   PYMEM_HUGEPAGES_THP (for example), the run-time mode with
+   _PyObject_SetHugePageArenas().
+*/
+#define HUGE_REGION_SIZE        (2 << 20)       /* 2 MB */
+#define HUGE_REGION_MASK        (HUGE_REGION_SIZE - 1)
+
+#ifndef PYMALLOC_HUGE_PAGES
+#define PYMALLOC_HUGE_PAGES     PYMEM_HUGEPAGES_OFF
+#endif
+
+struct huge_region {
+    Py_uintptr_t address;       /* HUGE_REGION_SIZE-aligned base address */
+    size_t slot_size;           /* size of the arenas carved out of it */
+    unsigned int used;          /* bit i set:  slot i is handed out */
+    unsigned int nused;         /* number of bits set in used */
+    int hugetlb;                /* mapped with MAP_HUGETLB? */
+#ifdef ARENAS_USE_NUMA
+    int node;                   /* numa_arena_node it was mapped for */
+#endif
+    struct huge_region *next;
+};
+
+static _PyObject_HugePageMode huge_page_mode = PYMALLOC_HUGE_PAGES;
+
+/* All the regions currently mapped, and how many of them use MAP_HUGETLB. */
+static struct huge_region *huge_regions = NULL;
+static size_t nhuge_regions = 0;
+static size_t nhugetlb_regions = 0;
+
+/* Map a HUGE_REGION_SIZE region aligned on a huge page boundary.  Set
+ * *hugetlb to 1 if it is backed by reserved huge pages, else to 0.
+ */
+static void *
+huge_region_map(int *hugetlb)
+{
+    void *ptr;
+    Py_uintptr_t base, aligned;
+
+#ifdef MAP_HUGETLB
+    if (huge_page_mode == PYMEM_HUGEPAGES_HUGETLB) {
+        ptr = mmap(NULL, HUGE_REGION_SIZE, PROT_READ|PROT_WRITE,
+                   MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            *hugetlb = 1;
+            return ptr;
+        }
+        /* No huge page left in the pool:  use transparent ones. */
+    }
+#endif
+    *hugetlb = 0;
+
+    /* mmap() only guarantees page alignment:  map twice the size and trim
+     * the excess on both sides.
+     */
+    ptr = mmap(NULL, 2 * HUGE_REGION_SIZE, PROT_READ|PROT_WRITE,
+               MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+        return NULL;
+    base = (Py_uintptr_t)ptr;
+    aligned = (base + HUGE_REGION_MASK) & ~(Py_uintptr_t)HUGE_REGION_MASK;
+    if (aligned != base)
+        munmap(ptr, aligned - base);
+    if (aligned - base != HUGE_REGION_SIZE)
+        munmap((void *)(aligned + HUGE_REGION_SIZE),
+               base + HUGE_REGION_SIZE - aligned);
+#ifdef MADV_HUGEPAGE
+    (void)madvise((void *)aligned, HUGE_REGION_SIZE, MADV_HUGEPAGE);
+#endif
+    return (void *)aligned;
+}
+
+/* Hand out a SIZE bytes slot of a huge region, mapping a new region if none
+ * has room.  SIZE must divide HUGE_REGION_SIZE into at most 32 slots.
+ */
+static void *
+huge_arena_alloc(size_t size)
+{
+    struct huge_region *region, *best = NULL;
+    unsigned int full = (1U << (HUGE_REGION_SIZE / size)) - 1;
+    unsigned int i;
+
+    for (region = huge_regions; region != NULL; region = region->next) {
+        if (region->slot_size != size || region->used == full)
+            continue;
+#ifdef ARENAS_USE_NUMA
+        if (region->node != numa_arena_node)
+            continue;
+#endif
+        if (best == NULL || region->nused > best->nused)
+            best = region;
+    }
+    if (best == NULL) {
+        int hugetlb;
+        void *address = huge_region_map(&hugetlb);
+
+        if (address == NULL)
+            return NULL;
+        best = (struct huge_region *)PyMem_RawMalloc(sizeof(*best));
+        if (best == NULL) {
+            munmap(address, HUGE_REGION_SIZE);
+            return NULL;
+        }
+        best->address = (Py_uintptr_t)address;
+        best->slot_size = size;
+        best->used = 0;
+        best->nused = 0;
+        best->hugetlb = hugetlb;
+#ifdef ARENAS_USE_NUMA
+        best->node = numa_arena_node;
+        if (numa_arena_node >= 0)
+            numa_bind(address, HUGE_REGION_SIZE, numa_arena_node);
+#endif
+        best->next = huge_regions;
+        huge_regions = best;
+        ++nhuge_regions;
+        nhugetlb_regions += hugetlb;
+    }
+
+    for (i = 0; best->used & (1U << i); ++i)
+        ;
+    best->used |= 1U << i;
+    ++best->nused;
+    return (void *)(best->address + i * size);
+}
+
+/* If PTR was handed out by huge_arena_alloc(), release its slot (unmapping
+ * the region if it's now unused) and return 1.  Else return 0.
+ */
+static int
+huge_arena_free(void *ptr)
+{
+    Py_uintptr_t base = (Py_uintptr_t)ptr & ~(Py_uintptr_t)HUGE_REGION_MASK;
+    struct huge_region **pregion, *region;
+    unsigned int i;
+
+    for (pregion = &huge_regions; (region = *pregion) != NULL;
+         pregion = &region->next) {
+        if (region->address != base)
+            continue;
+        i = (unsigned int)(((Py_uintptr_t)ptr - base) / region->slot_size);
+        assert(region->used & (1U << i));
+        region->used &= ~(1U << i);
+        if (--region->nused == 0) {
+            *pregion = region->next;
+            munmap((void *)region->address, HUGE_REGION_SIZE);
+            --nhuge_regions;
+            nhugetlb_regions -= region->hugetlb;
+            PyMem_RawFree(region);
+        }
+        return 1;
+    }
+    return 0;
+}
+#endif   /* ARENAS_USE_HUGE_PAGES */
+
 static void *
 _PyObject_ArenaMmap(void *ctx, size_t size)
 {
     void *ptr;
+#ifdef ARENAS_USE_HUGE_PAGES
+    if (huge_page_mode != PYMEM_HUGEPAGES_OFF &&
+        size <= HUGE_REGION_SIZE &&
+        HUGE_REGION_SIZE % size == 0 &&
+        HUGE_REGION_SIZE / size <= 32) {
+        ptr = huge_arena_alloc(size);
+        if (ptr != NULL)
+            return ptr;
+    }
+#endif
     ptr = mmap(NULL, size, PROT_READ|PROT_WRITE,
                MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
     if (ptr == MAP_FAILED)
         return NULL;
     assert(ptr != NULL);
+#ifdef ARENAS_USE_NUMA
+    if (numa_arena_node >= 0)
+        numa_bind(ptr, size, numa_arena_node);
+#endif
     return ptr;
 }
 
 static void
 _PyObject_ArenaMunmap(void *ctx, void *ptr, size_t size)
 {
+#ifdef ARENAS_USE_HUGE_PAGES
+    /* Arenas mapped before the mode was switched on are plain mappings. */
+    if (huge_regions != NULL && huge_arena_free(ptr))
+        return;
+#endif
     munmap(ptr, size);
 }
 
+#if defined(MADV_DONTNEED) || defined(MADV_FREE)
+/* Linux frees MADV_DONTNEED pages at once, which is what makes the resident
+   set size go down; elsewhere MADV_DONTNEED may be a mere hint, and
+   MADV_FREE is the call which lets the pages go.  Either way the range stays
+   mapped and reads as zeroes, or as its old contents, afterwards. */
+#  if defined(MADV_DONTNEED) && (defined(__linux__) || !defined(MADV_FREE))
+#    define ARENAS_MADV_RELEASE MADV_DONTNEED
+#  else
+#    define ARENAS_MADV_RELEASE MADV_FREE
+#  endif
+
+static size_t arenas_page_size = 0;
+
+/* Give the pages of [ptr, ptr+size) inside an arena back to the system.
+ * Only whole pages are released:  if the system page is larger than a
+ * pool, the partial pages at both ends are kept.  Return the number of
+ * bytes given back.
+ */
+static size_t
+_PyObject_ArenaMadvise(void *ptr, size_t size)
+{
+    void *start, *end;
+
+    if (arenas_page_size == 0) {
+#if defined(HAVE_SYSCONF) && defined(_SC_PAGESIZE)
+        long n = sysconf(_SC_PAGESIZE);
+        arenas_page_size = n > 0 ? (size_t)n : 4096;
+#else
+        arenas_page_size = 4096;
+#endif
+    }
+    start = _Py_ALIGN_UP(ptr, arenas_page_size);
+    end = _Py_ALIGN_DOWN((char *)ptr + size, arenas_page_size);
+    if ((char *)start >= (char *)end)
+        return 0;
+    if (madvise(start, (char *)end - (char *)start, ARENAS_MADV_RELEASE) < 0)
+        return 0;   /* e.g. EINVAL inside a MAP_HUGETLB region */
+    return (char *)end - (char *)start;
+}
+
+#define ARENAS_DEFAULT_FREE     _PyObject_ArenaMunmap
+#define ARENAS_RELEASE_PAGES    _PyObject_ArenaMadvise
+#endif
+
 #else
 static void *
 _PyObject_ArenaMalloc(void *ctx, size_t size)
@@ -278,6 +707,23 @@ PyObject_SetArenaAllocator(PyObjectArenaAllocator *allocator)
     _PyObject_Arena = *allocator;
 }
 
+int
+_PyObject_SetHugePageArenas(_PyObject_HugePageMode mode)
+{
+#ifdef ARENAS_USE_HUGE_PAGES
+    switch (mode) {
+    case PYMEM_HUGEPAGES_OFF:
+    case PYMEM_HUGEPAGES_THP:
+    case PYMEM_HUGEPAGES_HUGETLB:
+        huge_page_mode = mode;
+        return 0;
+    }
+    return -1;
+#else
+    return mode == PYMEM_HUGEPAGES_OFF ? 0 : -1;
+#endif
+}
+
 void *
 PyMem_RawMalloc(size_t size)
 {
@@ -488,8 +934,9 @@ static int running_on_valgrind = -1;
  * Requests greater than SMALL_REQUEST_THRESHOLD bytes are routed to the
  * system's allocator.
  *
- * Small requests are grouped in size classes spaced 8 bytes apart, due
- * to the required valid alignment of the returned address. Requests of
+ * Small requests are grouped in size classes spaced ALIGNMENT (8 or 16)
+ * bytes apart, due to the required valid alignment of the returned
+ * address. Requests of
  * a particular size are serviced from memory pools of 4K (one VMM page).
  * Pools are fragmented on demand and contain free lists of blocks of one
  * particular size class. In other words, there is a fixed-size allocator
@@ -521,6 +968,9 @@ static int running_on_valgrind = -1;
  *      497-504                 504                      62
  *      505-512                 512                      63
  *
+ * This is the table for the default 8-byte alignment and 512-byte threshold;
+ * with 16-byte alignment, each class covers 16 request sizes.
+ *
  *      0, SMALL_REQUEST_THRESHOLD + 1 and up: routed to the underlying
  *      allocator.
  */
@@ -537,10 +987,24 @@ static int running_on_valgrind = -1;
  * The alignment value is also used for grouping small requests in size
  * classes spaced ALIGNMENT bytes apart.
  *
+ * Objects holding a long double or SIMD vectors want 16 bytes:  build with
+ * -DPYMALLOC_ALIGNMENT=16 for that.  It halves the number of size classes,
+ * at the price of up to 8 more bytes wasted per block.
+ *
  * You shouldn't change this unless you know what you are doing.
  */
+#ifndef PYMALLOC_ALIGNMENT
+#define PYMALLOC_ALIGNMENT      8
+#endif
+#if PYMALLOC_ALIGNMENT == 8
 #define ALIGNMENT               8               /* must be 2^N */
 #define ALIGNMENT_SHIFT         3
+#elif PYMALLOC_ALIGNMENT == 16
+#define ALIGNMENT               16
+#define ALIGNMENT_SHIFT         4
+#else
+#error "PYMALLOC_ALIGNMENT must be 8 or 16"
+#endif
 
 /* Return the number of bytes in size class I, as a uint. */
 #define INDEX2SIZE(I) (((uint)(I) + 1) << ALIGNMENT_SHIFT)
@@ -551,17 +1015,30 @@ static int running_on_valgrind = -1;
  * this value according to your application behaviour and memory needs.
  *
  * Note: a size threshold of 512 guarantees that newly created dictionaries
- * will be allocated from preallocated memory pools on 64-bit.
+ * will be allocated from preallocated memory pools on 64-bit.  Build with
+ * -DPYMALLOC_SMALL_REQUEST_THRESHOLD=1024 to also serve the buffers of
+ * mid-sized lists, dicts and strings from the pools.
  *
  * The following invariants must hold:
- *      1) ALIGNMENT <= SMALL_REQUEST_THRESHOLD <= 512
+ *      1) ALIGNMENT <= SMALL_REQUEST_THRESHOLD <= 1024
  *      2) SMALL_REQUEST_THRESHOLD is evenly divisible by ALIGNMENT
+ *      3) there are at most 128 size classes
+ *
+ * A pool must hold at least two blocks of the largest class, and it can't be
+ * larger than a page (see Py_ADDRESS_IN_RANGE), hence the 1024 limit with
+ * 4K pages.
  *
  * Although not required, for better performance and space efficiency,
  * it is recommended that SMALL_REQUEST_THRESHOLD is set to a power of 2.
  */
-#define SMALL_REQUEST_THRESHOLD 512
+#ifndef PYMALLOC_SMALL_REQUEST_THRESHOLD
+#define PYMALLOC_SMALL_REQUEST_THRESHOLD        512
+#endif
+#define SMALL_REQUEST_THRESHOLD PYMALLOC_SMALL_REQUEST_THRESHOLD
 #define NB_SMALL_SIZE_CLASSES   (SMALL_REQUEST_THRESHOLD / ALIGNMENT)
+#if SMALL_REQUEST_THRESHOLD > 1024 || SMALL_REQUEST_THRESHOLD % ALIGNMENT != 0
+#error "PYMALLOC_SMALL_REQUEST_THRESHOLD must be a multiple of PYMALLOC_ALIGNMENT, at most 1024"
+#endif
 
 /*
  * The system's VMM page size can be obtained on most unices with a
@@ -611,6 +1088,35 @@ static int running_on_valgrind = -1;
 #define POOL_SIZE               SYSTEM_PAGE_SIZE        /* must be 2^N */
 #define POOL_SIZE_MASK          SYSTEM_PAGE_SIZE_MASK
 
+#define MAX_POOLS_IN_ARENA      (ARENA_SIZE / POOL_SIZE)
+
+/*
+ * Per-thread block caches (see "Per-thread block caches" below).  Each
+ * thread state keeps up to THREAD_CACHE_CLASS_BYTES worth of free blocks
+ * per size class, but never fewer than THREAD_CACHE_MIN_BLOCKS nor more
+ * than THREAD_CACHE_MAX_BLOCKS blocks.  Define PYMALLOC_NO_THREAD_CACHE
+ * to disable the caches.
+ */
+#ifndef PYMALLOC_NO_THREAD_CACHE
+#define PYMALLOC_THREAD_CACHE
+#endif
+#define THREAD_CACHE_CLASS_BYTES        POOL_SIZE
+#define THREAD_CACHE_MIN_BLOCKS         4
+#define THREAD_CACHE_MAX_BLOCKS         64
+
+/*
+ * Releasing empty pools (see "Released pools" below).  Every time
+ * POOL_RELEASE_INTERVAL pools have become empty, the memory of the empty
+ * pools cached by the arenas is given back to the system, except for the
+ * POOL_RELEASE_KEEP most recently emptied ones of each arena.  Define
+ * PYMALLOC_NO_RELEASE_POOLS to disable this.
+ */
+#if defined(ARENAS_RELEASE_PAGES) && !defined(PYMALLOC_NO_RELEASE_POOLS)
+#define PYMALLOC_RELEASE_POOLS
+#endif
+#define POOL_RELEASE_INTERVAL           1024
+#define POOL_RELEASE_KEEP               4
+
 /*
  * -- End of tunable settings section --
  */
@@ -695,9 +1201,24 @@ struct arena_object {
     /* The total number of pools in the arena, whether or not available. */
     uint ntotalpools;
 
+    /* The NUMA node the arena belongs to, as an index into arena_nodes. */
+    uint node;
+
     /* Singly-linked list of available pools. */
     struct pool_header* freepools;
 
+#ifdef PYMALLOC_RELEASE_POOLS
+    /* The number of pools in the freepools list. */
+    uint ncachedpools;
+
+    /* Pools whose memory was given back to the system, as a bitmap of pool
+     * indices (see POOL_INDEX).  They count in nfreepools but are linked to
+     * no list, since their headers are gone.
+     */
+    uint nreleasedpools;
+    uint releasedpools[(MAX_POOLS_IN_ARENA + 31) / 32];
+#endif
+
     /* Whenever this arena_object is not associated with an allocated
      * arena, the nextarena member is used to link all unassociated
      * arena_objects in the singly-linked `unused_arena_objects` list.
@@ -723,6 +1244,12 @@ struct arena_object {
 /* Round pointer P down to the closest pool-aligned address <= P, as a poolp */
 #define POOL_ADDR(P) ((poolp)_Py_ALIGN_DOWN((P), POOL_SIZE))
 
+/* Index of pool P within the arena described by AO, and back */
+#define POOL_INDEX(AO, P) ((uint)(((uptr)(P) - (AO)->address) / POOL_SIZE))
+#define INDEX_POOL(AO, I) \
+    ((poolp)((block *)_Py_ALIGN_UP((AO)->address, POOL_SIZE) + \
+             (uptr)(I) * POOL_SIZE))
+
 /* Return total number of blocks in pool of size index I, as a uint. */
 #define NUMBLOCKS(I) ((uint)(POOL_SIZE - POOL_OVERHEAD) / INDEX2SIZE(I))
 
@@ -853,7 +1380,31 @@ static poolp usedpools[2 * ((NB_SMALL_SIZE_CLASSES + 7) / 8) * 8] = {
 #if NB_SMALL_SIZE_CLASSES > 56
     , PT(56), PT(57), PT(58), PT(59), PT(60), PT(61), PT(62), PT(63)
 #if NB_SMALL_SIZE_CLASSES > 64
-#error "NB_SMALL_SIZE_CLASSES should be less than 64"
+    , PT(64), PT(65), PT(66), PT(67), PT(68), PT(69), PT(70), PT(71)
+#if NB_SMALL_SIZE_CLASSES > 72
+    , PT(72), PT(73), PT(74), PT(75), PT(76), PT(77), PT(78), PT(79)
+#if NB_SMALL_SIZE_CLASSES > 80
+    , PT(80), PT(81), PT(82), PT(83), PT(84), PT(85), PT(86), PT(87)
+#if NB_SMALL_SIZE_CLASSES > 88
+    , PT(88), PT(89), PT(90), PT(91), PT(92), PT(93), PT(94), PT(95)
+#if NB_SMALL_SIZE_CLASSES > 96
+    , PT(96), PT(97), PT(98), PT(99), PT(100), PT(101), PT(102), PT(103)
+#if NB_SMALL_SIZE_CLASSES > 104
+    , PT(104), PT(105), PT(106), PT(107), PT(108), PT(109), PT(110), PT(111)
+#if NB_SMALL_SIZE_CLASSES > 112
+    , PT(112), PT(113), PT(114), PT(115), PT(116), PT(117), PT(118), PT(119)
+#if NB_SMALL_SIZE_CLASSES > 120
+    , PT(120), PT(121), PT(122), PT(123), PT(124), PT(125), PT(126), PT(127)
+#if NB_SMALL_SIZE_CLASSES > 128
+#error "NB_SMALL_SIZE_CLASSES should be less than 128"
+#endif /* NB_SMALL_SIZE_CLASSES > 128 */
+#endif /* NB_SMALL_SIZE_CLASSES > 120 */
+#endif /* NB_SMALL_SIZE_CLASSES > 112 */
+#endif /* NB_SMALL_SIZE_CLASSES > 104 */
+#endif /* NB_SMALL_SIZE_CLASSES > 96 */
+#endif /* NB_SMALL_SIZE_CLASSES > 88 */
+#endif /* NB_SMALL_SIZE_CLASSES > 80 */
+#endif /* NB_SMALL_SIZE_CLASSES > 72 */
 #endif /* NB_SMALL_SIZE_CLASSES > 64 */
 #endif /* NB_SMALL_SIZE_CLASSES > 56 */
 #endif /* NB_SMALL_SIZE_CLASSES > 48 */
@@ -864,6 +1415,15 @@ static poolp usedpools[2 * ((NB_SMALL_SIZE_CLASSES + 7) / 8) * 8] = {
 #endif /* NB_SMALL_SIZE_CLASSES >  8 */
 };
 
+/* Number of used and full pools per size class.  Only pools change these,
+ * so _PyObject_GetMallocStats() can count blocks by visiting the used pools
+ * alone:  the full ones hold NUMBLOCKS() blocks each.
+ */
+static size_t npools_in_use[NB_SMALL_SIZE_CLASSES];
+#if NB_SMALL_SIZE_CLASSES > _PyObject_MAX_SIZE_CLASSES
+#error "_PyObject_MallocStats can't describe all the size classes"
+#endif
+
 /*==========================================================================
 Arena management.
 
@@ -909,10 +1469,86 @@ static uint maxarenas = 0;
  */
 static struct arena_object* unused_arena_objects = NULL;
 
-/* The head of the doubly-linked, NULL-terminated at each end, list of
- * arena_objects associated with arenas that have pools available.
- */
-static struct arena_object* usable_arenas = NULL;
+/*==========================================================================
+NUMA nodes.
+
+With NUMA arenas on (see _PyObject_SetNumaArenas()), every node of the machine
+has its own usable_arenas list and its own usedpools table, bundled in an
+arena_node.  An arena belongs to the node it was allocated for, and so do its
+pools.  A malloc is served from the node of the CPU the calling thread runs
+on, so that the thread gets memory local to it, while a free puts the block's
+pool back on the lists of the pool's own node.  The only blocks which cross
+nodes are those of thread caches:  a block freed by a thread of another node
+stays in that thread's cache until it is reused or drained.
+
+Otherwise arena_nodes[0] is the only node, and its lists are the usable_arenas
+and usedpools described above.  The other nodes keep their arenas when NUMA
+arenas are turned off again, and simply aren't allocated from anymore.
+*/
+
+struct arena_node {
+    /* The head of the doubly-linked, NULL-terminated at each end, list of
+     * arena_objects associated with arenas that have pools available.
+     */
+    struct arena_object* usable_arenas;
+
+    /* The pool table of the node, laid out like usedpools. */
+    poolp *usedpools;
+};
+
+/* List head of size class X in the pool table of arena_node AN */
+#define NODE_PTA(AN, x) \
+    ((poolp )((uchar *)&((AN)->usedpools[2*(x)]) - 2*sizeof(block *)))
+
+static struct arena_node arena_nodes[_PyObject_MAX_NUMA_NODES] = {
+    {NULL, usedpools}
+};
+/* Number of arena_nodes entries with a pool table */
+static uint narena_nodes = 1;
+/* Are allocations served from the caller's node? */
+static int numa_arenas = 0;
+
+/* Return the node to serve an allocation of the calling thread from. */
+static struct arena_node *
+arena_node_current(void)
+{
+#ifdef ARENAS_USE_NUMA
+    if (numa_arenas)
+        return &arena_nodes[numa_current_node()];
+#endif
+    return &arena_nodes[0];
+}
+
+int
+_PyObject_SetNumaArenas(int enable)
+{
+#ifdef ARENAS_USE_NUMA
+    uint i, j;
+
+    if (!enable) {
+        numa_arenas = 0;
+        return 0;
+    }
+    if (numa_nnodes == 0)
+        numa_nnodes = numa_probe();
+    for (i = narena_nodes; i < (uint)numa_nnodes; ++i) {
+        struct arena_node *an = &arena_nodes[i];
+
+        an->usedpools = (poolp *)PyMem_RawMalloc(sizeof(usedpools));
+        if (an->usedpools == NULL)
+            return -1;
+        for (j = 0; j < NB_SMALL_SIZE_CLASSES; ++j)
+            an->usedpools[j + j] = an->usedpools[j + j + 1] = NODE_PTA(an, j);
+        an->usable_arenas = NULL;
+        narena_nodes = i + 1;
+    }
+    /* A single node needs no bookkeeping. */
+    numa_arenas = numa_nnodes > 1;
+    return 0;
+#else
+    return enable ? -1 : 0;
+#endif
+}
 
 /* How many arena_objects do we initially allocate?
  * 16 = can allocate 16 arenas = 16 * ARENA_SIZE = 4MB before growing the
@@ -937,13 +1573,24 @@ _Py_GetAllocatedBlocks(void)
 }
 
 
-/* Allocate a new arena.  If we run out of memory, return NULL.  Else
- * allocate a new arena, and return the address of an arena_object
- * describing the new arena.  It's expected that the caller will set
- * `usable_arenas` to the return value.
+/* Return the new address of AO, a pointer into the `arenas` vector from
+ * before it was moved away from address OLD.
+ */
+static struct arena_object *
+arena_moved(struct arena_object *ao, uptr old)
+{
+    if (ao == NULL)
+        return NULL;
+    return &arenas[((uptr)ao - old) / sizeof(*arenas)];
+}
+
+/* Allocate a new arena for arena_nodes[NODE].  If we run out of memory,
+ * return NULL.  Else allocate a new arena, and return the address of an
+ * arena_object describing the new arena.  It's expected that the caller
+ * will set the node's `usable_arenas` to the return value.
  */
 static struct arena_object*
-new_arena(void)
+new_arena(uint node)
 {
     struct arena_object* arenaobj;
     uint excess;        /* number of bytes above pool alignment */
@@ -957,6 +1604,7 @@ new_arena(void)
         uint i;
         uint numarenas;
         size_t nbytes;
+        uptr oldarenas = (uptr)arenas;
 
         /* Double the number of arena objects on each allocation.
          * Note that it's possible for `numarenas` to overflow.
@@ -976,12 +1624,25 @@ new_arena(void)
 
         /* We might need to fix pointers that were copied.  However,
          * new_arena only gets called when all the pages in the
-         * previous arenas are full.  Thus, there are *no* pointers
-         * into the old array. Thus, we don't have to worry about
-         * invalid pointers.  Just to be sure, some asserts:
+         * previous arenas of the node are full.  Thus, with a single
+         * node, there are *no* pointers into the old array.  With
+         * several, the lists of the other nodes must be moved along.
          */
-        assert(usable_arenas == NULL);
+        assert(arena_nodes[node].usable_arenas == NULL);
         assert(unused_arena_objects == NULL);
+        if ((uptr)arenas != oldarenas && narena_nodes > 1) {
+            for (i = 0; i < narena_nodes; ++i)
+                arena_nodes[i].usable_arenas =
+                    arena_moved(arena_nodes[i].usable_arenas, oldarenas);
+            for (i = 0; i < maxarenas; ++i) {
+                if (arenas[i].address == 0 || arenas[i].nfreepools == 0)
+                    continue;
+                arenas[i].nextarena =
+                    arena_moved(arenas[i].nextarena, oldarenas);
+                arenas[i].prevarena =
+                    arena_moved(arenas[i].prevarena, oldarenas);
+            }
+        }
 
         /* Put the new arenas on the unused_arena_objects list. */
         for (i = maxarenas; i < numarenas; ++i) {
@@ -1000,7 +1661,13 @@ new_arena(void)
     arenaobj = unused_arena_objects;
     unused_arena_objects = arenaobj->nextarena;
     assert(arenaobj->address == 0);
+#ifdef ARENAS_USE_NUMA
+    numa_arena_node = numa_arenas ? (int)node : -1;
+#endif
     address = _PyObject_Arena.alloc(_PyObject_Arena.ctx, ARENA_SIZE);
+#ifdef ARENAS_USE_NUMA
+    numa_arena_node = -1;
+#endif
     if (address == NULL) {
         /* The allocation failed: return NULL after putting the
          * arenaobj back.
@@ -1027,6 +1694,12 @@ new_arena(void)
         arenaobj->pool_address += POOL_SIZE - excess;
     }
     arenaobj->ntotalpools = arenaobj->nfreepools;
+    arenaobj->node = node;
+#ifdef PYMALLOC_RELEASE_POOLS
+    arenaobj->ncachedpools = 0;
+    arenaobj->nreleasedpools = 0;
+    memset(arenaobj->releasedpools, 0, sizeof(arenaobj->releasedpools));
+#endif
 
     return arenaobj;
 }
@@ -1152,211 +1825,864 @@ int Py_ADDRESS_IN_RANGE(void *P, poolp pool) Py_NO_INLINE;
 
 /*==========================================================================*/
 
-/* malloc.  Note that nbytes==0 tries to return a non-NULL pointer, distinct
- * from all other currently live pointers.  This may not be possible.
- */
+#ifdef PYMALLOC_RELEASE_POOLS
+/*==========================================================================
+Released pools.
+
+An arena is only given back to the system when all of its pools are empty,
+so a handful of long-lived objects can pin most of the arenas reached during
+a load spike.  The empty pools of such arenas are released instead:  their
+pages are handed back with madvise() (VirtualAlloc(MEM_RESET) on Windows),
+except for the few most recently emptied ones of each arena, which are the
+likeliest to be wanted again.
+
+Releasing is deferred and done for all the arenas at once, every
+POOL_RELEASE_INTERVAL emptied pools.  Under allocation churn, arenas are
+emptied and freed entirely all the time, and releasing their pools one by
+one just before munmap() would be wasted system calls.
+
+A released pool stays mapped, so Py_ADDRESS_IN_RANGE is unaffected, but its
+contents are lost, header included.  It is therefore taken off the freepools
+list and recorded in the arena's releasedpools bitmap.  When an arena has
+neither cached pools nor virgin space left, a released pool is set up afresh
+like a newly carved one, and the system faults its pages back in on demand.
+
+Only arenas from the default arena allocator are released:  a custom one may
+hand out memory which doesn't like madvise().
+*/
 
-/*
- * The basic blocks are ordered by decreasing execution frequency,
- * which minimizes the number of jumps in the most common cases,
- * improves branching prediction and instruction scheduling (small
- * block allocations typically result in a couple of instructions).
- * Unless the optimizer reorders everything, being too smart...
+/* Number of pools emptied since the last release */
+static uint npools_emptied = 0;
+/* Total number of bytes given back to the system */
+static size_t released_bytes = 0;
+/* Number of times a released pool was used again */
+static size_t nreleased_pools_reused = 0;
+
+/* Release the cached pools of arena AO, except the POOL_RELEASE_KEEP ones at
+ * the head of its freepools list.
  */
+static void
+release_cached_pools(struct arena_object *ao)
+{
+    uint newly[(MAX_POOLS_IN_ARENA + 31) / 32];
+    poolp pool, last;
+    uint i, j, n;
 
-static void *
-_PyObject_Alloc(int use_calloc, void *ctx, size_t nelem, size_t elsize)
+    if (ao->ncachedpools <= POOL_RELEASE_KEEP)
+        return;
+    memset(newly, 0, sizeof(newly));
+    last = ao->freepools;
+    for (n = 1; n < POOL_RELEASE_KEEP; ++n)
+        last = last->nextpool;
+    pool = last->nextpool;
+    last->nextpool = NULL;
+    for (n = 0; pool != NULL; ++n, pool = pool->nextpool) {
+        i = POOL_INDEX(ao, pool);
+        newly[i / 32] |= 1U << (i % 32);
+    }
+    assert(n == ao->ncachedpools - POOL_RELEASE_KEEP);
+    ao->ncachedpools -= n;
+    ao->nreleasedpools += n;
+
+    /* Release runs of adjacent pools with one call each. */
+    for (i = 0; i < ao->ntotalpools; i = j) {
+        if (!(newly[i / 32] & (1U << (i % 32)))) {
+            j = i + 1;
+            continue;
+        }
+        for (j = i; j < ao->ntotalpools && newly[j / 32] & (1U << (j % 32)); ++j)
+            ao->releasedpools[j / 32] |= 1U << (j % 32);
+        released_bytes += ARENAS_RELEASE_PAGES(INDEX_POOL(ao, i),
+                                               (size_t)(j - i) * POOL_SIZE);
+    }
+}
+
+/* Release the cached pools of all the arenas. */
+static void
+release_free_pools(void)
 {
-    size_t nbytes;
-    block *bp;
-    poolp pool;
-    poolp next;
-    uint size;
+    uint i;
 
-    _Py_AllocatedBlocks++;
+    npools_emptied = 0;
+    if (_PyObject_Arena.free != ARENAS_DEFAULT_FREE)
+        return;
+    for (i = 0; i < maxarenas; ++i) {
+        if (arenas[i].address != 0)
+            release_cached_pools(&arenas[i]);
+    }
+}
 
-    assert(nelem <= PY_SSIZE_T_MAX / elsize);
-    nbytes = nelem * elsize;
+/* Take a released pool from arena AO, which must have one. */
+static poolp
+reuse_released_pool(struct arena_object *ao)
+{
+    uint i, k;
+
+    assert(ao->nreleasedpools > 0);
+    for (k = 0; ao->releasedpools[k] == 0; ++k)
+        assert(k < (MAX_POOLS_IN_ARENA + 31) / 32 - 1);
+    for (i = 0; !(ao->releasedpools[k] & (1U << i)); ++i)
+        ;
+    ao->releasedpools[k] &= ~(1U << i);
+    --ao->nreleasedpools;
+    ++nreleased_pools_reused;
+    return INDEX_POOL(ao, k * 32 + i);
+}
 
-#ifdef WITH_VALGRIND
-    if (UNLIKELY(running_on_valgrind == -1))
-        running_on_valgrind = RUNNING_ON_VALGRIND;
-    if (UNLIKELY(running_on_valgrind))
-        goto redirect;
-#endif
+#endif   /* PYMALLOC_RELEASE_POOLS */
 
-    if (nelem == 0 || elsize == 0)
-        goto redirect;
+/*==========================================================================*/
 
-    if ((nbytes - 1) < SMALL_REQUEST_THRESHOLD) {
-        LOCK();
-        /*
-         * Most frequent paths first
-         */
-        size = (uint)(nbytes - 1) >> ALIGNMENT_SHIFT;
-        pool = usedpools[size + size];
-        if (pool != pool->nextpool) {
-            /*
-             * There is a used pool for this size class.
-             * Pick up the head block of its free list.
-             */
-            ++pool->ref.count;
-            bp = pool->freeblock;
-            assert(bp != NULL);
-            if ((pool->freeblock = *(block **)bp) != NULL) {
-                UNLOCK();
-                if (use_calloc)
-                    memset(bp, 0, nbytes);
-                return (void *)bp;
+/* Take an empty pool from the arenas, allocating a new arena if needed,
+ * and return it with its arenaindex set.  If the pool was cached, its szidx
+ * and free list are those of its last use, otherwise szidx is
+ * DUMMY_SIZE_IDX.  Returns NULL if no arena could be obtained.  The caller
+ * holds the lock.
+ */
+static poolp
+pool_take_free(struct arena_node *an)
+{
+    poolp pool;
+
+    if (an->usable_arenas == NULL) {
+        /* No arena has a free pool:  allocate a new arena. */
+#ifdef WITH_MEMORY_LIMITS
+        if (narenas_currently_allocated >= MAX_ARENAS)
+            return NULL;
+#endif
+        an->usable_arenas = new_arena((uint)(an - arena_nodes));
+        if (an->usable_arenas == NULL)
+            return NULL;
+        an->usable_arenas->nextarena =
+            an->usable_arenas->prevarena = NULL;
+    }
+    assert(an->usable_arenas->address != 0);
+
+    /* Try to get a cached free pool. */
+    pool = an->usable_arenas->freepools;
+    if (pool != NULL) {
+        /* Unlink from cached pools. */
+        an->usable_arenas->freepools = pool->nextpool;
+#ifdef PYMALLOC_RELEASE_POOLS
+        --an->usable_arenas->ncachedpools;
+#endif
+
+        /* This arena already had the smallest nfreepools
+         * value, so decreasing nfreepools doesn't change
+         * that, and we don't need to rearrange the
+         * usable_arenas list.  However, if the arena has
+         * become wholly allocated, we need to remove its
+         * arena_object from usable_arenas.
+         */
+        --an->usable_arenas->nfreepools;
+        if (an->usable_arenas->nfreepools == 0) {
+            /* Wholly allocated:  remove. */
+            assert(an->usable_arenas->freepools == NULL);
+            assert(an->usable_arenas->nextarena == NULL ||
+                   an->usable_arenas->nextarena->prevarena ==
+                   an->usable_arenas);
+
+            an->usable_arenas = an->usable_arenas->nextarena;
+            if (an->usable_arenas != NULL) {
+                an->usable_arenas->prevarena = NULL;
+                assert(an->usable_arenas->address != 0);
             }
-            /*
-             * Reached the end of the free list, try to extend it.
+        }
+        else {
+            /* nfreepools > 0:  it must be that freepools
+             * isn't NULL, or that we haven't yet carved
+             * off all the arena's pools for the first
+             * time.
              */
-            if (pool->nextoffset <= pool->maxnextoffset) {
-                /* There is room for another block. */
-                pool->freeblock = (block*)pool +
-                                  pool->nextoffset;
-                pool->nextoffset += INDEX2SIZE(size);
-                *(block **)(pool->freeblock) = NULL;
-                UNLOCK();
-                if (use_calloc)
-                    memset(bp, 0, nbytes);
-                return (void *)bp;
-            }
-            /* Pool is full, unlink from used pools. */
-            next = pool->nextpool;
-            pool = pool->prevpool;
-            next->prevpool = pool;
-            pool->nextpool = next;
+            assert(an->usable_arenas->freepools != NULL ||
+                   an->usable_arenas->pool_address <=
+                   (block*)an->usable_arenas->address +
+                       ARENA_SIZE - POOL_SIZE
+#ifdef PYMALLOC_RELEASE_POOLS
+                   || an->usable_arenas->nreleasedpools > 0
+#endif
+                   );
+        }
+        return pool;
+    }
+
+    /* Carve off a new pool. */
+    assert(an->usable_arenas->nfreepools > 0);
+    assert(an->usable_arenas->freepools == NULL);
+#ifdef PYMALLOC_RELEASE_POOLS
+    if (an->usable_arenas->pool_address >
+            (block*)an->usable_arenas->address + ARENA_SIZE - POOL_SIZE) {
+        /* All the pools were carved off already:  bring back a
+         * released one.  Its header is initialized from scratch.
+         */
+        pool = reuse_released_pool(an->usable_arenas);
+    }
+    else
+#endif
+    {
+        pool = (poolp)an->usable_arenas->pool_address;
+        assert((block*)pool <= (block*)an->usable_arenas->address +
+                               ARENA_SIZE - POOL_SIZE);
+        an->usable_arenas->pool_address += POOL_SIZE;
+    }
+    pool->arenaindex = (uint)(an->usable_arenas - arenas);
+    assert(&arenas[pool->arenaindex] == an->usable_arenas);
+    pool->szidx = DUMMY_SIZE_IDX;
+    --an->usable_arenas->nfreepools;
+
+    if (an->usable_arenas->nfreepools == 0) {
+        assert(an->usable_arenas->nextarena == NULL ||
+               an->usable_arenas->nextarena->prevarena ==
+               an->usable_arenas);
+        /* Unlink the arena:  it is completely allocated. */
+        an->usable_arenas = an->usable_arenas->nextarena;
+        if (an->usable_arenas != NULL) {
+            an->usable_arenas->prevarena = NULL;
+            assert(an->usable_arenas->address != 0);
+        }
+    }
+
+    return pool;
+}
+
+/* Take one block of size class SIZE from the shared pools.  Returns NULL if
+ * no arena could be obtained; the caller then redirects the request to the
+ * underlying allocator.
+ *
+ * The basic blocks are ordered by decreasing execution frequency,
+ * which minimizes the number of jumps in the most common cases,
+ * improves branching prediction and instruction scheduling (small
+ * block allocations typically result in a couple of instructions).
+ * Unless the optimizer reorders everything, being too smart...
+ */
+
+static block *
+pool_alloc_block(struct arena_node *an, uint size)
+{
+    block *bp;
+    poolp pool;
+    poolp next;
+
+    LOCK();
+    /*
+     * Most frequent paths first
+     */
+    pool = an->usedpools[size + size];
+    if (pool != pool->nextpool) {
+        /*
+         * There is a used pool for this size class.
+         * Pick up the head block of its free list.
+         */
+        ++pool->ref.count;
+        bp = pool->freeblock;
+        assert(bp != NULL);
+        if ((pool->freeblock = *(block **)bp) != NULL) {
             UNLOCK();
-            if (use_calloc)
-                memset(bp, 0, nbytes);
-            return (void *)bp;
+            return bp;
         }
+        /*
+         * Reached the end of the free list, try to extend it.
+         */
+        if (pool->nextoffset <= pool->maxnextoffset) {
+            /* There is room for another block. */
+            pool->freeblock = (block*)pool +
+                              pool->nextoffset;
+            pool->nextoffset += INDEX2SIZE(size);
+            *(block **)(pool->freeblock) = NULL;
+            UNLOCK();
+            return bp;
+        }
+        /* Pool is full, unlink from used pools. */
+        next = pool->nextpool;
+        pool = pool->prevpool;
+        next->prevpool = pool;
+        pool->nextpool = next;
+        UNLOCK();
+        return bp;
+    }
 
-        /* There isn't a pool of the right size class immediately
-         * available:  use a free pool.
+    /* There isn't a pool of the right size class immediately
+     * available:  use a free pool.
+     */
+    pool = pool_take_free(an);
+    if (pool == NULL) {
+        UNLOCK();
+        return NULL;
+    }
+
+    /* Frontlink to used pools. */
+    next = an->usedpools[size + size]; /* == prev */
+    pool->nextpool = next;
+    pool->prevpool = next;
+    next->nextpool = pool;
+    next->prevpool = pool;
+    pool->ref.count = 1;
+    ++npools_in_use[size];
+    if (pool->szidx == size) {
+        /* Luckily, this pool last contained blocks
+         * of the same size class, so its header
+         * and free list are already initialized.
          */
-        if (usable_arenas == NULL) {
-            /* No arena has a free pool:  allocate a new arena. */
-#ifdef WITH_MEMORY_LIMITS
-            if (narenas_currently_allocated >= MAX_ARENAS) {
-                UNLOCK();
-                goto redirect;
-            }
+        bp = pool->freeblock;
+        assert(bp != NULL);
+        pool->freeblock = *(block **)bp;
+        UNLOCK();
+        return bp;
+    }
+    /*
+     * Initialize the pool header, set up the free list to
+     * contain just the second block, and return the first
+     * block.
+     */
+    pool->szidx = size;
+    size = INDEX2SIZE(size);
+    bp = (block *)pool + POOL_OVERHEAD;
+    pool->nextoffset = POOL_OVERHEAD + (size << 1);
+    pool->maxnextoffset = POOL_SIZE - size;
+    pool->freeblock = bp + size;
+    *(block **)(pool->freeblock) = NULL;
+    UNLOCK();
+    return bp;
+}
+
+/* Give the empty POOL back to its arena, and do the arena management this
+ * entails.  The pool must be on no list.  The caller holds the lock.
+ */
+static void
+pool_return(poolp pool)
+{
+    struct arena_object* ao;
+    struct arena_node *an;
+    uint nf;  /* ao->nfreepools */
+
+    /* Link the pool to freepools.  This is a singly-linked
+     * list, and pool->prevpool isn't used there.
+     */
+    ao = &arenas[pool->arenaindex];
+    an = &arena_nodes[ao->node];
+    pool->nextpool = ao->freepools;
+    ao->freepools = pool;
+    nf = ++ao->nfreepools;
+#ifdef PYMALLOC_RELEASE_POOLS
+    ++ao->ncachedpools;
 #endif
-            usable_arenas = new_arena();
-            if (usable_arenas == NULL) {
-                UNLOCK();
-                goto redirect;
-            }
-            usable_arenas->nextarena =
-                usable_arenas->prevarena = NULL;
+
+    /* All the rest is arena management.  We just freed
+     * a pool, and there are 4 cases for arena mgmt:
+     * 1. If all the pools are free, return the arena to
+     *    the system free().
+     * 2. If this is the only free pool in the arena,
+     *    add the arena back to the `usable_arenas` list.
+     * 3. If the "next" arena has a smaller count of free
+     *    pools, we have to "slide this arena right" to
+     *    restore that usable_arenas is sorted in order of
+     *    nfreepools.
+     * 4. Else there's nothing more to do.
+     */
+    if (nf == ao->ntotalpools) {
+        /* Case 1.  First unlink ao from usable_arenas.
+         */
+        assert(ao->prevarena == NULL ||
+               ao->prevarena->address != 0);
+        assert(ao ->nextarena == NULL ||
+               ao->nextarena->address != 0);
+
+        /* Fix the pointer in the prevarena, or the
+         * usable_arenas pointer.
+         */
+        if (ao->prevarena == NULL) {
+            an->usable_arenas = ao->nextarena;
+            assert(an->usable_arenas == NULL ||
+                   an->usable_arenas->address != 0);
         }
-        assert(usable_arenas->address != 0);
-
-        /* Try to get a cached free pool. */
-        pool = usable_arenas->freepools;
-        if (pool != NULL) {
-            /* Unlink from cached pools. */
-            usable_arenas->freepools = pool->nextpool;
-
-            /* This arena already had the smallest nfreepools
-             * value, so decreasing nfreepools doesn't change
-             * that, and we don't need to rearrange the
-             * usable_arenas list.  However, if the arena has
-             * become wholly allocated, we need to remove its
-             * arena_object from usable_arenas.
-             */
-            --usable_arenas->nfreepools;
-            if (usable_arenas->nfreepools == 0) {
-                /* Wholly allocated:  remove. */
-                assert(usable_arenas->freepools == NULL);
-                assert(usable_arenas->nextarena == NULL ||
-                       usable_arenas->nextarena->prevarena ==
-                       usable_arenas);
-
-                usable_arenas = usable_arenas->nextarena;
-                if (usable_arenas != NULL) {
-                    usable_arenas->prevarena = NULL;
-                    assert(usable_arenas->address != 0);
-                }
+        else {
+            assert(ao->prevarena->nextarena == ao);
+            ao->prevarena->nextarena =
+                ao->nextarena;
+        }
+        /* Fix the pointer in the nextarena. */
+        if (ao->nextarena != NULL) {
+            assert(ao->nextarena->prevarena == ao);
+            ao->nextarena->prevarena =
+                ao->prevarena;
+        }
+        /* Record that this arena_object slot is
+         * available to be reused.
+         */
+        ao->nextarena = unused_arena_objects;
+        unused_arena_objects = ao;
+
+        /* Free the entire arena. */
+        _PyObject_Arena.free(_PyObject_Arena.ctx,
+                             (void *)ao->address, ARENA_SIZE);
+        ao->address = 0;                        /* mark unassociated */
+        --narenas_currently_allocated;
+        return;
+    }
+#ifdef PYMALLOC_RELEASE_POOLS
+    /* The arena stays:  maybe give empty pools back. */
+    if (++npools_emptied >= POOL_RELEASE_INTERVAL)
+        release_free_pools();
+#endif
+    if (nf == 1) {
+        /* Case 2.  Put ao at the head of
+         * usable_arenas.  Note that because
+         * ao->nfreepools was 0 before, ao isn't
+         * currently on the usable_arenas list.
+         */
+        ao->nextarena = an->usable_arenas;
+        ao->prevarena = NULL;
+        if (an->usable_arenas)
+            an->usable_arenas->prevarena = ao;
+        an->usable_arenas = ao;
+        assert(an->usable_arenas->address != 0);
+        return;
+    }
+    /* If this arena is now out of order, we need to keep
+     * the list sorted.  The list is kept sorted so that
+     * the "most full" arenas are used first, which allows
+     * the nearly empty arenas to be completely freed.  In
+     * a few un-scientific tests, it seems like this
+     * approach allowed a lot more memory to be freed.
+     */
+    if (ao->nextarena == NULL ||
+                 nf <= ao->nextarena->nfreepools) {
+        /* Case 4.  Nothing to do. */
+        return;
+    }
+    /* Case 3:  We have to move the arena towards the end
+     * of the list, because it has more free pools than
+     * the arena to its right.
+     * First unlink ao from usable_arenas.
+     */
+    if (ao->prevarena != NULL) {
+        /* ao isn't at the head of the list */
+        assert(ao->prevarena->nextarena == ao);
+        ao->prevarena->nextarena = ao->nextarena;
+    }
+    else {
+        /* ao is at the head of the list */
+        assert(an->usable_arenas == ao);
+        an->usable_arenas = ao->nextarena;
+    }
+    ao->nextarena->prevarena = ao->prevarena;
+
+    /* Locate the new insertion point by iterating over
+     * the list, using our nextarena pointer.
+     */
+    while (ao->nextarena != NULL &&
+                    nf > ao->nextarena->nfreepools) {
+        ao->prevarena = ao->nextarena;
+        ao->nextarena = ao->nextarena->nextarena;
+    }
+
+    /* Insert ao at this point. */
+    assert(ao->nextarena == NULL ||
+        ao->prevarena == ao->nextarena->prevarena);
+    assert(ao->prevarena->nextarena == ao->nextarena);
+
+    ao->prevarena->nextarena = ao;
+    if (ao->nextarena != NULL)
+        ao->nextarena->prevarena = ao;
+
+    /* Verify that the swaps worked. */
+    assert(ao->nextarena == NULL ||
+              nf <= ao->nextarena->nfreepools);
+    assert(ao->prevarena == NULL ||
+              nf > ao->prevarena->nfreepools);
+    assert(ao->nextarena == NULL ||
+        ao->nextarena->prevarena == ao);
+    assert((an->usable_arenas == ao &&
+        ao->prevarena == NULL) ||
+        ao->prevarena->nextarena == ao);
+}
+
+/* Give block P back to POOL, which must be POOL_ADDR(P) and must be
+ * controlled by obmalloc.
+ */
+static void
+pool_free_block(poolp pool, block *p)
+{
+    block *lastfree;
+    poolp next, prev;
+    uint size;
+
+    LOCK();
+    /* Link p to the start of the pool's freeblock list.  Since
+     * the pool had at least the p block outstanding, the pool
+     * wasn't empty (so it's already in a usedpools[] list, or
+     * was full and is in no list -- it's not in the freeblocks
+     * list in any case).
+     */
+    assert(pool->ref.count > 0);            /* else it was empty */
+    *(block **)p = lastfree = pool->freeblock;
+    pool->freeblock = (block *)p;
+    if (lastfree) {
+        /* freeblock wasn't NULL, so the pool wasn't full,
+         * and the pool is in a usedpools[] list.
+         */
+        if (--pool->ref.count != 0) {
+            /* pool isn't empty:  leave it in usedpools */
+            UNLOCK();
+            return;
+        }
+        /* Pool is now empty:  unlink from usedpools, and
+         * link to the front of freepools.  This ensures that
+         * previously freed pools will be allocated later
+         * (being not referenced, they are perhaps paged out).
+         */
+        --npools_in_use[pool->szidx];
+        next = pool->nextpool;
+        prev = pool->prevpool;
+        next->prevpool = prev;
+        prev->nextpool = next;
+
+        pool_return(pool);
+        UNLOCK();
+        return;
+    }
+    /* Pool was full, so doesn't currently live in any list:
+     * link it to the front of the appropriate usedpools[] list.
+     * This mimics LRU pool usage for new allocations and
+     * targets optimal filling when several pools contain
+     * blocks of the same size class.
+     * Except if the pool belongs to an emptier arena than the pool
+     * allocations are served from:  then it goes to the back, so
+     * that allocations keep going to the fullest arenas and the
+     * emptier ones get a chance to drain.
+     */
+    --pool->ref.count;
+    assert(pool->ref.count > 0);            /* else the pool is empty */
+    size = pool->szidx;
+    next = arena_nodes[arenas[pool->arenaindex].node].usedpools[size + size];
+    if (next != next->nextpool &&
+        arenas[pool->arenaindex].nfreepools >
+        arenas[next->arenaindex].nfreepools)
+        next = next->prevpool;          /* the list head */
+    prev = next->prevpool;
+    /* insert pool before next:   prev <-> pool <-> next */
+    pool->nextpool = next;
+    pool->prevpool = prev;
+    next->prevpool = pool;
+    prev->nextpool = pool;
+    UNLOCK();
+}
+
+#ifdef PYMALLOC_THREAD_CACHE
+/*==========================================================================
+Per-thread block caches.
+
+Each thread state owns a small cache of free blocks per size class, stored as
+singly-linked lists threaded through the blocks themselves (exactly like a
+pool's freeblock list).  A malloc first pops from the calling thread's list
+and a free pushes onto it, so the common alloc/free pair never looks at
+usedpools[] or the arena lists.  Only when a list runs dry is it refilled
+with a batch of blocks from the shared pools, and only when it overflows is
+half of it drained back.
+
+Blocks sitting in a thread cache are still "allocated" as far as their pools
+are concerned (they're counted in pool->ref.count), so a cache can keep a
+pool, and so an arena, alive.  The per-class limit bounds that to roughly
+THREAD_CACHE_CLASS_BYTES of memory per size class and thread.  The caches
+are emptied when their thread state is cleared.
+*/
+
+struct _obmalloc_tcache {
+    block *freeblocks[NB_SMALL_SIZE_CLASSES];   /* per-class free lists */
+    uint nblocks[NB_SMALL_SIZE_CLASSES];        /* length of each list  */
+
+    /* Statistics, reported by _PyObject_DebugMallocStats(). */
+    size_t alloc_hits;          /* mallocs served from the cache */
+    size_t alloc_misses;        /* mallocs that had to refill it */
+    size_t free_hits;           /* frees kept in the cache */
+    size_t free_misses;         /* frees that had to drain it */
+};
+
+/* Maximum number of blocks cached for size class I, as a uint. */
+#define THREAD_CACHE_LIMIT(I)                                           \
+    (THREAD_CACHE_CLASS_BYTES / INDEX2SIZE(I) > THREAD_CACHE_MAX_BLOCKS ? \
+     THREAD_CACHE_MAX_BLOCKS :                                          \
+     THREAD_CACHE_CLASS_BYTES / INDEX2SIZE(I) < THREAD_CACHE_MIN_BLOCKS ? \
+     THREAD_CACHE_MIN_BLOCKS : THREAD_CACHE_CLASS_BYTES / INDEX2SIZE(I))
+
+/* Return the block cache of TSTATE, the current thread state, creating it
+ * if needed.  Returns
+ * NULL when there is no current thread state (or no memory for the cache),
+ * in which case the caller goes straight to the shared pools.
+ */
+static struct _obmalloc_tcache *
+tcache_get(PyThreadState *tstate)
+{
+    struct _obmalloc_tcache *tc;
+
+    if (tstate == NULL)
+        return NULL;
+    tc = tstate->obmalloc_tcache;
+    if (tc == NULL) {
+        tc = (struct _obmalloc_tcache *)PyMem_RawCalloc(1, sizeof(*tc));
+        tstate->obmalloc_tcache = tc;
+    }
+    return tc;
+}
+
+/* The list for size class SIZE is empty: move a batch of blocks from the
+ * shared pools into it and return one more block for the caller.
+ */
+static block *
+tcache_refill(struct _obmalloc_tcache *tc, uint size)
+{
+    block *bp, *extra;
+    uint n = THREAD_CACHE_LIMIT(size) / 2;
+    struct arena_node *an = arena_node_current();
+
+    assert(tc->freeblocks[size] == NULL && tc->nblocks[size] == 0);
+    bp = pool_alloc_block(an, size);
+    if (bp == NULL)
+        return NULL;
+    while (n-- > 0) {
+        extra = pool_alloc_block(an, size);
+        if (extra == NULL)
+            break;
+        *(block **)extra = tc->freeblocks[size];
+        tc->freeblocks[size] = extra;
+        tc->nblocks[size]++;
+    }
+    return bp;
+}
+
+/* Give up to N blocks of size class SIZE back to their pools. */
+static void
+tcache_drain(struct _obmalloc_tcache *tc, uint size, uint n)
+{
+    block *bp;
+
+    while (n-- > 0 && (bp = tc->freeblocks[size]) != NULL) {
+        tc->freeblocks[size] = *(block **)bp;
+        tc->nblocks[size]--;
+        pool_free_block(POOL_ADDR(bp), bp);
+    }
+}
+
+void
+_PyObject_ClearThreadCache(PyThreadState *tstate)
+{
+    struct _obmalloc_tcache *tc = tstate->obmalloc_tcache;
+    uint i;
+
+    if (tc == NULL)
+        return;
+    tstate->obmalloc_tcache = NULL;
+    for (i = 0; i < NB_SMALL_SIZE_CLASSES; i++)
+        tcache_drain(tc, i, tc->nblocks[i]);
+    PyMem_RawFree(tc);
+}
+
+#else   /* !PYMALLOC_THREAD_CACHE */
+
+void
+_PyObject_ClearThreadCache(PyThreadState *tstate)
+{
+}
+
+#endif  /* PYMALLOC_THREAD_CACHE */
+
+/*==========================================================================
+Object regions.
+
+Between _PyObject_RegionBegin() and _PyObject_RegionEnd(), the small blocks
+a thread allocates don't come from the pools of their size class but are
+carved, one after the other, from pools owned by the region:  an allocation
+bumps an offset, and a free decrements the count of live blocks of the pool.
+Freed blocks are not reused, except that the pool being carved starts over
+when it becomes empty, so temporary objects keep hitting the same memory.
+
+When the region ends, its pools without live blocks go back to their arenas
+in one sweep.  Objects which escaped the region keep their pool alive:  the
+pool is detached from the region (its freeblock, which points to the owning
+region, is cleared) and given back by the free of its last block.
+
+Region pools are ordinary pools as far as arenas and Py_ADDRESS_IN_RANGE are
+concerned.  They are told apart by their szidx, REGION_SIZE_IDX, and as the
+size of their blocks isn't recorded, realloc() copies up to the carving
+point of the pool.
+*/
+
+#define REGION_SIZE_IDX         0xfffe
+
+struct _PyObjectRegion {
+    struct _PyObjectRegion *outer;      /* enclosing region of the thread */
+    poolp pools;        /* doubly-linked, the pool being carved first */
+};
+
+/* Number of pools owned by regions, ended or not */
+static size_t nregion_pools = 0;
+/* Number of pools kept alive by escaped objects when their region ended */
+static size_t nregion_pools_escaped = 0;
+
+/* Carve a block of NBYTES bytes from REGION.  Returns NULL if no pool
+ * could be obtained.
+ */
+static block *
+region_alloc_block(struct _PyObjectRegion *region, size_t nbytes)
+{
+    poolp pool = region->pools;
+    block *bp;
+
+    nbytes = _Py_SIZE_ROUND_UP(nbytes, ALIGNMENT);
+    if (pool == NULL || pool->nextoffset + nbytes > POOL_SIZE) {
+        LOCK();
+        pool = pool_take_free(arena_node_current());
+        UNLOCK();
+        if (pool == NULL)
+            return NULL;
+        pool->szidx = REGION_SIZE_IDX;
+        pool->ref.count = 0;
+        pool->freeblock = (block *)region;
+        pool->nextoffset = POOL_OVERHEAD;
+        pool->maxnextoffset = POOL_SIZE;
+        pool->prevpool = NULL;
+        pool->nextpool = region->pools;
+        if (region->pools != NULL)
+            region->pools->prevpool = pool;
+        region->pools = pool;
+        ++nregion_pools;
+    }
+    bp = (block *)pool + pool->nextoffset;
+    pool->nextoffset += (uint)nbytes;
+    ++pool->ref.count;
+    return bp;
+}
+
+/* A block of region pool POOL was freed. */
+static void
+region_free_block(poolp pool)
+{
+    struct _PyObjectRegion *region;
+
+    assert(pool->ref.count > 0);
+    if (--pool->ref.count != 0)
+        return;
+    region = (struct _PyObjectRegion *)pool->freeblock;
+    if (region != NULL) {
+        if (pool == region->pools) {
+            /* The pool being carved:  start it over. */
+            pool->nextoffset = POOL_OVERHEAD;
+            return;
+        }
+        assert(pool->prevpool != NULL);
+        pool->prevpool->nextpool = pool->nextpool;
+        if (pool->nextpool != NULL)
+            pool->nextpool->prevpool = pool->prevpool;
+    }
+    --nregion_pools;
+    pool->szidx = DUMMY_SIZE_IDX;
+    LOCK();
+    pool_return(pool);
+    UNLOCK();
+}
+
+_PyObjectRegion *
+_PyObject_RegionBegin(void)
+{
+    PyThreadState *tstate = PyThreadState_GET();
+    struct _PyObjectRegion *region;
+
+    assert(tstate != NULL);
+    region = (struct _PyObjectRegion *)PyMem_RawMalloc(sizeof(*region));
+    if (region == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    region->pools = NULL;
+    region->outer = tstate->obmalloc_region;
+    tstate->obmalloc_region = region;
+    return region;
+}
+
+void
+_PyObject_RegionEnd(_PyObjectRegion *region)
+{
+    PyThreadState *tstate = PyThreadState_GET();
+    poolp pool, next;
+
+    assert(tstate != NULL && tstate->obmalloc_region == region);
+    tstate->obmalloc_region = region->outer;
+    LOCK();
+    for (pool = region->pools; pool != NULL; pool = next) {
+        next = pool->nextpool;
+        if (pool->ref.count == 0) {
+            --nregion_pools;
+            pool->szidx = DUMMY_SIZE_IDX;
+            pool_return(pool);
+        }
+        else {
+            /* Escaped objects:  the last one to go frees the pool. */
+            pool->freeblock = NULL;
+            ++nregion_pools_escaped;
+        }
+    }
+    UNLOCK();
+    PyMem_RawFree(region);
+}
+
+/* malloc.  Note that nbytes==0 tries to return a non-NULL pointer, distinct
+ * from all other currently live pointers.  This may not be possible.
+ */
+
+static void *
+_PyObject_Alloc(int use_calloc, void *ctx, size_t nelem, size_t elsize)
+{
+    size_t nbytes;
+    block *bp;
+    uint size;
+    PyThreadState *tstate;
+#ifdef PYMALLOC_THREAD_CACHE
+    struct _obmalloc_tcache *tc;
+#endif
+
+    _Py_AllocatedBlocks++;
+
+    assert(nelem <= PY_SSIZE_T_MAX / elsize);
+    nbytes = nelem * elsize;
+
+#ifdef WITH_VALGRIND
+    if (UNLIKELY(running_on_valgrind == -1))
+        running_on_valgrind = RUNNING_ON_VALGRIND;
+    if (UNLIKELY(running_on_valgrind))
+        goto redirect;
+#endif
+
+    if (nelem == 0 || elsize == 0)
+        goto redirect;
+
+    if ((nbytes - 1) < SMALL_REQUEST_THRESHOLD) {
+        size = (uint)(nbytes - 1) >> ALIGNMENT_SHIFT;
+        tstate = PyThreadState_GET();
+        if (tstate != NULL && tstate->obmalloc_region != NULL)
+            bp = region_alloc_block(tstate->obmalloc_region, nbytes);
+        else {
+#ifdef PYMALLOC_THREAD_CACHE
+            tc = tcache_get(tstate);
+            if (tc == NULL)
+                bp = pool_alloc_block(arena_node_current(), size);
+            else if ((bp = tc->freeblocks[size]) != NULL) {
+                tc->freeblocks[size] = *(block **)bp;
+                tc->nblocks[size]--;
+                tc->alloc_hits++;
             }
             else {
-                /* nfreepools > 0:  it must be that freepools
-                 * isn't NULL, or that we haven't yet carved
-                 * off all the arena's pools for the first
-                 * time.
-                 */
-                assert(usable_arenas->freepools != NULL ||
-                       usable_arenas->pool_address <=
-                       (block*)usable_arenas->address +
-                           ARENA_SIZE - POOL_SIZE);
+                tc->alloc_misses++;
+                bp = tcache_refill(tc, size);
             }
-        init_pool:
-            /* Frontlink to used pools. */
-            next = usedpools[size + size]; /* == prev */
-            pool->nextpool = next;
-            pool->prevpool = next;
-            next->nextpool = pool;
-            next->prevpool = pool;
-            pool->ref.count = 1;
-            if (pool->szidx == size) {
-                /* Luckily, this pool last contained blocks
-                 * of the same size class, so its header
-                 * and free list are already initialized.
-                 */
-                bp = pool->freeblock;
-                assert(bp != NULL);
-                pool->freeblock = *(block **)bp;
-                UNLOCK();
-                if (use_calloc)
-                    memset(bp, 0, nbytes);
-                return (void *)bp;
-            }
-            /*
-             * Initialize the pool header, set up the free list to
-             * contain just the second block, and return the first
-             * block.
-             */
-            pool->szidx = size;
-            size = INDEX2SIZE(size);
-            bp = (block *)pool + POOL_OVERHEAD;
-            pool->nextoffset = POOL_OVERHEAD + (size << 1);
-            pool->maxnextoffset = POOL_SIZE - size;
-            pool->freeblock = bp + size;
-            *(block **)(pool->freeblock) = NULL;
-            UNLOCK();
+#else
+            bp = pool_alloc_block(arena_node_current(), size);
+#endif
+        }
+        if (bp != NULL) {
             if (use_calloc)
                 memset(bp, 0, nbytes);
             return (void *)bp;
         }
-
-        /* Carve off a new pool. */
-        assert(usable_arenas->nfreepools > 0);
-        assert(usable_arenas->freepools == NULL);
-        pool = (poolp)usable_arenas->pool_address;
-        assert((block*)pool <= (block*)usable_arenas->address +
-                               ARENA_SIZE - POOL_SIZE);
-        pool->arenaindex = (uint)(usable_arenas - arenas);
-        assert(&arenas[pool->arenaindex] == usable_arenas);
-        pool->szidx = DUMMY_SIZE_IDX;
-        usable_arenas->pool_address += POOL_SIZE;
-        --usable_arenas->nfreepools;
-
-        if (usable_arenas->nfreepools == 0) {
-            assert(usable_arenas->nextarena == NULL ||
-                   usable_arenas->nextarena->prevarena ==
-                   usable_arenas);
-            /* Unlink the arena:  it is completely allocated. */
-            usable_arenas = usable_arenas->nextarena;
-            if (usable_arenas != NULL) {
-                usable_arenas->prevarena = NULL;
-                assert(usable_arenas->address != 0);
-            }
-        }
-
-        goto init_pool;
     }
 
     /* The small block allocator ends here. */
@@ -1398,9 +2724,10 @@ static void
 _PyObject_Free(void *ctx, void *p)
 {
     poolp pool;
-    block *lastfree;
-    poolp next, prev;
+#ifdef PYMALLOC_THREAD_CACHE
+    struct _obmalloc_tcache *tc;
     uint size;
+#endif
 #ifndef Py_USING_MEMORY_DEBUGGER
     uint arenaindex_temp;
 #endif
@@ -1418,195 +2745,28 @@ _PyObject_Free(void *ctx, void *p)
     pool = POOL_ADDR(p);
     if (Py_ADDRESS_IN_RANGE(p, pool)) {
         /* We allocated this address. */
-        LOCK();
-        /* Link p to the start of the pool's freeblock list.  Since
-         * the pool had at least the p block outstanding, the pool
-         * wasn't empty (so it's already in a usedpools[] list, or
-         * was full and is in no list -- it's not in the freeblocks
-         * list in any case).
-         */
-        assert(pool->ref.count > 0);            /* else it was empty */
-        *(block **)p = lastfree = pool->freeblock;
-        pool->freeblock = (block *)p;
-        if (lastfree) {
-            struct arena_object* ao;
-            uint nf;  /* ao->nfreepools */
-
-            /* freeblock wasn't NULL, so the pool wasn't full,
-             * and the pool is in a usedpools[] list.
-             */
-            if (--pool->ref.count != 0) {
-                /* pool isn't empty:  leave it in usedpools */
-                UNLOCK();
-                return;
-            }
-            /* Pool is now empty:  unlink from usedpools, and
-             * link to the front of freepools.  This ensures that
-             * previously freed pools will be allocated later
-             * (being not referenced, they are perhaps paged out).
-             */
-            next = pool->nextpool;
-            prev = pool->prevpool;
-            next->prevpool = prev;
-            prev->nextpool = next;
-
-            /* Link the pool to freepools.  This is a singly-linked
-             * list, and pool->prevpool isn't used there.
-             */
-            ao = &arenas[pool->arenaindex];
-            pool->nextpool = ao->freepools;
-            ao->freepools = pool;
-            nf = ++ao->nfreepools;
-
-            /* All the rest is arena management.  We just freed
-             * a pool, and there are 4 cases for arena mgmt:
-             * 1. If all the pools are free, return the arena to
-             *    the system free().
-             * 2. If this is the only free pool in the arena,
-             *    add the arena back to the `usable_arenas` list.
-             * 3. If the "next" arena has a smaller count of free
-             *    pools, we have to "slide this arena right" to
-             *    restore that usable_arenas is sorted in order of
-             *    nfreepools.
-             * 4. Else there's nothing more to do.
-             */
-            if (nf == ao->ntotalpools) {
-                /* Case 1.  First unlink ao from usable_arenas.
-                 */
-                assert(ao->prevarena == NULL ||
-                       ao->prevarena->address != 0);
-                assert(ao ->nextarena == NULL ||
-                       ao->nextarena->address != 0);
-
-                /* Fix the pointer in the prevarena, or the
-                 * usable_arenas pointer.
-                 */
-                if (ao->prevarena == NULL) {
-                    usable_arenas = ao->nextarena;
-                    assert(usable_arenas == NULL ||
-                           usable_arenas->address != 0);
-                }
-                else {
-                    assert(ao->prevarena->nextarena == ao);
-                    ao->prevarena->nextarena =
-                        ao->nextarena;
-                }
-                /* Fix the pointer in the nextarena. */
-                if (ao->nextarena != NULL) {
-                    assert(ao->nextarena->prevarena == ao);
-                    ao->nextarena->prevarena =
-                        ao->prevarena;
-                }
-                /* Record that this arena_object slot is
-                 * available to be reused.
-                 */
-                ao->nextarena = unused_arena_objects;
-                unused_arena_objects = ao;
-
-                /* Free the entire arena. */
-                _PyObject_Arena.free(_PyObject_Arena.ctx,
-                                     (void *)ao->address, ARENA_SIZE);
-                ao->address = 0;                        /* mark unassociated */
-                --narenas_currently_allocated;
-
-                UNLOCK();
-                return;
-            }
-            if (nf == 1) {
-                /* Case 2.  Put ao at the head of
-                 * usable_arenas.  Note that because
-                 * ao->nfreepools was 0 before, ao isn't
-                 * currently on the usable_arenas list.
-                 */
-                ao->nextarena = usable_arenas;
-                ao->prevarena = NULL;
-                if (usable_arenas)
-                    usable_arenas->prevarena = ao;
-                usable_arenas = ao;
-                assert(usable_arenas->address != 0);
-
-                UNLOCK();
-                return;
-            }
-            /* If this arena is now out of order, we need to keep
-             * the list sorted.  The list is kept sorted so that
-             * the "most full" arenas are used first, which allows
-             * the nearly empty arenas to be completely freed.  In
-             * a few un-scientific tests, it seems like this
-             * approach allowed a lot more memory to be freed.
-             */
-            if (ao->nextarena == NULL ||
-                         nf <= ao->nextarena->nfreepools) {
-                /* Case 4.  Nothing to do. */
-                UNLOCK();
-                return;
-            }
-            /* Case 3:  We have to move the arena towards the end
-             * of the list, because it has more free pools than
-             * the arena to its right.
-             * First unlink ao from usable_arenas.
-             */
-            if (ao->prevarena != NULL) {
-                /* ao isn't at the head of the list */
-                assert(ao->prevarena->nextarena == ao);
-                ao->prevarena->nextarena = ao->nextarena;
-            }
+        if (pool->szidx == REGION_SIZE_IDX) {
+            region_free_block(pool);
+            return;
+        }
+#ifdef PYMALLOC_THREAD_CACHE
+        tc = tcache_get(PyThreadState_GET());
+        if (tc != NULL) {
+            size = pool->szidx;
+            if (tc->nblocks[size] < THREAD_CACHE_LIMIT(size))
+                tc->free_hits++;
             else {
-                /* ao is at the head of the list */
-                assert(usable_arenas == ao);
-                usable_arenas = ao->nextarena;
-            }
-            ao->nextarena->prevarena = ao->prevarena;
-
-            /* Locate the new insertion point by iterating over
-             * the list, using our nextarena pointer.
-             */
-            while (ao->nextarena != NULL &&
-                            nf > ao->nextarena->nfreepools) {
-                ao->prevarena = ao->nextarena;
-                ao->nextarena = ao->nextarena->nextarena;
+                /* Full:  hand half of it back to the pools. */
+                tc->free_misses++;
+                tcache_drain(tc, size, THREAD_CACHE_LIMIT(size) / 2);
             }
-
-            /* Insert ao at this point. */
-            assert(ao->nextarena == NULL ||
-                ao->prevarena == ao->nextarena->prevarena);
-            assert(ao->prevarena->nextarena == ao->nextarena);
-
-            ao->prevarena->nextarena = ao;
-            if (ao->nextarena != NULL)
-                ao->nextarena->prevarena = ao;
-
-            /* Verify that the swaps worked. */
-            assert(ao->nextarena == NULL ||
-                      nf <= ao->nextarena->nfreepools);
-            assert(ao->prevarena == NULL ||
-                      nf > ao->prevarena->nfreepools);
-            assert(ao->nextarena == NULL ||
-                ao->nextarena->prevarena == ao);
-            assert((usable_arenas == ao &&
-                ao->prevarena == NULL) ||
-                ao->prevarena->nextarena == ao);
-
-            UNLOCK();
+            *(block **)p = tc->freeblocks[size];
+            tc->freeblocks[size] = (block *)p;
+            tc->nblocks[size]++;
             return;
         }
-        /* Pool was full, so doesn't currently live in any list:
-         * link it to the front of the appropriate usedpools[] list.
-         * This mimics LRU pool usage for new allocations and
-         * targets optimal filling when several pools contain
-         * blocks of the same size class.
-         */
-        --pool->ref.count;
-        assert(pool->ref.count > 0);            /* else the pool is empty */
-        size = pool->szidx;
-        next = usedpools[size + size];
-        prev = next->prevpool;
-        /* insert pool before next:   prev <-> pool <-> next */
-        pool->nextpool = next;
-        pool->prevpool = prev;
-        next->prevpool = pool;
-        prev->nextpool = pool;
-        UNLOCK();
+#endif
+        pool_free_block(pool, (block *)p);
         return;
     }
 
@@ -1645,8 +2805,13 @@ _PyObject_Realloc(void *ctx, void *p, size_t nbytes)
     pool = POOL_ADDR(p);
     if (Py_ADDRESS_IN_RANGE(p, pool)) {
         /* We're in charge of this block */
-        size = INDEX2SIZE(pool->szidx);
-        if (nbytes <= size) {
+        if (pool->szidx == REGION_SIZE_IDX) {
+            /* A region block ends before the carving point. */
+            size = (size_t)((block *)pool + pool->nextoffset - (block *)p);
+            if (nbytes < size)
+                size = nbytes;
+        }
+        else if (nbytes <= (size = INDEX2SIZE(pool->szidx))) {
             /* The block is staying the same or shrinking.  If
              * it's shrinking, there's a tradeoff:  it costs
              * cycles to copy the block to a smaller size class,
@@ -1706,6 +2871,49 @@ _Py_GetAllocatedBlocks(void)
     return 0;
 }
 
+void
+_PyObject_ClearThreadCache(PyThreadState *tstate)
+{
+}
+
+int
+_PyObject_SetNumaArenas(int enable)
+{
+    return enable ? -1 : 0;
+}
+
+/* Without pymalloc, a region is just a scope marker. */
+struct _PyObjectRegion {
+    struct _PyObjectRegion *outer;
+};
+
+_PyObjectRegion *
+_PyObject_RegionBegin(void)
+{
+    PyThreadState *tstate = PyThreadState_GET();
+    struct _PyObjectRegion *region;
+
+    assert(tstate != NULL);
+    region = (struct _PyObjectRegion *)PyMem_RawMalloc(sizeof(*region));
+    if (region == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    region->outer = tstate->obmalloc_region;
+    tstate->obmalloc_region = region;
+    return region;
+}
+
+void
+_PyObject_RegionEnd(_PyObjectRegion *region)
+{
+    PyThreadState *tstate = PyThreadState_GET();
+
+    assert(tstate != NULL && tstate->obmalloc_region == region);
+    tstate->obmalloc_region = region->outer;
+    PyMem_RawFree(region);
+}
+
 #endif /* WITH_PYMALLOC */
 
 #ifdef PYMALLOC_DEBUG
@@ -2159,6 +3367,49 @@ _PyDebugAllocatorStats(FILE *out,
 
 #ifdef WITH_PYMALLOC
 
+#ifdef PYMALLOC_THREAD_CACHE
+/* Print one line per thread block cache to "out", and return the number of
+ * bytes held by all of them.
+ */
+static size_t
+print_thread_caches(FILE *out)
+{
+    PyInterpreterState *interp;
+    PyThreadState *tstate;
+    size_t cached_bytes = 0;
+
+    fputc('\n', out);
+    fputs("thread id   cached blocks   alloc hit %   free hit %\n"
+          "---------   -------------   -----------   ----------\n",
+          out);
+
+    for (interp = PyInterpreterState_Head(); interp != NULL;
+         interp = PyInterpreterState_Next(interp)) {
+        for (tstate = PyInterpreterState_ThreadHead(interp); tstate != NULL;
+             tstate = PyThreadState_Next(tstate)) {
+            struct _obmalloc_tcache *tc = tstate->obmalloc_tcache;
+            size_t nblocks = 0;
+            size_t nallocs, nfrees;
+            uint i;
+
+            if (tc == NULL)
+                continue;
+            for (i = 0; i < NB_SMALL_SIZE_CLASSES; ++i) {
+                nblocks += tc->nblocks[i];
+                cached_bytes += (size_t)tc->nblocks[i] * INDEX2SIZE(i);
+            }
+            nallocs = tc->alloc_hits + tc->alloc_misses;
+            nfrees = tc->free_hits + tc->free_misses;
+            fprintf(out, "%9ld %15" PY_FORMAT_SIZE_T "u %13.1f %12.1f\n",
+                    tstate->thread_id, nblocks,
+                    nallocs ? 100.0 * tc->alloc_hits / nallocs : 0.0,
+                    nfrees ? 100.0 * tc->free_hits / nfrees : 0.0);
+        }
+    }
+    return cached_bytes;
+}
+#endif
+
 /* Print summary info to "out" about the state of pymalloc's structures.
  * In Py_DEBUG mode, also perform some expensive internal consistency
  * checks.
@@ -2178,6 +3429,10 @@ _PyObject_DebugMallocStats(FILE *out)
     size_t available_bytes = 0;
     /* # of free pools + pools not yet carved out of current arena */
     uint numfreepools = 0;
+    /* # of free pools whose memory was given back to the system */
+    uint numreleasedpools = 0;
+    /* # of pools owned by object regions */
+    uint numregionpools = 0;
     /* # of bytes for arena alignment padding */
     size_t arena_alignment = 0;
     /* # of bytes in used and full pools used for pool_headers */
@@ -2189,6 +3444,14 @@ _PyObject_DebugMallocStats(FILE *out)
     size_t quantization = 0;
     /* # of arenas actually allocated. */
     size_t narenas = 0;
+    /* total # of bytes in blocks held by thread caches; these are counted
+     * as allocated by their pools
+     */
+    size_t cached_bytes = 0;
+    /* # of arenas, pools in use and allocated bytes per NUMA node */
+    size_t node_arenas[_PyObject_MAX_NUMA_NODES];
+    size_t node_pools[_PyObject_MAX_NUMA_NODES];
+    size_t node_bytes[_PyObject_MAX_NUMA_NODES];
     /* running total -- should equal narenas * ARENA_SIZE */
     size_t total;
     char buf[128];
@@ -2198,6 +3461,8 @@ _PyObject_DebugMallocStats(FILE *out)
 
     for (i = 0; i < numclasses; ++i)
         numpools[i] = numblocks[i] = numfreeblocks[i] = 0;
+    for (i = 0; i < narena_nodes; ++i)
+        node_arenas[i] = node_pools[i] = node_bytes[i] = 0;
 
     /* Because full pools aren't linked to from anything, it's easiest
      * to march over all the arenas.  If we're lucky, most of the memory
@@ -2211,8 +3476,14 @@ _PyObject_DebugMallocStats(FILE *out)
         if (arenas[i].address == (uptr)NULL)
             continue;
         narenas += 1;
+        node_arenas[arenas[i].node] += 1;
+        node_pools[arenas[i].node] +=
+            arenas[i].ntotalpools - arenas[i].nfreepools;
 
         numfreepools += arenas[i].nfreepools;
+#ifdef PYMALLOC_RELEASE_POOLS
+        numreleasedpools += arenas[i].nreleasedpools;
+#endif
 
         /* round up to pool alignment */
         if (base & (uptr)POOL_SIZE_MASK) {
@@ -2227,9 +3498,19 @@ _PyObject_DebugMallocStats(FILE *out)
                     base < (uptr) arenas[i].pool_address;
                     ++j, base += POOL_SIZE) {
             poolp p = (poolp)base;
-            const uint sz = p->szidx;
+            uint sz;
             uint freeblocks;
 
+#ifdef PYMALLOC_RELEASE_POOLS
+            /* don't fault released pools back in */
+            if (arenas[i].releasedpools[j / 32] & (1U << (j % 32)))
+                continue;
+#endif
+            sz = p->szidx;
+            if (sz == REGION_SIZE_IDX) {
+                ++numregionpools;
+                continue;
+            }
             if (p->ref.count == 0) {
                 /* currently unused */
                 assert(pool_is_in_list(p, arenas[i].freepools));
@@ -2237,11 +3518,13 @@ _PyObject_DebugMallocStats(FILE *out)
             }
             ++numpools[sz];
             numblocks[sz] += p->ref.count;
+            node_bytes[arenas[i].node] += p->ref.count * INDEX2SIZE(sz);
             freeblocks = NUMBLOCKS(sz) - p->ref.count;
             numfreeblocks[sz] += freeblocks;
 #ifdef Py_DEBUG
             if (freeblocks > 0)
-                assert(pool_is_in_list(p, usedpools[sz + sz]));
+                assert(pool_is_in_list(p,
+                    arena_nodes[arenas[i].node].usedpools[sz + sz]));
 #endif
         }
     }
@@ -2257,6 +3540,7 @@ _PyObject_DebugMallocStats(FILE *out)
         size_t b = numblocks[i];
         size_t f = numfreeblocks[i];
         uint size = INDEX2SIZE(i);
+        assert(p == npools_in_use[i]);
         if (p == 0) {
             assert(b == 0 && f == 0);
             continue;
@@ -2271,6 +3555,22 @@ _PyObject_DebugMallocStats(FILE *out)
         pool_header_bytes += p * POOL_OVERHEAD;
         quantization += p * ((POOL_SIZE - POOL_OVERHEAD) % size);
     }
+#ifdef PYMALLOC_THREAD_CACHE
+    cached_bytes = print_thread_caches(out);
+    allocated_bytes -= cached_bytes;
+#endif
+    if (narena_nodes > 1) {
+        fputc('\n', out);
+        fprintf(out, "NUMA arenas are %s.\n", numa_arenas ? "on" : "off");
+        fputs("node   arenas   pools in use   bytes in use\n"
+              "----   ------   ------------   ------------\n",
+              out);
+        for (i = 0; i < narena_nodes; ++i)
+            fprintf(out, "%4u %8" PY_FORMAT_SIZE_T "u "
+                            "%14" PY_FORMAT_SIZE_T "u "
+                            "%14" PY_FORMAT_SIZE_T "u\n",
+                    i, node_arenas[i], node_pools[i], node_bytes[i]);
+    }
     fputc('\n', out);
 #ifdef PYMALLOC_DEBUG
     (void)printone(out, "# times object malloc called", serialno);
@@ -2279,6 +3579,16 @@ _PyObject_DebugMallocStats(FILE *out)
     (void)printone(out, "# arenas reclaimed", ntimes_arena_allocated - narenas);
     (void)printone(out, "# arenas highwater mark", narenas_highwater);
     (void)printone(out, "# arenas allocated current", narenas);
+#ifdef ARENAS_USE_HUGE_PAGES
+    (void)printone(out, "# huge-page regions", nhuge_regions);
+    (void)printone(out, "# regions with MAP_HUGETLB", nhugetlb_regions);
+#endif
+#ifdef PYMALLOC_RELEASE_POOLS
+    (void)printone(out, "# bytes released from live arenas", released_bytes);
+    (void)printone(out, "# released pools reused", nreleased_pools_reused);
+#endif
+    (void)printone(out, "# region pools kept by escapees",
+                   nregion_pools_escaped);
 
     PyOS_snprintf(buf, sizeof(buf),
         "%" PY_FORMAT_SIZE_T "u arenas * %d bytes/arena",
@@ -2289,10 +3599,19 @@ _PyObject_DebugMallocStats(FILE *out)
 
     total = printone(out, "# bytes in allocated blocks", allocated_bytes);
     total += printone(out, "# bytes in available blocks", available_bytes);
+    total += printone(out, "# bytes in thread-cached blocks", cached_bytes);
 
     PyOS_snprintf(buf, sizeof(buf),
-        "%u unused pools * %d bytes", numfreepools, POOL_SIZE);
-    total += printone(out, buf, (size_t)numfreepools * POOL_SIZE);
+        "%u unused pools * %d bytes", numfreepools - numreleasedpools,
+        POOL_SIZE);
+    total += printone(out, buf,
+                      (size_t)(numfreepools - numreleasedpools) * POOL_SIZE);
+    PyOS_snprintf(buf, sizeof(buf),
+        "%u released pools * %d bytes", numreleasedpools, POOL_SIZE);
+    total += printone(out, buf, (size_t)numreleasedpools * POOL_SIZE);
+    PyOS_snprintf(buf, sizeof(buf),
+        "%u region pools * %d bytes", numregionpools, POOL_SIZE);
+    total += printone(out, buf, (size_t)numregionpools * POOL_SIZE);
 
     total += printone(out, "# bytes lost to pool headers", pool_header_bytes);
     total += printone(out, "# bytes lost to quantization", quantization);
@@ -2302,6 +3621,85 @@ _PyObject_DebugMallocStats(FILE *out)
 
 #endif /* #ifdef WITH_PYMALLOC */
 
+void
+_PyObject_GetMallocStats(_PyObject_MallocStats *stats)
+{
+#ifdef WITH_PYMALLOC
+    uint i, n;
+#ifdef PYMALLOC_THREAD_CACHE
+    PyInterpreterState *interp;
+    PyThreadState *tstate;
+#endif
+#endif
+
+    memset(stats, 0, sizeof(*stats));
+#ifdef WITH_PYMALLOC
+    stats->num_size_classes = NB_SMALL_SIZE_CLASSES;
+    for (i = 0; i < NB_SMALL_SIZE_CLASSES; ++i) {
+        _PyObject_SizeClassStats *sc = &stats->size_classes[i];
+        poolp pool;
+
+        sc->block_size = INDEX2SIZE(i);
+        sc->num_pools = npools_in_use[i];
+        /* Full pools are on no list, and have no free blocks. */
+        for (n = 0; n < narena_nodes; ++n) {
+            struct arena_node *an = &arena_nodes[n];
+
+            for (pool = an->usedpools[i + i]; pool != NODE_PTA(an, i);
+                 pool = pool->nextpool)
+                sc->free_blocks += NUMBLOCKS(i) - pool->ref.count;
+        }
+        sc->used_blocks = sc->num_pools * NUMBLOCKS(i) - sc->free_blocks;
+    }
+#ifdef PYMALLOC_THREAD_CACHE
+    /* Blocks in thread caches count as used by their pools. */
+    for (interp = PyInterpreterState_Head(); interp != NULL;
+         interp = PyInterpreterState_Next(interp)) {
+        for (tstate = PyInterpreterState_ThreadHead(interp); tstate != NULL;
+             tstate = PyThreadState_Next(tstate)) {
+            struct _obmalloc_tcache *tc = tstate->obmalloc_tcache;
+
+            if (tc == NULL)
+                continue;
+            for (i = 0; i < NB_SMALL_SIZE_CLASSES; ++i) {
+                stats->size_classes[i].cached_blocks += tc->nblocks[i];
+                stats->size_classes[i].used_blocks -= tc->nblocks[i];
+            }
+        }
+    }
+#endif
+    stats->allocated_blocks = _Py_AllocatedBlocks;
+    stats->num_numa_nodes = narena_nodes;
+    for (i = 0; i < maxarenas; ++i) {
+        _PyObject_NumaNodeStats *ns;
+
+        if (arenas[i].address == 0)
+            continue;
+        ns = &stats->numa_nodes[arenas[i].node];
+        ns->arenas += 1;
+        ns->used_pools += arenas[i].ntotalpools - arenas[i].nfreepools;
+        ns->free_pools += arenas[i].nfreepools;
+        stats->free_pools += arenas[i].nfreepools;
+#ifdef PYMALLOC_RELEASE_POOLS
+        stats->released_pools += arenas[i].nreleasedpools;
+#endif
+    }
+    stats->region_pools = nregion_pools;
+    stats->arenas = narenas_currently_allocated;
+    stats->arenas_allocated_total = ntimes_arena_allocated;
+    stats->arenas_highwater = narenas_highwater;
+#ifdef PYMALLOC_RELEASE_POOLS
+    stats->released_bytes_total = released_bytes;
+#endif
+#endif /* WITH_PYMALLOC */
+
+    stats->free_tuples = _PyTuple_NumFree();
+    stats->free_floats = _PyFloat_NumFree();
+    stats->free_frames = _PyFrame_NumFree();
+    stats->free_lists = _PyList_NumFree();
+    stats->free_dicts = _PyDict_NumFree();
+}
+
 #ifdef Py_USING_MEMORY_DEBUGGER
 /* Make this function last so gcc won't inline it since the definition is
  * after the reference.
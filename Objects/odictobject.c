@@ -39,17 +39,15 @@ we've considered:
    __getitem__(), get(), etc. accordingly.
 
 The approach with the least performance impact (time and space) is #2,
-mirroring the key order of dict's dk_enties with an array of node pointers.
-While lookdict() and friends (dk_lookup) don't give us the index into the
-array, we make use of pointer arithmetic to get that index.  An alternative
-would be to refactor lookdict() to provide the index, explicitly exposing
-the implementation detail.  We could even just use a custom lookup function
-for OrderedDict that facilitates our need.  However, both approaches are
-significantly more complicated than just using pointer arithmetic.
-
-The catch with mirroring the hash table ordering is that we have to keep
-the ordering in sync through any dict resizes.  However, that order only
-matters during node lookup.  We can simply defer any potential resizing
+mirroring the key order of dict's dk_entries with an array of node pointers.
+lookdict() and friends (dk_lookup) return the index of the key's entry in
+that array, which we use as is.  Since dk_entries is dense, the array only
+needs room for the entries the dict's keys can hold, not for every slot of
+its hash table.
+
+The catch with mirroring the entries is that we have to keep the indices
+in sync through any dict resizes, which compact the entries.  However, they
+only matter during node lookup.  We can simply defer any potential resizing
 until we need to do a lookup.
 
 Linked-List Nodes
@@ -522,7 +520,11 @@ struct _odictnode {
 #define _odict_FOREACH(od, node) \
     for (node = _odict_FIRST(od); node != NULL; node = _odictnode_NEXT(node))
 
-#define _odict_FAST_SIZE(od) ((PyDictObject *)od)->ma_keys->dk_size
+/* The number of entries the dict's keys have room for:  the indices of
+   the entries are below it. */
+#define _odict_FAST_SIZE(od) \
+    (((PyDictObject *)od)->ma_keys->dk_nentries + \
+     ((PyDictObject *)od)->ma_keys->dk_usable)
 
 static void
 _odict_free_fast_nodes(PyODictObject *od) {
@@ -531,29 +533,29 @@ _odict_free_fast_nodes(PyODictObject *od) {
     }
 }
 
-/* Return the index into the hash table, regardless of a valid node. */
+/* Return the index into the dict's entries, regardless of a valid node,
+   or -1 if the key isn't in the dict. */
 static Py_ssize_t
 _odict_get_index_raw(PyODictObject *od, PyObject *key, Py_hash_t hash)
 {
     PyObject **value_addr = NULL;
-    PyDictKeyEntry *ep;
     PyDictKeysObject *keys = ((PyDictObject *)od)->ma_keys;
+    Py_ssize_t ix;
 
-    ep = (keys->dk_lookup)((PyDictObject *)od, key, hash, &value_addr);
-    if (ep == NULL)
+    ix = (keys->dk_lookup)((PyDictObject *)od, key, hash, &value_addr, NULL);
+    if (ix < 0)
         return -1;
-    /* We use pointer arithmetic to get the entry's index into the table. */
-    return ep - keys->dk_entries;
+    return ix;
 }
 
-/* Replace od->od_fast_nodes with a new table matching the size of dict's. */
+/* Replace od->od_fast_nodes with a new table matching the dict's entries. */
 static int
 _odict_resize(PyODictObject *od) {
     Py_ssize_t size, i;
     _ODictNode **fast_nodes, *node;
 
     /* Initialize a new "fast nodes" table. */
-    size = ((PyDictObject *)od)->ma_keys->dk_size;
+    size = _odict_FAST_SIZE(od);
     fast_nodes = PyMem_NEW(_ODictNode *, size);
     if (fast_nodes == NULL) {
         PyErr_NoMemory();
@@ -581,7 +583,7 @@ _odict_resize(PyODictObject *od) {
     return 0;
 }
 
-/* Return the index into the hash table, regardless of a valid node. */
+/* Return the index into the dict's entries, regardless of a valid node. */
 static Py_ssize_t
 _odict_get_index(PyODictObject *od, PyObject *key, Py_hash_t hash)
 {
@@ -592,7 +594,7 @@ _odict_get_index(PyODictObject *od, PyObject *key, Py_hash_t hash)
 
     /* Ensure od_fast_nodes and dk_entries are in sync. */
     if (od->od_resize_sentinel != keys ||
-        od->od_fast_nodes_size != keys->dk_size) {
+        od->od_fast_nodes_size != _odict_FAST_SIZE(od)) {
         int resize_res = _odict_resize(od);
         if (resize_res < 0)
             return -1;
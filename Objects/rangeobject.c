@@ -76,16 +76,13 @@ make_range_object(PyTypeObject *type, PyObject *start,
    range(0, 5, -1)
 */
 static PyObject *
-range_new(PyTypeObject *type, PyObject *args, PyObject *kw)
+range_from_array(PyTypeObject *type, PyObject **args, Py_ssize_t nargs)
 {
     rangeobject *obj;
     PyObject *start = NULL, *stop = NULL, *step = NULL;
 
-    if (!_PyArg_NoKeywords("range()", kw))
-        return NULL;
-
-    if (PyTuple_Size(args) <= 1) {
-        if (!PyArg_UnpackTuple(args, "range", 1, 1, &stop))
+    if (nargs <= 1) {
+        if (!_PyArg_UnpackStack(args, nargs, "range", 1, 1, &stop))
             return NULL;
         stop = PyNumber_Index(stop);
         if (!stop)
@@ -103,8 +100,8 @@ range_new(PyTypeObject *type, PyObject *args, PyObject *kw)
         }
     }
     else {
-        if (!PyArg_UnpackTuple(args, "range", 2, 3,
-                               &start, &stop, &step))
+        if (!_PyArg_UnpackStack(args, nargs, "range", 2, 3,
+                                &start, &stop, &step))
             return NULL;
 
         /* Convert borrowed refs to owned refs */
@@ -135,6 +132,25 @@ range_new(PyTypeObject *type, PyObject *args, PyObject *kw)
     return NULL;
 }
 
+static PyObject *
+range_new(PyTypeObject *type, PyObject *args, PyObject *kw)
+{
+    if (!_PyArg_NoKeywords("range()", kw))
+        return NULL;
+
+    return range_from_array(type, &PyTuple_GET_ITEM(args, 0),
+                            PyTuple_GET_SIZE(args));
+}
+
+static PyObject *
+range_vectorcall(PyObject *type, PyObject **args, Py_ssize_t nargs,
+                 PyObject *kwnames)
+{
+    if (!_PyArg_NoStackKeywords("range()", kwnames))
+        return NULL;
+    return range_from_array((PyTypeObject *)type, args, nargs);
+}
+
 PyDoc_STRVAR(range_doc,
 "range(stop) -> range object\n\
 range(start, stop[, step]) -> range object\n\
@@ -742,6 +758,17 @@ PyTypeObject PyRange_Type = {
         0,                      /* tp_init */
         0,                      /* tp_alloc */
         range_new,              /* tp_new */
+        0,                      /* tp_free */
+        0,                      /* tp_is_gc */
+        0,                      /* tp_bases */
+        0,                      /* tp_mro */
+        0,                      /* tp_cache */
+        0,                      /* tp_subclasses */
+        0,                      /* tp_weaklist */
+        0,                      /* tp_del */
+        0,                      /* tp_version_tag */
+        0,                      /* tp_finalize */
+        range_vectorcall,       /* tp_vectorcall */
 };
 
 /*********************** range Iterator **************************/
@@ -751,13 +778,7 @@ PyTypeObject PyRange_Type = {
    in the normal case, but possible for any numeric value.
 */
 
-typedef struct {
-        PyObject_HEAD
-        long    index;
-        long    start;
-        long    step;
-        long    len;
-} rangeiterobject;
+typedef _PyRangeIterObject rangeiterobject;
 
 static PyObject *
 rangeiter_next(rangeiterobject *r)
@@ -1041,12 +1062,11 @@ longrangeiter_dealloc(longrangeiterobject *r)
     PyObject_Del(r);
 }
 
+/* The item at r->index, which is below r->len, stepping r->index */
 static PyObject *
-longrangeiter_next(longrangeiterobject *r)
+longrangeiter_step(longrangeiterobject *r)
 {
     PyObject *one, *product, *new_index, *result;
-    if (PyObject_RichCompareBool(r->index, r->len, Py_LT) != 1)
-        return NULL;
 
     one = PyLong_FromLong(1);
     if (!one)
@@ -1076,6 +1096,28 @@ longrangeiter_next(longrangeiterobject *r)
     return result;
 }
 
+static PyObject *
+longrangeiter_next(longrangeiterobject *r)
+{
+    if (PyObject_RichCompareBool(r->index, r->len, Py_LT) != 1)
+        return NULL;
+    return longrangeiter_step(r);
+}
+
+/* The next item of the iterator 'it' in *pitem, for FOR_ITER:  1 for an
+   item, 0 at the end, without an exception, or -1 for an error */
+int
+_PyLongRangeIter_Next(PyObject *it, PyObject **pitem)
+{
+    longrangeiterobject *r = (longrangeiterobject *)it;
+    int cmp = PyObject_RichCompareBool(r->index, r->len, Py_LT);
+
+    if (cmp <= 0)
+        return cmp;
+    *pitem = longrangeiter_step(r);
+    return *pitem != NULL ? 1 : -1;
+}
+
 PyTypeObject PyLongRangeIter_Type = {
         PyVarObject_HEAD_INIT(&PyType_Type, 0)
         "longrange_iterator",                   /* tp_name */
@@ -62,6 +62,19 @@ _PyTuple_DebugMallocStats(FILE *out)
 #endif
 }
 
+/* Number of objects in the free lists, all sizes together */
+int
+_PyTuple_NumFree(void)
+{
+    int n = 0;
+#if PyTuple_MAXSAVESIZE > 0
+    int i;
+    for (i = 1; i < PyTuple_MAXSAVESIZE; i++)
+        n += numfree[i];
+#endif
+    return n;
+}
+
 PyObject *
 PyTuple_New(Py_ssize_t size)
 {
@@ -679,6 +692,19 @@ tuple_subtype_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
     return newobj;
 }
 
+/* tuple() and tuple(iterable), called on the tuple type itself */
+static PyObject *
+tuple_vectorcall(PyObject *type, PyObject **args, Py_ssize_t nargs,
+                 PyObject *kwnames)
+{
+    assert(type == (PyObject *)&PyTuple_Type);
+    if (nargs > 1 || (kwnames != NULL && PyTuple_GET_SIZE(kwnames) != 0))
+        return _PyObject_MakeTpCall(type, args, nargs, kwnames);
+    if (nargs == 0)
+        return PyTuple_New(0);
+    return PySequence_Tuple(args[0]);
+}
+
 PyDoc_STRVAR(tuple_doc,
 "tuple() -> empty tuple\n\
 tuple(iterable) -> tuple initialized from iterable's items\n\
@@ -822,6 +848,16 @@ PyTypeObject PyTuple_Type = {
     0,                                          /* tp_alloc */
     tuple_new,                                  /* tp_new */
     PyObject_GC_Del,                            /* tp_free */
+    0,                                          /* tp_is_gc */
+    0,                                          /* tp_bases */
+    0,                                          /* tp_mro */
+    0,                                          /* tp_cache */
+    0,                                          /* tp_subclasses */
+    0,                                          /* tp_weaklist */
+    0,                                          /* tp_del */
+    0,                                          /* tp_version_tag */
+    0,                                          /* tp_finalize */
+    tuple_vectorcall,                           /* tp_vectorcall */
 };
 
 /* The following function breaks the notion that tuples are immutable:
@@ -924,11 +960,7 @@ PyTuple_Fini(void)
 
 /*********************** Tuple Iterator **************************/
 
-typedef struct {
-    PyObject_HEAD
-    Py_ssize_t it_index;
-    PyTupleObject *it_seq; /* Set to NULL when iterator is exhausted */
-} tupleiterobject;
+typedef _PyTupleIterObject tupleiterobject;
 
 static void
 tupleiter_dealloc(tupleiterobject *it)
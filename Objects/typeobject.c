@@ -6,6 +6,10 @@
 
 #include <ctype.h>
 
+/* from compile.h, which isn't part of this tree:  without the prototype, the
+   pointer it returns would be truncated to an int on 64-bit targets */
+extern PyObject *_Py_Mangle(PyObject *p, PyObject *name);
+
 
 /* Support type attribute cache */
 
@@ -930,6 +934,22 @@ type_call(PyTypeObject *type, PyObject *args, PyObject *kwds)
     return obj;
 }
 
+/* type(x) without the argument tuple; other calls of type itself take the
+   type_call() route. */
+static PyObject *
+type_vectorcall(PyObject *metatype, PyObject **args, Py_ssize_t nargs,
+                PyObject *kwnames)
+{
+    assert(metatype == (PyObject *)&PyType_Type);
+    if (nargs == 1 &&
+        (kwnames == NULL || PyTuple_GET_SIZE(kwnames) == 0)) {
+        PyObject *obj = (PyObject *)Py_TYPE(args[0]);
+        Py_INCREF(obj);
+        return obj;
+    }
+    return _PyObject_MakeTpCall(metatype, args, nargs, kwnames);
+}
+
 PyObject *
 PyType_GenericAlloc(PyTypeObject *type, Py_ssize_t nitems)
 {
@@ -3297,7 +3317,7 @@ PyTypeObject PyType_Type = {
     sizeof(PyHeapTypeObject),                   /* tp_basicsize */
     sizeof(PyMemberDef),                        /* tp_itemsize */
     (destructor)type_dealloc,                   /* tp_dealloc */
-    0,                                          /* tp_print */
+    offsetof(PyTypeObject, tp_vectorcall),      /* tp_vectorcall_offset */
     0,                                          /* tp_getattr */
     0,                                          /* tp_setattr */
     0,                                          /* tp_reserved */
@@ -3312,7 +3332,8 @@ PyTypeObject PyType_Type = {
     (setattrofunc)type_setattro,                /* tp_setattro */
     0,                                          /* tp_as_buffer */
     Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC |
-        Py_TPFLAGS_BASETYPE | Py_TPFLAGS_TYPE_SUBCLASS,         /* tp_flags */
+        Py_TPFLAGS_BASETYPE | Py_TPFLAGS_TYPE_SUBCLASS |
+        Py_TPFLAGS_HAVE_VECTORCALL,             /* tp_flags */
     type_doc,                                   /* tp_doc */
     (traverseproc)type_traverse,                /* tp_traverse */
     (inquiry)type_clear,                        /* tp_clear */
@@ -3333,6 +3354,15 @@ PyTypeObject PyType_Type = {
     type_new,                                   /* tp_new */
     PyObject_GC_Del,                            /* tp_free */
     (inquiry)type_is_gc,                        /* tp_is_gc */
+    0,                                          /* tp_bases */
+    0,                                          /* tp_mro */
+    0,                                          /* tp_cache */
+    0,                                          /* tp_subclasses */
+    0,                                          /* tp_weaklist */
+    0,                                          /* tp_del */
+    0,                                          /* tp_version_tag */
+    0,                                          /* tp_finalize */
+    type_vectorcall,                            /* tp_vectorcall */
 };
 
 
@@ -7257,7 +7287,7 @@ super_init(PyObject *self, PyObject *args, PyObject *kwds)
     if (type == NULL) {
         /* Call super(), without args -- fill in from __class__
            and first local variable on the stack. */
-        PyFrameObject *f;
+        _PyInterpreterFrame *f;
         PyCodeObject *co;
         Py_ssize_t i, n;
         f = PyThreadState_GET()->frame;
@@ -10756,6 +10756,13 @@ unicode_compare_eq(PyObject *str1, PyObject *str2)
     return (cmp == 0);
 }
 
+int
+_PyUnicode_EQ(PyObject *left, PyObject *right)
+{
+    assert(PyUnicode_IS_READY(left) && PyUnicode_IS_READY(right));
+    return left == right || unicode_compare_eq(left, right);
+}
+
 
 int
 PyUnicode_Compare(PyObject *left, PyObject *right)
@@ -0,0 +1,169 @@
+/* Allocation-heavy workloads run with obmalloc's arenas mapped normally,
+ * carved from huge-page regions, see _PyObject_SetHugePageArenas(), and kept
+ * per NUMA node, see _PyObject_SetNumaArenas().
+ *
+ * Every workload frees all of its memory, so that each mode starts from an
+ * empty allocator and maps its own arenas.
+ */
+#include "Python.h"
+#include <time.h>
+
+#define NBLOCKS     (1 << 20)       /* live blocks in the large heap */
+#define NTOUCHES    (8 << 20)       /* random accesses into it */
+#define NCHURN      200             /* rounds of the churn workload */
+#define NOBJECTS    (1 << 18)       /* floats and ints per round */
+
+static void *blocks[NBLOCKS];
+static PyObject *objects[NOBJECTS];
+
+static unsigned long rng_state = 12345;
+
+static unsigned long
+rng(void)
+{
+    /* xorshift, good enough to defeat the prefetcher */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double
+seconds(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* Build a heap of NBLOCKS blocks of mixed sizes, then read and write them
+ * in random order:  this is where the TLB hurts. */
+static double
+bench_scatter(void)
+{
+    clock_t start = clock();
+    size_t i, sum = 0;
+
+    for (i = 0; i < NBLOCKS; i++) {
+        blocks[i] = PyObject_Malloc(16 + (rng() % 24) * 8);
+        *(size_t *)blocks[i] = i;
+    }
+    for (i = 0; i < NTOUCHES; i++) {
+        size_t *p = (size_t *)blocks[rng() % NBLOCKS];
+        sum += *p;
+        *p = sum;
+    }
+    for (i = 0; i < NBLOCKS; i++)
+        PyObject_Free(blocks[i]);
+    if (sum == 42)
+        printf("unlikely\n");
+    return seconds(start);
+}
+
+/* Allocate and free short-lived blocks, in waves. */
+static double
+bench_churn(void)
+{
+    clock_t start = clock();
+    int round;
+    size_t i, n = NBLOCKS / 16;
+
+    for (round = 0; round < NCHURN; round++) {
+        for (i = 0; i < n; i++)
+            blocks[i] = PyObject_Malloc(8 + (i * 7) % 256);
+        for (i = 0; i < n; i += 2)
+            PyObject_Free(blocks[i]);
+        for (i = 0; i < n; i += 2)
+            blocks[i] = PyObject_Malloc(8 + (i * 13) % 256);
+        for (i = 0; i < n; i++)
+            PyObject_Free(blocks[i]);
+    }
+    return seconds(start);
+}
+
+/* Create and sum float and int objects. */
+static double
+bench_objects(void)
+{
+    clock_t start = clock();
+    int round;
+    size_t i;
+    double total = 0.0;
+
+    for (round = 0; round < 20; round++) {
+        for (i = 0; i < NOBJECTS; i += 2) {
+            objects[i] = PyFloat_FromDouble((double)i);
+            objects[i + 1] = PyLong_FromSsize_t((Py_ssize_t)i << 20);
+        }
+        for (i = 0; i < NOBJECTS; i++) {
+            PyObject *op = objects[rng() % NOBJECTS];
+            total += PyFloat_Check(op) ? PyFloat_AS_DOUBLE(op) : 1.0;
+        }
+        for (i = 0; i < NOBJECTS; i++)
+            Py_DECREF(objects[i]);
+    }
+    if (total == 42.0)
+        printf("unlikely\n");
+    return seconds(start);
+}
+
+static void
+run(const char *name, _PyObject_HugePageMode mode)
+{
+    if (_PyObject_SetHugePageArenas(mode) < 0) {
+        printf("%-10s not supported on this platform\n", name);
+        return;
+    }
+    printf("%-10s scatter %7.3fs   churn %7.3fs   objects %7.3fs\n",
+           name, bench_scatter(), bench_churn(), bench_objects());
+}
+
+/* Run the workloads with NUMA arenas on.  First check that the arenas of a
+ * heap are all accounted to some node:  on a single-node machine, turning
+ * NUMA arenas on must leave everything on node 0, as if they were off. */
+static void
+run_numa(void)
+{
+    _PyObject_MallocStats stats;
+    size_t i, total = 0;
+    unsigned int node;
+
+    if (_PyObject_SetNumaArenas(1) < 0) {
+        printf("%-10s not supported on this platform\n", "numa");
+        return;
+    }
+    for (i = 0; i < NBLOCKS / 4; i++)
+        blocks[i] = PyObject_Malloc(64);
+    _PyObject_GetMallocStats(&stats);
+    for (i = 0; i < NBLOCKS / 4; i++)
+        PyObject_Free(blocks[i]);
+    for (node = 0; node < stats.num_numa_nodes; node++)
+        total += stats.numa_nodes[node].arenas;
+    if (total != stats.arenas)
+        Py_FatalError("arenas missing from the NUMA nodes");
+    printf("%-10s %u node%s:", "numa", stats.num_numa_nodes,
+           stats.num_numa_nodes == 1 ? "" : "s");
+    for (node = 0; node < stats.num_numa_nodes; node++)
+        printf(" %lu", (unsigned long)stats.numa_nodes[node].arenas);
+    printf(" arenas\n");
+
+    run("numa", PYMEM_HUGEPAGES_OFF);
+    if (_PyObject_SetNumaArenas(0) < 0)
+        Py_FatalError("can't turn NUMA arenas off");
+}
+
+int main()
+{
+#ifndef WITH_PYMALLOC
+    printf("pymalloc is disabled in this build: "
+           "every mode measures the system malloc.\n");
+#endif
+    PyThreadState_Swap(PyThreadState_New(PyInterpreterState_New()));
+    if (!_PyLong_Init())
+        Py_FatalError("can't init longs");
+
+    run("off", PYMEM_HUGEPAGES_OFF);
+    run("thp", PYMEM_HUGEPAGES_THP);
+    run("hugetlb", PYMEM_HUGEPAGES_HUGETLB);
+    run_numa();
+    run("off", PYMEM_HUGEPAGES_OFF);
+    return 0;
+}
@@ -0,0 +1,580 @@
+/* Microbenchmarks of the object core:  number arithmetic, dict construction,
+ * lookup and merging, set operations, list sorting, str methods, the UTF-8
+ * codec and obmalloc.
+ *
+ *     bench_core [name ...]
+ *
+ * runs the benchmarks whose name starts with one of the arguments, or all of
+ * them.  Each one is calibrated to run at least MIN_TIME seconds per round,
+ * and the best of ROUNDS rounds is reported as ns per operation.  Then one
+ * more round runs with counting hooks on the PYMEM_DOMAIN_MEM and
+ * PYMEM_DOMAIN_OBJ allocators to report the allocations per operation:
+ * requests for new blocks (malloc, calloc and realloc of NULL), so that
+ * objects served by a free list don't count.
+ */
+#include "Python.h"
+#ifdef MS_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define ROUNDS      5
+#define MIN_TIME    0.05
+#define N           1000        /* items per container */
+
+static double
+now(void)
+{
+#ifdef MS_WINDOWS
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER t;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / freq.QuadPart;
+#else
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+static void
+check(PyObject *op, const char *what)
+{
+    if (op == NULL)
+        Py_FatalError(what);
+}
+
+/* Allocation counting hooks */
+
+static PyMemAllocatorEx mem_alloc, obj_alloc;
+static size_t nallocs;
+
+static void *
+count_malloc(void *ctx, size_t size)
+{
+    PyMemAllocatorEx *alloc = (PyMemAllocatorEx *)ctx;
+    nallocs++;
+    return alloc->malloc(alloc->ctx, size);
+}
+
+static void *
+count_calloc(void *ctx, size_t nelem, size_t elsize)
+{
+    PyMemAllocatorEx *alloc = (PyMemAllocatorEx *)ctx;
+    nallocs++;
+    return alloc->calloc(alloc->ctx, nelem, elsize);
+}
+
+static void *
+count_realloc(void *ctx, void *ptr, size_t size)
+{
+    PyMemAllocatorEx *alloc = (PyMemAllocatorEx *)ctx;
+    if (ptr == NULL)
+        nallocs++;
+    return alloc->realloc(alloc->ctx, ptr, size);
+}
+
+static void
+count_free(void *ctx, void *ptr)
+{
+    PyMemAllocatorEx *alloc = (PyMemAllocatorEx *)ctx;
+    alloc->free(alloc->ctx, ptr);
+}
+
+static void
+set_counting(int enable)
+{
+    PyMemAllocatorEx hook = {NULL, count_malloc, count_calloc, count_realloc,
+                             count_free};
+
+    if (enable) {
+        PyMem_GetAllocator(PYMEM_DOMAIN_MEM, &mem_alloc);
+        PyMem_GetAllocator(PYMEM_DOMAIN_OBJ, &obj_alloc);
+        hook.ctx = &mem_alloc;
+        PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &hook);
+        hook.ctx = &obj_alloc;
+        PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &hook);
+    }
+    else {
+        PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &mem_alloc);
+        PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &obj_alloc);
+    }
+}
+
+/* Shared data, built once */
+
+static PyObject *ints[N];       /* 0, 7919, 2*7919, ... out of the small ints */
+static PyObject *floats[N];
+static PyObject *keys;          /* list of N distinct str keys */
+static PyObject *shuffled;      /* list of N ints in random order */
+static PyObject *text;          /* words separated by spaces */
+static PyObject *needle;        /* found near the end of text */
+static PyObject *space;
+static PyObject *mixed;         /* ASCII, Latin-1, BMP and astral chars */
+static void *blocks[N];
+
+static void
+setup(void)
+{
+    static const char *words[] = {"spam", "eggs", "ham", "bacon", "sausage",
+                                  "lobster", "thermidor", "truffle", "pate",
+                                  "brandy", "fried", "egg", "on", "top"};
+    static const char mixed_utf8[] = "abc \xc3\xa9t\xc3\xa9 \xe2\x82\xac "
+                                     "\xe6\x97\xa5\xe6\x9c\xac "
+                                     "\xf0\x9f\x90\x8d ";
+    unsigned long state = 12345;
+    PyObject *list, *s;
+    char buf[32];
+    Py_ssize_t i;
+
+    for (i = 0; i < N; i++) {
+        check(ints[i] = PyLong_FromLong(i * 7919 + 1000), "ints");
+        check(floats[i] = PyFloat_FromDouble(i * 0.25 + 1.0), "floats");
+    }
+
+    check(keys = PyList_New(N), "keys");
+    for (i = 0; i < N; i++) {
+        sprintf(buf, "key_%s_%d", words[i % 14], (int)i);
+        check(s = PyUnicode_FromString(buf), "key");
+        PyList_SET_ITEM(keys, i, s);
+    }
+
+    check(shuffled = PyList_New(N), "shuffled");
+    for (i = 0; i < N; i++) {
+        Py_INCREF(ints[i]);
+        PyList_SET_ITEM(shuffled, i, ints[i]);
+    }
+    for (i = N - 1; i > 0; i--) {
+        Py_ssize_t j;
+        PyObject *tmp;
+
+        state = state * 1103515245 + 12345;
+        j = (Py_ssize_t)((state >> 16) % (i + 1));
+        tmp = PyList_GET_ITEM(shuffled, i);
+        PyList_SET_ITEM(shuffled, i, PyList_GET_ITEM(shuffled, j));
+        PyList_SET_ITEM(shuffled, j, tmp);
+    }
+
+    check(list = PyList_New(N), "words");
+    for (i = 0; i < N; i++) {
+        check(s = PyUnicode_FromString(words[i % 14]), "word");
+        PyList_SET_ITEM(list, i, s);
+    }
+    check(space = PyUnicode_FromString(" "), "space");
+    check(text = PyUnicode_Join(space, list), "text");
+    Py_DECREF(list);
+    check(needle = PyUnicode_FromString("thermidor truffle pate brandy "
+                                        "fried egg on top spam eggs"),
+          "needle");
+
+    check(s = PyUnicode_FromString(mixed_utf8), "mixed");
+    check(list = PyList_New(N / 16), "mixed");
+    for (i = 0; i < N / 16; i++) {
+        Py_INCREF(s);
+        PyList_SET_ITEM(list, i, s);
+    }
+    Py_DECREF(s);
+    check(mixed = PyUnicode_Join(space, list), "mixed");
+    Py_DECREF(list);
+}
+
+/* Benchmarks:  each runs 'loops' times and returns the operations it did */
+
+static Py_ssize_t
+bench_int_arith(Py_ssize_t loops)
+{
+    Py_ssize_t n, i;
+
+    for (n = 0; n < loops; n++) {
+        for (i = 0; i < N - 1; i++) {
+            PyObject *a, *b;
+
+            check(a = PyNumber_Multiply(ints[i], ints[i + 1]), "int mul");
+            check(b = PyNumber_Add(a, ints[i]), "int add");
+            Py_DECREF(a);
+            check(a = PyNumber_FloorDivide(b, ints[i + 1]), "int div");
+            Py_DECREF(b);
+            Py_DECREF(a);
+        }
+    }
+    return loops * (N - 1) * 3;
+}
+
+static Py_ssize_t
+bench_float_arith(Py_ssize_t loops)
+{
+    Py_ssize_t n, i;
+
+    for (n = 0; n < loops; n++) {
+        for (i = 0; i < N - 1; i++) {
+            PyObject *a, *b;
+
+            check(a = PyNumber_Multiply(floats[i], floats[i + 1]), "float mul");
+            check(b = PyNumber_Add(a, floats[i]), "float add");
+            Py_DECREF(a);
+            check(a = PyNumber_TrueDivide(b, floats[i + 1]), "float div");
+            Py_DECREF(b);
+            Py_DECREF(a);
+        }
+    }
+    return loops * (N - 1) * 3;
+}
+
+/* Fill a new dict from scratch, so that resizing is part of the cost */
+static Py_ssize_t
+bench_dict_insert(Py_ssize_t loops)
+{
+    Py_ssize_t n, i;
+
+    for (n = 0; n < loops; n++) {
+        PyObject *d;
+
+        check(d = PyDict_New(), "dict");
+        for (i = 0; i < N; i++)
+            if (PyDict_SetItem(d, PyList_GET_ITEM(keys, i), ints[i]) < 0)
+                Py_FatalError("dict insert");
+        Py_DECREF(d);
+    }
+    return loops * N;
+}
+
+static Py_ssize_t
+bench_dict_lookup(Py_ssize_t loops)
+{
+    static PyObject *d;
+    Py_ssize_t n, i;
+
+    if (d == NULL) {
+        check(d = PyDict_New(), "dict");
+        for (i = 0; i < N; i++)
+            if (PyDict_SetItem(d, PyList_GET_ITEM(keys, i), ints[i]) < 0)
+                Py_FatalError("dict insert");
+    }
+    for (n = 0; n < loops; n++)
+        for (i = 0; i < N; i++)
+            if (PyDict_GetItem(d, PyList_GET_ITEM(keys, i)) != ints[i])
+                Py_FatalError("dict lookup");
+    return loops * N;
+}
+
+/* The dict of the N keys, and the list of its (key, value) pairs */
+static PyObject *
+source_dict(void)
+{
+    static PyObject *d;
+    Py_ssize_t i;
+
+    if (d == NULL) {
+        check(d = PyDict_New(), "dict");
+        for (i = 0; i < N; i++)
+            if (PyDict_SetItem(d, PyList_GET_ITEM(keys, i), ints[i]) < 0)
+                Py_FatalError("dict insert");
+    }
+    return d;
+}
+
+static PyObject *
+source_pairs(void)
+{
+    static PyObject *pairs;
+    Py_ssize_t i;
+
+    if (pairs == NULL) {
+        check(pairs = PyList_New(N), "pairs");
+        for (i = 0; i < N; i++)
+            check(PyList_SET_ITEM(pairs, i,
+                                  PyTuple_Pack(2, PyList_GET_ITEM(keys, i),
+                                               ints[i])), "pair");
+    }
+    return pairs;
+}
+
+static Py_ssize_t
+bench_dict_copy(Py_ssize_t loops)
+{
+    PyObject *src = source_dict();
+    Py_ssize_t n;
+
+    for (n = 0; n < loops; n++) {
+        PyObject *d;
+
+        check(d = PyDict_Copy(src), "dict copy");
+        Py_DECREF(d);
+    }
+    return loops * N;
+}
+
+/* update() of a dict which already has a key */
+static Py_ssize_t
+bench_dict_update(Py_ssize_t loops)
+{
+    PyObject *src = source_dict();
+    Py_ssize_t n;
+
+    for (n = 0; n < loops; n++) {
+        PyObject *d;
+
+        check(d = PyDict_New(), "dict");
+        if (PyDict_SetItem(d, space, Py_None) < 0 ||
+            PyDict_Update(d, src) < 0)
+            Py_FatalError("dict update");
+        Py_DECREF(d);
+    }
+    return loops * N;
+}
+
+/* dict(pairs) */
+static Py_ssize_t
+bench_dict_from_pairs(Py_ssize_t loops)
+{
+    PyObject *pairs = source_pairs();
+    Py_ssize_t n;
+
+    for (n = 0; n < loops; n++) {
+        PyObject *d;
+
+        check(d = PyDict_New(), "dict");
+        if (PyDict_MergeFromSeq2(d, pairs, 1) < 0)
+            Py_FatalError("dict from pairs");
+        Py_DECREF(d);
+    }
+    return loops * N;
+}
+
+/* dict.fromkeys() of a list, then of a dict */
+static Py_ssize_t
+bench_dict_fromkeys(Py_ssize_t loops)
+{
+    PyObject *src = source_dict();
+    Py_ssize_t n;
+
+    for (n = 0; n < loops; n++) {
+        PyObject *d;
+
+        check(d = _PyDict_FromKeys((PyObject *)&PyDict_Type, keys, Py_None),
+              "fromkeys");
+        Py_DECREF(d);
+        check(d = _PyDict_FromKeys((PyObject *)&PyDict_Type, src, Py_None),
+              "fromkeys");
+        Py_DECREF(d);
+    }
+    return loops * N * 2;
+}
+
+static Py_ssize_t
+bench_set_insert(Py_ssize_t loops)
+{
+    Py_ssize_t n, i;
+
+    for (n = 0; n < loops; n++) {
+        PyObject *s;
+
+        check(s = PySet_New(NULL), "set");
+        for (i = 0; i < N; i++)
+            if (PySet_Add(s, ints[i]) < 0)
+                Py_FatalError("set insert");
+        Py_DECREF(s);
+    }
+    return loops * N;
+}
+
+static Py_ssize_t
+bench_set_lookup(Py_ssize_t loops)
+{
+    static PyObject *s;
+    Py_ssize_t n, i;
+
+    if (s == NULL)
+        check(s = PySet_New(shuffled), "set");
+    for (n = 0; n < loops; n++)
+        for (i = 0; i < N; i++)
+            if (PySet_Contains(s, ints[i]) != 1)
+                Py_FatalError("set lookup");
+    return loops * N;
+}
+
+/* One operation is copying and sorting a list of N ints */
+static Py_ssize_t
+bench_list_sort(Py_ssize_t loops)
+{
+    Py_ssize_t n;
+
+    for (n = 0; n < loops; n++) {
+        PyObject *list;
+
+        check(list = PyList_GetSlice(shuffled, 0, N), "list copy");
+        if (PyList_Sort(list) < 0)
+            Py_FatalError("list sort");
+        Py_DECREF(list);
+    }
+    return loops;
+}
+
+static Py_ssize_t
+bench_str_find(Py_ssize_t loops)
+{
+    Py_ssize_t n, len = PyUnicode_GET_LENGTH(text);
+
+    for (n = 0; n < loops; n++)
+        if (PyUnicode_Find(text, needle, 0, len, 1) < 0)
+            Py_FatalError("str find");
+    return loops;
+}
+
+static Py_ssize_t
+bench_str_split(Py_ssize_t loops)
+{
+    Py_ssize_t n;
+
+    for (n = 0; n < loops; n++) {
+        PyObject *list;
+
+        check(list = PyUnicode_Split(text, space, -1), "str split");
+        Py_DECREF(list);
+    }
+    return loops;
+}
+
+static Py_ssize_t
+bench_str_join(Py_ssize_t loops)
+{
+    Py_ssize_t n;
+
+    for (n = 0; n < loops; n++) {
+        PyObject *s;
+
+        check(s = PyUnicode_Join(space, keys), "str join");
+        Py_DECREF(s);
+    }
+    return loops;
+}
+
+static Py_ssize_t
+bench_utf8_roundtrip(Py_ssize_t loops)
+{
+    Py_ssize_t n;
+
+    for (n = 0; n < loops; n++) {
+        PyObject *b, *s;
+
+        /* the str caches its UTF-8 form:  encode a fresh copy each time */
+        check(s = PyUnicode_Substring(mixed, 1, PyUnicode_GET_LENGTH(mixed)),
+              "str copy");
+        check(b = PyUnicode_AsUTF8String(s), "utf-8 encode");
+        Py_DECREF(s);
+        check(s = PyUnicode_DecodeUTF8(PyBytes_AS_STRING(b),
+                                       PyBytes_GET_SIZE(b), "strict"),
+              "utf-8 decode");
+        Py_DECREF(b);
+        Py_DECREF(s);
+    }
+    return loops;
+}
+
+/* One operation is a malloc/free pair, from 8 to 512 bytes */
+static Py_ssize_t
+bench_obmalloc_churn(Py_ssize_t loops)
+{
+    Py_ssize_t n, i;
+
+    for (n = 0; n < loops; n++) {
+        for (i = 0; i < N; i++)
+            if ((blocks[i] = PyObject_Malloc(8 + (i * 37) % 505)) == NULL)
+                Py_FatalError("obmalloc");
+        for (i = 0; i < N; i += 2)
+            PyObject_Free(blocks[i]);
+        for (i = 0; i < N; i += 2)
+            if ((blocks[i] = PyObject_Malloc(8 + (i * 53) % 505)) == NULL)
+                Py_FatalError("obmalloc");
+        for (i = 0; i < N; i++)
+            PyObject_Free(blocks[i]);
+    }
+    return loops * (N + N / 2);
+}
+
+static struct {
+    const char *name;
+    Py_ssize_t (*run)(Py_ssize_t loops);
+} benchmarks[] = {
+    {"int_arith", bench_int_arith},
+    {"float_arith", bench_float_arith},
+    {"dict_insert", bench_dict_insert},
+    {"dict_lookup", bench_dict_lookup},
+    {"dict_copy", bench_dict_copy},
+    {"dict_update", bench_dict_update},
+    {"dict_from_pairs", bench_dict_from_pairs},
+    {"dict_fromkeys", bench_dict_fromkeys},
+    {"set_insert", bench_set_insert},
+    {"set_lookup", bench_set_lookup},
+    {"list_sort", bench_list_sort},
+    {"str_find", bench_str_find},
+    {"str_split", bench_str_split},
+    {"str_join", bench_str_join},
+    {"utf8_roundtrip", bench_utf8_roundtrip},
+    {"obmalloc_churn", bench_obmalloc_churn},
+};
+
+static int
+selected(const char *name, int argc, char **argv)
+{
+    int i;
+
+    if (argc < 2)
+        return 1;
+    for (i = 1; i < argc; i++)
+        if (strncmp(name, argv[i], strlen(argv[i])) == 0)
+            return 1;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t i;
+
+    PyThreadState_Swap(PyThreadState_New(PyInterpreterState_New()));
+    if (!_PyLong_Init())
+        Py_FatalError("can't init longs");
+    setup();
+
+    printf("%-16s %12s %12s\n", "benchmark", "ns/op", "allocs/op");
+    for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        Py_ssize_t (*run)(Py_ssize_t) = benchmarks[i].run;
+        Py_ssize_t loops = 1, ops;
+        double start, elapsed, best = -1.0;
+        int round;
+
+        if (!selected(benchmarks[i].name, argc, argv))
+            continue;
+
+        /* warm up free lists and caches, then calibrate */
+        run(1);
+        for (;;) {
+            start = now();
+            run(loops);
+            if (now() - start >= MIN_TIME)
+                break;
+            loops *= 2;
+        }
+        for (round = 0; round < ROUNDS; round++) {
+            start = now();
+            ops = run(loops);
+            elapsed = now() - start;
+            if (best < 0 || elapsed < best)
+                best = elapsed;
+        }
+
+        nallocs = 0;
+        set_counting(1);
+        ops = run(loops);
+        set_counting(0);
+
+        printf("%-16s %12.1f %12.3f\n", benchmarks[i].name,
+               best * 1e9 / ops, (double)nallocs / ops);
+    }
+    return 0;
+}
@@ -0,0 +1,193 @@
+/* Lookup throughput of str-keyed dicts, to compare the probing of
+ * dictobject.c:  bench_dict_perturb is the same program linked with a
+ * dictobject built with -DDICT_PERTURB_PROBE, which probes one slot at a time
+ * without control bytes.
+ *
+ *     bench_dict [size ...]
+ *
+ * For dicts of each size (default:  5, 1000, 100000 and 1000000 keys), it
+ * reports the ns per lookup of keys which are present (hit) and of keys which
+ * aren't (miss), both in random order, and the size of the dict per key.
+ * "hit-del" looks up the same keys again after as many other keys were
+ * inserted and deleted, as in a dict used as a cache.  Each measure is the
+ * best of ROUNDS rounds, calibrated to run at least MIN_TIME seconds.
+ */
+#include "Python.h"
+#ifdef MS_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define ROUNDS      5
+#define MIN_TIME    0.05
+
+static double
+now(void)
+{
+#ifdef MS_WINDOWS
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER t;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / freq.QuadPart;
+#else
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+static void
+check(PyObject *op, const char *what)
+{
+    if (op == NULL)
+        Py_FatalError(what);
+}
+
+static unsigned long rng_state = 12345;
+
+static unsigned long
+rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* n new str keys "<prefix><i>", with their hash computed, in random order */
+static PyObject **
+make_keys(const char *prefix, Py_ssize_t n)
+{
+    PyObject **keys = PyMem_RawMalloc(n * sizeof(PyObject *));
+    char buf[32];
+    Py_ssize_t i;
+
+    if (keys == NULL)
+        Py_FatalError("no memory for keys");
+    for (i = 0; i < n; i++) {
+        sprintf(buf, "%s%ld", prefix, (long)i);
+        check(keys[i] = PyUnicode_FromString(buf), "key");
+        if (PyObject_Hash(keys[i]) == -1)
+            Py_FatalError("hash");
+    }
+    for (i = n - 1; i > 0; i--) {
+        Py_ssize_t j = (Py_ssize_t)(rng() % (unsigned long)(i + 1));
+        PyObject *tmp = keys[i];
+        keys[i] = keys[j];
+        keys[j] = tmp;
+    }
+    return keys;
+}
+
+static void
+free_keys(PyObject **keys, Py_ssize_t n)
+{
+    Py_ssize_t i;
+
+    for (i = 0; i < n; i++)
+        Py_DECREF(keys[i]);
+    PyMem_RawFree(keys);
+}
+
+/* Look up the n keys 'loops' times, and check that they are present or not */
+static void
+lookup(PyObject *d, PyObject **keys, Py_ssize_t n, Py_ssize_t loops,
+       int present)
+{
+    Py_ssize_t l, i;
+
+    for (l = 0; l < loops; l++)
+        for (i = 0; i < n; i++)
+            if ((PyDict_GetItem(d, keys[i]) != NULL) != present)
+                Py_FatalError("dict lookup");
+}
+
+/* The best ns per lookup */
+static double
+measure(PyObject *d, PyObject **keys, Py_ssize_t n, int present)
+{
+    Py_ssize_t loops = 1;
+    double start, elapsed, best = -1.0;
+    int round;
+
+    /* warm up caches, then calibrate */
+    lookup(d, keys, n, 1, present);
+    for (;;) {
+        start = now();
+        lookup(d, keys, n, loops, present);
+        if (now() - start >= MIN_TIME)
+            break;
+        loops *= 2;
+    }
+    for (round = 0; round < ROUNDS; round++) {
+        start = now();
+        lookup(d, keys, n, loops, present);
+        elapsed = now() - start;
+        if (best < 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best * 1e9 / ((double)loops * n);
+}
+
+static void
+bench_size(Py_ssize_t n)
+{
+    PyObject **keys = make_keys("key_", n);
+    PyObject **misses = make_keys("miss_", n);
+    PyObject **churn = make_keys("churn_", n);
+    PyObject *d, *size;
+    double hit, miss, hit_del;
+    Py_ssize_t i;
+
+    check(d = PyDict_New(), "dict");
+    for (i = 0; i < n; i++)
+        if (PyDict_SetItem(d, keys[i], Py_None) < 0)
+            Py_FatalError("dict insert");
+    hit = measure(d, keys, n, 1);
+    miss = measure(d, misses, n, 0);
+    check(size = _PyDict_SizeOf((PyDictObject *)d), "sizeof");
+
+    /* then as many keys come and go */
+    for (i = 0; i < n; i++) {
+        if (PyDict_SetItem(d, churn[i], Py_None) < 0 ||
+            PyDict_DelItem(d, churn[i]) < 0)
+            Py_FatalError("dict churn");
+    }
+    hit_del = measure(d, keys, n, 1);
+
+    printf("%10ld %10.2f %10.2f %10.2f %10.1f\n", (long)n, hit, miss, hit_del,
+           (double)PyLong_AsSsize_t(size) / n);
+    Py_DECREF(size);
+    Py_DECREF(d);
+    free_keys(keys, n);
+    free_keys(misses, n);
+    free_keys(churn, n);
+}
+
+int main(int argc, char **argv)
+{
+    static const long sizes[] = {5, 1000, 100000, 1000000};
+    size_t i;
+    int a;
+
+    PyThreadState_Swap(PyThreadState_New(PyInterpreterState_New()));
+    if (!_PyLong_Init())
+        Py_FatalError("can't init longs");
+
+    printf("%10s %10s %10s %10s %10s\n", "keys", "hit ns", "miss ns",
+           "hit-del ns", "bytes/key");
+    if (argc > 1) {
+        for (a = 1; a < argc; a++)
+            bench_size(atol(argv[a]));
+    }
+    else {
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+            bench_size(sizes[i]);
+    }
+    return 0;
+}
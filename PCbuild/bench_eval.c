@@ -0,0 +1,1662 @@
+/* Microbenchmarks of the eval loop, on hand-assembled code objects since
+ * there is no compiler in this tree.
+ *
+ *     bench_eval [name ...]
+ *
+ * runs the benchmarks whose name starts with one of the arguments, or all of
+ * them, and reports the best of ROUNDS runs in ns per operation.  The
+ * operation is the instruction under test, with its share of the loop
+ * around it.
+ *
+ * Built with DYNAMIC_EXECUTION_PROFILE and DXPAIRS, against an eval loop
+ * built with them too (bench_eval_dxp), it reports the instructions
+ * dispatched per operation instead:  in the first run, before the code has
+ * got its caches and superinstructions, and once it has them.  Then the
+ * pairs of instructions which the first runs dispatched most.
+ */
+#include "Python.h"
+#include "code.h"
+#include "frameobject.h"
+#include "opcode.h"
+#ifdef MS_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define ROUNDS      100
+#define N           1000        /* loop iterations per run */
+
+/* An instruction with an argument */
+#define ARG(op, arg)    op, (arg) & 0xff, (arg) >> 8
+
+static double
+now(void)
+{
+#ifdef MS_WINDOWS
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER t;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / freq.QuadPart;
+#else
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+#endif
+}
+
+static void
+check(PyObject *op, const char *what)
+{
+    if (op == NULL)
+        Py_FatalError(what);
+}
+
+/* Make a function body taking one argument, 'items', with the names in the
+ * space-separated 'names' and the given constants, on the lines of 'lines',
+ * a co_lnotab of 'nlines' bytes. */
+static PyObject *
+make_code_lines(const char *name, const unsigned char *code, Py_ssize_t size,
+                int nlocals, const char *names, PyObject *consts,
+                const unsigned char *lines, Py_ssize_t nlines)
+{
+    PyObject *bytes, *lnotab, *namelist, *nametuple, *varnames, *empty;
+    PyObject *str, *co;
+    Py_ssize_t i;
+
+    check(bytes = PyBytes_FromStringAndSize((const char *)code, size),
+          "code");
+    check(lnotab = PyBytes_FromStringAndSize((const char *)lines, nlines),
+          "lnotab");
+    check(str = PyUnicode_FromString(names), "names");
+    check(namelist = PyUnicode_Split(str, NULL, -1), "names");
+    Py_DECREF(str);
+    check(nametuple = PyList_AsTuple(namelist), "names");
+    Py_DECREF(namelist);
+    check(varnames = PyTuple_New(nlocals), "varnames");
+    for (i = 0; i < nlocals; i++) {
+        char buf[16];
+        sprintf(buf, i == 0 ? "items" : "v%d", (int)i);
+        check(str = PyUnicode_FromString(buf), "varnames");
+        PyTuple_SET_ITEM(varnames, i, str);
+    }
+    check(empty = PyTuple_New(0), "empty");
+    check(str = PyUnicode_FromString(name), "name");
+    check(co = (PyObject *)PyCode_New(1, 0, nlocals, 16,
+                                      CO_OPTIMIZED | CO_NEWLOCALS | CO_NOFREE,
+                                      bytes, consts, nametuple, varnames,
+                                      empty, empty, str, str, 1, lnotab),
+          "code object");
+    Py_DECREF(bytes);
+    Py_DECREF(lnotab);
+    Py_DECREF(nametuple);
+    Py_DECREF(varnames);
+    Py_DECREF(empty);
+    Py_DECREF(str);
+    return co;
+}
+
+/* The same, all on one line */
+static PyObject *
+make_code(const char *name, const unsigned char *code, Py_ssize_t size,
+          int nlocals, const char *names, PyObject *consts)
+{
+    return make_code_lines(name, code, size, nlocals, names, consts,
+                           NULL, 0);
+}
+
+static PyObject *items;         /* the list iterated over */
+
+/* In pylifecycle.h, which isn't part of this tree */
+void _PyExc_Init(PyObject *bltinmod);
+
+static PyObject *
+run_code(PyObject *co, PyObject *globals)
+{
+    PyObject *res = PyEval_EvalCodeEx(co, globals, NULL, &items, 1,
+                                      NULL, 0, NULL, 0, NULL, NULL);
+    check(res, "eval");
+    return res;
+}
+
+/* A C function for the globals */
+static PyObject *
+noop(PyObject *self, PyObject *args)
+{
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyMethodDef noop_def = {"noop", noop, METH_VARARGS, NULL};
+
+/* An __exit__ which suppresses the exception */
+static PyObject *
+suppress(PyObject *self, PyObject *args)
+{
+    Py_INCREF(Py_True);
+    return Py_True;
+}
+
+static PyMethodDef suppress_def = {"suppress", suppress, METH_VARARGS, NULL};
+
+/* The benchmarks which raise check that their try blocks made the entries
+   of the exception table, rather than blocks on the block stack */
+static void
+check_table(PyObject *co, int entries, const char *what)
+{
+    if (((PyCodeObject *)co)->co_exceptiontable_size != entries)
+        Py_FatalError(what);
+}
+
+/* Benchmarks:  each returns the time of one run, and the operations */
+
+/* for v1 in items: g; len */
+static double
+bench_load_global(Py_ssize_t *ops)
+{
+    static const unsigned char code[] = {
+        ARG(SETUP_LOOP, 22),            /* 0 */
+        ARG(LOAD_FAST, 0),              /* 3 */
+        GET_ITER,                       /* 6 */
+        ARG(FOR_ITER, 14),              /* 7 */
+        ARG(STORE_FAST, 1),             /* 10 */
+        ARG(LOAD_GLOBAL, 0),            /* 13:  module global */
+        POP_TOP,
+        ARG(LOAD_GLOBAL, 1),            /* 17:  builtin */
+        POP_TOP,
+        ARG(JUMP_ABSOLUTE, 7),          /* 21 */
+        POP_BLOCK,                      /* 24 */
+        ARG(LOAD_GLOBAL, 0),            /* 25 */
+        RETURN_VALUE,
+    };
+    static PyObject *co, *globals;
+    PyObject *res, *g;
+    double start;
+
+    if (co == NULL) {
+        PyObject *builtins, *consts;
+
+        check(consts = PyTuple_Pack(1, Py_None), "consts");
+        co = make_code("load_global", code, sizeof(code), 2, "g len", consts);
+        Py_DECREF(consts);
+        check(globals = PyDict_New(), "globals");
+        check(builtins = PyDict_New(), "builtins");
+        check(g = PyCFunction_New(&noop_def, NULL), "g");
+        if (PyDict_SetItemString(globals, "g", g) < 0 ||
+            PyDict_SetItemString(builtins, "len", g) < 0 ||
+            PyDict_SetItemString(globals, "__builtins__", builtins) < 0)
+            Py_FatalError("globals");
+        Py_DECREF(g);
+        Py_DECREF(builtins);
+    }
+
+    start = now();
+    res = run_code(co, globals);
+    start = now() - start;
+    Py_DECREF(res);
+    *ops = 2 * N;
+    return start;
+}
+
+/* v2 = 0
+ * for v1 in items:
+ *     if v1 >= 0:
+ *         v2 += v1
+ * return v2 */
+static PyObject *
+loop_sum_code(void)
+{
+    static const unsigned char code[] = {
+        ARG(LOAD_CONST, 1),             /* 0 */
+        ARG(STORE_FAST, 2),             /* 3 */
+        ARG(SETUP_LOOP, 36),            /* 6 */
+        ARG(LOAD_FAST, 0),              /* 9 */
+        GET_ITER,                       /* 12 */
+        ARG(FOR_ITER, 28),              /* 13 */
+        ARG(STORE_FAST, 1),             /* 16 */
+        ARG(LOAD_FAST, 1),              /* 19 */
+        ARG(LOAD_CONST, 1),             /* 22 */
+        ARG(COMPARE_OP, PyCmp_GE),      /* 25 */
+        ARG(POP_JUMP_IF_FALSE, 13),     /* 28 */
+        ARG(LOAD_FAST, 2),              /* 31 */
+        ARG(LOAD_FAST, 1),              /* 34 */
+        INPLACE_ADD,                    /* 37 */
+        ARG(STORE_FAST, 2),             /* 38 */
+        ARG(JUMP_ABSOLUTE, 13),         /* 41 */
+        POP_BLOCK,                      /* 44 */
+        ARG(LOAD_FAST, 2),              /* 45 */
+        RETURN_VALUE,
+    };
+    /* lines 1 to 5 start at 0, 6, 19, 31 and 45 */
+    static const unsigned char lines[] = {6, 1, 13, 1, 12, 1, 14, 1};
+    static PyObject *co;
+
+    if (co == NULL) {
+        PyObject *consts;
+
+        check(consts = Py_BuildValue("(Oi)", Py_None, 0), "consts");
+        co = make_code_lines("loop_sum", code, sizeof(code), 3, "", consts,
+                             lines, sizeof(lines));
+        Py_DECREF(consts);
+    }
+    return co;
+}
+
+static double
+run_loop_sum(Py_ssize_t *ops)
+{
+    static PyObject *globals;
+    PyObject *res;
+    double start;
+
+    if (globals == NULL)
+        check(globals = PyDict_New(), "globals");
+
+    start = now();
+    res = run_code(loop_sum_code(), globals);
+    start = now() - start;
+    if (PyLong_AsLong(res) != N * (N - 1) / 2)
+        Py_FatalError("loop_sum");
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+static double
+bench_loop_sum(Py_ssize_t *ops)
+{
+    return run_loop_sum(ops);
+}
+
+static long events;             /* the events traced */
+
+static int
+count_event(PyObject *obj, PyFrameObject *frame, int what, PyObject *arg)
+{
+    events++;
+    return 0;
+}
+
+/* loop_sum with a trace function, which every frame reports its lines to */
+static double
+bench_loop_sum_traced(Py_ssize_t *ops)
+{
+    double elapsed;
+
+    PyEval_SetTrace(count_event, NULL);
+    elapsed = run_loop_sum(ops);
+    PyEval_SetTrace(NULL, NULL);
+    return elapsed;
+}
+
+/* loop_sum with line events of its code only */
+static double
+bench_loop_sum_lines(Py_ssize_t *ops)
+{
+    PyCodeObject *co = (PyCodeObject *)loop_sum_code();
+    double elapsed;
+
+    PyEval_SetInstrumentation(count_event, NULL);
+    if (PyCode_SetInstrumentation(co, PyCode_INSTRUMENT_LINE) < 0)
+        Py_FatalError("instrumentation");
+    events = 0;
+    elapsed = run_loop_sum(ops);
+    /* two lines per item, and three around the loop */
+    if (events != 2 * N + 3)
+        Py_FatalError("loop_sum_lines");
+    if (PyCode_SetInstrumentation(co, 0) < 0)
+        Py_FatalError("instrumentation");
+    PyEval_SetInstrumentation(NULL, NULL);
+    return elapsed;
+}
+
+/* loop_sum with an opcode profile, which samples one instruction in 100 */
+static double
+bench_loop_sum_profiled(Py_ssize_t *ops)
+{
+    _PyEval_OpcodeProfile opcodes[256];
+    _PyEval_CodeProfile codes[1];
+    PY_UINT64_T count = 0, timed = 0;
+    double elapsed;
+    int i;
+
+    if (_PyEval_SetOpcodeProfile(100) < 0)
+        Py_FatalError("opcode profile");
+    elapsed = run_loop_sum(ops);
+    if (_PyEval_GetOpcodeProfile(opcodes, codes, 1) != 1)
+        Py_FatalError("loop_sum_profiled");
+    for (i = 0; i < 256; i++) {
+        count += opcodes[i].count;
+        timed += opcodes[i].timed;
+    }
+    /* the loop dispatches several instructions per item, see
+       loop_sum_code(), and each sampled one is timed */
+    if (count < N / 100 || count > N ||
+        codes[0].code != loop_sum_code() ||
+        codes[0].profile.count != count || timed != count)
+        Py_FatalError("loop_sum_profiled");
+    _PyEval_SetOpcodeProfile(0);
+    return elapsed;
+}
+
+/* v2 = 0; for v1 in items: try: v2 += v1; except: pass; return v2 */
+static double
+bench_try_except(Py_ssize_t *ops)
+{
+    static const unsigned char code[] = {
+        ARG(LOAD_CONST, 1),             /* 0 */
+        ARG(STORE_FAST, 2),             /* 3 */
+        ARG(SETUP_LOOP, 39),            /* 6 */
+        ARG(LOAD_FAST, 0),              /* 9 */
+        GET_ITER,                       /* 12 */
+        ARG(FOR_ITER, 31),              /* 13 */
+        ARG(STORE_FAST, 1),             /* 16 */
+        ARG(SETUP_EXCEPT, 14),          /* 19 */
+        ARG(LOAD_FAST, 2),              /* 22 */
+        ARG(LOAD_FAST, 1),              /* 25 */
+        INPLACE_ADD,                    /* 28 */
+        ARG(STORE_FAST, 2),             /* 29 */
+        POP_BLOCK,                      /* 32 */
+        ARG(JUMP_FORWARD, 8),           /* 33 */
+        POP_TOP,                        /* 36:  except: */
+        POP_TOP,
+        POP_TOP,
+        POP_EXCEPT,                     /* 39 */
+        ARG(JUMP_FORWARD, 1),           /* 40 */
+        END_FINALLY,                    /* 43 */
+        ARG(JUMP_ABSOLUTE, 13),         /* 44 */
+        POP_BLOCK,                      /* 47 */
+        ARG(LOAD_FAST, 2),              /* 48 */
+        RETURN_VALUE,
+    };
+    static PyObject *co, *globals;
+    PyObject *res;
+    double start;
+
+    if (co == NULL) {
+        PyObject *consts;
+
+        check(consts = Py_BuildValue("(Oi)", Py_None, 0), "consts");
+        co = make_code("try_except", code, sizeof(code), 3, "", consts);
+        Py_DECREF(consts);
+        check(globals = PyDict_New(), "globals");
+    }
+
+    start = now();
+    res = run_code(co, globals);
+    start = now() - start;
+    if (PyLong_AsLong(res) != N * (N - 1) / 2)
+        Py_FatalError("try_except");
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+/* v2 = 0; for v1 in items: try: v2 += v1; finally: pass; return v2 */
+static double
+bench_try_finally(Py_ssize_t *ops)
+{
+    static const unsigned char code[] = {
+        ARG(LOAD_CONST, 1),             /* 0 */
+        ARG(STORE_FAST, 2),             /* 3 */
+        ARG(SETUP_LOOP, 32),            /* 6 */
+        ARG(LOAD_FAST, 0),              /* 9 */
+        GET_ITER,                       /* 12 */
+        ARG(FOR_ITER, 24),              /* 13 */
+        ARG(STORE_FAST, 1),             /* 16 */
+        ARG(SETUP_FINALLY, 14),         /* 19 */
+        ARG(LOAD_FAST, 2),              /* 22 */
+        ARG(LOAD_FAST, 1),              /* 25 */
+        INPLACE_ADD,                    /* 28 */
+        ARG(STORE_FAST, 2),             /* 29 */
+        POP_BLOCK,                      /* 32 */
+        ARG(LOAD_CONST, 0),             /* 33 */
+        END_FINALLY,                    /* 36:  finally: */
+        ARG(JUMP_ABSOLUTE, 13),         /* 37 */
+        POP_BLOCK,                      /* 40 */
+        ARG(LOAD_FAST, 2),              /* 41 */
+        RETURN_VALUE,
+    };
+    static PyObject *co, *globals;
+    PyObject *res;
+    double start;
+
+    if (co == NULL) {
+        PyObject *consts;
+
+        check(consts = Py_BuildValue("(Oi)", Py_None, 0), "consts");
+        co = make_code("try_finally", code, sizeof(code), 3, "", consts);
+        Py_DECREF(consts);
+        check(globals = PyDict_New(), "globals");
+    }
+
+    start = now();
+    res = run_code(co, globals);
+    start = now() - start;
+    if (PyLong_AsLong(res) != N * (N - 1) / 2)
+        Py_FatalError("try_finally");
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+/* A context manager whose __enter__ does nothing, and whose __exit__ does
+   nothing either, or suppresses the exception if 'suppressing' */
+static PyObject *
+make_manager(int suppressing)
+{
+    static PyObject *managers[2];
+    PyObject *dict, *enter, *exit, *cls;
+
+    if (managers[suppressing] != NULL)
+        return managers[suppressing];
+    check(enter = PyCFunction_New(&noop_def, NULL), "noop");
+    check(exit = PyCFunction_New(suppressing ? &suppress_def : &noop_def,
+                                 NULL), "exit");
+    check(dict = PyDict_New(), "class dict");
+    if (PyDict_SetItemString(dict, "__enter__", enter) < 0 ||
+        PyDict_SetItemString(dict, "__exit__", exit) < 0)
+        Py_FatalError("class dict");
+    check(cls = PyObject_CallFunction((PyObject *)&PyType_Type, "s()O",
+                                      "M", dict), "class");
+    check(managers[suppressing] = PyObject_CallObject(cls, NULL), "manager");
+    Py_DECREF(dict);
+    Py_DECREF(enter);
+    Py_DECREF(exit);
+    Py_DECREF(cls);
+    return managers[suppressing];
+}
+
+/* v2 = 0; for v1 in items: with g: v2 += v1; return v2 */
+static double
+bench_with_block(Py_ssize_t *ops)
+{
+    static const unsigned char code[] = {
+        ARG(LOAD_CONST, 1),             /* 0 */
+        ARG(STORE_FAST, 2),             /* 3 */
+        ARG(SETUP_LOOP, 38),            /* 6 */
+        ARG(LOAD_FAST, 0),              /* 9 */
+        GET_ITER,                       /* 12 */
+        ARG(FOR_ITER, 30),              /* 13 */
+        ARG(STORE_FAST, 1),             /* 16 */
+        ARG(LOAD_GLOBAL, 0),            /* 19 */
+        ARG(SETUP_WITH, 15),            /* 22 */
+        POP_TOP,                        /* 25 */
+        ARG(LOAD_FAST, 2),              /* 26 */
+        ARG(LOAD_FAST, 1),              /* 29 */
+        INPLACE_ADD,                    /* 32 */
+        ARG(STORE_FAST, 2),             /* 33 */
+        POP_BLOCK,                      /* 36 */
+        ARG(LOAD_CONST, 0),             /* 37 */
+        WITH_CLEANUP_START,             /* 40:  __exit__ */
+        WITH_CLEANUP_FINISH,
+        END_FINALLY,
+        ARG(JUMP_ABSOLUTE, 13),         /* 43 */
+        POP_BLOCK,                      /* 46 */
+        ARG(LOAD_FAST, 2),              /* 47 */
+        RETURN_VALUE,
+    };
+    static PyObject *co, *globals;
+    PyObject *res;
+    double start;
+
+    if (co == NULL) {
+        PyObject *consts;
+
+        check(consts = Py_BuildValue("(Oi)", Py_None, 0), "consts");
+        co = make_code("with_block", code, sizeof(code), 3, "g", consts);
+        Py_DECREF(consts);
+        check(globals = PyDict_New(), "globals");
+        if (PyDict_SetItemString(globals, "g", make_manager(0)) < 0 ||
+            PyDict_SetItemString(globals, "__builtins__", globals) < 0)
+            Py_FatalError("globals");
+    }
+
+    start = now();
+    res = run_code(co, globals);
+    start = now() - start;
+    if (PyLong_AsLong(res) != N * (N - 1) / 2)
+        Py_FatalError("with_block");
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+/* The globals of the benchmarks which raise:  IndexError, and g, a context
+   manager which suppresses it */
+static PyObject *
+raising_globals(void)
+{
+    static PyObject *globals;
+
+    if (globals == NULL) {
+        check(globals = PyDict_New(), "globals");
+        if (PyDict_SetItemString(globals, "IndexError",
+                                 PyExc_IndexError) < 0 ||
+            PyDict_SetItemString(globals, "g", make_manager(1)) < 0 ||
+            PyDict_SetItemString(globals, "__builtins__", globals) < 0)
+            Py_FatalError("globals");
+    }
+    return globals;
+}
+
+/* v2 = 0; v3 = []
+ * for v1 in items: try: v3[0] except IndexError: v2 += v1
+ * return v2 */
+static double
+bench_try_except_raise(Py_ssize_t *ops)
+{
+    static const unsigned char code[] = {
+        ARG(BUILD_LIST, 0),             /* 0 */
+        ARG(STORE_FAST, 3),             /* 3 */
+        ARG(LOAD_CONST, 1),             /* 6 */
+        ARG(STORE_FAST, 2),             /* 9 */
+        ARG(SETUP_LOOP, 57),            /* 12 */
+        ARG(LOAD_FAST, 0),              /* 15 */
+        GET_ITER,                       /* 18 */
+        ARG(FOR_ITER, 49),              /* 19 */
+        ARG(STORE_FAST, 1),             /* 22 */
+        ARG(SETUP_EXCEPT, 12),          /* 25 */
+        ARG(LOAD_FAST, 3),              /* 28 */
+        ARG(LOAD_CONST, 1),             /* 31 */
+        BINARY_SUBSCR,                  /* 34 */
+        POP_TOP,                        /* 35 */
+        POP_BLOCK,                      /* 36 */
+        ARG(JUMP_FORWARD, 28),          /* 37 */
+        DUP_TOP,                        /* 40:  except IndexError: */
+        ARG(LOAD_GLOBAL, 0),            /* 41 */
+        ARG(COMPARE_OP, PyCmp_EXC_MATCH), /* 44 */
+        ARG(POP_JUMP_IF_FALSE, 67),     /* 47 */
+        POP_TOP,                        /* 50 */
+        POP_TOP,
+        POP_TOP,
+        ARG(LOAD_FAST, 2),              /* 53 */
+        ARG(LOAD_FAST, 1),              /* 56 */
+        INPLACE_ADD,                    /* 59 */
+        ARG(STORE_FAST, 2),             /* 60 */
+        POP_EXCEPT,                     /* 63 */
+        ARG(JUMP_FORWARD, 1),           /* 64 */
+        END_FINALLY,                    /* 67 */
+        ARG(JUMP_ABSOLUTE, 19),         /* 68 */
+        POP_BLOCK,                      /* 71 */
+        ARG(LOAD_FAST, 2),              /* 72 */
+        RETURN_VALUE,
+    };
+    static PyObject *co;
+    PyObject *res;
+    double start;
+
+    if (co == NULL) {
+        PyObject *consts;
+
+        check(consts = Py_BuildValue("(Oi)", Py_None, 0), "consts");
+        co = make_code("try_except_raise", code, sizeof(code), 4,
+                       "IndexError", consts);
+        Py_DECREF(consts);
+        check_table(co, 1, "try_except_raise");
+    }
+
+    start = now();
+    res = run_code(co, raising_globals());
+    start = now() - start;
+    if (PyLong_AsLong(res) != N * (N - 1) / 2)
+        Py_FatalError("try_except_raise");
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+/* v2 = 0
+ * for v1 in items:
+ *     try:
+ *         if v1 & 1: continue
+ *         if v1 == N - 2: break
+ *         v2 += v1
+ *     finally:
+ *         v2 += 1
+ * try: return v2
+ * finally: v2 += 1; r = v2 */
+static double
+bench_try_finally_exit(Py_ssize_t *ops)
+{
+    static const unsigned char code[] = {
+        ARG(LOAD_CONST, 1),             /* 0 */
+        ARG(STORE_FAST, 2),             /* 3 */
+        ARG(SETUP_LOOP, 68),            /* 6 */
+        ARG(LOAD_FAST, 0),              /* 9 */
+        GET_ITER,                       /* 12 */
+        ARG(FOR_ITER, 60),              /* 13 */
+        ARG(STORE_FAST, 1),             /* 16 */
+        ARG(SETUP_FINALLY, 40),         /* 19 */
+        ARG(LOAD_FAST, 1),              /* 22 */
+        ARG(LOAD_CONST, 2),             /* 25 */
+        BINARY_AND,                     /* 28 */
+        ARG(POP_JUMP_IF_FALSE, 35),     /* 29 */
+        ARG(CONTINUE_LOOP, 13),         /* 32 */
+        ARG(LOAD_FAST, 1),              /* 35 */
+        ARG(LOAD_CONST, 3),             /* 38 */
+        ARG(COMPARE_OP, PyCmp_EQ),      /* 41 */
+        ARG(POP_JUMP_IF_FALSE, 48),     /* 44 */
+        BREAK_LOOP,                     /* 47 */
+        ARG(LOAD_FAST, 2),              /* 48 */
+        ARG(LOAD_FAST, 1),              /* 51 */
+        INPLACE_ADD,                    /* 54 */
+        ARG(STORE_FAST, 2),             /* 55 */
+        POP_BLOCK,                      /* 58 */
+        ARG(LOAD_CONST, 0),             /* 59 */
+        ARG(LOAD_FAST, 2),              /* 62:  finally: */
+        ARG(LOAD_CONST, 2),             /* 65 */
+        INPLACE_ADD,                    /* 68 */
+        ARG(STORE_FAST, 2),             /* 69 */
+        END_FINALLY,                    /* 72 */
+        ARG(JUMP_ABSOLUTE, 13),         /* 73 */
+        POP_BLOCK,                      /* 76 */
+        ARG(SETUP_FINALLY, 8),          /* 77 */
+        ARG(LOAD_FAST, 2),              /* 80 */
+        RETURN_VALUE,                   /* 83 */
+        POP_BLOCK,                      /* 84 */
+        ARG(LOAD_CONST, 0),             /* 85 */
+        ARG(LOAD_FAST, 2),              /* 88:  finally: */
+        ARG(LOAD_CONST, 2),             /* 91 */
+        INPLACE_ADD,                    /* 94 */
+        ARG(STORE_FAST, 2),             /* 95 */
+        ARG(LOAD_FAST, 2),              /* 98 */
+        ARG(STORE_GLOBAL, 0),           /* 101 */
+        END_FINALLY,                    /* 104 */
+        ARG(LOAD_CONST, 0),             /* 105 */
+        RETURN_VALUE,
+    };
+    /* a finally per item up to N - 2, and the even items below it */
+    const long sum = (N - 1) + (N / 2 - 1) * (N / 2 - 2);
+    static PyObject *co, *globals;
+    PyObject *res, *r;
+    double start;
+
+    if (co == NULL) {
+        PyObject *consts;
+
+        check(consts = Py_BuildValue("(Oiii)", Py_None, 0, 1, N - 2),
+              "consts");
+        co = make_code("try_finally_exit", code, sizeof(code), 3, "r",
+                       consts);
+        Py_DECREF(consts);
+        check_table(co, 2, "try_finally_exit");
+        check(globals = PyDict_New(), "globals");
+    }
+
+    start = now();
+    res = run_code(co, globals);
+    start = now() - start;
+    /* the finally after the return ran, and didn't change its value */
+    r = PyDict_GetItemString(globals, "r");
+    if (PyLong_AsLong(res) != sum || r == NULL || PyLong_AsLong(r) != sum + 1)
+        Py_FatalError("try_finally_exit");
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+/* v2 = 0; v3 = []
+ * for v1 in items: with g: v3[0]   # g suppresses the IndexError
+ *     v2 += v1
+ * return v2 */
+static double
+bench_with_suppress(Py_ssize_t *ops)
+{
+    static const unsigned char code[] = {
+        ARG(BUILD_LIST, 0),             /* 0 */
+        ARG(STORE_FAST, 3),             /* 3 */
+        ARG(LOAD_CONST, 1),             /* 6 */
+        ARG(STORE_FAST, 2),             /* 9 */
+        ARG(SETUP_LOOP, 46),            /* 12 */
+        ARG(LOAD_FAST, 0),              /* 15 */
+        GET_ITER,                       /* 18 */
+        ARG(FOR_ITER, 38),              /* 19 */
+        ARG(STORE_FAST, 1),             /* 22 */
+        ARG(LOAD_GLOBAL, 0),            /* 25 */
+        ARG(SETUP_WITH, 13),            /* 28 */
+        POP_TOP,                        /* 31 */
+        ARG(LOAD_FAST, 3),              /* 32 */
+        ARG(LOAD_CONST, 1),             /* 35 */
+        BINARY_SUBSCR,                  /* 38 */
+        POP_TOP,                        /* 39 */
+        POP_BLOCK,                      /* 40 */
+        ARG(LOAD_CONST, 0),             /* 41 */
+        WITH_CLEANUP_START,             /* 44:  __exit__ */
+        WITH_CLEANUP_FINISH,
+        END_FINALLY,
+        ARG(LOAD_FAST, 2),              /* 47 */
+        ARG(LOAD_FAST, 1),              /* 50 */
+        INPLACE_ADD,                    /* 53 */
+        ARG(STORE_FAST, 2),             /* 54 */
+        ARG(JUMP_ABSOLUTE, 19),         /* 57 */
+        POP_BLOCK,                      /* 60 */
+        ARG(LOAD_FAST, 2),              /* 61 */
+        RETURN_VALUE,
+    };
+    static PyObject *co;
+    PyObject *res;
+    double start;
+
+    if (co == NULL) {
+        PyObject *consts;
+
+        check(consts = Py_BuildValue("(Oi)", Py_None, 0), "consts");
+        co = make_code("with_suppress", code, sizeof(code), 4, "g", consts);
+        Py_DECREF(consts);
+        check_table(co, 1, "with_suppress");
+    }
+
+    start = now();
+    res = run_code(co, raising_globals());
+    start = now() - start;
+    if (PyLong_AsLong(res) != N * (N - 1) / 2)
+        Py_FatalError("with_suppress");
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+/* A generator:  v2 = []
+ * for v1 in items: try: v2[0] except IndexError: yield v1
+ * and the sum of what it yields */
+static double
+bench_generator_except(Py_ssize_t *ops)
+{
+    static const unsigned char code[] = {
+        ARG(BUILD_LIST, 0),             /* 0 */
+        ARG(STORE_FAST, 2),             /* 3 */
+        ARG(SETUP_LOOP, 52),            /* 6 */
+        ARG(LOAD_FAST, 0),              /* 9 */
+        GET_ITER,                       /* 12 */
+        ARG(FOR_ITER, 44),              /* 13 */
+        ARG(STORE_FAST, 1),             /* 16 */
+        ARG(SETUP_EXCEPT, 12),          /* 19 */
+        ARG(LOAD_FAST, 2),              /* 22 */
+        ARG(LOAD_CONST, 1),             /* 25 */
+        BINARY_SUBSCR,                  /* 28 */
+        POP_TOP,                        /* 29 */
+        POP_BLOCK,                      /* 30 */
+        ARG(JUMP_FORWARD, 23),          /* 31 */
+        DUP_TOP,                        /* 34:  except IndexError: */
+        ARG(LOAD_GLOBAL, 0),            /* 35 */
+        ARG(COMPARE_OP, PyCmp_EXC_MATCH), /* 38 */
+        ARG(POP_JUMP_IF_FALSE, 56),     /* 41 */
+        POP_TOP,                        /* 44 */
+        POP_TOP,
+        POP_TOP,
+        ARG(LOAD_FAST, 1),              /* 47 */
+        YIELD_VALUE,                    /* 50 */
+        POP_TOP,                        /* 51 */
+        POP_EXCEPT,                     /* 52 */
+        ARG(JUMP_FORWARD, 1),           /* 53 */
+        END_FINALLY,                    /* 56 */
+        ARG(JUMP_ABSOLUTE, 13),         /* 57 */
+        POP_BLOCK,                      /* 60 */
+        ARG(LOAD_CONST, 0),             /* 61 */
+        RETURN_VALUE,
+    };
+    static PyObject *co;
+    PyObject *gen, *item, *exc;
+    long sum = 0;
+    double start;
+
+    if (co == NULL) {
+        PyObject *consts;
+
+        check(consts = Py_BuildValue("(Oi)", Py_None, 0), "consts");
+        co = make_code("generator_except", code, sizeof(code), 3,
+                       "IndexError", consts);
+        Py_DECREF(consts);
+        ((PyCodeObject *)co)->co_flags |= CO_GENERATOR;
+        check_table(co, 1, "generator_except");
+    }
+
+    start = now();
+    gen = run_code(co, raising_globals());
+    while ((item = PyIter_Next(gen)) != NULL) {
+        sum += PyLong_AsLong(item);
+        Py_DECREF(item);
+    }
+    start = now() - start;
+    /* the exception of the handler the generator yielded from is gone:
+       the thread's is back to NULL, or the None of a handled one */
+    exc = PyThreadState_GET()->exc_type;
+    if (PyErr_Occurred() || (exc != NULL && exc != Py_None) ||
+        sum != N * (N - 1) / 2)
+        Py_FatalError("generator_except");
+    Py_DECREF(gen);
+    *ops = N;
+    return start;
+}
+
+/* An instance of a class with an attribute in its dict 'd', a slot 's', a
+ * property 'p', a class attribute 'c' and a method 'f' */
+static PyObject *
+make_instance(void)
+{
+    static const unsigned char code[] = {
+        ARG(LOAD_CONST, 0),
+        RETURN_VALUE,
+    };
+    static PyObject *instance;
+    PyObject *dict, *slots, *fget, *prop, *consts, *co, *globals, *f, *cls;
+
+    if (instance != NULL)
+        return instance;
+    check(consts = PyTuple_Pack(1, Py_None), "consts");
+    co = make_code("f", code, sizeof(code), 1, "", consts);
+    check(globals = PyDict_New(), "globals");
+    check(f = PyFunction_New(co, globals), "function");
+    check(dict = PyDict_New(), "class dict");
+    check(slots = Py_BuildValue("(ss)", "s", "__dict__"), "slots");
+    check(fget = PyCFunction_New(&noop_def, NULL), "fget");
+    check(prop = PyObject_CallFunctionObjArgs((PyObject *)&PyProperty_Type,
+                                              fget, NULL), "property");
+    if (PyDict_SetItemString(dict, "__slots__", slots) < 0 ||
+        PyDict_SetItemString(dict, "p", prop) < 0 ||
+        PyDict_SetItemString(dict, "c", Py_None) < 0 ||
+        PyDict_SetItemString(dict, "f", f) < 0)
+        Py_FatalError("class dict");
+    check(cls = PyObject_CallFunction((PyObject *)&PyType_Type, "s()O",
+                                      "C", dict), "class");
+    check(instance = PyObject_CallObject(cls, NULL), "instance");
+    if (PyObject_SetAttrString(instance, "d", Py_None) < 0 ||
+        PyObject_SetAttrString(instance, "s", Py_None) < 0)
+        Py_FatalError("instance");
+    Py_DECREF(dict);
+    Py_DECREF(slots);
+    Py_DECREF(fget);
+    Py_DECREF(prop);
+    Py_DECREF(consts);
+    Py_DECREF(co);
+    Py_DECREF(globals);
+    Py_DECREF(f);
+    Py_DECREF(cls);
+    return instance;
+}
+
+/* The globals of the attribute benchmarks:  g is the instance */
+static PyObject *
+instance_globals(void)
+{
+    static PyObject *globals;
+
+    if (globals == NULL) {
+        check(globals = PyDict_New(), "globals");
+        if (PyDict_SetItemString(globals, "g", make_instance()) < 0 ||
+            PyDict_SetItemString(globals, "__builtins__", globals) < 0)
+            Py_FatalError("globals");
+    }
+    return globals;
+}
+
+/* o = g; for v1 in items: o.<attr>, or o.<attr> = v1 if 'store' */
+static double
+run_attr(PyObject **co, const char *attr, int store, Py_ssize_t *ops)
+{
+    static const unsigned char load[] = {
+        ARG(LOAD_GLOBAL, 0),            /* 0 */
+        ARG(STORE_FAST, 2),             /* 3 */
+        ARG(SETUP_LOOP, 21),            /* 6 */
+        ARG(LOAD_FAST, 0),              /* 9 */
+        GET_ITER,                       /* 12 */
+        ARG(FOR_ITER, 13),              /* 13 */
+        ARG(STORE_FAST, 1),             /* 16 */
+        ARG(LOAD_FAST, 2),              /* 19 */
+        ARG(LOAD_ATTR, 1),              /* 22 */
+        POP_TOP,                        /* 25 */
+        ARG(JUMP_ABSOLUTE, 13),         /* 26 */
+        POP_BLOCK,                      /* 29 */
+        ARG(LOAD_CONST, 0),             /* 30 */
+        RETURN_VALUE,
+    };
+    static const unsigned char store_[] = {
+        ARG(LOAD_GLOBAL, 0),            /* 0 */
+        ARG(STORE_FAST, 2),             /* 3 */
+        ARG(SETUP_LOOP, 23),            /* 6 */
+        ARG(LOAD_FAST, 0),              /* 9 */
+        GET_ITER,                       /* 12 */
+        ARG(FOR_ITER, 15),              /* 13 */
+        ARG(STORE_FAST, 1),             /* 16 */
+        ARG(LOAD_FAST, 1),              /* 19 */
+        ARG(LOAD_FAST, 2),              /* 22 */
+        ARG(STORE_ATTR, 1),             /* 25 */
+        ARG(JUMP_ABSOLUTE, 13),         /* 28 */
+        POP_BLOCK,                      /* 31 */
+        ARG(LOAD_CONST, 0),             /* 32 */
+        RETURN_VALUE,
+    };
+    PyObject *res;
+    double start;
+
+    if (*co == NULL) {
+        PyObject *consts;
+        char names[32];
+
+        check(consts = PyTuple_Pack(1, Py_None), "consts");
+        sprintf(names, "g %s", attr);
+        if (store)
+            *co = make_code("store_attr", store_, sizeof(store_), 3, names,
+                            consts);
+        else
+            *co = make_code("load_attr", load, sizeof(load), 3, names,
+                            consts);
+        Py_DECREF(consts);
+    }
+
+    start = now();
+    res = run_code(*co, instance_globals());
+    start = now() - start;
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+/* o = g; for v1 in items: o.f(), or v1.bit_length() if 'builtin', with
+ * LOAD_METHOD and CALL_METHOD if 'method', else LOAD_ATTR and CALL_FUNCTION
+ */
+static double
+run_call(PyObject **co, int builtin, int method, Py_ssize_t *ops)
+{
+    PyObject *res;
+    double start;
+
+    if (*co == NULL) {
+        unsigned char code[] = {
+            ARG(LOAD_GLOBAL, 0),                    /* 0 */
+            ARG(STORE_FAST, 2),                     /* 3 */
+            ARG(SETUP_LOOP, 24),                    /* 6 */
+            ARG(LOAD_FAST, 0),                      /* 9 */
+            GET_ITER,                               /* 12 */
+            ARG(FOR_ITER, 16),                      /* 13 */
+            ARG(STORE_FAST, 1),                     /* 16 */
+            ARG(LOAD_FAST, builtin ? 1 : 2),        /* 19 */
+            ARG(method ? LOAD_METHOD : LOAD_ATTR, 1),       /* 22 */
+            ARG(method ? CALL_METHOD : CALL_FUNCTION, 0),   /* 25 */
+            POP_TOP,                                /* 28 */
+            ARG(JUMP_ABSOLUTE, 13),                 /* 29 */
+            POP_BLOCK,                              /* 32 */
+            ARG(LOAD_CONST, 0),                     /* 33 */
+            RETURN_VALUE,
+        };
+        PyObject *consts;
+
+        check(consts = PyTuple_Pack(1, Py_None), "consts");
+        *co = make_code("call", code, sizeof(code), 3,
+                        builtin ? "g bit_length" : "g f", consts);
+        Py_DECREF(consts);
+    }
+
+    start = now();
+    res = run_code(*co, instance_globals());
+    start = now() - start;
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+#define CALL_BENCHMARK(name, builtin, method) \
+    static double \
+    bench_##name(Py_ssize_t *ops) \
+    { \
+        static PyObject *co; \
+        return run_call(&co, builtin, method, ops); \
+    }
+
+CALL_BENCHMARK(call_attr, 0, 0)
+CALL_BENCHMARK(call_method, 0, 1)
+CALL_BENCHMARK(call_attr_builtin, 1, 0)
+CALL_BENCHMARK(call_method_builtin, 1, 1)
+
+/* o = g; for v1 in items: o(v1), or o(items=v1) if 'kw' */
+static double
+run_call_arg(PyObject **co, PyObject **globals, PyObject *(*make)(void),
+             int kw, Py_ssize_t *ops)
+{
+    static const unsigned char positional[] = {
+        ARG(LOAD_GLOBAL, 0),            /* 0 */
+        ARG(STORE_FAST, 2),             /* 3 */
+        ARG(SETUP_LOOP, 24),            /* 6 */
+        ARG(LOAD_FAST, 0),              /* 9 */
+        GET_ITER,                       /* 12 */
+        ARG(FOR_ITER, 16),              /* 13 */
+        ARG(STORE_FAST, 1),             /* 16 */
+        ARG(LOAD_FAST, 2),              /* 19 */
+        ARG(LOAD_FAST, 1),              /* 22 */
+        ARG(CALL_FUNCTION, 1),          /* 25 */
+        POP_TOP,                        /* 28 */
+        ARG(JUMP_ABSOLUTE, 13),         /* 29 */
+        POP_BLOCK,                      /* 32 */
+        ARG(LOAD_CONST, 0),             /* 33 */
+        RETURN_VALUE,
+    };
+    static const unsigned char keyword[] = {
+        ARG(LOAD_GLOBAL, 0),            /* 0 */
+        ARG(STORE_FAST, 2),             /* 3 */
+        ARG(SETUP_LOOP, 27),            /* 6 */
+        ARG(LOAD_FAST, 0),              /* 9 */
+        GET_ITER,                       /* 12 */
+        ARG(FOR_ITER, 19),              /* 13 */
+        ARG(STORE_FAST, 1),             /* 16 */
+        ARG(LOAD_FAST, 2),              /* 19 */
+        ARG(LOAD_CONST, 1),             /* 22 */
+        ARG(LOAD_FAST, 1),              /* 25 */
+        ARG(CALL_FUNCTION, 1 << 8),     /* 28 */
+        POP_TOP,                        /* 31 */
+        ARG(JUMP_ABSOLUTE, 13),         /* 32 */
+        POP_BLOCK,                      /* 35 */
+        ARG(LOAD_CONST, 0),             /* 36 */
+        RETURN_VALUE,
+    };
+    PyObject *res;
+    double start;
+
+    if (*co == NULL) {
+        PyObject *consts, *o;
+
+        check(consts = Py_BuildValue("(Os)", Py_None, "items"), "consts");
+        if (kw)
+            *co = make_code("call_arg", keyword, sizeof(keyword), 3, "g",
+                            consts);
+        else
+            *co = make_code("call_arg", positional, sizeof(positional), 3,
+                            "g", consts);
+        Py_DECREF(consts);
+        check(*globals = PyDict_New(), "globals");
+        check(o = make(), "callable");
+        if (PyDict_SetItemString(*globals, "g", o) < 0 ||
+            PyDict_SetItemString(*globals, "__builtins__", *globals) < 0)
+            Py_FatalError("globals");
+        Py_DECREF(o);
+    }
+
+    start = now();
+    res = run_code(*co, *globals);
+    start = now() - start;
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+/* def f(items): return None */
+static PyObject *
+make_function(void)
+{
+    static const unsigned char code[] = {
+        ARG(LOAD_CONST, 0),
+        RETURN_VALUE,
+    };
+    PyObject *consts, *co, *f;
+
+    check(consts = PyTuple_Pack(1, Py_None), "consts");
+    co = make_code("f", code, sizeof(code), 1, "", consts);
+    f = PyFunction_New(co, instance_globals());
+    Py_DECREF(consts);
+    Py_DECREF(co);
+    return f;
+}
+
+/* def f0(items): return f1(items) ... def f3(items): return None, so that a
+ * call of f0 is a chain of CHAIN_DEPTH calls between Python functions */
+#define CHAIN_DEPTH 4
+
+static PyObject *
+make_function_chain(void)
+{
+    static const unsigned char call_next[] = {
+        ARG(LOAD_GLOBAL, 0),
+        ARG(LOAD_FAST, 0),
+        ARG(CALL_FUNCTION, 1),
+        RETURN_VALUE,
+    };
+    static const unsigned char last[] = {
+        ARG(LOAD_CONST, 0),
+        RETURN_VALUE,
+    };
+    PyObject *consts, *globals, *co, *f = NULL;
+    char name[16];
+    int i;
+
+    check(consts = PyTuple_Pack(1, Py_None), "consts");
+    check(globals = PyDict_New(), "globals");
+    if (PyDict_SetItemString(globals, "__builtins__", globals) < 0)
+        Py_FatalError("globals");
+    for (i = CHAIN_DEPTH - 1; i >= 0; i--) {
+        sprintf(name, "f%d", i + 1);
+        if (i == CHAIN_DEPTH - 1)
+            co = make_code(name, last, sizeof(last), 1, "", consts);
+        else
+            co = make_code(name, call_next, sizeof(call_next), 1, name,
+                           consts);
+        Py_XDECREF(f);
+        check(f = PyFunction_New(co, globals), "function");
+        Py_DECREF(co);
+        sprintf(name, "f%d", i);
+        if (PyDict_SetItemString(globals, name, f) < 0)
+            Py_FatalError("globals");
+    }
+    Py_DECREF(consts);
+    Py_DECREF(globals);
+    return f;
+}
+
+/* {}.get, a METH_FASTCALL builtin */
+static PyObject *
+make_dict_get(void)
+{
+    PyObject *d, *get;
+
+    check(d = PyDict_New(), "dict");
+    get = PyObject_GetAttrString(d, "get");
+    Py_DECREF(d);
+    return get;
+}
+
+static PyObject *
+make_type(void)
+{
+    Py_INCREF(&PyType_Type);
+    return (PyObject *)&PyType_Type;
+}
+
+#define CALL_ARG_BENCHMARK(name, make, kw) \
+    static double \
+    bench_##name(Py_ssize_t *ops) \
+    { \
+        static PyObject *co, *globals; \
+        return run_call_arg(&co, &globals, make, kw, ops); \
+    }
+
+CALL_ARG_BENCHMARK(call_function, make_function, 0)
+CALL_ARG_BENCHMARK(call_function_kw, make_function, 1)
+CALL_ARG_BENCHMARK(call_chain, make_function_chain, 0)
+CALL_ARG_BENCHMARK(call_dict_get, make_dict_get, 0)
+CALL_ARG_BENCHMARK(call_type, make_type, 0)
+
+/* for v1 in items: a <op> b, with 'consts' (None, a, b), which is only made
+ * for the first run */
+static double
+run_binary(PyObject **co, int op, int arg, PyObject *consts, Py_ssize_t *ops)
+{
+    static const unsigned char with_arg[] = {
+        ARG(SETUP_LOOP, 24),            /* 0 */
+        ARG(LOAD_FAST, 0),              /* 3 */
+        GET_ITER,                       /* 6 */
+        ARG(FOR_ITER, 16),              /* 7 */
+        ARG(STORE_FAST, 1),             /* 10 */
+        ARG(LOAD_CONST, 1),             /* 13 */
+        ARG(LOAD_CONST, 2),             /* 16 */
+        ARG(NOP, 0),                    /* 19:  op */
+        POP_TOP,                        /* 22 */
+        ARG(JUMP_ABSOLUTE, 7),          /* 23 */
+        POP_BLOCK,                      /* 26 */
+        ARG(LOAD_CONST, 0),             /* 27 */
+        RETURN_VALUE,
+    };
+    static const unsigned char no_arg[] = {
+        ARG(SETUP_LOOP, 22),            /* 0 */
+        ARG(LOAD_FAST, 0),              /* 3 */
+        GET_ITER,                       /* 6 */
+        ARG(FOR_ITER, 14),              /* 7 */
+        ARG(STORE_FAST, 1),             /* 10 */
+        ARG(LOAD_CONST, 1),             /* 13 */
+        ARG(LOAD_CONST, 2),             /* 16 */
+        NOP,                            /* 19:  op */
+        POP_TOP,                        /* 20 */
+        ARG(JUMP_ABSOLUTE, 7),          /* 21 */
+        POP_BLOCK,                      /* 24 */
+        ARG(LOAD_CONST, 0),             /* 25 */
+        RETURN_VALUE,
+    };
+    PyObject *res;
+    double start;
+
+    if (*co == NULL) {
+        unsigned char code[sizeof(with_arg)];
+        Py_ssize_t size;
+
+        if (HAS_ARG(op)) {
+            memcpy(code, with_arg, size = sizeof(with_arg));
+            code[20] = arg & 0xff;
+            code[21] = arg >> 8;
+        }
+        else
+            memcpy(code, no_arg, size = sizeof(no_arg));
+        code[19] = op;
+        check(consts, "consts");
+        *co = make_code("binary", code, size, 2, "", consts);
+        Py_DECREF(consts);
+    }
+
+    start = now();
+    res = run_code(*co, instance_globals());
+    start = now() - start;
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+#define BINARY_BENCHMARK(name, op, arg, consts) \
+    static double \
+    bench_##name(Py_ssize_t *ops) \
+    { \
+        static PyObject *co; \
+        return run_binary(&co, op, arg, \
+                          co == NULL ? Py_BuildValue consts : NULL, ops); \
+    }
+
+BINARY_BENCHMARK(binary_add_int, BINARY_ADD, 0, ("(Oii)", Py_None, 1, 2))
+BINARY_BENCHMARK(inplace_add_int, INPLACE_ADD, 0, ("(Oii)", Py_None, 1, 2))
+BINARY_BENCHMARK(binary_add_float, BINARY_ADD, 0,
+                 ("(Odd)", Py_None, 1.5, 2.5))
+BINARY_BENCHMARK(binary_subscr_list, BINARY_SUBSCR, 0,
+                 ("(O[iii]i)", Py_None, 1, 2, 3, 1))
+BINARY_BENCHMARK(compare_op_int, COMPARE_OP, PyCmp_LT,
+                 ("(Oii)", Py_None, 1, 2))
+BINARY_BENCHMARK(compare_op_float, COMPARE_OP, PyCmp_LT,
+                 ("(Odd)", Py_None, 1.5, 2.5))
+/* two equal strings, not the same one */
+BINARY_BENCHMARK(compare_op_str, COMPARE_OP, PyCmp_EQ,
+                 ("(Oss)", Py_None, "spam", "spam"))
+
+#define ATTR_BENCHMARK(name, attr, store) \
+    static double \
+    bench_##name(Py_ssize_t *ops) \
+    { \
+        static PyObject *co; \
+        return run_attr(&co, attr, store, ops); \
+    }
+
+ATTR_BENCHMARK(load_attr_dict, "d", 0)
+ATTR_BENCHMARK(load_attr_slot, "s", 0)
+ATTR_BENCHMARK(load_attr_descr, "p", 0)
+ATTR_BENCHMARK(load_attr_class, "c", 0)
+ATTR_BENCHMARK(store_attr_dict, "d", 1)
+ATTR_BENCHMARK(store_attr_slot, "s", 1)
+
+/* for v1 in <consts[1]>: pass; return v1, with 'consts' (None, iterable)
+ * only made for the first run */
+static double
+run_for_iter(PyObject **co, PyObject *consts, Py_ssize_t *ops)
+{
+    static const unsigned char code[] = {
+        ARG(SETUP_LOOP, 14),            /* 0 */
+        ARG(LOAD_CONST, 1),             /* 3 */
+        GET_ITER,                       /* 6 */
+        ARG(FOR_ITER, 6),               /* 7 */
+        ARG(STORE_FAST, 1),             /* 10 */
+        ARG(JUMP_ABSOLUTE, 7),          /* 13 */
+        POP_BLOCK,                      /* 16 */
+        ARG(LOAD_FAST, 1),              /* 17 */
+        RETURN_VALUE,
+    };
+    static PyObject *globals;
+    PyObject *res;
+    double start;
+
+    if (*co == NULL) {
+        check(consts, "consts");
+        *co = make_code("for_iter", code, sizeof(code), 2, "", consts);
+        Py_DECREF(consts);
+    }
+    if (globals == NULL)
+        check(globals = PyDict_New(), "globals");
+
+    start = now();
+    res = run_code(*co, globals);
+    start = now() - start;
+    if (PyLong_AsLong(res) != N - 1)
+        Py_FatalError("for_iter");
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+/* range(N), and {i: i} for the items */
+static PyObject *
+make_range(void)
+{
+    return PyObject_CallFunction((PyObject *)&PyRange_Type, "n",
+                                 (Py_ssize_t)N);
+}
+
+static PyObject *
+make_dict(void)
+{
+    PyObject *d;
+    Py_ssize_t i;
+
+    check(d = PyDict_New(), "dict");
+    for (i = 0; i < N; i++)
+        if (PyDict_SetItem(d, PyList_GET_ITEM(items, i),
+                           PyList_GET_ITEM(items, i)) < 0)
+            Py_FatalError("dict");
+    return d;
+}
+
+#define FOR_ITER_BENCHMARK(name, iterable) \
+    static double \
+    bench_##name(Py_ssize_t *ops) \
+    { \
+        static PyObject *co; \
+        return run_for_iter(&co, co == NULL ? \
+                            Py_BuildValue("(ON)", Py_None, iterable) : \
+                            NULL, ops); \
+    }
+
+FOR_ITER_BENCHMARK(for_iter_list, PyList_GetSlice(items, 0, N))
+FOR_ITER_BENCHMARK(for_iter_tuple, PyList_AsTuple(items))
+FOR_ITER_BENCHMARK(for_iter_range, make_range())
+FOR_ITER_BENCHMARK(for_iter_dict, make_dict())
+
+/* v2 = 0; v3 = 1
+ * for v1 in items: v2, v3 = v3, v2
+ * return v2 */
+static double
+bench_unpack_swap(Py_ssize_t *ops)
+{
+    static const unsigned char code[] = {
+        ARG(LOAD_CONST, 1),             /* 0 */
+        ARG(STORE_FAST, 2),             /* 3 */
+        ARG(LOAD_CONST, 2),             /* 6 */
+        ARG(STORE_FAST, 3),             /* 9 */
+        ARG(SETUP_LOOP, 32),            /* 12 */
+        ARG(LOAD_FAST, 0),              /* 15 */
+        GET_ITER,                       /* 18 */
+        ARG(FOR_ITER, 24),              /* 19 */
+        ARG(STORE_FAST, 1),             /* 22 */
+        ARG(LOAD_FAST, 3),              /* 25 */
+        ARG(LOAD_FAST, 2),              /* 28 */
+        ARG(BUILD_TUPLE, 2),            /* 31 */
+        ARG(UNPACK_SEQUENCE, 2),        /* 34 */
+        ARG(STORE_FAST, 2),             /* 37 */
+        ARG(STORE_FAST, 3),             /* 40 */
+        ARG(JUMP_ABSOLUTE, 19),         /* 43 */
+        POP_BLOCK,                      /* 46 */
+        ARG(LOAD_FAST, 2),              /* 47 */
+        RETURN_VALUE,
+    };
+    static PyObject *co, *globals;
+    PyObject *res;
+    double start;
+
+    if (co == NULL) {
+        PyObject *consts;
+
+        check(consts = Py_BuildValue("(Oii)", Py_None, 0, 1), "consts");
+        co = make_code("unpack_swap", code, sizeof(code), 4, "", consts);
+        Py_DECREF(consts);
+        check(globals = PyDict_New(), "globals");
+    }
+
+    start = now();
+    res = run_code(co, globals);
+    start = now() - start;
+    if (PyLong_AsLong(res) != N % 2)
+        Py_FatalError("unpack_swap");
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+/* def f(items): return items, items
+ * v2 = f
+ * for v1 in items: v3, v4 = v2(v1)
+ * return v4 */
+static double
+bench_unpack_return(Py_ssize_t *ops)
+{
+    static const unsigned char callee[] = {
+        ARG(LOAD_FAST, 0),
+        ARG(LOAD_FAST, 0),
+        ARG(BUILD_TUPLE, 2),
+        RETURN_VALUE,
+    };
+    static const unsigned char code[] = {
+        ARG(LOAD_GLOBAL, 0),            /* 0 */
+        ARG(STORE_FAST, 2),             /* 3 */
+        ARG(SETUP_LOOP, 32),            /* 6 */
+        ARG(LOAD_FAST, 0),              /* 9 */
+        GET_ITER,                       /* 12 */
+        ARG(FOR_ITER, 24),              /* 13 */
+        ARG(STORE_FAST, 1),             /* 16 */
+        ARG(LOAD_FAST, 2),              /* 19 */
+        ARG(LOAD_FAST, 1),              /* 22 */
+        ARG(CALL_FUNCTION, 1),          /* 25 */
+        ARG(UNPACK_SEQUENCE, 2),        /* 28 */
+        ARG(STORE_FAST, 3),             /* 31 */
+        ARG(STORE_FAST, 4),             /* 34 */
+        ARG(JUMP_ABSOLUTE, 13),         /* 37 */
+        POP_BLOCK,                      /* 40 */
+        ARG(LOAD_FAST, 4),              /* 41 */
+        RETURN_VALUE,
+    };
+    static PyObject *co, *globals;
+    PyObject *res;
+    double start;
+
+    if (co == NULL) {
+        PyObject *consts, *f;
+
+        check(consts = PyTuple_Pack(1, Py_None), "consts");
+        check(globals = PyDict_New(), "globals");
+        co = make_code("f", callee, sizeof(callee), 1, "", consts);
+        check(f = PyFunction_New(co, globals), "function");
+        Py_DECREF(co);
+        co = make_code("unpack_return", code, sizeof(code), 5, "f", consts);
+        Py_DECREF(consts);
+        if (PyDict_SetItemString(globals, "f", f) < 0 ||
+            PyDict_SetItemString(globals, "__builtins__", globals) < 0)
+            Py_FatalError("globals");
+        Py_DECREF(f);
+    }
+
+    start = now();
+    res = run_code(co, globals);
+    start = now() - start;
+    if (PyLong_AsLong(res) != N - 1)
+        Py_FatalError("unpack_return");
+    Py_DECREF(res);
+    *ops = N;
+    return start;
+}
+
+static struct {
+    const char *name;
+    double (*run)(Py_ssize_t *ops);
+} benchmarks[] = {
+    {"load_global", bench_load_global},
+    {"loop_sum", bench_loop_sum},
+    {"loop_sum_traced", bench_loop_sum_traced},
+    {"loop_sum_lines", bench_loop_sum_lines},
+    {"loop_sum_profiled", bench_loop_sum_profiled},
+    {"try_except", bench_try_except},
+    {"try_finally", bench_try_finally},
+    {"with_block", bench_with_block},
+    {"try_except_raise", bench_try_except_raise},
+    {"try_finally_exit", bench_try_finally_exit},
+    {"with_suppress", bench_with_suppress},
+    {"generator_except", bench_generator_except},
+    {"load_attr_dict", bench_load_attr_dict},
+    {"load_attr_slot", bench_load_attr_slot},
+    {"load_attr_descr", bench_load_attr_descr},
+    {"load_attr_class", bench_load_attr_class},
+    {"store_attr_dict", bench_store_attr_dict},
+    {"store_attr_slot", bench_store_attr_slot},
+    {"call_attr", bench_call_attr},
+    {"call_method", bench_call_method},
+    {"call_attr_builtin", bench_call_attr_builtin},
+    {"call_method_builtin", bench_call_method_builtin},
+    {"call_function", bench_call_function},
+    {"call_function_kw", bench_call_function_kw},
+    {"call_chain", bench_call_chain},
+    {"call_dict_get", bench_call_dict_get},
+    {"call_type", bench_call_type},
+    {"binary_add_int", bench_binary_add_int},
+    {"inplace_add_int", bench_inplace_add_int},
+    {"binary_add_float", bench_binary_add_float},
+    {"binary_subscr_list", bench_binary_subscr_list},
+    {"compare_op_int", bench_compare_op_int},
+    {"compare_op_float", bench_compare_op_float},
+    {"compare_op_str", bench_compare_op_str},
+    {"for_iter_list", bench_for_iter_list},
+    {"for_iter_tuple", bench_for_iter_tuple},
+    {"for_iter_range", bench_for_iter_range},
+    {"for_iter_dict", bench_for_iter_dict},
+    {"unpack_swap", bench_unpack_swap},
+    {"unpack_return", bench_unpack_return},
+};
+
+#ifdef DYNAMIC_EXECUTION_PROFILE
+#ifndef DXPAIRS
+#error "the dispatch counts need DXPAIRS"
+#endif
+
+extern PyObject *_Py_GetDXProfile(PyObject *, PyObject *);
+
+static long cold_pairs[256][256];   /* dispatches in the first runs */
+
+/* The instructions dispatched since the last call, which are also added to
+ * 'pairs' by pair unless it's NULL */
+static long
+dispatches(long pairs[256][256])
+{
+    PyObject *profile;
+    long n, total = 0;
+    int i, j;
+
+    check(profile = _Py_GetDXProfile(NULL, NULL), "profile");
+    /* the last row has the counts by instruction */
+    for (i = 0; i < 256; i++) {
+        PyObject *row = PyList_GET_ITEM(profile, i);
+        for (j = 0; j < 256; j++) {
+            n = PyLong_AsLong(PyList_GET_ITEM(row, j));
+            total += n;
+            if (pairs != NULL)
+                pairs[i][j] += n;
+        }
+    }
+    Py_DECREF(profile);
+    return total;
+}
+
+static void
+report_dispatches(const char *name, double (*run)(Py_ssize_t *ops))
+{
+    Py_ssize_t ops = 1;
+    long cold, quickened;
+    int round;
+
+    dispatches(NULL);
+    run(&ops);
+    cold = dispatches(cold_pairs);
+    for (round = 0; round < 10; round++)
+        run(&ops);
+    dispatches(NULL);
+    run(&ops);
+    quickened = dispatches(NULL);
+    printf("%-20s %12.2f %12.2f\n", name,
+           (double)cold / ops, (double)quickened / ops);
+}
+
+static void
+report_pairs(int count)
+{
+    long total = 0, best;
+    int i, j, first = 0, second = 0;
+
+    for (i = 0; i < 256; i++)
+        for (j = 0; j < 256; j++)
+            total += cold_pairs[i][j];
+    printf("\n%-6s %-6s %10s\n", "first", "second", "share");
+    while (count-- > 0 && total > 0) {
+        best = 0;
+        for (i = 1; i < 256; i++)       /* 0 is the start of a frame */
+            for (j = 0; j < 256; j++)
+                if (cold_pairs[i][j] > best) {
+                    best = cold_pairs[i][j];
+                    first = i;
+                    second = j;
+                }
+        if (best == 0)
+            break;
+        printf("%-6d %-6d %9.1f%%\n", first, second, 100.0 * best / total);
+        cold_pairs[first][second] = 0;
+    }
+}
+#endif
+
+static int
+selected(const char *name, int argc, char **argv)
+{
+    int i;
+
+    if (argc < 2)
+        return 1;
+    for (i = 1; i < argc; i++)
+        if (strncmp(name, argv[i], strlen(argv[i])) == 0)
+            return 1;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    _PyEval_SpecializationStats stats[16];
+    PyObject *builtins;
+    size_t i;
+    Py_ssize_t j;
+    int n;
+
+    PyThreadState_Swap(PyThreadState_New(PyInterpreterState_New()));
+    if (!_PyLong_Init())
+        Py_FatalError("can't init longs");
+    _Py_ReadyTypes();
+    check(builtins = PyModule_New("builtins"), "builtins");
+    _PyExc_Init(builtins);
+    check(items = PyList_New(N), "items");
+    for (j = 0; j < N; j++)
+        PyList_SET_ITEM(items, j, PyLong_FromSsize_t(j));
+
+#ifdef DYNAMIC_EXECUTION_PROFILE
+    printf("%-20s %12s %12s\n", "dispatches/op", "cold", "quickened");
+    for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        if (selected(benchmarks[i].name, argc, argv))
+            report_dispatches(benchmarks[i].name, benchmarks[i].run);
+    }
+    report_pairs(10);
+#else
+    printf("%-20s %12s\n", "benchmark", "ns/op");
+    for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        double elapsed, best = -1.0;
+        Py_ssize_t ops = 1;
+        int round;
+
+        if (!selected(benchmarks[i].name, argc, argv))
+            continue;
+
+        /* warm up:  enough runs for the inline caches to be made */
+        for (round = 0; round < 10; round++)
+            benchmarks[i].run(&ops);
+        for (round = 0; round < ROUNDS; round++) {
+            elapsed = benchmarks[i].run(&ops);
+            if (best < 0 || elapsed < best)
+                best = elapsed;
+        }
+        printf("%-20s %12.2f\n", benchmarks[i].name, best * 1e9 / ops);
+    }
+#endif
+
+    n = _PyEval_GetSpecializationStats(stats, 16);
+    printf("\n%-24s %10s %12s %10s\n",
+           "specialized form", "rewrites", "hits", "misses");
+    for (j = 0; j < n && j < 16; j++)
+        printf("%-24s %10lu %12lu %10lu\n", stats[j].name,
+               (unsigned long)stats[j].specialized,
+               (unsigned long)stats[j].hits, (unsigned long)stats[j].misses);
+    return 0;
+}
@@ -0,0 +1,76 @@
+/* Per-request cost of building and dropping a graph of temporary objects,
+ * with and without an object region around each request, see
+ * _PyObject_RegionBegin().
+ */
+#include "Python.h"
+#include <time.h>
+
+#define NREQUESTS   2000
+#define NITEMS      2000        /* (int, float, str) tuples per request */
+
+static PyObject *kept;          /* escapes its region */
+
+/* Build a list of NITEMS tuples, keep one of them, drop the rest. */
+static void
+handle_request(int n)
+{
+    static const char names[] = "abcdefghijklmnopqrstuvwxyz";
+    PyObject *list = PyList_New(NITEMS);
+    int i;
+
+    if (list == NULL)
+        Py_FatalError("out of memory");
+    for (i = 0; i < NITEMS; i++) {
+        PyObject *t = PyTuple_New(3);
+        if (t == NULL)
+            Py_FatalError("out of memory");
+        PyTuple_SET_ITEM(t, 0, PyLong_FromLong((long)n * NITEMS + i));
+        PyTuple_SET_ITEM(t, 1, PyFloat_FromDouble(i * 0.5));
+        PyTuple_SET_ITEM(t, 2, PyUnicode_FromStringAndSize(names + i % 16,
+                                                           4 + i % 7));
+        PyList_SET_ITEM(list, i, t);
+    }
+    Py_XDECREF(kept);
+    kept = PyList_GET_ITEM(list, n % NITEMS);
+    Py_INCREF(kept);
+    Py_DECREF(list);
+}
+
+static double
+run(int use_region)
+{
+    clock_t start = clock();
+    int n;
+
+    for (n = 0; n < NREQUESTS; n++) {
+        _PyObjectRegion *region = NULL;
+        if (use_region && (region = _PyObject_RegionBegin()) == NULL)
+            Py_FatalError("can't begin a region");
+        handle_request(n);
+        if (region != NULL)
+            _PyObject_RegionEnd(region);
+    }
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main()
+{
+    int round;
+
+    PyThreadState_Swap(PyThreadState_New(PyInterpreterState_New()));
+    if (!_PyLong_Init())
+        Py_FatalError("can't init longs");
+
+    for (round = 0; round < 3; round++) {
+        double plain = run(0), region = run(1);
+        printf("per request:  obmalloc %8.1f us   region %8.1f us"
+               "   (%d objects)\n",
+               plain * 1e6 / NREQUESTS, region * 1e6 / NREQUESTS,
+               NITEMS * 4 + 1);
+    }
+    Py_CLEAR(kept);
+#ifdef WITH_PYMALLOC
+    _PyObject_DebugMallocStats(stdout);
+#endif
+    return 0;
+}
@@ -0,0 +1,181 @@
+/* Mixed-size allocation workloads, to compare obmalloc's size class layouts:
+ * build with -DPYMALLOC_ALIGNMENT=16 and/or
+ * -DPYMALLOC_SMALL_REQUEST_THRESHOLD=1024 and compare with the default.
+ *
+ * Each workload keeps NLIVE blocks alive and replaces a random one NOPS
+ * times.  It reports the time per free/malloc pair, the share of requests
+ * served by the pools, and the fragmentation at the end:  the part of the
+ * memory held for the blocks (arenas, plus what went to the raw allocator)
+ * which isn't requested bytes.  Memory behind the raw allocator is counted
+ * at its requested size, so its own overhead isn't seen.
+ */
+#include "Python.h"
+#include <time.h>
+
+#define NLIVE       (1 << 16)
+#define NOPS        (1 << 23)
+
+static void *blocks[NLIVE];
+static size_t sizes[NLIVE];
+
+static unsigned long rng_state = 12345;
+
+static unsigned long
+rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* Raw allocator wrapper counting the requests obmalloc doesn't serve.  The
+ * size is kept in a 16-byte header, so that alignment is preserved. */
+#define RAW_HEADER  16
+
+static PyMemAllocatorEx raw;
+static size_t raw_calls, raw_bytes;
+
+static void *
+raw_malloc(void *ctx, size_t size)
+{
+    char *p = raw.malloc(raw.ctx, size + RAW_HEADER);
+    if (p == NULL)
+        return NULL;
+    *(size_t *)p = size;
+    raw_calls++;
+    raw_bytes += size;
+    return p + RAW_HEADER;
+}
+
+static void *
+raw_calloc(void *ctx, size_t nelem, size_t elsize)
+{
+    void *p = raw_malloc(ctx, nelem * elsize);
+    if (p != NULL)
+        memset(p, 0, nelem * elsize);
+    return p;
+}
+
+static void
+raw_free(void *ctx, void *ptr)
+{
+    char *p = (char *)ptr - RAW_HEADER;
+    if (ptr == NULL)
+        return;
+    raw_bytes -= *(size_t *)p;
+    raw.free(raw.ctx, p);
+}
+
+static void *
+raw_realloc(void *ctx, void *ptr, size_t size)
+{
+    char *p;
+    size_t old;
+
+    if (ptr == NULL)
+        return raw_malloc(ctx, size);
+    p = (char *)ptr - RAW_HEADER;
+    old = *(size_t *)p;
+    p = raw.realloc(raw.ctx, p, size + RAW_HEADER);
+    if (p == NULL)
+        return NULL;
+    *(size_t *)p = size;
+    raw_bytes += size - old;
+    return p + RAW_HEADER;
+}
+
+/* Request sizes of the workloads */
+
+static size_t
+size_objects(void)      /* mostly small:  8 to 256 bytes */
+{
+    return 8 + (rng() % 16) * (rng() % 16);
+}
+
+static size_t
+size_mixed(void)        /* log-uniform from 1 byte to 1 KB */
+{
+    return 1 + rng() % (8 << (rng() % 8));
+}
+
+static size_t
+size_buffers(void)      /* list, dict and string buffers:  256 bytes to 2 KB */
+{
+    return 256 + rng() % 1793;
+}
+
+static void
+run(const char *name, size_t (*size_of)(void))
+{
+    _PyObject_MallocStats stats;
+    size_t i, requested = 0, misaligned = 0, footprint;
+    size_t calls_before;
+    clock_t start;
+    double elapsed;
+
+    for (i = 0; i < NLIVE; i++) {
+        sizes[i] = size_of();
+        blocks[i] = PyObject_Malloc(sizes[i]);
+    }
+
+    calls_before = raw_calls;
+    start = clock();
+    for (i = 0; i < NOPS; i++) {
+        size_t j = rng() % NLIVE;
+        PyObject_Free(blocks[j]);
+        sizes[j] = size_of();
+        blocks[j] = PyObject_Malloc(sizes[j]);
+        *(char *)blocks[j] = 1;
+    }
+    elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    for (i = 0; i < NLIVE; i++) {
+        requested += sizes[i];
+        if (sizes[i] >= 16 && ((Py_uintptr_t)blocks[i] & 15) != 0)
+            misaligned++;
+    }
+    _PyObject_GetMallocStats(&stats);
+    footprint = stats.arenas * (256 << 10) + raw_bytes;
+
+    printf("%-8s %8.1f %9.1f%% %12.1f %9.1f%% %11.1f%%\n",
+           name, elapsed * 1e9 / NOPS,
+           100.0 - 100.0 * (raw_calls - calls_before) / NOPS,
+           footprint / 1048576.0,
+           100.0 - 100.0 * requested / footprint,
+           100.0 * misaligned / NLIVE);
+
+    for (i = 0; i < NLIVE; i++)
+        PyObject_Free(blocks[i]);
+}
+
+int main()
+{
+    PyMemAllocatorEx hooks = {NULL, raw_malloc, raw_calloc, raw_realloc,
+                              raw_free};
+    _PyObject_MallocStats stats;
+
+    /* before anything is allocated, so that every raw block has a header */
+    PyMem_GetAllocator(PYMEM_DOMAIN_RAW, &raw);
+    PyMem_SetAllocator(PYMEM_DOMAIN_RAW, &hooks);
+
+    PyThreadState_Swap(PyThreadState_New(PyInterpreterState_New()));
+    if (!_PyLong_Init())
+        Py_FatalError("can't init longs");
+
+    _PyObject_GetMallocStats(&stats);
+    if (stats.num_size_classes == 0)
+        printf("pymalloc is disabled in this build.\n");
+    else
+        printf("%u size classes of %u bytes, up to %u bytes\n",
+               stats.num_size_classes,
+               (unsigned)stats.size_classes[0].block_size,
+               (unsigned)(stats.num_size_classes *
+                          stats.size_classes[0].block_size));
+    printf("workload    ns/op    pooled   footprint MB      frag"
+           "   not 16-aligned\n");
+    run("objects", size_objects);
+    run("mixed", size_mixed);
+    run("buffers", size_buffers);
+    return 0;
+}
@@ -6,6 +6,9 @@ set MACRO_DEFINE=/DPy_BUILD_CORE /DPy_NO_ENABLE_SHARED
 set HEAD_FOLDER=/I..\Include /I..\PC
 set CC=cl /Zi /w /c %MACRO_DEFINE% %HEAD_FOLDER%
 
+rem program objects must not end up in the library
+del test.obj stubs.obj bench_*.obj 2> nul
+
 @echo on
 
 REM ** Object **
@@ -63,6 +66,34 @@ REM ** Python **
 %CC% ..\Python\_warnings.c
 %CC% ..\Python\structmember.c
 %CC% ..\Python\codecs.c
+%CC% ..\Python\memsampler.c
+
+lib /nologo /out:pycore.lib *.obj
 
+REM ** Programs **
+%CC% stubs.c
 %CC% test.c
-link /out:test.exe /debug *.obj
+link /out:test.exe /debug test.obj stubs.obj pycore.lib
+%CC% bench_core.c
+link /out:bench_core.exe /debug bench_core.obj stubs.obj pycore.lib
+%CC% bench_eval.c
+link /out:bench_eval.exe /debug bench_eval.obj stubs.obj pycore.lib
+%CC% /DDYNAMIC_EXECUTION_PROFILE /DDXPAIRS /Fobench_eval_dxp.obj bench_eval.c
+%CC% /DDYNAMIC_EXECUTION_PROFILE /DDXPAIRS /Fobench_ceval_dxp.obj ..\Python\ceval.c
+link /out:bench_eval_dxp.exe /debug bench_eval_dxp.obj bench_ceval_dxp.obj stubs.obj pycore.lib
+%CC% bench_arenas.c
+link /out:bench_arenas.exe /debug bench_arenas.obj stubs.obj pycore.lib
+%CC% bench_regions.c
+link /out:bench_regions.exe /debug bench_regions.obj stubs.obj pycore.lib
+%CC% bench_sizes.c
+link /out:bench_sizes.exe /debug bench_sizes.obj stubs.obj pycore.lib
+%CC% /DPYMALLOC_ALIGNMENT=16 /Fobench_obmalloc_a16.obj ..\Objects\obmalloc.c
+link /out:bench_sizes_a16.exe /debug bench_sizes.obj bench_obmalloc_a16.obj stubs.obj pycore.lib
+%CC% /DPYMALLOC_SMALL_REQUEST_THRESHOLD=1024 /Fobench_obmalloc_1k.obj ..\Objects\obmalloc.c
+link /out:bench_sizes_1k.exe /debug bench_sizes.obj bench_obmalloc_1k.obj stubs.obj pycore.lib
+%CC% /DPYMALLOC_ALIGNMENT=16 /DPYMALLOC_SMALL_REQUEST_THRESHOLD=1024 /Fobench_obmalloc_a16_1k.obj ..\Objects\obmalloc.c
+link /out:bench_sizes_a16_1k.exe /debug bench_sizes.obj bench_obmalloc_a16_1k.obj stubs.obj pycore.lib
+%CC% bench_dict.c
+link /out:bench_dict.exe /debug bench_dict.obj stubs.obj pycore.lib
+%CC% /DDICT_PERTURB_PROBE /Fobench_dictobject_perturb.obj ..\Objects\dictobject.c
+link /out:bench_dict_perturb.exe /debug bench_dict.obj bench_dictobject_perturb.obj stubs.obj pycore.lib
@@ -2,6 +2,7 @@
 
 del *.obj
 del *.exe
+del *.lib
 del *.pdb
 del *.ilk
 del *.suo
\ No newline at end of file
@@ -0,0 +1,259 @@
+/* Stand-ins for the parts of the runtime (sys, import, gc, ...) which are
+ * not part of this tree, shared by test.c and the benchmark programs.
+ */
+#include "Python.h"
+#include <stdarg.h>
+#include <ctype.h>
+
+void
+Py_FatalError(const char *msg)
+{
+    fprintf(stderr, "FATAL ERROR: %s\n", msg);
+    exit(1);
+}
+
+int Py_VerboseFlag;
+int Py_BytesWarningFlag;
+int Py_IgnoreEnvironmentFlag;
+
+/* Normally set by _PyRandom_Init():  the hash secret stays all zeros */
+int _Py_HashSecret_Initialized = 1;
+
+/* Normally in bltinmodule.c; NULL selects the locale codec */
+#ifndef HAVE_MBCS
+const char *Py_FileSystemDefaultEncoding = NULL;
+#endif
+
+int
+PyOS_snprintf(char *str, size_t size, const  char  *format, ...)
+{
+    int rc;
+    va_list va;
+
+    va_start(va, format);
+    rc = vsnprintf(str, size, format, va);
+    va_end(va);
+    return rc;
+}
+
+PyObject *
+_PySys_GetObjectId(_Py_Identifier *key)
+{
+    return NULL;
+}
+
+PyObject *
+PySys_GetXOptions(void)
+{
+    return NULL;
+}
+
+void
+PySys_WriteStderr(const char *format, ...)
+{
+    va_list va;
+
+    va_start(va, format);
+    vfprintf(stderr, format, va);
+    va_end(va);
+}
+
+void
+PySys_FormatStderr(const char *format, ...)
+{
+    va_list va;
+
+    va_start(va, format);
+    //sys_format(&PyId_stderr, stderr, format, va);
+    va_end(va);
+}
+
+int
+PyErr_CheckSignals(void)
+{
+    return 0;
+}
+
+void
+PyErr_Print(void)
+{
+}
+
+PyObject *PyExc_OverflowError, *PyExc_TypeError, *PyExc_ValueError, *PyExc_ZeroDivisionError, *PyExc_DeprecationWarning;
+PyObject *PyExc_IndexError, *PyExc_SystemError, *PyExc_BufferError, *PyExc_StopIteration, *PyExc_AttributeError;
+PyObject *PyExc_KeyError, *PyExc_MemoryError, *PyExc_RuntimeError, *PyExc_ImportError, *PyExc_NotImplementedError;
+PyObject *PyExc_RuntimeWarning;
+
+/* A single generation which is never collected:  just enough of gcmodule.c
+ * for the _PyObject_GC_TRACK() family of macros to work.
+ */
+#define AS_GC(o) ((PyGC_Head *)(o)-1)
+#define FROM_GC(g) ((PyObject *)(((PyGC_Head *)g)+1))
+
+static PyGC_Head generation0 = {{&generation0, &generation0, 0}};
+PyGC_Head *_PyGC_generation0 = &generation0;
+
+void
+PyObject_GC_Track(void *op)
+{
+    _PyObject_GC_TRACK(op);
+}
+
+void
+PyObject_GC_UnTrack(void *op)
+{
+    /* Obscure:  the Py_TRASHCAN mechanism requires that we be able to
+     * call PyObject_GC_UnTrack twice on an object.
+     */
+    if (_PyObject_GC_IS_TRACKED(op))
+        _PyObject_GC_UNTRACK(op);
+}
+
+PyObject *
+_PyObject_GC_Malloc(size_t basicsize)
+{
+    PyGC_Head *g;
+    if (basicsize > PY_SSIZE_T_MAX - sizeof(PyGC_Head))
+        return PyErr_NoMemory();
+    g = (PyGC_Head *)PyObject_Malloc(sizeof(PyGC_Head) + basicsize);
+    if (g == NULL)
+        return PyErr_NoMemory();
+    g->gc.gc_refs = 0;
+    _PyGCHead_SET_REFS(g, _PyGC_REFS_UNTRACKED);
+    return FROM_GC(g);
+}
+
+PyObject *
+_PyObject_GC_New(PyTypeObject *tp)
+{
+    PyObject *op = _PyObject_GC_Malloc(_PyObject_SIZE(tp));
+    if (op != NULL)
+        op = PyObject_INIT(op, tp);
+    return op;
+}
+
+PyVarObject *
+_PyObject_GC_NewVar(PyTypeObject *tp, Py_ssize_t nitems)
+{
+    size_t size;
+    PyVarObject *op;
+
+    if (nitems < 0) {
+        PyErr_BadInternalCall();
+        return NULL;
+    }
+    size = _PyObject_VAR_SIZE(tp, nitems);
+    op = (PyVarObject *) _PyObject_GC_Malloc(size);
+    if (op != NULL)
+        op = PyObject_INIT_VAR(op, tp, nitems);
+    return op;
+}
+
+void
+PyObject_GC_Del(void *op)
+{
+    if (_PyObject_GC_IS_TRACKED(op))
+        _PyObject_GC_UNTRACK(op);
+    PyObject_FREE(AS_GC(op));
+}
+
+PyVarObject *
+_PyObject_GC_Resize(PyVarObject *op, Py_ssize_t nitems)
+{
+    const size_t basicsize = _PyObject_VAR_SIZE(Py_TYPE(op), nitems);
+    PyGC_Head *g = AS_GC(op);
+    if (basicsize > PY_SSIZE_T_MAX - sizeof(PyGC_Head))
+        return (PyVarObject *)PyErr_NoMemory();
+    g = (PyGC_Head *)PyObject_REALLOC(g,  sizeof(PyGC_Head) + basicsize);
+    if (g == NULL)
+        return (PyVarObject *)PyErr_NoMemory();
+    op = (PyVarObject *) FROM_GC(g);
+    Py_SIZE(op) = nitems;
+    return op;
+}
+
+PyObject *
+_Py_strhex(const char* argbuf, const Py_ssize_t arglen)
+{
+    return NULL;
+}
+
+PyObject *
+PyImport_ImportModule(const char *name)
+{
+    return NULL;
+}
+
+PyObject *
+PyImport_Import(PyObject *module_name)
+{
+    return NULL;
+}
+
+int
+_PyComplex_FormatAdvancedWriter(_PyUnicodeWriter *writer,
+                                PyObject *obj,
+                                PyObject *format_spec,
+                                Py_ssize_t start, Py_ssize_t end)
+{
+    return -1;
+}
+
+int
+_PyLong_FormatAdvancedWriter(_PyUnicodeWriter *writer,
+                             PyObject *obj,
+                             PyObject *format_spec,
+                             Py_ssize_t start, Py_ssize_t end)
+{
+    return -1;
+}
+
+int
+_PyFloat_FormatAdvancedWriter(_PyUnicodeWriter *writer,
+                              PyObject *obj,
+                              PyObject *format_spec,
+                              Py_ssize_t start, Py_ssize_t end)
+{
+    return -1;
+}
+
+int
+_PyUnicode_FormatAdvancedWriter(_PyUnicodeWriter *writer,
+                                PyObject *obj,
+                                PyObject *format_spec,
+                                Py_ssize_t start, Py_ssize_t end)
+{
+    return -1;
+}
+
+char *
+PyTokenizer_FindEncodingFilename(int fd, PyObject *filename)
+{
+    return NULL;
+}
+
+PyObject *
+PySys_GetObject(const char *name)
+{
+    return NULL;
+}
+
+PyObject *
+PyImport_ImportModuleNoBlock(const char *name)
+{
+    return NULL;
+}
+
+PyObject *
+PyImport_GetModuleDict(void)
+{
+    return NULL;
+}
+
+PyObject *
+_Py_Mangle(PyObject *privateobj, PyObject *ident)
+{
+    /* no private names without the compiler:  __slots__ are kept as is */
+    Py_INCREF(ident);
+    return ident;
+}
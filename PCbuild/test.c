@@ -1,16 +1,165 @@
 #include "Python.h"
-#include <stdarg.h>
-#include <ctype.h>
+#include "code.h"
+#include "opcode.h"
+
+/* Sample the allocations of "for v in items: v + 1000", all made on line 1
+   of one code object, and return the number of stacks the samples were
+   aggregated into.  Store the samples lost in *lost. */
+static long
+sample_one_stack(size_t max_stacks, long *lost)
+{
+    static const unsigned char code[] = {
+        LOAD_FAST, 0, 0,
+        GET_ITER,
+        FOR_ITER, 14, 0,
+        STORE_FAST, 1, 0,
+        LOAD_FAST, 1, 0,
+        LOAD_CONST, 1, 0,
+        BINARY_ADD,
+        POP_TOP,
+        JUMP_ABSOLUTE, 4, 0,
+        LOAD_CONST, 0, 0,
+        RETURN_VALUE,
+    };
+    PyObject *bytes, *consts, *varnames, *empty, *name, *co, *items;
+    PyObject *globals, *res;
+    long i, nstacks = -1, nlines = 0;
+    unsigned long nsamples, sample_bytes;
+    char line[256];
+    FILE *out;
+
+    bytes = PyBytes_FromStringAndSize((const char *)code, sizeof(code));
+    consts = Py_BuildValue("(Oi)", Py_None, 1000);
+    varnames = Py_BuildValue("(ss)", "items", "v");
+    empty = PyTuple_New(0);
+    name = PyUnicode_FromString("sampled");
+    co = (PyObject *)PyCode_New(1, 0, 2, 4, CO_OPTIMIZED | CO_NEWLOCALS,
+                                bytes, consts, empty, varnames, empty, empty,
+                                name, name, 1, PyBytes_FromString(""));
+    items = PyList_New(10000);
+    for (i = 0; i < 10000; i++)
+        PyList_SET_ITEM(items, i, PyLong_FromLong(i));
+    globals = PyDict_New();
+
+    if (_PyMem_StartSampling(64, 8, max_stacks) < 0)
+        Py_FatalError("can't start sampling");
+    res = PyEval_EvalCodeEx(co, globals, NULL, &items, 1,
+                            NULL, 0, NULL, 0, NULL, NULL);
+    if (res == NULL)
+        Py_FatalError("sampled code failed");
+    /* An allocation outside Python code, worth about 100 samples */
+    PyMem_Free(PyMem_Malloc(6400));
+    _PyMem_StopSampling();
+
+    out = tmpfile();
+    _PyMem_DumpSamples(out);
+    rewind(out);
+    if (fscanf(out, "%lu samples, one per %lu bytes, %ld stacks, %ld",
+               &nsamples, &sample_bytes, &nstacks, lost) != 4)
+        Py_FatalError("can't read the samples");
+    while (fgets(line, sizeof(line), out) != NULL) {
+        if (strstr(line, "line 1, in sampled") != NULL)
+            nlines++;
+    }
+    fclose(out);
+    _PyMem_ClearSamples();
+    /* The stack of the code object must be in one entry, not several,
+       unless the table was already full */
+    if (nlines > 1 || (nlines == 0 && *lost == 0))
+        Py_FatalError("samples of one stack in several entries");
+    return nstacks;
+}
+
+#define NPENDING 1000
+
+static long pending_run[NPENDING + 2];
+static long npending_run = 0;
+static long npending_queued = 0;
 
-void
-Py_FatalError(const char *msg)
+static PyMemAllocatorEx raw_alloc;
+static int raw_malloc_fails = 0;
+
+static void *
+failing_raw_malloc(void *ctx, size_t size)
 {
-    fprintf(stderr, "FATAL ERROR: %s\n", msg);
-    exit(1);
+    if (raw_malloc_fails)
+        return NULL;
+    return raw_alloc.malloc(raw_alloc.ctx, size);
+}
+
+static int
+record_pending_call(void *arg)
+{
+    _PyEval_PendingCallStats stats;
+
+    if (npending_run >= NPENDING + 2)
+        Py_FatalError("too many pending calls run");
+    pending_run[npending_run++] = (long)(Py_intptr_t)arg;
+    /* The call being run is no longer waiting */
+    _PyEval_GetPendingCallStats(&stats);
+    if (stats.depth != npending_queued - npending_run)
+        Py_FatalError("wrong pending call depth while running");
+    /* Queued while the ring has free slots again but older calls are still
+       on the fallback list:  it must run after them */
+    if (npending_run == 100) {
+        if (Py_AddPendingCall(record_pending_call,
+                              (void *)(Py_intptr_t)npending_queued) < 0)
+            Py_FatalError("can't queue a pending call from a pending call");
+        npending_queued++;
+    }
+    return 0;
 }
 
-int Py_VerboseFlag;
-int Py_BytesWarningFlag;
+/* Queue more pending calls than the ring holds, make the allocation of the
+   fallback list fail once, and check that the calls run once each, in the
+   order they were queued.  Return the number of calls run. */
+static long
+run_pending_calls(size_t *overflowed, size_t *dropped)
+{
+    PyMemAllocatorEx hooks = {NULL, failing_raw_malloc, NULL, NULL, NULL};
+    _PyEval_PendingCallStats stats;
+    long i;
+
+    PyMem_GetAllocator(PYMEM_DOMAIN_RAW, &raw_alloc);
+    hooks.calloc = raw_alloc.calloc;
+    hooks.realloc = raw_alloc.realloc;
+    hooks.free = raw_alloc.free;
+    hooks.ctx = raw_alloc.ctx;
+    PyMem_SetAllocator(PYMEM_DOMAIN_RAW, &hooks);
+
+    for (i = 0; i < NPENDING; i++) {
+        if (Py_AddPendingCall(record_pending_call, (void *)(Py_intptr_t)i) < 0)
+            Py_FatalError("can't queue a pending call");
+    }
+    npending_queued = NPENDING;
+    /* The ring is full and the fallback list can't grow */
+    raw_malloc_fails = 1;
+    if (Py_AddPendingCall(record_pending_call, NULL) == 0 ||
+        _Py_AddPendingCallNoAlloc(record_pending_call, NULL) == 0)
+        Py_FatalError("pending call queued without memory");
+    raw_malloc_fails = 0;
+
+    _PyEval_GetPendingCallStats(&stats);
+    if (stats.depth != NPENDING || stats.added != NPENDING)
+        Py_FatalError("wrong pending call depth");
+    while (npending_run < npending_queued) {
+        i = npending_run;
+        if (Py_MakePendingCalls() < 0 || npending_run == i)
+            Py_FatalError("pending calls not run");
+    }
+    PyMem_SetAllocator(PYMEM_DOMAIN_RAW, &raw_alloc);
+
+    for (i = 0; i < npending_run; i++) {
+        if (pending_run[i] != i)
+            Py_FatalError("pending calls run out of order");
+    }
+    _PyEval_GetPendingCallStats(&stats);
+    if (stats.depth != 0 || stats.added != (size_t)npending_run)
+        Py_FatalError("pending calls left over");
+    *overflowed = stats.overflowed;
+    *dropped = stats.dropped;
+    return npending_run;
+}
 
 int main()
 {
@@ -21,6 +170,8 @@ int main()
     void *ptr = PyMem_Malloc(1024);
     PyMem_Free(ptr);
     
+    PyThreadState_Swap(PyThreadState_New(PyInterpreterState_New()));
+
     if (!_PyLong_Init())
         Py_FatalError("Py_Initialize: can't init longs");
     
@@ -30,7 +181,7 @@ int main()
     y = PyLong_FromLong(60);
     z = PyLong_Type.tp_as_number->nb_remainder(x, y);
     result = PyLong_AsLong(z);
-    printf("1+2=%d\n", result);
+    printf("1+2=%ld\n", result);
     
     PyObject *t, *f, *zz;
     t = PyBool_FromLong(1);
@@ -45,193 +196,25 @@ int main()
     double d = PyFloat_AsDouble(f3);
     printf("10.5*15.4 = %f\n", d);
     
+    PyObject *dict, *copy;
+    dict = PyDict_New();
+    PyDict_SetItem(dict, x, y);
+    PyDict_Clear(dict);
+    copy = PyDict_Copy(dict);
+    printf("len(cleared dict copy) = %d\n", (int)PyDict_Size(copy));
+    
+    long nstacks, lost;
+    _Py_ReadyTypes();
+    nstacks = sample_one_stack(16, &lost);
+    printf("sampled stacks = %ld, lost = %ld\n", nstacks, lost);
+    nstacks = sample_one_stack(1, &lost);
+    printf("sampled stacks at most 1 = %ld, lost > 0 is %s\n", nstacks,
+           lost > 0 ? "True" : "False");
+    
+    size_t overflowed, dropped;
+    result = run_pending_calls(&overflowed, &dropped);
+    printf("pending calls run in order = %ld, overflowed = %lu, dropped = %lu\n",
+           result, (unsigned long)overflowed, (unsigned long)dropped);
+    
     return 0;
 }
-
-// missed functions
-int
-PyOS_snprintf(char *str, size_t size, const  char  *format, ...)
-{
-    int rc;
-    va_list va;
-
-    va_start(va, format);
-    rc = vsnprintf(str, size, format, va);
-    va_end(va);
-    return rc;
-}
-
-PyObject *
-_PySys_GetObjectId(_Py_Identifier *key)
-{
-}
-
-void
-PySys_WriteStderr(const char *format, ...)
-{
-    va_list va;
-
-    va_start(va, format);
-    vfprintf(stderr, format, va);
-    va_end(va);
-}
-
-void
-PySys_FormatStderr(const char *format, ...)
-{
-    va_list va;
-
-    va_start(va, format);
-    //sys_format(&PyId_stderr, stderr, format, va);
-    va_end(va);
-}
-
-int
-PyErr_CheckSignals(void)
-{
-    return 0;
-}
-
-void
-PyErr_Print(void)
-{
-}
-
-PyObject *PyExc_OverflowError, *PyExc_TypeError, *PyExc_ValueError, *PyExc_ZeroDivisionError, *PyExc_DeprecationWarning;
-PyObject *PyExc_IndexError, *PyExc_SystemError, *PyExc_BufferError, *PyExc_StopIteration, *PyExc_AttributeError;
-PyObject *PyExc_KeyError, *PyExc_MemoryError, *PyExc_RuntimeError, *PyExc_ImportError, *PyExc_NotImplementedError;
-PyObject *PyExc_RuntimeWarning;
-
-PyGC_Head *_PyGC_generation0;
-
-void
-PyObject_GC_Track(void *op)
-{
-    _PyObject_GC_TRACK(op);
-}
-
-void
-PyObject_GC_UnTrack(void *op)
-{
-    /* Obscure:  the Py_TRASHCAN mechanism requires that we be able to
-     * call PyObject_GC_UnTrack twice on an object.
-     */
-    //if (IS_TRACKED(op))
-        _PyObject_GC_UNTRACK(op);
-}
-
-PyObject *
-_PyObject_GC_New(PyTypeObject *tp)
-{
-    PyObject *op = PyObject_Malloc(_PyObject_SIZE(tp));
-    if (op != NULL)
-        op = PyObject_INIT(op, tp);
-    return op;
-}
-
-PyVarObject *
-_PyObject_GC_NewVar(PyTypeObject *tp, Py_ssize_t nitems)
-{
-    size_t size;
-    PyVarObject *op;
-
-    if (nitems < 0) {
-        PyErr_BadInternalCall();
-        return NULL;
-    }
-    size = _PyObject_VAR_SIZE(tp, nitems);
-    op = (PyVarObject *) PyObject_Malloc(size);
-    if (op != NULL)
-        op = PyObject_INIT_VAR(op, tp, nitems);
-    return op;
-}
-
-PyObject *
-_PyObject_GC_Malloc(size_t basicsize)
-{
-    PyObject_Malloc(basicsize);
-}
-
-void
-PyObject_GC_Del(void *op)
-{
-    PyObject_FREE(op);
-}
-
-PyVarObject *
-_PyObject_GC_Resize(PyVarObject *op, Py_ssize_t nitems)
-{
-}
-
-PyObject *
-_Py_strhex(const char* argbuf, const Py_ssize_t arglen)
-{
-}
-
-PyObject *
-PyImport_ImportModule(const char *name)
-{
-}
-
-PyObject *
-PyImport_Import(PyObject *module_name)
-{
-}
-
-int
-_PyComplex_FormatAdvancedWriter(_PyUnicodeWriter *writer,
-                                PyObject *obj,
-                                PyObject *format_spec,
-                                Py_ssize_t start, Py_ssize_t end)
-{
-}
-
-int
-_PyLong_FormatAdvancedWriter(_PyUnicodeWriter *writer,
-                             PyObject *obj,
-                             PyObject *format_spec,
-                             Py_ssize_t start, Py_ssize_t end)
-{
-}
-
-int
-_PyFloat_FormatAdvancedWriter(_PyUnicodeWriter *writer,
-                              PyObject *obj,
-                              PyObject *format_spec,
-                              Py_ssize_t start, Py_ssize_t end)
-{
-}
-
-int
-_PyUnicode_FormatAdvancedWriter(_PyUnicodeWriter *writer,
-                                PyObject *obj,
-                                PyObject *format_spec,
-                                Py_ssize_t start, Py_ssize_t end)
-{
-}
-
-char *
-PyTokenizer_FindEncodingFilename(int fd, PyObject *filename)
-{
-}
-
-PyObject *
-PySys_GetObject(const char *name)
-{
-}
-
-PyObject *
-PyImport_ImportModuleNoBlock(const char *name)
-{
-    return NULL;
-}
-
-PyObject *
-PyImport_GetModuleDict(void)
-{
-}
-
-PyObject *
-_Py_Mangle(PyObject *privateobj, PyObject *ident)
-{
-}
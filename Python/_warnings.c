@@ -514,7 +514,7 @@ warn_explicit(PyObject *category, PyObject *message,
 }
 
 static int
-is_internal_frame(PyFrameObject *frame)
+is_internal_frame(_PyInterpreterFrame *frame)
 {
     static PyObject *importlib_string = NULL;
     static PyObject *bootstrap_string = NULL;
@@ -561,11 +561,11 @@ is_internal_frame(PyFrameObject *frame)
     return 0;
 }
 
-static PyFrameObject *
-next_external_frame(PyFrameObject *frame)
+static _PyInterpreterFrame *
+next_external_frame(_PyInterpreterFrame *frame)
 {
     do {
-        frame = frame->f_back;
+        frame = frame->f_previous;
     } while (frame != NULL && is_internal_frame(frame));
 
     return frame;
@@ -580,12 +580,12 @@ setup_context(Py_ssize_t stack_level, PyObject **filename, int *lineno,
     PyObject *globals;
 
     /* Setup globals and lineno. */
-    PyFrameObject *f = PyThreadState_GET()->frame;
+    _PyInterpreterFrame *f = PyThreadState_GET()->frame;
     // Stack level comparisons to Python code is off by one as there is no
     // warnings-related stack level to avoid.
     if (stack_level <= 0 || is_internal_frame(f)) {
         while (--stack_level > 0 && f != NULL) {
-            f = f->f_back;
+            f = f->f_previous;
         }
     }
     else {
@@ -600,7 +600,7 @@ setup_context(Py_ssize_t stack_level, PyObject **filename, int *lineno,
     }
     else {
         globals = f->f_globals;
-        *lineno = PyFrame_GetLineNumber(f);
+        *lineno = _PyFrame_GetLineNumber(f);
     }
 
     *module = NULL;
@@ -14,30 +14,29 @@
 #include "code.h"
 #include "dictobject.h"
 #include "frameobject.h"
+#include "longintrepr.h"
 #include "opcode.h"
 #include "setobject.h"
 #include "structmember.h"
 
 #include <ctype.h>
 
-#ifndef WITH_TSC
+/* The timestamp counter, which times the instructions of the opcode profile,
+   see _PyEval_SetOpcodeProfile() */
 
-#define READ_TIMESTAMP(var)
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
 
-#else
-
-typedef unsigned long long uint64;
+#include <intrin.h>
+#define READ_TIMESTAMP(var) ((var) = __rdtsc())
 
-/* PowerPC support.
-   "__ppc__" appears to be the preprocessor definition to detect on OS X, whereas
-   "__powerpc__" appears to be the correct one for Linux with GCC
-*/
-#if defined(__ppc__) || defined (__powerpc__)
+#elif defined(__GNUC__) && (defined(__ppc__) || defined (__powerpc__))
 
+/* "__ppc__" appears to be the preprocessor definition to detect on OS X,
+   whereas "__powerpc__" appears to be the correct one for Linux with GCC */
 #define READ_TIMESTAMP(var) ppc_getcounter(&var)
 
 static void
-ppc_getcounter(uint64 *v)
+ppc_getcounter(PY_UINT64_T *v)
 {
     unsigned long tbu, tb, tbu2;
 
@@ -53,14 +52,14 @@ ppc_getcounter(uint64 *v)
     ((long*)(v))[1] = tb;
 }
 
-#elif defined(__i386__)
+#elif defined(__GNUC__) && defined(__i386__)
 
 /* this is for linux/x86 (and probably any other GCC/x86 combo) */
 
 #define READ_TIMESTAMP(val) \
      __asm__ __volatile__("rdtsc" : "=A" (val))
 
-#elif defined(__x86_64__)
+#elif defined(__GNUC__) && defined(__x86_64__)
 
 /* for gcc/x86_64, the "A" constraint in DI mode means *either* rax *or* rdx;
    not edx:eax as it does for i386.  Since rdtsc puts its result in edx:eax
@@ -70,29 +69,22 @@ ppc_getcounter(uint64 *v)
 #define READ_TIMESTAMP(val) do {                        \
     unsigned int h, l;                                  \
     __asm__ __volatile__("rdtsc" : "=a" (l), "=d" (h)); \
-    (val) = ((uint64)l) | (((uint64)h) << 32);          \
+    (val) = ((PY_UINT64_T)l) | (((PY_UINT64_T)h) << 32); \
     } while(0)
 
+#elif defined(HAVE_CLOCK_GETTIME)
 
-#else
-
-#error "Don't know how to implement timestamp counter for this architecture"
+/* no timestamp counter:  nanoseconds */
+#define READ_TIMESTAMP(val) do {                        \
+    struct timespec ts;                                 \
+    clock_gettime(CLOCK_MONOTONIC, &ts);                \
+    (val) = (PY_UINT64_T)ts.tv_sec * 1000000000 + ts.tv_nsec; \
+    } while(0)
 
-#endif
+#else
 
-void dump_tsc(int opcode, int ticked, uint64 inst0, uint64 inst1,
-              uint64 loop0, uint64 loop1, uint64 intr0, uint64 intr1)
-{
-    uint64 intr, inst, loop;
-    PyThreadState *tstate = PyThreadState_Get();
-    if (!tstate->interp->tscdump)
-        return;
-    intr = intr1 - intr0;
-    inst = inst1 - inst0 - intr;
-    loop = loop1 - loop0 - intr;
-    fprintf(stderr, "opcode=%03d t=%d inst=%06lld loop=%06lld\n",
-            opcode, ticked, inst, loop);
-}
+/* nothing to time the instructions with:  they only get counted */
+#define READ_TIMESTAMP(val) ((val) = 0)
 
 #endif
 
@@ -108,18 +100,14 @@ void dump_tsc(int opcode, int ticked, uint64 inst0, uint64 inst1,
 typedef PyObject *(*callproc)(PyObject *, PyObject *, PyObject *);
 
 /* Forward declarations */
-#ifdef WITH_TSC
-static PyObject * call_function(PyObject ***, int, uint64*, uint64*);
-#else
 static PyObject * call_function(PyObject ***, int);
-#endif
-static PyObject * fast_function(PyObject *, PyObject ***, int, int, int);
-static PyObject * do_call(PyObject *, PyObject ***, int, int);
+static PyObject * stack_kwnames(PyObject ***, int);
+static PyObject * function_call(PyObject *, PyObject **, Py_ssize_t,
+                                PyObject **, PyObject **, int, int);
 static PyObject * ext_do_call(PyObject *, PyObject ***, int, int, int);
 static PyObject * update_keyword_args(PyObject *, int, PyObject ***,
                                       PyObject *);
 static PyObject * update_star_args(int, int, PyObject *, PyObject ***);
-static PyObject * load_args(PyObject ***, int);
 #define CALL_FLAG_VAR 1
 #define CALL_FLAG_KW 2
 
@@ -128,15 +116,15 @@ static int lltrace;
 static int prtrace(PyObject *, char *);
 #endif
 static int call_trace(Py_tracefunc, PyObject *,
-                      PyThreadState *, PyFrameObject *,
+                      PyThreadState *, _PyInterpreterFrame *,
                       int, PyObject *);
 static int call_trace_protected(Py_tracefunc, PyObject *,
-                                PyThreadState *, PyFrameObject *,
+                                PyThreadState *, _PyInterpreterFrame *,
                                 int, PyObject *);
 static void call_exc_trace(Py_tracefunc, PyObject *,
-                           PyThreadState *, PyFrameObject *);
+                           PyThreadState *, _PyInterpreterFrame *);
 static int maybe_call_line_trace(Py_tracefunc, PyObject *,
-                                 PyThreadState *, PyFrameObject *, int *, int *, int *);
+                                 PyThreadState *, _PyInterpreterFrame *, int *, int *, int *);
 
 static PyObject * cmp_outcome(int, PyObject *, PyObject *);
 static PyObject * import_from(PyObject *, PyObject *);
@@ -144,8 +132,20 @@ static int import_all_from(PyObject *, PyObject *);
 static void format_exc_check_arg(PyObject *, const char *, PyObject *);
 static void format_exc_unbound(PyCodeObject *co, int oparg);
 static PyObject * unicode_concatenate(PyObject *, PyObject *,
-                                      PyFrameObject *, unsigned char *);
+                                      _PyInterpreterFrame *, unsigned char *);
 static PyObject * special_lookup(PyObject *, _Py_Identifier *);
+static int starts_table_block(PyCodeObject *, int);
+static int attr_shadowed(_PyOpcache_Attr *, PyObject *, PyObject *);
+static int load_attr_cached(_PyOpcache_Attr *, PyObject *, PyObject *,
+                            PyObject **);
+static int store_attr_cached(_PyOpcache_Attr *, PyObject *, PyObject *,
+                             PyObject *, int *);
+static void attr_cache_fill(_PyOpcache *, PyObject *, PyObject *, int);
+static void specialize(PyCodeObject *, int, _PyOpcache *, int,
+                       PyObject *, PyObject *);
+static void profile_instruction(PyThreadState *, PyCodeObject *,
+                                int, int);
+static void profile_stop_timing(struct _opcode_profile *);
 
 #define NAME_ERROR_MSG \
     "name '%.200s' is not defined"
@@ -165,6 +165,14 @@ static long dxp[256];
 #endif
 #endif
 
+/* Counts of the specialized forms, by opcode, see
+   _PyEval_GetSpecializationStats() */
+static struct {
+    size_t specialized;
+    size_t hits;
+    size_t misses;
+} specialization_stats[256];
+
 /* Function call profile */
 #ifdef CALL_PROFILE
 #define PCALL_NUM 11
@@ -254,7 +262,7 @@ PyEval_GetCallStats(PyObject *self)
 
 #endif
 
-/* Pending calls are only modified under pending_lock */
+/* Set by whoever queues a pending call, reset by Py_MakePendingCalls() */
 #define SIGNAL_PENDING_CALLS() \
     do { \
         _Py_atomic_store_relaxed(&pendingcalls_to_do, 1); \
@@ -284,7 +292,6 @@ PyEval_GetCallStats(PyObject *self)
 #endif
 #include "pythread.h"
 
-static PyThread_type_lock pending_lock = 0; /* for pending calls */
 static long main_thread = 0;
 /* This single variable consolidates all requests to break out of the fast path
    in the eval loop. */
@@ -313,8 +320,6 @@ PyEval_InitThreads(void)
     create_gil();
     take_gil(PyThreadState_GET());
     main_thread = PyThread_get_thread_ident();
-    if (!pending_lock)
-        pending_lock = PyThread_allocate_lock();
 }
 
 void
@@ -384,7 +389,6 @@ PyEval_ReInitThreads(void)
     if (!gil_created())
         return;
     recreate_gil();
-    pending_lock = PyThread_allocate_lock();
     take_gil(current_tstate);
     main_thread = PyThread_get_thread_ident();
 
@@ -410,6 +414,7 @@ PyEval_ReInitThreads(void)
 
 #else
 static _Py_atomic_int eval_breaker = {0};
+static _Py_atomic_int pendingcalls_to_do = {0};
 static int pending_async_exc = 0;
 #endif /* WITH_THREAD */
 
@@ -472,74 +477,196 @@ PyEval_RestoreThread(PyThreadState *tstate)
    (e.g. due to too many pending calls) it returns -1 (without setting
    an exception condition).
 
-   Note that because registry may occur from within signal handlers,
-   or other asynchronous events, calling malloc() is unsafe!
-
-#ifdef WITH_THREAD
-   Any thread can schedule pending calls, but only the main thread
-   will execute them.
+   Any thread can schedule pending calls, even from a signal handler or
+   an executing callback, but only the main thread will execute them.
    There is no facility to schedule calls to a particular thread, but
    that should be easy to change, should that ever be required.  In
    that case, the static variables here should go into the python
    threadstate.
-#endif
+
+   The calls are queued in a ring of NPENDINGCALLS slots without any lock:
+   a producer claims the position pendinglast with a compare-and-swap, then
+   fills the slot and publishes it through the slot's sequence number.  The
+   main thread is the only consumer.  A producer interrupted between the
+   claim and the publication, even by a signal handler queuing another
+   call, only holds up the consumer, until it resumes.  Nothing is
+   allocated, so this part is async-signal-safe.
+
+   When the ring is full, Py_AddPendingCall() falls back to a list of heap
+   nodes, so that no call is lost.  Allocating memory isn't safe in a
+   signal handler, but it only happens when NPENDINGCALLS calls are already
+   waiting; handlers which can't take that risk use
+   _Py_AddPendingCallNoAlloc(), which fails instead.  While the list is in
+   use, new calls go to it as well, so that the calls of each producer
+   still run in order.
 */
 
-#ifdef WITH_THREAD
+#ifndef NPENDINGCALLS
+#define NPENDINGCALLS 256       /* must be a power of 2 */
+#endif
 
-/* The WITH_THREAD implementation is thread-safe.  It allows
-   scheduling to be made from any thread, and even from an executing
-   callback.
- */
+/* The most calls run by one Py_MakePendingCalls(), in case of recursion */
+#define PENDINGCALLS_BATCH 32
 
-#define NPENDINGCALLS 32
+/* Slot i is free for the position pos when seq + i == pos, and holds the
+   call of pos when seq + i == pos + 1.  Storing seq relative to i lets the
+   zeroed array start out with every slot free for its first position.
+   Positions wrap around as unsigned ints. */
 static struct {
+    _Py_atomic_int seq;
     int (*func)(void *);
     void *arg;
 } pendingcalls[NPENDINGCALLS];
-static int pendingfirst = 0;
-static int pendinglast = 0;
+static _Py_atomic_int pendinglast = {0};    /* next position to fill */
+static unsigned int pendingfirst = 0;       /* next position to run */
 
-int
-Py_AddPendingCall(int (*func)(void *), void *arg)
+/* The fallback list, pushed newest first by the producers */
+struct pendingcall_node {
+    struct pendingcall_node *next;
+    int (*func)(void *);
+    void *arg;
+};
+static _Py_atomic_address pending_overflow = {NULL};
+/* Nodes taken over by the consumer, oldest first */
+static struct pendingcall_node *pending_overflow_taken = NULL;
+/* Nodes not run yet, on either list */
+static _Py_atomic_int pending_overflow_nodes = {0};
+
+/* Statistics */
+static _Py_atomic_int pendingcalls_added = {0};
+static _Py_atomic_int pendingcalls_overflowed = {0};
+static _Py_atomic_int pendingcalls_dropped = {0};
+static unsigned int pendingcalls_done = 0;  /* main thread only */
+
+static int
+pending_ring_push(int (*func)(void *), void *arg)
 {
-    int i, j, result=0;
-    PyThread_type_lock lock = pending_lock;
-
-    /* try a few times for the lock.  Since this mechanism is used
-     * for signal handling (on the main thread), there is a (slim)
-     * chance that a signal is delivered on the same thread while we
-     * hold the lock during the Py_MakePendingCalls() function.
-     * This avoids a deadlock in that case.
-     * Note that signals can be delivered on any thread.  In particular,
-     * on Windows, a SIGINT is delivered on a system-created worker
-     * thread.
-     * We also check for lock being NULL, in the unlikely case that
-     * this function is called before any bytecode evaluation takes place.
-     */
-    if (lock != NULL) {
-        for (i = 0; i<100; i++) {
-            if (PyThread_acquire_lock(lock, NOWAIT_LOCK))
-                break;
+    unsigned int pos = (unsigned int)_Py_atomic_load_relaxed(&pendinglast);
+
+    for (;;) {
+        unsigned int i = pos % NPENDINGCALLS;
+        int diff = (int)((unsigned int)_Py_atomic_load_explicit(
+                             &pendingcalls[i].seq, _Py_memory_order_acquire)
+                         + i - pos);
+
+        if (diff == 0) {
+            int expected = (int)pos;
+            if (_Py_atomic_compare_exchange(&pendinglast, &expected,
+                                            (int)(pos + 1))) {
+                pendingcalls[i].func = func;
+                pendingcalls[i].arg = arg;
+                _Py_atomic_store_explicit(&pendingcalls[i].seq,
+                                          (int)(pos + 1 - i),
+                                          _Py_memory_order_release);
+                return 0;
+            }
+            pos = (unsigned int)expected;
         }
-        if (i == 100)
-            return -1;
+        else if (diff < 0)
+            return -1;  /* Queue full:  the call of pos - NPENDINGCALLS */
+        else
+            pos = (unsigned int)_Py_atomic_load_relaxed(&pendinglast);
     }
+}
 
-    i = pendinglast;
-    j = (i + 1) % NPENDINGCALLS;
-    if (j == pendingfirst) {
-        result = -1; /* Queue full */
-    } else {
-        pendingcalls[i].func = func;
-        pendingcalls[i].arg = arg;
-        pendinglast = j;
+static int
+pending_ring_pop(int (**func)(void *), void **arg)
+{
+    unsigned int pos = pendingfirst;
+    unsigned int i = pos % NPENDINGCALLS;
+
+    if ((unsigned int)_Py_atomic_load_explicit(&pendingcalls[i].seq,
+                                               _Py_memory_order_acquire)
+        + i != pos + 1)
+        return 0;   /* Queue empty, or the call is still being filled in */
+    *func = pendingcalls[i].func;
+    *arg = pendingcalls[i].arg;
+    _Py_atomic_store_explicit(&pendingcalls[i].seq,
+                              (int)(pos + NPENDINGCALLS - i),
+                              _Py_memory_order_release);
+    pendingfirst = pos + 1;
+    return 1;
+}
+
+static int
+pending_overflow_push(int (*func)(void *), void *arg)
+{
+    struct pendingcall_node *node;
+    void *head;
+
+    node = (struct pendingcall_node *)PyMem_RawMalloc(sizeof(*node));
+    if (node == NULL)
+        return -1;
+    node->func = func;
+    node->arg = arg;
+    _Py_atomic_fetch_add(&pending_overflow_nodes, 1);
+    head = _Py_atomic_load(&pending_overflow);
+    do {
+        node->next = (struct pendingcall_node *)head;
+    } while (!_Py_atomic_compare_exchange(&pending_overflow, &head,
+                                          (void *)node));
+    return 0;
+}
+
+static int
+pending_overflow_pop(int (**func)(void *), void **arg)
+{
+    struct pendingcall_node *node = pending_overflow_taken;
+
+    if (node == NULL) {
+        /* Take the whole list at once, so there's no ABA problem, and
+           reverse it */
+        void *head = _Py_atomic_load(&pending_overflow);
+        while (head != NULL &&
+               !_Py_atomic_compare_exchange(&pending_overflow, &head, NULL))
+            ;
+        while (head != NULL) {
+            struct pendingcall_node *next;
+            next = ((struct pendingcall_node *)head)->next;
+            ((struct pendingcall_node *)head)->next = node;
+            node = (struct pendingcall_node *)head;
+            head = next;
+        }
+        if (node == NULL)
+            return 0;
+    }
+    pending_overflow_taken = node->next;
+    *func = node->func;
+    *arg = node->arg;
+    PyMem_RawFree(node);
+    _Py_atomic_fetch_add(&pending_overflow_nodes, -1);
+    return 1;
+}
+
+static int
+add_pending_call(int (*func)(void *), void *arg, int may_alloc)
+{
+    if (!may_alloc || _Py_atomic_load(&pending_overflow_nodes) == 0) {
+        if (pending_ring_push(func, arg) == 0)
+            goto queued;
+    }
+    if (!may_alloc || pending_overflow_push(func, arg) < 0) {
+        _Py_atomic_fetch_add(&pendingcalls_dropped, 1);
+        return -1;
     }
+    _Py_atomic_fetch_add(&pendingcalls_overflowed, 1);
+queued:
+    _Py_atomic_fetch_add(&pendingcalls_added, 1);
     /* signal main loop */
     SIGNAL_PENDING_CALLS();
-    if (lock != NULL)
-        PyThread_release_lock(lock);
-    return result;
+    return 0;
+}
+
+int
+Py_AddPendingCall(int (*func)(void *), void *arg)
+{
+    return add_pending_call(func, arg, 1);
+}
+
+int
+_Py_AddPendingCallNoAlloc(int (*func)(void *), void *arg)
+{
+    return add_pending_call(func, arg, 0);
 }
 
 int
@@ -549,141 +676,57 @@ Py_MakePendingCalls(void)
     int i;
     int r = 0;
 
-    if (!pending_lock) {
-        /* initial allocation of the lock */
-        pending_lock = PyThread_allocate_lock();
-        if (pending_lock == NULL)
-            return -1;
-    }
-
+#ifdef WITH_THREAD
     /* only service pending calls on main thread */
     if (main_thread && PyThread_get_thread_ident() != main_thread)
         return 0;
+#endif
     /* don't perform recursive pending calls */
     if (busy)
         return 0;
     busy = 1;
-    /* perform a bounded number of calls, in case of recursion */
-    for (i=0; i<NPENDINGCALLS; i++) {
-        int j;
+    /* a call queued from here on signals again */
+    UNSIGNAL_PENDING_CALLS();
+    _Py_atomic_thread_fence(_Py_memory_order_seq_cst);
+    /* perform a bounded number of calls, in case of recursion.  The nodes
+       taken from the fallback list go first:  nothing is added to the ring
+       while they wait. */
+    for (i = 0; i < PENDINGCALLS_BATCH; i++) {
         int (*func)(void *);
-        void *arg = NULL;
+        void *arg;
 
-        /* pop one item off the queue while holding the lock */
-        PyThread_acquire_lock(pending_lock, WAIT_LOCK);
-        j = pendingfirst;
-        if (j == pendinglast) {
-            func = NULL; /* Queue empty */
-        } else {
-            func = pendingcalls[j].func;
-            arg = pendingcalls[j].arg;
-            pendingfirst = (j + 1) % NPENDINGCALLS;
-        }
-        if (pendingfirst != pendinglast)
-            SIGNAL_PENDING_CALLS();
-        else
-            UNSIGNAL_PENDING_CALLS();
-        PyThread_release_lock(pending_lock);
-        /* having released the lock, perform the callback */
-        if (func == NULL)
+        if (!(pending_overflow_taken != NULL &&
+              pending_overflow_pop(&func, &arg)) &&
+            !pending_ring_pop(&func, &arg) &&
+            !pending_overflow_pop(&func, &arg))
             break;
+        pendingcalls_done++;
         r = func(arg);
         if (r)
             break;
     }
+    if ((unsigned int)_Py_atomic_load(&pendingcalls_added) != pendingcalls_done)
+        SIGNAL_PENDING_CALLS(); /* We're not done yet */
     busy = 0;
     return r;
 }
 
-#else /* if ! defined WITH_THREAD */
-
-/*
-   WARNING!  ASYNCHRONOUSLY EXECUTING CODE!
-   This code is used for signal handling in python that isn't built
-   with WITH_THREAD.
-   Don't use this implementation when Py_AddPendingCalls() can happen
-   on a different thread!
-
-   There are two possible race conditions:
-   (1) nested asynchronous calls to Py_AddPendingCall()
-   (2) AddPendingCall() calls made while pending calls are being processed.
-
-   (1) is very unlikely because typically signal delivery
-   is blocked during signal handling.  So it should be impossible.
-   (2) is a real possibility.
-   The current code is safe against (2), but not against (1).
-   The safety against (2) is derived from the fact that only one
-   thread is present, interrupted by signals, and that the critical
-   section is protected with the "busy" variable.  On Windows, which
-   delivers SIGINT on a system thread, this does not hold and therefore
-   Windows really shouldn't use this version.
-   The two threads could theoretically wiggle around the "busy" variable.
-*/
-
-#define NPENDINGCALLS 32
-static struct {
-    int (*func)(void *);
-    void *arg;
-} pendingcalls[NPENDINGCALLS];
-static volatile int pendingfirst = 0;
-static volatile int pendinglast = 0;
-static _Py_atomic_int pendingcalls_to_do = {0};
-
-int
-Py_AddPendingCall(int (*func)(void *), void *arg)
-{
-    static volatile int busy = 0;
-    int i, j;
-    /* XXX Begin critical section */
-    if (busy)
-        return -1;
-    busy = 1;
-    i = pendinglast;
-    j = (i + 1) % NPENDINGCALLS;
-    if (j == pendingfirst) {
-        busy = 0;
-        return -1; /* Queue full */
-    }
-    pendingcalls[i].func = func;
-    pendingcalls[i].arg = arg;
-    pendinglast = j;
-
-    SIGNAL_PENDING_CALLS();
-    busy = 0;
-    /* XXX End critical section */
-    return 0;
-}
-
-int
-Py_MakePendingCalls(void)
+void
+_PyEval_GetPendingCallStats(_PyEval_PendingCallStats *stats)
 {
-    static int busy = 0;
-    if (busy)
-        return 0;
-    busy = 1;
-    UNSIGNAL_PENDING_CALLS();
-    for (;;) {
-        int i;
-        int (*func)(void *);
-        void *arg;
-        i = pendingfirst;
-        if (i == pendinglast)
-            break; /* Queue empty */
-        func = pendingcalls[i].func;
-        arg = pendingcalls[i].arg;
-        pendingfirst = (i + 1) % NPENDINGCALLS;
-        if (func(arg) < 0) {
-            busy = 0;
-            SIGNAL_PENDING_CALLS(); /* We're not done yet */
-            return -1;
-        }
-    }
-    busy = 0;
-    return 0;
+    unsigned int added = (unsigned int)_Py_atomic_load(&pendingcalls_added);
+    /* A call is counted in pendingcalls_added after its slot is published,
+       so the main thread may have run it already:  done can be ahead of
+       added for a moment.  The difference is signed so that it wraps. */
+    int depth = (int)(added - pendingcalls_done);
+
+    stats->depth = depth < 0 ? 0 : depth;
+    stats->added = added;
+    stats->overflowed =
+        (unsigned int)_Py_atomic_load(&pendingcalls_overflowed);
+    stats->dropped = (unsigned int)_Py_atomic_load(&pendingcalls_dropped);
 }
 
-#endif /* WITH_THREAD */
-
 
 /* The interpreter's recursion limit */
 
@@ -756,9 +799,11 @@ enum why_code {
         WHY_SILENCED =  0x0080  /* Exception silenced by 'with' */
 };
 
-static void save_exc_state(PyThreadState *, PyFrameObject *);
-static void swap_exc_state(PyThreadState *, PyFrameObject *);
-static void restore_and_clear_exc_state(PyThreadState *, PyFrameObject *);
+static void save_exc_state(PyThreadState *, _PyInterpreterFrame *);
+static void swap_exc_state(PyThreadState *, _PyInterpreterFrame *);
+static void restore_and_clear_exc_state(PyThreadState *, _PyInterpreterFrame *);
+static void traceback_here(_PyInterpreterFrame *);
+static PyObject * eval_frame(_PyInterpreterFrame *, int);
 static int do_raise(PyObject *, PyObject *);
 static int unpack_iterable(PyObject *, int, int, PyObject **);
 
@@ -769,6 +814,12 @@ static int unpack_iterable(PyObject *, int, int, PyObject **);
    fast_next_opcode*/
 static int _Py_TracingPossible = 0;
 
+/* tstate->use_tracing:  whether the thread has a trace, profile or
+   instrumentation function */
+#define USE_TRACING(tstate) \
+    ((tstate)->c_tracefunc != NULL || (tstate)->c_profilefunc != NULL || \
+     (tstate)->c_instrfunc != NULL)
+
 
 
 PyObject *
@@ -795,6 +846,12 @@ PyEval_EvalFrame(PyFrameObject *f) {
 
 PyObject *
 PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
+{
+    return eval_frame(f->f_frame, throwflag);
+}
+
+static PyObject *
+eval_frame(_PyInterpreterFrame *f, int throwflag)
 {
 #ifdef DXPAIRS
     int lastopcode = 0;
@@ -804,6 +861,8 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
     int opcode;        /* Current opcode */
     int oparg;         /* Current opcode argument, if any */
     enum why_code why; /* Reason for block stack unwind */
+    PyTryBlock table_block; /* A block of the exception table, unwinding */
+    int table_bound;   /* The start of the last one */
     PyObject **fastlocals, **freevars;
     PyObject *retval = NULL;            /* Return value */
     PyThreadState *tstate = PyThreadState_GET();
@@ -915,7 +974,9 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 #ifdef LLTRACE
 #define FAST_DISPATCH() \
     { \
-        if (!lltrace && !_Py_TracingPossible) { \
+        if (!lltrace && !_Py_TracingPossible && \
+            tstate->opcode_countdown > 1) { \
+            tstate->opcode_countdown--; \
             f->f_lasti = INSTR_OFFSET(); \
             goto *opcode_targets[*next_instr++]; \
         } \
@@ -924,7 +985,8 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 #else
 #define FAST_DISPATCH() \
     { \
-        if (!_Py_TracingPossible) { \
+        if (!_Py_TracingPossible && tstate->opcode_countdown > 1) { \
+            tstate->opcode_countdown--; \
             f->f_lasti = INSTR_OFFSET(); \
             goto *opcode_targets[*next_instr++]; \
         } \
@@ -952,45 +1014,6 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 #define GETITEM(v, i) PyTuple_GetItem((v), (i))
 #endif
 
-#ifdef WITH_TSC
-/* Use Pentium timestamp counter to mark certain events:
-   inst0 -- beginning of switch statement for opcode dispatch
-   inst1 -- end of switch statement (may be skipped)
-   loop0 -- the top of the mainloop
-   loop1 -- place where control returns again to top of mainloop
-            (may be skipped)
-   intr1 -- beginning of long interruption
-   intr2 -- end of long interruption
-
-   Many opcodes call out to helper C functions.  In some cases, the
-   time in those functions should be counted towards the time for the
-   opcode, but not in all cases.  For example, a CALL_FUNCTION opcode
-   calls another Python function; there's no point in charge all the
-   bytecode executed by the called function to the caller.
-
-   It's hard to make a useful judgement statically.  In the presence
-   of operator overloading, it's impossible to tell if a call will
-   execute new Python code or not.
-
-   It's a case-by-case judgement.  I'll use intr1 for the following
-   cases:
-
-   IMPORT_STAR
-   IMPORT_FROM
-   CALL_FUNCTION (and friends)
-
- */
-    uint64 inst0, inst1, loop0, loop1, intr0 = 0, intr1 = 0;
-    int ticked = 0;
-
-    READ_TIMESTAMP(inst0);
-    READ_TIMESTAMP(inst1);
-    READ_TIMESTAMP(loop0);
-    READ_TIMESTAMP(loop1);
-
-    /* shut up the compiler */
-    opcode = 0;
-#endif
 
 /* Code access macros */
 
@@ -1001,6 +1024,134 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 #define JUMPTO(x)       (next_instr = first_instr + (x))
 #define JUMPBY(x)       (next_instr += (x))
 
+/* Inline caches
+    A code object gets its caches (see _PyCode_InitOpcache()) once it has
+    been run OPCACHE_MIN_RUNS times, counting the calls and the backward
+    jumps, so that the hot loop of a function called only once gets them
+    too.  Cold code doesn't pay the memory.
+*/
+#define OPCACHE_MIN_RUNS 1024
+
+#define OPCACHE_BUMP() \
+    (co->co_opcache_flag < OPCACHE_MIN_RUNS && \
+     ++co->co_opcache_flag == OPCACHE_MIN_RUNS \
+     ? _PyCode_InitOpcache(co) : 0)
+
+/* The cache of the instruction at offset i, or NULL */
+#define OPCACHE_GET_AT(i) \
+    (co->co_opcache_map != NULL && co->co_opcache_map[i] \
+     ? &co->co_opcache[co->co_opcache_map[i] - 1] : NULL)
+
+/* The cache of the current instruction, which has an argument, or NULL */
+#define OPCACHE_GET() OPCACHE_GET_AT(INSTR_OFFSET() - 3)
+
+/* Attribute caches of LOAD_ATTR, STORE_ATTR and LOAD_METHOD
+
+   A cache is filled after a generic lookup or store on an object whose type
+   uses the generic getattr or setattr and has a valid version tag, see
+   attr_cache_fill(), with how the attribute was found:
+
+   OPCACHE_ATTR_DICT    in the instance dict, at index 'hint'
+   OPCACHE_ATTR_SLOT    in the __slots__ member at offset 'hint'
+   OPCACHE_ATTR_DESCR   through the data descriptor 'descr' of the type
+   OPCACHE_ATTR_CLASS   'descr' of the type, bound if it's a descriptor,
+                        unless the instance dict shadows it (load only)
+   OPCACHE_ATTR_METHOD  the same for a method, which LOAD_METHOD pushes
+                        unbound
+
+   Changing the type or one of its bases invalidates its version tag, so all
+   that's left to look at is the instance:  with the hint, that takes no
+   hashing.  A site which sees other types OPCACHE_MAX_MISSES times is
+   polymorphic:  it isn't cached any more.
+*/
+#define OPCACHE_MAX_MISSES 32
+
+#define OPCACHE_ATTR_MATCHES(ac, tp) \
+    ((ac)->type == (tp) && (ac)->tp_version_tag == (tp)->tp_version_tag && \
+     PyType_HasFeature((tp), Py_TPFLAGS_VALID_VERSION_TAG))
+
+#define OPCACHE_ATTR_DICT   1
+#define OPCACHE_ATTR_SLOT   2
+#define OPCACHE_ATTR_DESCR  3
+#define OPCACHE_ATTR_CLASS  4
+#define OPCACHE_ATTR_METHOD 5
+
+/* Specialized forms
+
+   Once the code has its caches, its frames run co_quickened, where a
+   BINARY_ADD, INPLACE_ADD, BINARY_SUBSCR, COMPARE_OP or FOR_ITER instruction
+   which ran generic OPCACHE_SPECIALIZE_AFTER times is rewritten into the
+   form for the types of its operands, see specialize():
+
+   BINARY_ADD_INT          int + int, both of a digit at most (MEDIUM_VALUE)
+   BINARY_ADD_FLOAT        float + float
+   BINARY_SUBSCR_LIST_INT  list[int], the index of a digit at most
+   COMPARE_OP_INT          int < int, int == int and so on, as above
+   COMPARE_OP_FLOAT        float < float, float == float and so on
+   COMPARE_OP_STR          str == str and str != str
+   FOR_ITER_LIST           the iterator of a list
+   FOR_ITER_TUPLE          the iterator of a tuple
+   FOR_ITER_RANGE          the iterator of a range, of C longs or not
+   FOR_ITER_DICT           the key, value and item iterators of a dict
+
+   The FOR_ITER forms step the iterator inline, or call the function of its
+   type directly, and tell the end of the loop from an error by its result,
+   without looking at the exception state.  INPLACE_ADD gets the forms of
+   BINARY_ADD:  ints and floats don't add in place.  A form which finds other operands rewrites the instruction back
+   from co_code and runs it generic, see DEOPTIMIZE().  Like an attribute
+   cache, an instruction which missed OPCACHE_MAX_MISSES times, counting the
+   times it found no form, stays generic.
+*/
+#define OPCACHE_SPECIALIZE_AFTER 8
+
+/* Rewrite the instruction at offset i of co_quickened into op, or the one
+   which runs after the line event if the line is instrumented */
+#define SET_QUICKENED(co, i, op) \
+    do { \
+        if ((co)->co_instrumented != NULL && (co)->co_instrumented[i]) \
+            (co)->co_instrumented[i] = (unsigned char)(op); \
+        else \
+            (co)->co_quickened[i] = (unsigned char)(op); \
+    } while (0)
+
+/* The offset of the current instruction */
+#define INSTR_START()   (INSTR_OFFSET() - (HAS_ARG(opcode) ? 3 : 1))
+
+/* An int of which MEDIUM_VALUE() is the value */
+#define IS_MEDIUM_INT(v) \
+    (PyLong_CheckExact(v) && (size_t)(Py_SIZE(v) + 1) <= 2)
+
+#define OPCACHE_SPECIALIZE_AT(i, left, right) \
+    do { \
+        _PyOpcache *oc_ = OPCACHE_GET_AT(i); \
+        if (oc_ != NULL && oc_->misses < OPCACHE_MAX_MISSES && \
+            ++oc_->u.adaptive.counter == OPCACHE_SPECIALIZE_AFTER) \
+            specialize(co, (i), oc_, oparg, (left), (right)); \
+    } while (0)
+
+#define OPCACHE_SPECIALIZE(left, right) \
+    OPCACHE_SPECIALIZE_AT(INSTR_START(), left, right)
+
+#define DEOPTIMIZE() \
+    do { \
+        int i_ = INSTR_START(); \
+        _PyOpcache *oc_ = OPCACHE_GET_AT(i_); \
+        specialization_stats[opcode].misses++; \
+        oc_->misses++; \
+        oc_->u.adaptive.counter = 0; \
+        opcode = (unsigned char)PyBytes_AS_STRING(co->co_code)[i_]; \
+        SET_QUICKENED(co, i_, opcode); \
+        goto dispatch_opcode; \
+    } while (0)
+
+#define SPECIALIZATION_HIT() (specialization_stats[opcode].hits++)
+
+/* a op b, for a COMPARE_OP argument op up to PyCmp_GE */
+#define COMPARE(a, op, b) \
+    ((op) == PyCmp_LT ? (a) < (b) : (op) == PyCmp_LE ? (a) <= (b) : \
+     (op) == PyCmp_EQ ? (a) == (b) : (op) == PyCmp_NE ? (a) != (b) : \
+     (op) == PyCmp_GT ? (a) > (b) : (a) >= (b))
+
 /* OpCode prediction macros
     Some opcodes tend to come in pairs thus making it possible to
     predict the second code when the first is run.  For example,
@@ -1030,14 +1181,51 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 
 #if defined(DYNAMIC_EXECUTION_PROFILE) || USE_COMPUTED_GOTOS
 #define PREDICT(op)             if (0) goto PRED_##op
+#else
+#define PREDICT(op)             if (*next_instr == op) goto PRED_##op
+#endif
+
+#if USE_COMPUTED_GOTOS
 #define PREDICTED(op)           PRED_##op:
 #define PREDICTED_WITH_ARG(op)  PRED_##op:
 #else
-#define PREDICT(op)             if (*next_instr == op) goto PRED_##op
 #define PREDICTED(op)           PRED_##op: next_instr++
 #define PREDICTED_WITH_ARG(op)  PRED_##op: oparg = PEEKARG(); next_instr += 3
 #endif
 
+/* Superinstructions
+    A superinstruction runs the first instruction of a pair which often runs
+    in this order, and goes on with the second one like a successful
+    PREDICT() does:  it saves the dispatch of the second instruction, and its
+    check of eval_breaker.  Unlike PREDICT(), it doesn't test the next opcode,
+    and it works with the profile and threaded code too.  The pairs are
+    chosen from the DXPAIRS counts, see fuse_superinstructions() in
+    codeobject.c, which rewrites the first instruction in co_quickened.
+    BUILD_TUPLE__UNPACK_SEQUENCE and BUILD_LIST__UNPACK_SEQUENCE run neither
+    instruction:  they leave the items on the stack as the pair would, and
+    skip the second.
+
+    When tracing, the second instruction is dispatched:  it may be the first
+    of its line.
+*/
+#if USE_COMPUTED_GOTOS
+#define SUPERINSTRUCTION_NEXT(op) \
+    { \
+        if (!_Py_TracingPossible) { \
+            next_instr++; \
+            goto PRED_##op; \
+        } \
+        FAST_DISPATCH(); \
+    }
+#else
+#define SUPERINSTRUCTION_NEXT(op) \
+    { \
+        if (!_Py_TracingPossible) \
+            goto PRED_##op; \
+        FAST_DISPATCH(); \
+    }
+#endif
+
 
 /* Stack manipulation macros */
 
@@ -1124,6 +1312,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
     if (Py_EnterRecursiveCall(""))
         return NULL;
 
+    f->f_previous = tstate->frame;
     tstate->frame = f;
 
     if (tstate->use_tracing) {
@@ -1158,14 +1347,27 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
                 goto exit_eval_frame;
             }
         }
+        if (tstate->c_instrfunc != NULL &&
+            (f->f_code->co_instrumentation & PyCode_INSTRUMENT_CALL)) {
+            /* The same, for the code objects with call events */
+            if (call_trace_protected(tstate->c_instrfunc,
+                                     tstate->c_instrobj,
+                                     tstate, f, PyTrace_CALL, Py_None))
+                goto exit_eval_frame;
+        }
     }
 
     co = f->f_code;
+    if (OPCACHE_BUMP() < 0)
+        goto exit_eval_frame;
     names = co->co_names;
     consts = co->co_consts;
     fastlocals = f->f_localsplus;
     freevars = f->f_localsplus + co->co_nlocals;
-    first_instr = (unsigned char*) PyBytes_AS_STRING(co->co_code);
+    if (co->co_quickened != NULL)
+        first_instr = co->co_quickened;
+    else
+        first_instr = (unsigned char*) PyBytes_AS_STRING(co->co_code);
     /* An explanation is in order for the next line.
 
        f->f_lasti now refers to the index of the last instruction
@@ -1219,23 +1421,6 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 #endif
 
     for (;;) {
-#ifdef WITH_TSC
-        if (inst1 == 0) {
-            /* Almost surely, the opcode executed a break
-               or a continue, preventing inst1 from being set
-               on the way out of the loop.
-            */
-            READ_TIMESTAMP(inst1);
-            loop1 = inst1;
-        }
-        dump_tsc(opcode, ticked, inst0, inst1, loop0, loop1,
-                 intr0, intr1);
-        ticked = 0;
-        inst1 = 0;
-        intr0 = 0;
-        intr1 = 0;
-        READ_TIMESTAMP(loop0);
-#endif
         assert(stack_pointer >= f->f_valuestack); /* else underflow */
         assert(STACK_LEVEL() <= co->co_stacksize);  /* else overflow */
         assert(!PyErr_Occurred());
@@ -1249,14 +1434,13 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
            Py_MakePendingCalls() above. */
 
         if (_Py_atomic_load_relaxed(&eval_breaker)) {
-            if (*next_instr == SETUP_FINALLY) {
+            if (*next_instr == SETUP_FINALLY ||
+                (*next_instr == INSTRUMENTED_LINE &&
+                 co->co_instrumented[INSTR_OFFSET()] == SETUP_FINALLY)) {
                 /* Make the last opcode before
                    a try: finally: block uninterruptible. */
                 goto fast_next_opcode;
             }
-#ifdef WITH_TSC
-            ticked = 1;
-#endif
             if (_Py_atomic_load_relaxed(&pendingcalls_to_do)) {
                 if (Py_MakePendingCalls() < 0)
                     goto error;
@@ -1298,28 +1482,34 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 
         /* line-by-line tracing support */
 
-        if (_Py_TracingPossible &&
-            tstate->c_tracefunc != NULL && !tstate->tracing) {
-            int err;
-            /* see maybe_call_line_trace
-               for expository comments */
-            f->f_stacktop = stack_pointer;
-
-            err = maybe_call_line_trace(tstate->c_tracefunc,
-                                        tstate->c_traceobj,
-                                        tstate, f,
-                                        &instr_lb, &instr_ub, &instr_prev);
-            /* Reload possibly changed frame fields */
-            JUMPTO(f->f_lasti);
-            if (f->f_stacktop != NULL) {
-                stack_pointer = f->f_stacktop;
-                f->f_stacktop = NULL;
-            }
-            if (err)
-                /* trace function raised an exception */
-                goto error;
+        if (_Py_TracingPossible) {
+            if (tstate->c_tracefunc != NULL && !tstate->tracing) {
+                int err;
+                /* see maybe_call_line_trace
+                   for expository comments */
+                f->f_stacktop = stack_pointer;
+
+                err = maybe_call_line_trace(tstate->c_tracefunc,
+                                            tstate->c_traceobj,
+                                            tstate, f, &instr_lb,
+                                            &instr_ub, &instr_prev);
+                /* Reload possibly changed frame fields */
+                JUMPTO(f->f_lasti);
+                if (f->f_stacktop != NULL) {
+                    stack_pointer = f->f_stacktop;
+                    f->f_stacktop = NULL;
+                }
+                if (err)
+                    /* trace function raised an exception */
+                    goto error;
+            }
         }
 
+        /* the opcode profile */
+
+        if (--tstate->opcode_countdown == 0)
+            profile_instruction(tstate, co, *next_instr, f->f_lasti);
+
         /* Extract opcode and argument */
 
         opcode = NEXTOP();
@@ -1352,7 +1542,6 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 #endif
 
         /* Main switch on opcode */
-        READ_TIMESTAMP(inst0);
 
         switch (opcode) {
 
@@ -1364,6 +1553,41 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
         TARGET(NOP)
             FAST_DISPATCH();
 
+        TARGET(INSTRUMENTED_LINE) {
+            /* The first instruction of a line of a code object with line
+               events, see PyCode_SetInstrumentation() */
+            int offset = INSTR_OFFSET() - 1;
+            if (tstate->c_instrfunc != NULL && !tstate->tracing) {
+                int err;
+                f->f_stacktop = stack_pointer;
+                f->f_lineno = PyCode_Addr2Line(co, offset);
+                err = call_trace(tstate->c_instrfunc, tstate->c_instrobj,
+                                 tstate, f, PyTrace_LINE, Py_None);
+                if (f->f_stacktop != NULL) {
+                    stack_pointer = f->f_stacktop;
+                    f->f_stacktop = NULL;
+                }
+                if (err)
+                    goto error;
+                if (f->f_lasti != offset) {
+                    /* the function set f_lineno */
+                    JUMPTO(f->f_lasti);
+                    goto fast_next_opcode;
+                }
+            }
+            /* Run the instruction, unless the function took the events
+               away */
+            if (co->co_instrumented != NULL && co->co_instrumented[offset])
+                opcode = co->co_instrumented[offset];
+            else
+                opcode = first_instr[offset];
+            oparg = 0;
+            if (HAS_ARG(opcode))
+                oparg = NEXTARG();
+            goto dispatch_opcode;
+        }
+
+        PREDICTED_WITH_ARG(LOAD_FAST);
         TARGET(LOAD_FAST) {
             PyObject *value = GETLOCAL(oparg);
             if (value == NULL) {
@@ -1377,6 +1601,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             FAST_DISPATCH();
         }
 
+        PREDICTED_WITH_ARG(LOAD_CONST);
         TARGET(LOAD_CONST) {
             PyObject *value = GETITEM(consts, oparg);
             Py_INCREF(value);
@@ -1391,6 +1616,58 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             FAST_DISPATCH();
         }
 
+        TARGET(LOAD_FAST__LOAD_FAST) {
+            PyObject *value = GETLOCAL(oparg);
+            if (value == NULL) {
+                format_exc_check_arg(PyExc_UnboundLocalError,
+                                     UNBOUNDLOCAL_ERROR_MSG,
+                                     PyTuple_GetItem(co->co_varnames, oparg));
+                goto error;
+            }
+            Py_INCREF(value);
+            PUSH(value);
+            SUPERINSTRUCTION_NEXT(LOAD_FAST);
+        }
+
+        TARGET(LOAD_FAST__LOAD_CONST) {
+            PyObject *value = GETLOCAL(oparg);
+            if (value == NULL) {
+                format_exc_check_arg(PyExc_UnboundLocalError,
+                                     UNBOUNDLOCAL_ERROR_MSG,
+                                     PyTuple_GetItem(co->co_varnames, oparg));
+                goto error;
+            }
+            Py_INCREF(value);
+            PUSH(value);
+            SUPERINSTRUCTION_NEXT(LOAD_CONST);
+        }
+
+        TARGET(LOAD_FAST__LOAD_ATTR) {
+            PyObject *value = GETLOCAL(oparg);
+            if (value == NULL) {
+                format_exc_check_arg(PyExc_UnboundLocalError,
+                                     UNBOUNDLOCAL_ERROR_MSG,
+                                     PyTuple_GetItem(co->co_varnames, oparg));
+                goto error;
+            }
+            Py_INCREF(value);
+            PUSH(value);
+            SUPERINSTRUCTION_NEXT(LOAD_ATTR);
+        }
+
+        TARGET(STORE_FAST__LOAD_FAST) {
+            PyObject *value = POP();
+            SETLOCAL(oparg, value);
+            SUPERINSTRUCTION_NEXT(LOAD_FAST);
+        }
+
+        TARGET(LOAD_CONST__RETURN_VALUE) {
+            PyObject *value = GETITEM(consts, oparg);
+            Py_INCREF(value);
+            PUSH(value);
+            SUPERINSTRUCTION_NEXT(RETURN_VALUE);
+        }
+
         TARGET(POP_TOP) {
             PyObject *value = POP();
             Py_DECREF(value);
@@ -1560,6 +1837,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             PyObject *right = POP();
             PyObject *left = TOP();
             PyObject *sum;
+            OPCACHE_SPECIALIZE(left, right);
             if (PyUnicode_CheckExact(left) &&
                      PyUnicode_CheckExact(right)) {
                 sum = unicode_concatenate(left, right, f, next_instr);
@@ -1576,6 +1854,43 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             DISPATCH();
         }
 
+        TARGET(BINARY_ADD_INT) {
+            PyObject *right = TOP();
+            PyObject *left = SECOND();
+            PyObject *sum;
+            if (!IS_MEDIUM_INT(left) || !IS_MEDIUM_INT(right))
+                DEOPTIMIZE();
+            SPECIALIZATION_HIT();
+            sum = PyLong_FromLong(
+                (long)MEDIUM_VALUE((PyLongObject *)left) +
+                MEDIUM_VALUE((PyLongObject *)right));
+            STACKADJ(-1);
+            Py_DECREF(left);
+            Py_DECREF(right);
+            SET_TOP(sum);
+            if (sum == NULL)
+                goto error;
+            DISPATCH();
+        }
+
+        TARGET(BINARY_ADD_FLOAT) {
+            PyObject *right = TOP();
+            PyObject *left = SECOND();
+            PyObject *sum;
+            if (!PyFloat_CheckExact(left) || !PyFloat_CheckExact(right))
+                DEOPTIMIZE();
+            SPECIALIZATION_HIT();
+            sum = PyFloat_FromDouble(PyFloat_AS_DOUBLE(left) +
+                                     PyFloat_AS_DOUBLE(right));
+            STACKADJ(-1);
+            Py_DECREF(left);
+            Py_DECREF(right);
+            SET_TOP(sum);
+            if (sum == NULL)
+                goto error;
+            DISPATCH();
+        }
+
         TARGET(BINARY_SUBTRACT) {
             PyObject *right = POP();
             PyObject *left = TOP();
@@ -1591,7 +1906,9 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
         TARGET(BINARY_SUBSCR) {
             PyObject *sub = POP();
             PyObject *container = TOP();
-            PyObject *res = PyObject_GetItem(container, sub);
+            PyObject *res;
+            OPCACHE_SPECIALIZE(container, sub);
+            res = PyObject_GetItem(container, sub);
             Py_DECREF(container);
             Py_DECREF(sub);
             SET_TOP(res);
@@ -1600,7 +1917,30 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             DISPATCH();
         }
 
-        TARGET(BINARY_LSHIFT) {
+        TARGET(BINARY_SUBSCR_LIST_INT) {
+            PyObject *sub = TOP();
+            PyObject *list = SECOND();
+            PyObject *res;
+            Py_ssize_t i;
+            if (!PyList_CheckExact(list) || !IS_MEDIUM_INT(sub))
+                DEOPTIMIZE();
+            i = MEDIUM_VALUE((PyLongObject *)sub);
+            if (i < 0)
+                i += PyList_GET_SIZE(list);
+            /* The generic form raises the IndexError */
+            if ((size_t)i >= (size_t)PyList_GET_SIZE(list))
+                DEOPTIMIZE();
+            SPECIALIZATION_HIT();
+            res = PyList_GET_ITEM(list, i);
+            Py_INCREF(res);
+            STACKADJ(-1);
+            Py_DECREF(list);
+            Py_DECREF(sub);
+            SET_TOP(res);
+            DISPATCH();
+        }
+
+        TARGET(BINARY_LSHIFT) {
             PyObject *right = POP();
             PyObject *left = TOP();
             PyObject *res = PyNumber_Lshift(left, right);
@@ -1760,6 +2100,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             PyObject *right = POP();
             PyObject *left = TOP();
             PyObject *sum;
+            OPCACHE_SPECIALIZE(left, right);
             if (PyUnicode_CheckExact(left) && PyUnicode_CheckExact(right)) {
                 sum = unicode_concatenate(left, right, f, next_instr);
                 /* unicode_concatenate consumed the ref to v */
@@ -1920,6 +2261,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             goto error;
         }
 
+        PREDICTED(RETURN_VALUE);
         TARGET(RETURN_VALUE) {
             retval = POP();
             why = WHY_RETURN;
@@ -2072,7 +2414,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
         }
 
         TARGET(POP_EXCEPT) {
-            PyTryBlock *b = PyFrame_BlockPop(f);
+            PyTryBlock *b = _PyFrame_BlockPop(f);
             if (b->b_type != EXCEPT_HANDLER) {
                 PyErr_SetString(PyExc_SystemError,
                                 "popped block is not an except handler");
@@ -2083,7 +2425,15 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
         }
 
         TARGET(POP_BLOCK) {
-            PyTryBlock *b = PyFrame_BlockPop(f);
+            PyTryBlock *b;
+            if (co->co_exceptiontable != NULL) {
+                /* co_code ends a try block of the exception table */
+                const _PyExceptionTableEntry *entry =
+                    _PyCode_FindTryBlock(co, INSTR_OFFSET() - 1, INT_MAX);
+                if (entry != NULL && entry->end == INSTR_OFFSET() - 1)
+                    DISPATCH();
+            }
+            b = _PyFrame_BlockPop(f);
             UNWIND_BLOCK(b);
             DISPATCH();
         }
@@ -2102,7 +2452,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
                     manually unwind the EXCEPT_HANDLER block which was
                     created when the exception was caught, otherwise
                     the stack will be in an inconsistent state. */
-                    PyTryBlock *b = PyFrame_BlockPop(f);
+                    PyTryBlock *b = _PyFrame_BlockPop(f);
                     assert(b->b_type == EXCEPT_HANDLER);
                     UNWIND_EXCEPT_HANDLER(b);
                     why = WHY_NOT;
@@ -2204,10 +2554,21 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             if (PyTuple_CheckExact(seq) &&
                 PyTuple_GET_SIZE(seq) == oparg) {
                 items = ((PyTupleObject *)seq)->ob_item;
-                while (oparg--) {
-                    item = items[oparg];
-                    Py_INCREF(item);
-                    PUSH(item);
+                if (Py_REFCNT(seq) == 1) {
+                    /* Nobody else sees the tuple, as when it comes from
+                       "return x, y":  move its items to the stack, and
+                       let it go back to the free list empty */
+                    while (oparg--) {
+                        PUSH(items[oparg]);
+                        items[oparg] = NULL;
+                    }
+                }
+                else {
+                    while (oparg--) {
+                        item = items[oparg];
+                        Py_INCREF(item);
+                        PUSH(item);
+                    }
                 }
             } else if (PyList_CheckExact(seq) &&
                        PyList_GET_SIZE(seq) == oparg) {
@@ -2249,8 +2610,21 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             PyObject *owner = TOP();
             PyObject *v = SECOND();
             int err;
+            _PyOpcache *oc = OPCACHE_GET();
             STACKADJ(-2);
+            if (oc != NULL && oc->optimized) {
+                if (OPCACHE_ATTR_MATCHES(&oc->u.attr, Py_TYPE(owner))) {
+                    if (store_attr_cached(&oc->u.attr, owner, name, v, &err))
+                        goto store_attr_done;
+                    oc = NULL;  /* a miss of the instance, not the type */
+                }
+                else if (++oc->misses == OPCACHE_MAX_MISSES)
+                    oc->optimized = 0;
+            }
             err = PyObject_SetAttr(owner, name, v);
+            if (err == 0 && oc != NULL && oc->misses < OPCACHE_MAX_MISSES)
+                attr_cache_fill(oc, owner, name, STORE_ATTR);
+          store_attr_done:
             Py_DECREF(v);
             Py_DECREF(owner);
             if (err != 0)
@@ -2348,6 +2722,19 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             PyObject *v;
             if (PyDict_CheckExact(f->f_globals)
                 && PyDict_CheckExact(f->f_builtins)) {
+                PY_UINT64_T globals_ver =
+                    ((PyDictObject *)f->f_globals)->ma_version_tag;
+                PY_UINT64_T builtins_ver =
+                    ((PyDictObject *)f->f_builtins)->ma_version_tag;
+                _PyOpcache *oc = OPCACHE_GET();
+                if (oc != NULL && oc->optimized
+                    && oc->u.lg.globals_ver == globals_ver
+                    && oc->u.lg.builtins_ver == builtins_ver) {
+                    v = oc->u.lg.ptr;
+                    Py_INCREF(v);
+                    PUSH(v);
+                    DISPATCH();
+                }
                 v = _PyDict_LoadGlobal((PyDictObject *)f->f_globals,
                                        (PyDictObject *)f->f_builtins,
                                        name);
@@ -2357,6 +2744,17 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
                                              NAME_ERROR_MSG, name);
                     goto error;
                 }
+                /* unless the lookup ran code which changed the dicts */
+                if (oc != NULL
+                    && ((PyDictObject *)f->f_globals)->ma_version_tag ==
+                       globals_ver
+                    && ((PyDictObject *)f->f_builtins)->ma_version_tag ==
+                       builtins_ver) {
+                    oc->u.lg.ptr = v;
+                    oc->u.lg.globals_ver = globals_ver;
+                    oc->u.lg.builtins_ver = builtins_ver;
+                    oc->optimized = 1;
+                }
                 Py_INCREF(v);
             }
             else {
@@ -2489,6 +2887,28 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             DISPATCH();
         }
 
+        TARGET_WITH_IMPL(BUILD_TUPLE__UNPACK_SEQUENCE, _build_unpack)
+        TARGET(BUILD_LIST__UNPACK_SEQUENCE)
+        _build_unpack: {
+            /* a, b = b, a:  UNPACK_SEQUENCE of as many items would push
+               them back in the reverse order, which is done in place,
+               without the tuple or list.  Under tracing, or for another
+               count, the first instruction runs alone. */
+            PyObject **lo = stack_pointer - oparg, **hi = stack_pointer - 1;
+            if (PEEKARG() != oparg || _Py_TracingPossible) {
+                opcode = opcode == BUILD_TUPLE__UNPACK_SEQUENCE ?
+                         BUILD_TUPLE : BUILD_LIST;
+                goto dispatch_opcode;
+            }
+            while (lo < hi) {
+                PyObject *item = *lo;
+                *lo++ = *hi;
+                *hi-- = item;
+            }
+            next_instr += 3;
+            DISPATCH();
+        }
+
         TARGET_WITH_IMPL(BUILD_TUPLE_UNPACK, _build_list_unpack)
         TARGET(BUILD_LIST_UNPACK)
         _build_list_unpack: {
@@ -2686,10 +3106,25 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             DISPATCH();
         }
 
+        PREDICTED_WITH_ARG(LOAD_ATTR);
         TARGET(LOAD_ATTR) {
             PyObject *name = GETITEM(names, oparg);
             PyObject *owner = TOP();
-            PyObject *res = PyObject_GetAttr(owner, name);
+            PyObject *res;
+            _PyOpcache *oc = OPCACHE_GET();
+            if (oc != NULL && oc->optimized) {
+                if (OPCACHE_ATTR_MATCHES(&oc->u.attr, Py_TYPE(owner))) {
+                    if (load_attr_cached(&oc->u.attr, owner, name, &res))
+                        goto load_attr_done;
+                    oc = NULL;  /* a miss of the instance, not the type */
+                }
+                else if (++oc->misses == OPCACHE_MAX_MISSES)
+                    oc->optimized = 0;
+            }
+            res = PyObject_GetAttr(owner, name);
+            if (res != NULL && oc != NULL && oc->misses < OPCACHE_MAX_MISSES)
+                attr_cache_fill(oc, owner, name, LOAD_ATTR);
+          load_attr_done:
             Py_DECREF(owner);
             SET_TOP(res);
             if (res == NULL)
@@ -2697,10 +3132,58 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             DISPATCH();
         }
 
+        TARGET(LOAD_METHOD) {
+            /* Pushes the method and the object for CALL_METHOD, if the
+               attribute is a method which would be bound to the object,
+               saving the bound method.  Else pushes NULL and the attribute,
+               like LOAD_ATTR does. */
+            PyObject *name = GETITEM(names, oparg);
+            PyObject *obj = TOP();
+            PyObject *meth = NULL;
+            _PyOpcache *oc = OPCACHE_GET();
+            if (oc != NULL && oc->optimized) {
+                _PyOpcache_Attr *ac = &oc->u.attr;
+                if (OPCACHE_ATTR_MATCHES(ac, Py_TYPE(obj))) {
+                    if (ac->kind == OPCACHE_ATTR_METHOD) {
+                        if (!attr_shadowed(ac, obj, name)) {
+                            meth = ac->descr;
+                            Py_INCREF(meth);
+                            SET_TOP(meth);
+                            PUSH(obj);
+                            DISPATCH();
+                        }
+                    }
+                    else if (load_attr_cached(ac, obj, name, &meth))
+                        goto load_method_attr;
+                    oc = NULL;  /* a miss of the instance, not the type */
+                }
+                else if (++oc->misses == OPCACHE_MAX_MISSES)
+                    oc->optimized = 0;
+            }
+            if (_PyObject_GetMethod(obj, name, &meth)) {
+                if (oc != NULL && oc->misses < OPCACHE_MAX_MISSES)
+                    attr_cache_fill(oc, obj, name, LOAD_METHOD);
+                SET_TOP(meth);
+                PUSH(obj);  /* the reference of the stack goes to self */
+                DISPATCH();
+            }
+            if (meth != NULL && oc != NULL && oc->misses < OPCACHE_MAX_MISSES)
+                attr_cache_fill(oc, obj, name, LOAD_METHOD);
+          load_method_attr:
+            if (meth == NULL)
+                goto error;
+            SET_TOP(NULL);
+            Py_DECREF(obj);
+            PUSH(meth);
+            DISPATCH();
+        }
+
         TARGET(COMPARE_OP) {
             PyObject *right = POP();
             PyObject *left = TOP();
-            PyObject *res = cmp_outcome(oparg, left, right);
+            PyObject *res;
+            OPCACHE_SPECIALIZE(left, right);
+            res = cmp_outcome(oparg, left, right);
             Py_DECREF(left);
             Py_DECREF(right);
             SET_TOP(res);
@@ -2711,6 +3194,114 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             DISPATCH();
         }
 
+        TARGET(COMPARE_OP_INT) {
+            PyObject *right = TOP();
+            PyObject *left = SECOND();
+            PyObject *res;
+            if (!IS_MEDIUM_INT(left) || !IS_MEDIUM_INT(right))
+                DEOPTIMIZE();
+            SPECIALIZATION_HIT();
+            res = COMPARE(MEDIUM_VALUE((PyLongObject *)left), oparg,
+                          MEDIUM_VALUE((PyLongObject *)right))
+                  ? Py_True : Py_False;
+            Py_INCREF(res);
+            STACKADJ(-1);
+            Py_DECREF(left);
+            Py_DECREF(right);
+            SET_TOP(res);
+            PREDICT(POP_JUMP_IF_FALSE);
+            PREDICT(POP_JUMP_IF_TRUE);
+            DISPATCH();
+        }
+
+        TARGET(COMPARE_OP_FLOAT) {
+            PyObject *right = TOP();
+            PyObject *left = SECOND();
+            PyObject *res;
+            if (!PyFloat_CheckExact(left) || !PyFloat_CheckExact(right))
+                DEOPTIMIZE();
+            SPECIALIZATION_HIT();
+            res = COMPARE(PyFloat_AS_DOUBLE(left), oparg,
+                          PyFloat_AS_DOUBLE(right)) ? Py_True : Py_False;
+            Py_INCREF(res);
+            STACKADJ(-1);
+            Py_DECREF(left);
+            Py_DECREF(right);
+            SET_TOP(res);
+            PREDICT(POP_JUMP_IF_FALSE);
+            PREDICT(POP_JUMP_IF_TRUE);
+            DISPATCH();
+        }
+
+        TARGET(COMPARE_OP_STR) {
+            PyObject *right = TOP();
+            PyObject *left = SECOND();
+            PyObject *res;
+            if (!PyUnicode_CheckExact(left) || !PyUnicode_CheckExact(right) ||
+                !PyUnicode_IS_READY(left) || !PyUnicode_IS_READY(right))
+                DEOPTIMIZE();
+            SPECIALIZATION_HIT();
+            /* oparg is PyCmp_EQ or PyCmp_NE */
+            res = _PyUnicode_EQ(left, right) == (oparg == PyCmp_EQ)
+                  ? Py_True : Py_False;
+            Py_INCREF(res);
+            STACKADJ(-1);
+            Py_DECREF(left);
+            Py_DECREF(right);
+            SET_TOP(res);
+            PREDICT(POP_JUMP_IF_FALSE);
+            PREDICT(POP_JUMP_IF_TRUE);
+            DISPATCH();
+        }
+
+        TARGET_WITH_IMPL(COMPARE_OP__POP_JUMP_IF_TRUE, _compare_op_jump)
+        TARGET(COMPARE_OP__POP_JUMP_IF_FALSE)
+        _compare_op_jump: {
+            /* These compare ints, floats and strings like the specialized
+               forms of COMPARE_OP, which they replace, and jump on the
+               outcome without making a bool of it */
+            PyObject *right = POP();
+            PyObject *left = POP();
+            int err;
+            if (oparg <= PyCmp_GE &&
+                IS_MEDIUM_INT(left) && IS_MEDIUM_INT(right))
+                err = COMPARE(MEDIUM_VALUE((PyLongObject *)left), oparg,
+                              MEDIUM_VALUE((PyLongObject *)right));
+            else if (oparg <= PyCmp_GE &&
+                     PyFloat_CheckExact(left) && PyFloat_CheckExact(right))
+                err = COMPARE(PyFloat_AS_DOUBLE(left), oparg,
+                              PyFloat_AS_DOUBLE(right));
+            else if ((oparg == PyCmp_EQ || oparg == PyCmp_NE) &&
+                     PyUnicode_CheckExact(left) &&
+                     PyUnicode_CheckExact(right) &&
+                     PyUnicode_IS_READY(left) && PyUnicode_IS_READY(right))
+                err = _PyUnicode_EQ(left, right) == (oparg == PyCmp_EQ);
+            else {
+                PyObject *res = cmp_outcome(oparg, left, right);
+                if (res == NULL)
+                    err = -1;
+                else {
+                    err = PyObject_IsTrue(res);
+                    Py_DECREF(res);
+                }
+            }
+            Py_DECREF(left);
+            Py_DECREF(right);
+            if (err < 0)
+                goto error;
+            if (_Py_TracingPossible) {
+                /* leave the jump to the traced POP_JUMP_IF_FALSE or
+                   POP_JUMP_IF_TRUE */
+                PUSH(PyBool_FromLong(err));
+                FAST_DISPATCH();
+            }
+            next_instr++;
+            oparg = NEXTARG();
+            if (err == (opcode == COMPARE_OP__POP_JUMP_IF_TRUE))
+                JUMPTO(oparg);
+            DISPATCH();
+        }
+
         TARGET(IMPORT_NAME) {
             _Py_IDENTIFIER(__import__);
             PyObject *name = GETITEM(names, oparg);
@@ -2746,9 +3337,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
                 STACKADJ(-1);
                 goto error;
             }
-            READ_TIMESTAMP(intr0);
             res = PyEval_CallObject(func, args);
-            READ_TIMESTAMP(intr1);
             Py_DECREF(args);
             Py_DECREF(func);
             SET_TOP(res);
@@ -2760,7 +3349,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
         TARGET(IMPORT_STAR) {
             PyObject *from = POP(), *locals;
             int err;
-            if (PyFrame_FastToLocalsWithError(f) < 0)
+            if (_PyFrame_FastToLocalsWithError(f) < 0)
                 goto error;
 
             locals = f->f_locals;
@@ -2769,10 +3358,8 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
                     "no locals found during 'import *'");
                 goto error;
             }
-            READ_TIMESTAMP(intr0);
             err = import_all_from(locals, from);
-            READ_TIMESTAMP(intr1);
-            PyFrame_LocalsToFast(f, 0);
+            _PyFrame_LocalsToFast(f, 0);
             Py_DECREF(from);
             if (err != 0)
                 goto error;
@@ -2783,9 +3370,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             PyObject *name = GETITEM(names, oparg);
             PyObject *from = TOP();
             PyObject *res;
-            READ_TIMESTAMP(intr0);
             res = import_from(from, name);
-            READ_TIMESTAMP(intr1);
             PUSH(res);
             if (res == NULL)
                 goto error;
@@ -2900,6 +3485,11 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
 
         PREDICTED_WITH_ARG(JUMP_ABSOLUTE);
         TARGET(JUMP_ABSOLUTE) {
+            if (oparg < INSTR_OFFSET() && OPCACHE_BUMP() < 0)
+                goto error;
+            /* The code may have got its caches:  go on in co_quickened */
+            if (co->co_quickened != NULL)
+                first_instr = co->co_quickened;
             JUMPTO(oparg);
 #if FAST_LOOPS
             /* Enabling this path speeds-up all while and for-loops by bypassing
@@ -2959,7 +3549,10 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
         TARGET(FOR_ITER) {
             /* before: [iter]; after: [iter, iter()] *or* [] */
             PyObject *iter = TOP();
-            PyObject *next = (*iter->ob_type->tp_iternext)(iter);
+            PyObject *next;
+            /* GET_ITER predicts FOR_ITER, which leaves opcode alone */
+            OPCACHE_SPECIALIZE_AT(INSTR_OFFSET() - 3, iter, NULL);
+            next = (*iter->ob_type->tp_iternext)(iter);
             if (next != NULL) {
                 PUSH(next);
                 PREDICT(STORE_FAST);
@@ -2980,6 +3573,119 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             DISPATCH();
         }
 
+        TARGET(FOR_ITER_LIST) {
+            PyObject *iter = TOP();
+            _PyListIterObject *it = (_PyListIterObject *)iter;
+            PyListObject *seq;
+            if (Py_TYPE(iter) != &PyListIter_Type)
+                DEOPTIMIZE();
+            SPECIALIZATION_HIT();
+            seq = it->it_seq;
+            if (seq != NULL) {
+                if (it->it_index < PyList_GET_SIZE(seq)) {
+                    PyObject *next = PyList_GET_ITEM(seq, it->it_index++);
+                    Py_INCREF(next);
+                    PUSH(next);
+                    PREDICT(STORE_FAST);
+                    PREDICT(UNPACK_SEQUENCE);
+                    DISPATCH();
+                }
+                it->it_seq = NULL;
+                Py_DECREF(seq);
+            }
+            STACKADJ(-1);
+            Py_DECREF(iter);
+            JUMPBY(oparg);
+            DISPATCH();
+        }
+
+        TARGET(FOR_ITER_TUPLE) {
+            PyObject *iter = TOP();
+            _PyTupleIterObject *it = (_PyTupleIterObject *)iter;
+            PyTupleObject *seq;
+            if (Py_TYPE(iter) != &PyTupleIter_Type)
+                DEOPTIMIZE();
+            SPECIALIZATION_HIT();
+            seq = it->it_seq;
+            if (seq != NULL) {
+                if (it->it_index < PyTuple_GET_SIZE(seq)) {
+                    PyObject *next = PyTuple_GET_ITEM(seq, it->it_index++);
+                    Py_INCREF(next);
+                    PUSH(next);
+                    PREDICT(STORE_FAST);
+                    PREDICT(UNPACK_SEQUENCE);
+                    DISPATCH();
+                }
+                it->it_seq = NULL;
+                Py_DECREF(seq);
+            }
+            STACKADJ(-1);
+            Py_DECREF(iter);
+            JUMPBY(oparg);
+            DISPATCH();
+        }
+
+        TARGET(FOR_ITER_RANGE) {
+            PyObject *iter = TOP();
+            PyObject *next;
+            if (Py_TYPE(iter) == &PyRangeIter_Type) {
+                _PyRangeIterObject *r = (_PyRangeIterObject *)iter;
+                SPECIALIZATION_HIT();
+                if (r->index < r->len) {
+                    /* as rangeiter_next() */
+                    next = PyLong_FromLong((long)(r->start +
+                        (unsigned long)(r->index++) * r->step));
+                    if (next == NULL)
+                        goto error;
+                    PUSH(next);
+                    PREDICT(STORE_FAST);
+                    DISPATCH();
+                }
+            }
+            else if (Py_TYPE(iter) == &PyLongRangeIter_Type) {
+                int found;
+                SPECIALIZATION_HIT();
+                found = _PyLongRangeIter_Next(iter, &next);
+                if (found < 0)
+                    goto error;
+                if (found) {
+                    PUSH(next);
+                    PREDICT(STORE_FAST);
+                    DISPATCH();
+                }
+            }
+            else
+                DEOPTIMIZE();
+            STACKADJ(-1);
+            Py_DECREF(iter);
+            JUMPBY(oparg);
+            DISPATCH();
+        }
+
+        TARGET(FOR_ITER_DICT) {
+            PyObject *iter = TOP();
+            PyObject *next;
+            int found;
+            if (Py_TYPE(iter) != &PyDictIterKey_Type &&
+                Py_TYPE(iter) != &PyDictIterValue_Type &&
+                Py_TYPE(iter) != &PyDictIterItem_Type)
+                DEOPTIMIZE();
+            SPECIALIZATION_HIT();
+            found = _PyDictIter_Next(iter, &next);
+            if (found < 0)
+                goto error;
+            if (found) {
+                PUSH(next);
+                PREDICT(STORE_FAST);
+                PREDICT(UNPACK_SEQUENCE);
+                DISPATCH();
+            }
+            STACKADJ(-1);
+            Py_DECREF(iter);
+            JUMPBY(oparg);
+            DISPATCH();
+        }
+
         TARGET(BREAK_LOOP) {
             why = WHY_BREAK;
             goto fast_block_end;
@@ -3002,8 +3708,11 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
                to update the PyGen_NeedsFinalizing() function.
                */
 
-            PyFrame_BlockSetup(f, opcode, INSTR_OFFSET() + oparg,
-                               STACK_LEVEL());
+            if (opcode != SETUP_LOOP &&
+                starts_table_block(co, INSTR_OFFSET()))
+                DISPATCH();
+            _PyFrame_BlockSetup(f, opcode, INSTR_OFFSET() + oparg,
+                                STACK_LEVEL());
             DISPATCH();
         }
 
@@ -3031,16 +3740,21 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
         }
 
         TARGET(SETUP_ASYNC_WITH) {
-            PyObject *res = POP();
+            PyObject *res;
+            if (starts_table_block(co, INSTR_OFFSET()))
+                DISPATCH();
+            res = POP();
             /* Setup the finally block before pushing the result
                of __aenter__ on the stack. */
-            PyFrame_BlockSetup(f, SETUP_FINALLY, INSTR_OFFSET() + oparg,
-                               STACK_LEVEL());
+            _PyFrame_BlockSetup(f, SETUP_FINALLY, INSTR_OFFSET() + oparg,
+                                STACK_LEVEL());
             PUSH(res);
             DISPATCH();
         }
 
-        TARGET(SETUP_WITH) {
+        TARGET_WITH_IMPL(ENTER_WITH, _setup_with)
+        TARGET(SETUP_WITH)
+        _setup_with: {
             _Py_IDENTIFIER(__exit__);
             _Py_IDENTIFIER(__enter__);
             PyObject *mgr = TOP();
@@ -3058,9 +3772,12 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             if (res == NULL)
                 goto error;
             /* Setup the finally block before pushing the result
-               of __enter__ on the stack. */
-            PyFrame_BlockSetup(f, SETUP_FINALLY, INSTR_OFFSET() + oparg,
-                               STACK_LEVEL());
+               of __enter__ on the stack, unless the exception table has
+               it */
+            if (opcode == SETUP_WITH &&
+                !starts_table_block(co, INSTR_OFFSET()))
+                _PyFrame_BlockSetup(f, SETUP_FINALLY, INSTR_OFFSET() + oparg,
+                                    STACK_LEVEL());
 
             PUSH(res);
             DISPATCH();
@@ -3179,11 +3896,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             PyObject **sp, *res;
             PCALL(PCALL_ALL);
             sp = stack_pointer;
-#ifdef WITH_TSC
-            res = call_function(&sp, oparg, &intr0, &intr1);
-#else
             res = call_function(&sp, oparg);
-#endif
             stack_pointer = sp;
             PUSH(res);
             if (res == NULL)
@@ -3191,6 +3904,37 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             DISPATCH();
         }
 
+        TARGET(CALL_METHOD) {
+            /* The stack has the method and self from LOAD_METHOD, or NULL
+               and the callable, then the oparg positional arguments. */
+            PyObject **sp, *res, *meth = PEEK(oparg + 2);
+            PCALL(PCALL_ALL);
+            if (meth != NULL && tstate->use_tracing &&
+                tstate->c_profilefunc != NULL &&
+                Py_TYPE(meth) == &PyMethodDescr_Type) {
+                /* a profiler sees calls of builtin functions:  bind it */
+                PyObject *self = PEEK(oparg + 1);
+                PyObject *bound = Py_TYPE(meth)->tp_descr_get(
+                    meth, self, (PyObject *)Py_TYPE(self));
+                if (bound == NULL)
+                    goto error;
+                PEEK(oparg + 2) = NULL;
+                PEEK(oparg + 1) = bound;
+                Py_DECREF(meth);
+                Py_DECREF(self);
+                meth = NULL;
+            }
+            sp = stack_pointer;
+            res = call_function(&sp, meth == NULL ? oparg : oparg + 1);
+            stack_pointer = sp;
+            if (meth == NULL)
+                STACKADJ(-1);   /* the NULL */
+            PUSH(res);
+            if (res == NULL)
+                goto error;
+            DISPATCH();
+        }
+
         TARGET_WITH_IMPL(CALL_FUNCTION_VAR, _call_function_var_kw)
         TARGET_WITH_IMPL(CALL_FUNCTION_KW, _call_function_var_kw)
         TARGET(CALL_FUNCTION_VAR_KW)
@@ -3221,9 +3965,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
             } else
                 Py_INCREF(func);
             sp = stack_pointer;
-            READ_TIMESTAMP(intr0);
             res = ext_do_call(func, &sp, flags, na, nk);
-            READ_TIMESTAMP(intr1);
             stack_pointer = sp;
             Py_DECREF(func);
 
@@ -3380,7 +4122,7 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
         default:
             fprintf(stderr,
                 "XXX lineno: %d, opcode: %d\n",
-                PyFrame_GetLineNumber(f),
+                _PyFrame_GetLineNumber(f),
                 opcode);
             PyErr_SetString(PyExc_SystemError, "unknown opcode");
             goto error;
@@ -3396,8 +4138,6 @@ PyEval_EvalFrameEx(PyFrameObject *f, int throwflag)
         assert(0);
 
 error:
-        READ_TIMESTAMP(inst1);
-
         assert(why == WHY_NOT);
         why = WHY_EXCEPTION;
 
@@ -3411,7 +4151,7 @@ error:
 #endif
 
         /* Log traceback info. */
-        PyTraceBack_Here(f);
+        traceback_here(f);
 
         if (tstate->c_tracefunc != NULL)
             call_exc_trace(tstate->c_tracefunc, tstate->c_traceobj,
@@ -3420,25 +4160,55 @@ error:
 fast_block_end:
         assert(why != WHY_NOT);
 
-        /* Unwind stacks if a (pseudo) exception occurred */
-        while (why != WHY_NOT && f->f_iblock > 0) {
-            /* Peek at the current block. */
-            PyTryBlock *b = &f->f_blockstack[f->f_iblock - 1];
+        /* Unwind stacks if a (pseudo) exception occurred.  The try blocks
+           of the exception table around the instruction come in between
+           the blocks of the block stack, the innermost first. */
+        table_bound = INT_MAX;
+        while (why != WHY_NOT) {
+            const _PyExceptionTableEntry *entry = NULL;
+            PyTryBlock *b;
 
             assert(why != WHY_YIELD);
-            if (b->b_type == SETUP_LOOP && why == WHY_CONTINUE) {
-                why = WHY_NOT;
-                JUMPTO(PyLong_AS_LONG(retval));
-                Py_DECREF(retval);
-                break;
+            if (co->co_exceptiontable != NULL) {
+                entry = _PyCode_FindTryBlock(co, f->f_lasti, table_bound);
+                /* It's in the block on top of the block stack if it ends
+                   before the handler of the block, or for an except
+                   handler, if it starts after the handler */
+                if (entry != NULL && f->f_iblock > 0) {
+                    b = &f->f_blockstack[f->f_iblock - 1];
+                    if (b->b_type == EXCEPT_HANDLER ?
+                        entry->start < b->b_handler :
+                        entry->end >= b->b_handler)
+                        entry = NULL;
+                }
             }
-            /* Now we have to pop the block. */
-            f->f_iblock--;
+            if (entry != NULL) {
+                table_bound = entry->start;
+                table_block.b_type = entry->type;
+                table_block.b_handler = entry->handler;
+                table_block.b_level = entry->level;
+                b = &table_block;
+            }
+            else if (f->f_iblock > 0) {
+                /* Peek at the current block. */
+                b = &f->f_blockstack[f->f_iblock - 1];
 
-            if (b->b_type == EXCEPT_HANDLER) {
-                UNWIND_EXCEPT_HANDLER(b);
-                continue;
+                if (b->b_type == SETUP_LOOP && why == WHY_CONTINUE) {
+                    why = WHY_NOT;
+                    JUMPTO(PyLong_AS_LONG(retval));
+                    Py_DECREF(retval);
+                    break;
+                }
+                /* Now we have to pop the block. */
+                f->f_iblock--;
+
+                if (b->b_type == EXCEPT_HANDLER) {
+                    UNWIND_EXCEPT_HANDLER(b);
+                    continue;
+                }
             }
+            else
+                break;
             UNWIND_BLOCK(b);
             if (b->b_type == SETUP_LOOP && why == WHY_BREAK) {
                 why = WHY_NOT;
@@ -3449,8 +4219,11 @@ fast_block_end:
                 || b->b_type == SETUP_FINALLY)) {
                 PyObject *exc, *val, *tb;
                 int handler = b->b_handler;
-                /* Beware, this invalidates all b->b_* fields */
-                PyFrame_BlockSetup(f, EXCEPT_HANDLER, -1, STACK_LEVEL());
+                /* The handler tells the try blocks of the exception table
+                   in the except clauses from those around them.  Beware,
+                   this invalidates all b->b_* fields */
+                _PyFrame_BlockSetup(f, EXCEPT_HANDLER, handler,
+                                    STACK_LEVEL());
                 PUSH(tstate->exc_traceback);
                 PUSH(tstate->exc_value);
                 if (tstate->exc_type != NULL) {
@@ -3500,7 +4273,6 @@ fast_block_end:
 
         if (why != WHY_NOT)
             break;
-        READ_TIMESTAMP(loop1);
 
         assert(!PyErr_Occurred());
 
@@ -3540,6 +4312,8 @@ fast_yield:
             swap_exc_state(tstate, f);
     }
 
+    if (tstate->opcode_profile != NULL)
+        profile_stop_timing(tstate->opcode_profile);
     if (tstate->use_tracing) {
         if (tstate->c_tracefunc) {
             if (why == WHY_RETURN || why == WHY_YIELD) {
@@ -3569,17 +4343,40 @@ fast_yield:
                 /* why = WHY_EXCEPTION; */
             }
         }
+        if (tstate->c_instrfunc != NULL &&
+            (co->co_instrumentation & PyCode_INSTRUMENT_RETURN)) {
+            if (why == WHY_EXCEPTION)
+                call_trace_protected(tstate->c_instrfunc,
+                                     tstate->c_instrobj,
+                                     tstate, f, PyTrace_RETURN, NULL);
+            else if (call_trace(tstate->c_instrfunc, tstate->c_instrobj,
+                                tstate, f, PyTrace_RETURN, retval)) {
+                Py_CLEAR(retval);
+                why = WHY_EXCEPTION;
+            }
+        }
     }
 
     /* pop frame */
 exit_eval_frame:
     Py_LeaveRecursiveCall();
     f->f_executing = 0;
-    tstate->frame = f->f_back;
+    tstate->frame = f->f_previous;
+    f->f_previous = NULL;
 
     return _Py_CheckFunctionResult(NULL, retval, "PyEval_EvalFrameEx");
 }
 
+/* Add the frame f to the traceback being raised */
+static void
+traceback_here(_PyInterpreterFrame *f)
+{
+    PyFrameObject *fo = _PyFrame_GetFrameObject(f);
+
+    if (fo != NULL)
+        PyTraceBack_Here(fo);
+}
+
 static void
 format_missing(const char *kind, PyCodeObject *co, PyObject *names)
 {
@@ -3734,14 +4531,18 @@ too_many_positional(PyCodeObject *co, int given, int defcount, PyObject **fastlo
    PyEval_EvalFrame() and PyEval_EvalCodeEx() you will need to adjust
    the test in the if statements in Misc/gdbinit (pystack and pystackv). */
 
+/* The keyword arguments are kwcount names and values:  kwnames[i * kwstep]
+   and kwargs[i * kwstep]. */
 static PyObject *
 _PyEval_EvalCodeWithName(PyObject *_co, PyObject *globals, PyObject *locals,
-           PyObject **args, int argcount, PyObject **kws, int kwcount,
+           PyObject **args, int argcount,
+           PyObject **kwnames, PyObject **kwargs, int kwcount, int kwstep,
            PyObject **defs, int defcount, PyObject *kwdefs, PyObject *closure,
            PyObject *name, PyObject *qualname)
 {
     PyCodeObject* co = (PyCodeObject*)_co;
-    PyFrameObject *f;
+    PyFrameObject *gen_frame = NULL;
+    _PyInterpreterFrame *f;
     PyObject *retval = NULL;
     PyObject **fastlocals, **freevars;
     PyThreadState *tstate = PyThreadState_GET();
@@ -3759,9 +4560,19 @@ _PyEval_EvalCodeWithName(PyObject *_co, PyObject *globals, PyObject *locals,
 
     assert(tstate != NULL);
     assert(globals != NULL);
-    f = PyFrame_New(tstate, co, globals, locals);
-    if (f == NULL)
-        return NULL;
+    /* A generator keeps its frame in a frame object, the frame of other
+       calls goes on the frame stack */
+    if (co->co_flags & (CO_GENERATOR | CO_COROUTINE)) {
+        gen_frame = PyFrame_New(tstate, co, globals, locals);
+        if (gen_frame == NULL)
+            return NULL;
+        f = gen_frame->f_frame;
+    }
+    else {
+        f = _PyFrame_Push(tstate, co, globals, locals);
+        if (f == NULL)
+            return NULL;
+    }
 
     fastlocals = f->f_localsplus;
     freevars = f->f_localsplus + co->co_nlocals;
@@ -3796,8 +4607,8 @@ _PyEval_EvalCodeWithName(PyObject *_co, PyObject *globals, PyObject *locals,
     }
     for (i = 0; i < kwcount; i++) {
         PyObject **co_varnames;
-        PyObject *keyword = kws[2*i];
-        PyObject *value = kws[2*i + 1];
+        PyObject *keyword = kwnames[i * kwstep];
+        PyObject *value = kwargs[i * kwstep];
         int j;
         if (keyword == NULL || !PyUnicode_Check(keyword)) {
             PyErr_Format(PyExc_TypeError,
@@ -3936,18 +4747,14 @@ _PyEval_EvalCodeWithName(PyObject *_co, PyObject *globals, PyObject *locals,
             goto fail;
         }
 
-        /* Don't need to keep the reference to f_back, it will be set
-         * when the generator is resumed. */
-        Py_CLEAR(f->f_back);
-
         PCALL(PCALL_GENERATOR);
 
         /* Create a new generator that owns the ready to run frame
          * and return that as the value. */
         if (is_coro) {
-            gen = PyCoro_New(f, name, qualname);
+            gen = PyCoro_New(gen_frame, name, qualname);
         } else {
-            gen = PyGen_NewWithQualName(f, name, qualname);
+            gen = PyGen_NewWithQualName(gen_frame, name, qualname);
         }
         if (gen == NULL)
             return NULL;
@@ -3963,18 +4770,21 @@ _PyEval_EvalCodeWithName(PyObject *_co, PyObject *globals, PyObject *locals,
         return gen;
     }
 
-    retval = PyEval_EvalFrameEx(f,0);
+    retval = eval_frame(f, 0);
 
 fail: /* Jump here from prelude on failure */
 
-    /* decref'ing the frame can cause __del__ methods to get invoked,
+    /* Popping the frame can cause __del__ methods to get invoked,
        which can call back into Python.  While we're done with the
        current Python frame (f), the associated C stack is still in use,
        so recursion_depth must be boosted for the duration.
     */
     assert(tstate != NULL);
     ++tstate->recursion_depth;
-    Py_DECREF(f);
+    if (gen_frame != NULL)
+        Py_DECREF(gen_frame);
+    else
+        _PyFrame_Pop(tstate, f);
     --tstate->recursion_depth;
     return retval;
 }
@@ -3985,7 +4795,9 @@ PyEval_EvalCodeEx(PyObject *_co, PyObject *globals, PyObject *locals,
            PyObject **defs, int defcount, PyObject *kwdefs, PyObject *closure)
 {
     return _PyEval_EvalCodeWithName(_co, globals, locals,
-                                    args, argcount, kws, kwcount,
+                                    args, argcount,
+                                    kws, kws != NULL ? kws + 1 : NULL,
+                                    kwcount, 2,
                                     defs, defcount, kwdefs, closure,
                                     NULL, NULL);
 }
@@ -4002,11 +4814,24 @@ special_lookup(PyObject *o, _Py_Identifier *id)
     return res;
 }
 
+/* Whether a block of the exception table of co starts at 'offset', after
+   the SETUP instruction which co_code runs for it:  the block isn't set up */
+static int
+starts_table_block(PyCodeObject *co, int offset)
+{
+    const _PyExceptionTableEntry *entry;
+
+    if (co->co_exceptiontable == NULL)
+        return 0;
+    entry = _PyCode_FindTryBlock(co, offset, INT_MAX);
+    return entry != NULL && entry->start == offset;
+}
+
 
 /* These 3 functions deal with the exception state of generators. */
 
 static void
-save_exc_state(PyThreadState *tstate, PyFrameObject *f)
+save_exc_state(PyThreadState *tstate, _PyInterpreterFrame *f)
 {
     PyObject *type, *value, *traceback;
     Py_XINCREF(tstate->exc_type);
@@ -4024,7 +4849,7 @@ save_exc_state(PyThreadState *tstate, PyFrameObject *f)
 }
 
 static void
-swap_exc_state(PyThreadState *tstate, PyFrameObject *f)
+swap_exc_state(PyThreadState *tstate, _PyInterpreterFrame *f)
 {
     PyObject *tmp;
     tmp = tstate->exc_type;
@@ -4039,7 +4864,7 @@ swap_exc_state(PyThreadState *tstate, PyFrameObject *f)
 }
 
 static void
-restore_and_clear_exc_state(PyThreadState *tstate, PyFrameObject *f)
+restore_and_clear_exc_state(PyThreadState *tstate, _PyInterpreterFrame *f)
 {
     PyObject *type, *value, *tb;
     type = tstate->exc_type;
@@ -4257,7 +5082,7 @@ prtrace(PyObject *v, char *str)
 
 static void
 call_exc_trace(Py_tracefunc func, PyObject *self,
-               PyThreadState *tstate, PyFrameObject *f)
+               PyThreadState *tstate, _PyInterpreterFrame *f)
 {
     PyObject *type, *value, *traceback, *orig_traceback, *arg;
     int err;
@@ -4286,7 +5111,7 @@ call_exc_trace(Py_tracefunc func, PyObject *self,
 
 static int
 call_trace_protected(Py_tracefunc func, PyObject *obj,
-                     PyThreadState *tstate, PyFrameObject *frame,
+                     PyThreadState *tstate, _PyInterpreterFrame *frame,
                      int what, PyObject *arg)
 {
     PyObject *type, *value, *traceback;
@@ -4308,17 +5133,20 @@ call_trace_protected(Py_tracefunc func, PyObject *obj,
 
 static int
 call_trace(Py_tracefunc func, PyObject *obj,
-           PyThreadState *tstate, PyFrameObject *frame,
+           PyThreadState *tstate, _PyInterpreterFrame *frame,
            int what, PyObject *arg)
 {
+    PyFrameObject *fo;
     int result;
     if (tstate->tracing)
         return 0;
+    fo = _PyFrame_GetFrameObject(frame);
+    if (fo == NULL)
+        return -1;
     tstate->tracing++;
     tstate->use_tracing = 0;
-    result = func(obj, frame, what, arg);
-    tstate->use_tracing = ((tstate->c_tracefunc != NULL)
-                           || (tstate->c_profilefunc != NULL));
+    result = func(obj, fo, what, arg);
+    tstate->use_tracing = USE_TRACING(tstate);
     tstate->tracing--;
     return result;
 }
@@ -4332,8 +5160,7 @@ _PyEval_CallTracing(PyObject *func, PyObject *args)
     PyObject *result;
 
     tstate->tracing = 0;
-    tstate->use_tracing = ((tstate->c_tracefunc != NULL)
-                           || (tstate->c_profilefunc != NULL));
+    tstate->use_tracing = USE_TRACING(tstate);
     result = PyObject_Call(func, args, NULL);
     tstate->tracing = save_tracing;
     tstate->use_tracing = save_use_tracing;
@@ -4343,7 +5170,7 @@ _PyEval_CallTracing(PyObject *func, PyObject *args)
 /* See Objects/lnotab_notes.txt for a description of how tracing works. */
 static int
 maybe_call_line_trace(Py_tracefunc func, PyObject *obj,
-                      PyThreadState *tstate, PyFrameObject *frame,
+                      PyThreadState *tstate, _PyInterpreterFrame *frame,
                       int *instr_lb, int *instr_ub, int *instr_prev)
 {
     int result = 0;
@@ -4379,12 +5206,30 @@ PyEval_SetProfile(Py_tracefunc func, PyObject *arg)
     tstate->c_profilefunc = NULL;
     tstate->c_profileobj = NULL;
     /* Must make sure that tracing is not ignored if 'temp' is freed */
-    tstate->use_tracing = tstate->c_tracefunc != NULL;
+    tstate->use_tracing = USE_TRACING(tstate);
     Py_XDECREF(temp);
     tstate->c_profilefunc = func;
     tstate->c_profileobj = arg;
     /* Flag that tracing or profiling is turned on */
-    tstate->use_tracing = (func != NULL) || (tstate->c_tracefunc != NULL);
+    tstate->use_tracing = USE_TRACING(tstate);
+}
+
+void
+PyEval_SetInstrumentation(Py_tracefunc func, PyObject *arg)
+{
+    PyThreadState *tstate = PyThreadState_GET();
+    PyObject *temp = tstate->c_instrobj;
+    Py_XINCREF(arg);
+    tstate->c_instrfunc = NULL;
+    tstate->c_instrobj = NULL;
+    /* Must make sure that tracing and profiling are not ignored if 'temp'
+       is freed */
+    tstate->use_tracing = USE_TRACING(tstate);
+    Py_XDECREF(temp);
+    tstate->c_instrfunc = func;
+    tstate->c_instrobj = arg;
+    /* The eval loop looks at the events of the code objects then */
+    tstate->use_tracing = USE_TRACING(tstate);
 }
 
 void
@@ -4397,13 +5242,12 @@ PyEval_SetTrace(Py_tracefunc func, PyObject *arg)
     tstate->c_tracefunc = NULL;
     tstate->c_traceobj = NULL;
     /* Must make sure that profiling is not ignored if 'temp' is freed */
-    tstate->use_tracing = tstate->c_profilefunc != NULL;
+    tstate->use_tracing = USE_TRACING(tstate);
     Py_XDECREF(temp);
     tstate->c_tracefunc = func;
     tstate->c_traceobj = arg;
     /* Flag that tracing or profiling is turned on */
-    tstate->use_tracing = ((func != NULL)
-                           || (tstate->c_profilefunc != NULL));
+    tstate->use_tracing = USE_TRACING(tstate);
 }
 
 void
@@ -4427,7 +5271,7 @@ _PyEval_GetCoroutineWrapper(void)
 PyObject *
 PyEval_GetBuiltins(void)
 {
-    PyFrameObject *current_frame = PyEval_GetFrame();
+    _PyInterpreterFrame *current_frame = PyThreadState_GET()->frame;
     if (current_frame == NULL)
         return PyThreadState_GET()->interp->builtins;
     else
@@ -4437,13 +5281,13 @@ PyEval_GetBuiltins(void)
 PyObject *
 PyEval_GetLocals(void)
 {
-    PyFrameObject *current_frame = PyEval_GetFrame();
+    _PyInterpreterFrame *current_frame = PyThreadState_GET()->frame;
     if (current_frame == NULL) {
         PyErr_SetString(PyExc_SystemError, "frame does not exist");
         return NULL;
     }
 
-    if (PyFrame_FastToLocalsWithError(current_frame) < 0)
+    if (_PyFrame_FastToLocalsWithError(current_frame) < 0)
         return NULL;
 
     assert(current_frame->f_locals != NULL);
@@ -4453,7 +5297,7 @@ PyEval_GetLocals(void)
 PyObject *
 PyEval_GetGlobals(void)
 {
-    PyFrameObject *current_frame = PyEval_GetFrame();
+    _PyInterpreterFrame *current_frame = PyThreadState_GET()->frame;
     if (current_frame == NULL)
         return NULL;
 
@@ -4471,7 +5315,7 @@ PyEval_GetFrame(void)
 int
 PyEval_MergeCompilerFlags(PyCompilerFlags *cf)
 {
-    PyFrameObject *current_frame = PyEval_GetFrame();
+    _PyInterpreterFrame *current_frame = PyThreadState_GET()->frame;
     int result = cf->cf_flags != 0;
 
     if (current_frame != NULL) {
@@ -4559,21 +5403,6 @@ PyEval_GetFuncDesc(PyObject *func)
         return " object";
 }
 
-static void
-err_args(PyObject *func, int flags, int nargs)
-{
-    if (flags & METH_NOARGS)
-        PyErr_Format(PyExc_TypeError,
-                     "%.200s() takes no arguments (%d given)",
-                     ((PyCFunctionObject *)func)->m_ml->ml_name,
-                     nargs);
-    else
-        PyErr_Format(PyExc_TypeError,
-                     "%.200s() takes exactly one argument (%d given)",
-                     ((PyCFunctionObject *)func)->m_ml->ml_name,
-                     nargs);
-}
-
 #define C_TRACE(x, call) \
 if (tstate->use_tracing && tstate->c_profilefunc) { \
     if (call_trace(tstate->c_profilefunc, tstate->c_profileobj, \
@@ -4606,60 +5435,35 @@ if (tstate->use_tracing && tstate->c_profilefunc) { \
     }
 
 static PyObject *
-call_function(PyObject ***pp_stack, int oparg
-#ifdef WITH_TSC
-                , uint64* pintr0, uint64* pintr1
-#endif
-                )
+call_function(PyObject ***pp_stack, int oparg)
 {
     int na = oparg & 0xff;
     int nk = (oparg>>8) & 0xff;
     int n = na + 2 * nk;
     PyObject **pfunc = (*pp_stack) - n - 1;
     PyObject *func = *pfunc;
+    PyObject **stack = pfunc + 1;
+    PyObject *kwnames = NULL;
     PyObject *x, *w;
 
     /* Always dispatch PyCFunction first, because these are
        presumed to be the most frequent callable object.
     */
-    if (PyCFunction_Check(func) && nk == 0) {
-        int flags = PyCFunction_GET_FLAGS(func);
+    if (PyCFunction_Check(func)) {
         PyThreadState *tstate = PyThreadState_GET();
 
         PCALL(PCALL_CFUNCTION);
-        if (flags & (METH_NOARGS | METH_O)) {
-            PyCFunction meth = PyCFunction_GET_FUNCTION(func);
-            PyObject *self = PyCFunction_GET_SELF(func);
-            if (flags & METH_NOARGS && na == 0) {
-                C_TRACE(x, (*meth)(self,NULL));
-
-                x = _Py_CheckFunctionResult(func, x, NULL);
-            }
-            else if (flags & METH_O && na == 1) {
-                PyObject *arg = EXT_POP(*pp_stack);
-                C_TRACE(x, (*meth)(self,arg));
-                Py_DECREF(arg);
-
-                x = _Py_CheckFunctionResult(func, x, NULL);
-            }
-            else {
-                err_args(func, flags, na);
-                x = NULL;
-            }
-        }
-        else {
-            PyObject *callargs;
-            callargs = load_args(pp_stack, na);
-            if (callargs != NULL) {
-                READ_TIMESTAMP(*pintr0);
-                C_TRACE(x, PyCFunction_Call(func,callargs,NULL));
-                READ_TIMESTAMP(*pintr1);
-                Py_XDECREF(callargs);
-            }
-            else {
+        if (nk > 0) {
+            kwnames = stack_kwnames(pp_stack, nk);
+            if (kwnames == NULL) {
                 x = NULL;
+                goto clear_stack;
             }
         }
+        C_TRACE(x, _PyMethodDef_Vectorcall(((PyCFunctionObject *)func)->m_ml,
+                                           PyCFunction_GET_SELF(func),
+                                           stack, na, kwnames));
+        x = _Py_CheckFunctionResult(func, x, NULL);
     }
     else {
         if (PyMethod_Check(func) && PyMethod_GET_SELF(func) != NULL) {
@@ -4672,24 +5476,37 @@ call_function(PyObject ***pp_stack, int oparg
             Py_INCREF(func);
             Py_DECREF(*pfunc);
             *pfunc = self;
+            stack = pfunc;
             na++;
-            n++;
         } else
             Py_INCREF(func);
-        READ_TIMESTAMP(*pintr0);
-        if (PyFunction_Check(func))
-            x = fast_function(func, pp_stack, n, na, nk);
-        else
-            x = do_call(func, pp_stack, na, nk);
-        READ_TIMESTAMP(*pintr1);
+        if (PyFunction_Check(func)) {
+            /* functions take the keyword arguments as they are on the
+               stack, in key, value pairs */
+            x = function_call(func, stack, na, stack + na, stack + na + 1,
+                              nk, 2);
+        }
+        else {
+#ifdef CALL_PROFILE
+            if (PyType_Check(func))
+                PCALL(PCALL_TYPE);
+            else
+                PCALL(PCALL_OTHER);
+#endif
+            if (nk > 0)
+                kwnames = stack_kwnames(pp_stack, nk);
+            if (nk > 0 && kwnames == NULL)
+                x = NULL;
+            else
+                x = _PyObject_Vectorcall(func, stack, na, kwnames);
+        }
         Py_DECREF(func);
-
-        assert((x != NULL) ^ (PyErr_Occurred() != NULL));
     }
+    Py_XDECREF(kwnames);
 
-    /* Clear the stack of the function object.  Also removes
-       the arguments in case they weren't consumed already
-       (fast_function() and err_args() leave them on the stack).
+  clear_stack:
+    /* Clear the stack of the function object and the arguments, which
+       the callee borrowed.
      */
     while ((*pp_stack) > pfunc) {
         w = EXT_POP(*pp_stack);
@@ -4701,17 +5518,49 @@ call_function(PyObject ***pp_stack, int oparg
     return x;
 }
 
-/* The fast_function() function optimize calls for which no argument
-   tuple is necessary; the objects are passed directly from the stack.
-   For the simplest case -- a function that takes only positional
-   arguments and is called with only positional arguments -- it
-   inlines the most primitive frame setup code from
-   PyEval_EvalCodeEx(), which vastly reduces the checks that must be
+/* Move the nk key, value pairs of keyword arguments on top of the stack to
+   where a vectorcall takes them:  the values go first, and the keys into the
+   tuple returned.  The nk slots left over are dropped from the stack. */
+static PyObject *
+stack_kwnames(PyObject ***pp_stack, int nk)
+{
+    PyObject **kwstack = (*pp_stack) - 2 * nk;
+    PyObject *kwnames = PyTuple_New(nk);
+    int i;
+
+    if (kwnames == NULL)
+        return NULL;
+    for (i = 0; i < nk; i++) {
+        PyTuple_SET_ITEM(kwnames, i, kwstack[2*i]);
+        kwstack[i] = kwstack[2*i + 1];
+    }
+    (*pp_stack) -= nk;
+    return kwnames;
+}
+
+/* The vectorcall of functions */
+PyObject *
+_PyFunction_Vectorcall(PyObject *func, PyObject **stack, Py_ssize_t nargs,
+                       PyObject *kwnames)
+{
+    Py_ssize_t nk = kwnames == NULL ? 0 : PyTuple_GET_SIZE(kwnames);
+
+    return function_call(func, stack, nargs,
+                         nk != 0 ? &PyTuple_GET_ITEM(kwnames, 0) : NULL,
+                         stack + nargs, Py_SAFE_DOWNCAST(nk, Py_ssize_t, int),
+                         1);
+}
+
+/* Call a function with nargs positional arguments, and the nk keyword
+   arguments kwnames[i*kwstep] = kwargs[i*kwstep].  For the simplest case --
+   a function that takes only positional arguments and is called with only
+   positional arguments -- it inlines the most primitive frame setup code
+   from PyEval_EvalCodeEx(), which vastly reduces the checks that must be
    done before evaluating the frame.
 */
-
 static PyObject *
-fast_function(PyObject *func, PyObject ***pp_stack, int n, int na, int nk)
+function_call(PyObject *func, PyObject **stack, Py_ssize_t nargs,
+              PyObject **kwnames, PyObject **kwargs, int nk, int kwstep)
 {
     PyCodeObject *co = (PyCodeObject *)PyFunction_GET_CODE(func);
     PyObject *globals = PyFunction_GET_GLOBALS(func);
@@ -4724,36 +5573,31 @@ fast_function(PyObject *func, PyObject ***pp_stack, int n, int na, int nk)
 
     PCALL(PCALL_FUNCTION);
     PCALL(PCALL_FAST_FUNCTION);
-    if (argdefs == NULL && co->co_argcount == n &&
-        co->co_kwonlyargcount == 0 && nk==0 &&
+    if (argdefs == NULL && co->co_argcount == nargs &&
+        co->co_kwonlyargcount == 0 && nk == 0 &&
         co->co_flags == (CO_OPTIMIZED | CO_NEWLOCALS | CO_NOFREE)) {
-        PyFrameObject *f;
+        _PyInterpreterFrame *f;
         PyObject *retval = NULL;
         PyThreadState *tstate = PyThreadState_GET();
-        PyObject **fastlocals, **stack;
-        int i;
+        PyObject **fastlocals;
+        Py_ssize_t i;
 
         PCALL(PCALL_FASTER_FUNCTION);
         assert(globals != NULL);
-        /* XXX Perhaps we should create a specialized
-           PyFrame_New() that doesn't take locals, but does
-           take builtins without sanity checking them.
-        */
         assert(tstate != NULL);
-        f = PyFrame_New(tstate, co, globals, NULL);
+        f = _PyFrame_Push(tstate, co, globals, NULL);
         if (f == NULL)
             return NULL;
 
         fastlocals = f->f_localsplus;
-        stack = (*pp_stack) - n;
 
-        for (i = 0; i < n; i++) {
+        for (i = 0; i < nargs; i++) {
             Py_INCREF(*stack);
             fastlocals[i] = *stack++;
         }
-        retval = PyEval_EvalFrameEx(f,0);
+        retval = eval_frame(f, 0);
         ++tstate->recursion_depth;
-        Py_DECREF(f);
+        _PyFrame_Pop(tstate, f);
         --tstate->recursion_depth;
         return retval;
     }
@@ -4762,8 +5606,11 @@ fast_function(PyObject *func, PyObject ***pp_stack, int n, int na, int nk)
         nd = Py_SIZE(argdefs);
     }
     return _PyEval_EvalCodeWithName((PyObject*)co, globals,
-                                    (PyObject *)NULL, (*pp_stack)-n, na,
-                                    (*pp_stack)-2*nk, nk, d, nd, kwdefs,
+                                    (PyObject *)NULL,
+                                    stack, Py_SAFE_DOWNCAST(nargs,
+                                                            Py_ssize_t, int),
+                                    kwnames, kwargs, nk, kwstep,
+                                    d, nd, kwdefs,
                                     PyFunction_GET_CLOSURE(func),
                                     name, qualname);
 }
@@ -4833,64 +5680,6 @@ update_star_args(int nstack, int nstar, PyObject *stararg,
     return callargs;
 }
 
-static PyObject *
-load_args(PyObject ***pp_stack, int na)
-{
-    PyObject *args = PyTuple_New(na);
-    PyObject *w;
-
-    if (args == NULL)
-        return NULL;
-    while (--na >= 0) {
-        w = EXT_POP(*pp_stack);
-        PyTuple_SET_ITEM(args, na, w);
-    }
-    return args;
-}
-
-static PyObject *
-do_call(PyObject *func, PyObject ***pp_stack, int na, int nk)
-{
-    PyObject *callargs = NULL;
-    PyObject *kwdict = NULL;
-    PyObject *result = NULL;
-
-    if (nk > 0) {
-        kwdict = update_keyword_args(NULL, nk, pp_stack, func);
-        if (kwdict == NULL)
-            goto call_fail;
-    }
-    callargs = load_args(pp_stack, na);
-    if (callargs == NULL)
-        goto call_fail;
-#ifdef CALL_PROFILE
-    /* At this point, we have to look at the type of func to
-       update the call stats properly.  Do it here so as to avoid
-       exposing the call stats machinery outside ceval.c
-    */
-    if (PyFunction_Check(func))
-        PCALL(PCALL_FUNCTION);
-    else if (PyMethod_Check(func))
-        PCALL(PCALL_METHOD);
-    else if (PyType_Check(func))
-        PCALL(PCALL_TYPE);
-    else if (PyCFunction_Check(func))
-        PCALL(PCALL_CFUNCTION);
-    else
-        PCALL(PCALL_OTHER);
-#endif
-    if (PyCFunction_Check(func)) {
-        PyThreadState *tstate = PyThreadState_GET();
-        C_TRACE(result, PyCFunction_Call(func, callargs, kwdict));
-    }
-    else
-        result = PyObject_Call(func, callargs, kwdict);
-call_fail:
-    Py_XDECREF(callargs);
-    Py_XDECREF(kwdict);
-    return result;
-}
-
 static PyObject *
 ext_do_call(PyObject *func, PyObject ***pp_stack, int flags, int na, int nk)
 {
@@ -4955,32 +5744,45 @@ ext_do_call(PyObject *func, PyObject ***pp_stack, int flags, int na, int nk)
             stararg = t;
         }
         nstar = PyTuple_GET_SIZE(stararg);
+        callargs = update_star_args(na, nstar, stararg, pp_stack);
+        if (callargs == NULL)
+            goto ext_call_fail;
     }
-    callargs = update_star_args(na, nstar, stararg, pp_stack);
-    if (callargs == NULL)
-        goto ext_call_fail;
 #ifdef CALL_PROFILE
     /* At this point, we have to look at the type of func to
        update the call stats properly.  Do it here so as to avoid
-       exposing the call stats machinery outside ceval.c
+       exposing the call stats machinery outside ceval.c.  Functions
+       count their calls in _PyFunction_Vectorcall().
     */
-    if (PyFunction_Check(func))
-        PCALL(PCALL_FUNCTION);
-    else if (PyMethod_Check(func))
+    if (PyMethod_Check(func))
         PCALL(PCALL_METHOD);
     else if (PyType_Check(func))
         PCALL(PCALL_TYPE);
     else if (PyCFunction_Check(func))
         PCALL(PCALL_CFUNCTION);
-    else
+    else if (!PyFunction_Check(func))
         PCALL(PCALL_OTHER);
 #endif
-    if (PyCFunction_Check(func)) {
-        PyThreadState *tstate = PyThreadState_GET();
-        C_TRACE(result, PyCFunction_Call(func, callargs, kwdict));
+    if (callargs != NULL) {
+        if (PyCFunction_Check(func)) {
+            PyThreadState *tstate = PyThreadState_GET();
+            C_TRACE(result, PyCFunction_Call(func, callargs, kwdict));
+        }
+        else
+            result = PyObject_Call(func, callargs, kwdict);
+    }
+    else {
+        /* Without *args, the positional arguments are passed from the
+           stack, where the caller clears them */
+        PyObject **stack = (*pp_stack) - na;
+        if (PyCFunction_Check(func)) {
+            PyThreadState *tstate = PyThreadState_GET();
+            C_TRACE(result, _PyObject_VectorcallDict(func, stack, na,
+                                                     kwdict));
+        }
+        else
+            result = _PyObject_VectorcallDict(func, stack, na, kwdict);
     }
-    else
-        result = PyObject_Call(func, callargs, kwdict);
 ext_call_fail:
     Py_XDECREF(callargs);
     Py_XDECREF(kwdict);
@@ -5019,6 +5821,518 @@ _PyEval_SliceIndex(PyObject *v, Py_ssize_t *pi)
     return 1;
 }
 
+/* Attribute caches, see OPCACHE_ATTR_DICT and the others */
+
+static PyObject **
+attr_dictptr(PyTypeObject *tp, PyObject *owner)
+{
+    if (tp->tp_dictoffset > 0)
+        return (PyObject **)((char *)owner + tp->tp_dictoffset);
+    return _PyObject_GetDictPtr(owner);
+}
+
+/* Whether the instance dict of 'owner' shadows the attribute of the type
+   that 'ac' has cached, or the lookup changed the type. */
+static int
+attr_shadowed(_PyOpcache_Attr *ac, PyObject *owner, PyObject *name)
+{
+    PyTypeObject *tp = Py_TYPE(owner);
+    PyObject **dictptr = attr_dictptr(tp, owner), *v;
+    Py_ssize_t hint;
+
+    if (dictptr == NULL || *dictptr == NULL)
+        return 0;
+    hint = _PyDict_GetItemHint((PyDictObject *)*dictptr, name, ac->hint, &v);
+    if (v != NULL)
+        return 1;
+    /* the lookup may have run code which changed the type */
+    if (!OPCACHE_ATTR_MATCHES(ac, tp))
+        return 1;
+    ac->hint = hint;
+    return 0;
+}
+
+/* Replay the cache 'ac' of a LOAD_ATTR of 'name' on 'owner', whose type it
+   matches.  Returns 1 with the attribute in *res (NULL on error), or 0 if
+   the generic lookup must be done. */
+static int
+load_attr_cached(_PyOpcache_Attr *ac, PyObject *owner, PyObject *name,
+                 PyObject **res)
+{
+    PyTypeObject *tp = Py_TYPE(owner);
+    PyObject **dictptr, *v, *descr;
+    Py_ssize_t hint;
+    descrgetfunc f;
+
+    switch (ac->kind) {
+    case OPCACHE_ATTR_DICT:
+        dictptr = attr_dictptr(tp, owner);
+        if (dictptr == NULL || *dictptr == NULL)
+            return 0;
+        hint = _PyDict_GetItemHint((PyDictObject *)*dictptr, name,
+                                   ac->hint, &v);
+        if (v == NULL)
+            return 0;
+        ac->hint = hint;
+        Py_INCREF(v);
+        *res = v;
+        return 1;
+
+    case OPCACHE_ATTR_SLOT:
+        v = *(PyObject **)((char *)owner + ac->hint);
+        if (v == NULL)
+            return 0;   /* the generic lookup raises AttributeError */
+        Py_INCREF(v);
+        *res = v;
+        return 1;
+
+    case OPCACHE_ATTR_CLASS:
+    case OPCACHE_ATTR_METHOD:
+        if (attr_shadowed(ac, owner, name))
+            return 0;
+        /* fall through */
+    case OPCACHE_ATTR_DESCR:
+        descr = ac->descr;
+        Py_INCREF(descr);
+        f = Py_TYPE(descr)->tp_descr_get;
+        if (f == NULL) {
+            *res = descr;
+            return 1;
+        }
+        *res = f(descr, owner, (PyObject *)tp);
+        Py_DECREF(descr);
+        return 1;
+    }
+    return 0;
+}
+
+/* Replay the cache 'ac' of a STORE_ATTR of 'name' on 'owner', whose type it
+   matches.  Returns 1 with the result of the store in *err, or 0 if the
+   generic store must be done. */
+static int
+store_attr_cached(_PyOpcache_Attr *ac, PyObject *owner, PyObject *name,
+                  PyObject *v, int *err)
+{
+    PyObject **dictptr, **slot, *old, *descr;
+
+    switch (ac->kind) {
+    case OPCACHE_ATTR_DICT:
+        dictptr = attr_dictptr(Py_TYPE(owner), owner);
+        if (dictptr == NULL || *dictptr == NULL ||
+            _PyDict_SetItemHint((PyDictObject *)*dictptr, name, ac->hint, v))
+            return 0;
+        *err = 0;
+        return 1;
+
+    case OPCACHE_ATTR_SLOT:
+        slot = (PyObject **)((char *)owner + ac->hint);
+        old = *slot;
+        Py_INCREF(v);
+        *slot = v;
+        Py_XDECREF(old);
+        *err = 0;
+        return 1;
+
+    case OPCACHE_ATTR_DESCR:
+        descr = ac->descr;
+        Py_INCREF(descr);
+        *err = Py_TYPE(descr)->tp_descr_set(descr, owner, v);
+        Py_DECREF(descr);
+        return 1;
+    }
+    return 0;
+}
+
+/* Fill the cache 'oc' of the LOAD_ATTR, STORE_ATTR or LOAD_METHOD 'opcode'
+   after a successful lookup or store of 'name' on 'owner', when it can be
+   replayed.  This follows _PyObject_GenericGetAttrWithDict(),
+   _PyObject_GenericSetAttrWithDict() and _PyObject_GetMethod(). */
+static void
+attr_cache_fill(_PyOpcache *oc, PyObject *owner, PyObject *name, int opcode)
+{
+    PyTypeObject *tp = Py_TYPE(owner);
+    _PyOpcache_Attr *ac = &oc->u.attr;
+    PyObject *descr, **dictptr, *v;
+    Py_ssize_t hint = -1;
+    unsigned int tag;
+    int store = opcode == STORE_ATTR;
+    int kind;
+
+    if (store ? tp->tp_setattro != PyObject_GenericSetAttr
+              : tp->tp_getattro != PyObject_GenericGetAttr)
+        return;
+    if (!PyUnicode_CheckExact(name))
+        return;
+    descr = _PyType_Lookup(tp, name);
+    if (!PyType_HasFeature(tp, Py_TPFLAGS_VALID_VERSION_TAG))
+        return;
+    tag = tp->tp_version_tag;
+
+    if (descr != NULL && Py_TYPE(descr) == &PyMemberDescr_Type) {
+        PyMemberDef *m = ((PyMemberDescrObject *)descr)->d_member;
+        if (m->type == T_OBJECT_EX && m->flags == 0 &&
+            PyType_IsSubtype(tp, PyDescr_TYPE(descr))) {
+            kind = OPCACHE_ATTR_SLOT;
+            hint = m->offset;
+            goto done;
+        }
+    }
+    if (descr != NULL && PyDescr_IsData(descr)) {
+        if (!store && Py_TYPE(descr)->tp_descr_get == NULL)
+            return;
+        kind = OPCACHE_ATTR_DESCR;
+        goto done;
+    }
+
+    dictptr = _PyObject_GetDictPtr(owner);
+    if (dictptr != NULL && *dictptr != NULL) {
+        hint = _PyDict_GetItemHint((PyDictObject *)*dictptr, name, -1, &v);
+        /* the lookup may have run code which changed the type */
+        if (!PyType_HasFeature(tp, Py_TPFLAGS_VALID_VERSION_TAG) ||
+            tp->tp_version_tag != tag)
+            return;
+        if (v != NULL) {
+            kind = OPCACHE_ATTR_DICT;
+            goto done;
+        }
+    }
+    if (store || descr == NULL)
+        return;
+    if (opcode == LOAD_METHOD &&
+        (PyFunction_Check(descr) || Py_TYPE(descr) == &PyMethodDescr_Type))
+        kind = OPCACHE_ATTR_METHOD;
+    else
+        kind = OPCACHE_ATTR_CLASS;
+
+  done:
+    ac->type = tp;
+    ac->tp_version_tag = tag;
+    ac->kind = kind;
+    ac->hint = hint;
+    ac->descr = descr;
+    oc->optimized = 1;
+}
+
+/* Specialized forms, see OPCACHE_SPECIALIZE_AFTER */
+
+/* Rewrite the instruction at 'offset' into the form for the types of its
+   operands, 'left' and 'right', or count a miss if there is none. */
+static void
+specialize(PyCodeObject *co, int offset, _PyOpcache *oc, int oparg,
+           PyObject *left, PyObject *right)
+{
+    int opcode = (unsigned char)PyBytes_AS_STRING(co->co_code)[offset];
+    int form = 0;
+
+    switch (opcode) {
+    case BINARY_ADD:
+    case INPLACE_ADD:
+        if (IS_MEDIUM_INT(left) && IS_MEDIUM_INT(right))
+            form = BINARY_ADD_INT;
+        else if (PyFloat_CheckExact(left) && PyFloat_CheckExact(right))
+            form = BINARY_ADD_FLOAT;
+        break;
+    case BINARY_SUBSCR:
+        if (PyList_CheckExact(left) && IS_MEDIUM_INT(right))
+            form = BINARY_SUBSCR_LIST_INT;
+        break;
+    case COMPARE_OP:
+        if (oparg > PyCmp_GE)
+            break;
+        if (IS_MEDIUM_INT(left) && IS_MEDIUM_INT(right))
+            form = COMPARE_OP_INT;
+        else if (PyFloat_CheckExact(left) && PyFloat_CheckExact(right))
+            form = COMPARE_OP_FLOAT;
+        else if ((oparg == PyCmp_EQ || oparg == PyCmp_NE) &&
+                 PyUnicode_CheckExact(left) && PyUnicode_CheckExact(right))
+            form = COMPARE_OP_STR;
+        break;
+    case FOR_ITER:
+        if (Py_TYPE(left) == &PyListIter_Type)
+            form = FOR_ITER_LIST;
+        else if (Py_TYPE(left) == &PyTupleIter_Type)
+            form = FOR_ITER_TUPLE;
+        else if (Py_TYPE(left) == &PyRangeIter_Type ||
+                 Py_TYPE(left) == &PyLongRangeIter_Type)
+            form = FOR_ITER_RANGE;
+        else if (Py_TYPE(left) == &PyDictIterKey_Type ||
+                 Py_TYPE(left) == &PyDictIterValue_Type ||
+                 Py_TYPE(left) == &PyDictIterItem_Type)
+            form = FOR_ITER_DICT;
+        break;
+    }
+    oc->u.adaptive.counter = 0;
+    if (form == 0) {
+        oc->misses++;
+        return;
+    }
+    SET_QUICKENED(co, offset, form);
+    specialization_stats[form].specialized++;
+}
+
+static const struct {
+    int opcode;
+    const char *name;
+} specialized_forms[] = {
+    {BINARY_ADD_INT, "BINARY_ADD_INT"},
+    {BINARY_ADD_FLOAT, "BINARY_ADD_FLOAT"},
+    {BINARY_SUBSCR_LIST_INT, "BINARY_SUBSCR_LIST_INT"},
+    {COMPARE_OP_INT, "COMPARE_OP_INT"},
+    {COMPARE_OP_FLOAT, "COMPARE_OP_FLOAT"},
+    {COMPARE_OP_STR, "COMPARE_OP_STR"},
+    {FOR_ITER_LIST, "FOR_ITER_LIST"},
+    {FOR_ITER_TUPLE, "FOR_ITER_TUPLE"},
+    {FOR_ITER_RANGE, "FOR_ITER_RANGE"},
+    {FOR_ITER_DICT, "FOR_ITER_DICT"},
+};
+
+#define NSPECIALIZED_FORMS \
+    ((int)(sizeof(specialized_forms) / sizeof(specialized_forms[0])))
+
+int
+_PyEval_GetSpecializationStats(_PyEval_SpecializationStats *stats, int n)
+{
+    int i;
+
+    for (i = 0; i < n && i < NSPECIALIZED_FORMS; i++) {
+        int opcode = specialized_forms[i].opcode;
+        stats[i].name = specialized_forms[i].name;
+        stats[i].specialized = specialization_stats[opcode].specialized;
+        stats[i].hits = specialization_stats[opcode].hits;
+        stats[i].misses = specialization_stats[opcode].misses;
+    }
+    return NSPECIALIZED_FORMS;
+}
+
+/* Opcode profile
+
+   A thread with a profile, see _PyEval_SetOpcodeProfile(), samples one in
+   'period' of the instructions it runs.  A sampled instruction is counted
+   by opcode, and by code object in a hash table keyed by address, which
+   keeps them alive, and timed with the timestamp counter, from its dispatch
+   to the dispatch of the next instruction of the thread, in any frame, or
+   to the exit of its frame:  a call is timed until the first instruction of
+   the callee, a return until the frame has gone.  The counts times the
+   period estimate the instructions run.
+
+   The eval loop counts tstate->opcode_countdown down at each dispatch and
+   calls profile_instruction() when it gets to 0:  for a sampled
+   instruction, and for the one after it, which stops the timing.  The
+   countdown of a thread without a profile starts at INT_MAX, so that the
+   profile costs the other threads a decrement and a test per instruction.
+   The instructions which PREDICT() goes on with, and the second ones of
+   the superinstructions, aren't dispatched:  they are never sampled, and
+   their time goes to the instruction before.
+*/
+
+struct _opcode_profile {
+    int period;                 /* instructions per sampled one */
+    int countdown;              /* 'period' from a sampled instruction to
+                                   the next one, 1 after the timing */
+    int timed_opcode;           /* the timed instruction, or -1 */
+    Py_ssize_t timed_code;      /* ... and the index of its code, or -1 */
+    PY_UINT64_T start;          /* ... and when it was dispatched */
+    PyCodeObject *last_code;    /* the code of the last instruction */
+    Py_ssize_t last_index;      /* ... and its index, or -1 */
+    _PyEval_OpcodeProfile opcodes[256];
+    _PyEval_CodeProfile *codes; /* by code object, NULL code for a free slot */
+    Py_ssize_t ncodes;
+    Py_ssize_t codes_size;      /* a power of 2, or 0 */
+};
+
+#define CODE_SLOT(co, mask) (((size_t)(co) >> 4) & (mask))
+
+/* The index of 'co' in the table of codes, which gets it if it's missing,
+   or -1 for no memory */
+static Py_ssize_t
+profile_code_index(struct _opcode_profile *prof, PyCodeObject *co)
+{
+    size_t mask = prof->codes_size - 1, i;
+
+    if (prof->codes_size > 0) {
+        for (i = CODE_SLOT(co, mask); prof->codes[i].code != NULL;
+             i = (i + 1) & mask) {
+            if (prof->codes[i].code == (PyObject *)co)
+                return i;
+        }
+    }
+    if (3 * (prof->ncodes + 1) > 2 * prof->codes_size) {
+        /* grow to keep the table up to 2/3 full */
+        Py_ssize_t j, size = prof->codes_size ? 2 * prof->codes_size : 64;
+        _PyEval_CodeProfile *codes = (_PyEval_CodeProfile *)PyMem_Calloc(
+            size, sizeof(_PyEval_CodeProfile));
+        if (codes == NULL)
+            return -1;
+        mask = size - 1;
+        for (j = 0; j < prof->codes_size; j++) {
+            if (prof->codes[j].code == NULL)
+                continue;
+            for (i = CODE_SLOT(prof->codes[j].code, mask);
+                 codes[i].code != NULL; i = (i + 1) & mask)
+                ;
+            codes[i] = prof->codes[j];
+        }
+        PyMem_FREE(prof->codes);
+        prof->codes = codes;
+        prof->codes_size = size;
+    }
+    for (i = CODE_SLOT(co, mask); prof->codes[i].code != NULL;
+         i = (i + 1) & mask)
+        ;
+    Py_INCREF(co);
+    prof->codes[i].code = (PyObject *)co;
+    prof->ncodes++;
+    return i;
+}
+
+static void
+profile_stop_timing(struct _opcode_profile *prof)
+{
+    PY_UINT64_T now, ticks;
+
+    if (prof->timed_opcode < 0)
+        return;
+    READ_TIMESTAMP(now);
+    ticks = now - prof->start;
+    prof->opcodes[prof->timed_opcode].timed++;
+    prof->opcodes[prof->timed_opcode].ticks += ticks;
+    if (prof->timed_code >= 0) {
+        prof->codes[prof->timed_code].profile.timed++;
+        prof->codes[prof->timed_code].profile.ticks += ticks;
+    }
+    prof->timed_opcode = -1;
+}
+
+/* Called when the countdown of tstate gets to 0, before the instruction
+   'opcode' at 'offset' of 'co' runs:  sample it, or stop timing the one
+   before */
+static void
+profile_instruction(PyThreadState *tstate, PyCodeObject *co,
+                    int opcode, int offset)
+{
+    struct _opcode_profile *prof = tstate->opcode_profile;
+
+    if (prof == NULL) {
+        tstate->opcode_countdown = INT_MAX;
+        return;
+    }
+    profile_stop_timing(prof);
+    if (prof->countdown > 1) {
+        /* the instruction after a sampled one */
+        tstate->opcode_countdown = prof->countdown - 1;
+        prof->countdown = 1;
+        return;
+    }
+    prof->countdown = prof->period;
+    if (opcode == INSTRUMENTED_LINE)
+        opcode = co->co_instrumented[offset];
+    if (co != prof->last_code) {
+        /* the table may move:  look the code up again */
+        prof->last_index = profile_code_index(prof, co);
+        prof->last_code = prof->last_index >= 0 ? co : NULL;
+    }
+    prof->opcodes[opcode].count++;
+    if (prof->last_index >= 0)
+        prof->codes[prof->last_index].profile.count++;
+    prof->timed_opcode = opcode;
+    prof->timed_code = prof->last_index;
+    /* back for the next instruction, to stop the timing */
+    tstate->opcode_countdown = 1;
+    READ_TIMESTAMP(prof->start);
+}
+
+static void
+profile_clear_codes(struct _opcode_profile *prof)
+{
+    _PyEval_CodeProfile *codes = prof->codes;
+    Py_ssize_t i, size = prof->codes_size;
+
+    /* the code objects may run Python code as they go, which the profile
+       counts:  empty it first */
+    prof->codes = NULL;
+    prof->ncodes = 0;
+    prof->codes_size = 0;
+    prof->last_code = NULL;
+    prof->timed_opcode = -1;
+    for (i = 0; i < size; i++)
+        Py_XDECREF(codes[i].code);
+    PyMem_FREE(codes);
+}
+
+int
+_PyEval_SetOpcodeProfile(int period)
+{
+    PyThreadState *tstate = PyThreadState_GET();
+    struct _opcode_profile *prof = tstate->opcode_profile;
+
+    if (period < 0) {
+        PyErr_SetString(PyExc_ValueError,
+                        "the period of the opcode profile is negative");
+        return -1;
+    }
+    if (period == 0) {
+        _PyEval_ClearOpcodeProfile(tstate);
+        return 0;
+    }
+    if (prof == NULL) {
+        prof = (struct _opcode_profile *)PyMem_Calloc(
+            1, sizeof(struct _opcode_profile));
+        if (prof == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        prof->timed_opcode = -1;
+        tstate->opcode_profile = prof;
+    }
+    prof->period = period;
+    prof->countdown = 1;
+    tstate->opcode_countdown = period;
+    return 0;
+}
+
+Py_ssize_t
+_PyEval_GetOpcodeProfile(_PyEval_OpcodeProfile *opcodes,
+                         _PyEval_CodeProfile *codes, Py_ssize_t n)
+{
+    struct _opcode_profile *prof = PyThreadState_GET()->opcode_profile;
+    Py_ssize_t i, k = 0;
+
+    if (prof == NULL)
+        return -1;
+    memcpy(opcodes, prof->opcodes, sizeof(prof->opcodes));
+    for (i = 0; i < prof->codes_size && k < n; i++) {
+        if (prof->codes[i].code != NULL)
+            codes[k++] = prof->codes[i];
+    }
+    return prof->ncodes;
+}
+
+void
+_PyEval_ResetOpcodeProfile(void)
+{
+    struct _opcode_profile *prof = PyThreadState_GET()->opcode_profile;
+
+    if (prof == NULL)
+        return;
+    profile_clear_codes(prof);
+    memset(prof->opcodes, 0, sizeof(prof->opcodes));
+    prof->countdown = 1;
+    PyThreadState_GET()->opcode_countdown = prof->period;
+}
+
+void
+_PyEval_ClearOpcodeProfile(PyThreadState *tstate)
+{
+    struct _opcode_profile *prof = tstate->opcode_profile;
+
+    if (prof == NULL)
+        return;
+    tstate->opcode_profile = NULL;
+    tstate->opcode_countdown = INT_MAX;
+    profile_clear_codes(prof);
+    PyMem_FREE(prof);
+}
+
 #define CANNOT_CATCH_MSG "catching classes that do not inherit from "\
                          "BaseException is not allowed"
 
@@ -5210,7 +6524,7 @@ format_exc_unbound(PyCodeObject *co, int oparg)
 
 static PyObject *
 unicode_concatenate(PyObject *v, PyObject *w,
-                    PyFrameObject *f, unsigned char *next_instr)
+                    _PyInterpreterFrame *f, unsigned char *next_instr)
 {
     PyObject *res;
     if (Py_REFCNT(v) == 2) {
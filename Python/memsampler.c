@@ -0,0 +1,362 @@
+/* Sampling allocation profiler
+
+   Hooks the PYMEM_DOMAIN_MEM and PYMEM_DOMAIN_OBJ allocators (see
+   PyMem_SetAllocator()) and records the Python stack of roughly one
+   allocation every sample_bytes bytes.
+
+   The allocated bytes are seen as a stream, and the points where a sample
+   is taken as a Poisson process over it:  the distance to the next point is
+   drawn from an exponential distribution of mean sample_bytes.  An
+   allocation is sampled if it spans at least one point, and it is weighted
+   by the number of points it spans, so that large allocations aren't
+   under-counted:  an allocation of sample_bytes * 10 bytes is worth about
+   10 samples.  Multiplying the samples of a stack by sample_bytes then
+   estimates the bytes allocated from it, whatever the allocation sizes.
+
+   Samples are aggregated per stack in a fixed size hash table, allocated
+   when sampling starts, so that the hooks never allocate memory.  Samples
+   whose stack doesn't fit in a full table are only counted.
+
+   The hooks cost one subtraction and one branch per allocation; when
+   sampling is stopped they are not installed at all.  The raw domain isn't
+   hooked:  it is called without the GIL, and there is no frame to record.
+*/
+
+#include "Python.h"
+
+#include "code.h"
+#include "frameobject.h"
+
+#include <math.h>
+
+typedef struct {
+    PyCodeObject *code;         /* strong reference */
+    int lineno;
+} sample_frame;
+
+typedef struct {
+    Py_uhash_t hash;
+    int used;
+    int nframes;                /* innermost first, 0 outside Python code */
+    size_t nsamples;            /* sampling points crossed */
+    size_t nallocs;             /* allocations sampled */
+    size_t nbytes;              /* bytes of the allocations sampled */
+} sample_stack;
+
+static struct {
+    int running;
+    /* bytes left before the next sampling point:  it is below zero once
+       the point is reached */
+    Py_ssize_t countdown;
+    size_t sample_bytes;
+    int max_frames;
+    size_t table_size;          /* entries of stacks, a power of two */
+    size_t max_stacks;          /* entries used at most, <= 3/4 table_size */
+    size_t nstacks;             /* entries used */
+    sample_stack *stacks;
+    sample_frame *frames;       /* max_frames per entry of stacks */
+    size_t nsamples;
+    size_t nlost;               /* samples whose stack didn't fit */
+    int busy;                   /* don't sample while sampling or dumping */
+    unsigned long rng;
+
+    PyMemAllocatorEx mem;
+    PyMemAllocatorEx obj;
+} sampler;
+
+/* Draw the distance to the next sampling point. */
+static Py_ssize_t
+sample_interval(void)
+{
+    double u, n;
+
+    /* xorshift */
+    sampler.rng ^= sampler.rng << 13;
+    sampler.rng ^= (sampler.rng & 0xffffffffUL) >> 17;
+    sampler.rng ^= sampler.rng << 5;
+    sampler.rng &= 0xffffffffUL;
+    u = ((double)sampler.rng + 1.0) / 4294967297.0;       /* in ]0, 1[ */
+    n = -log(u) * (double)sampler.sample_bytes;
+    if (n >= (double)(PY_SSIZE_T_MAX / 2))
+        return PY_SSIZE_T_MAX / 2;
+    return (Py_ssize_t)n;
+}
+
+/* Add the sample of an allocation of SIZE bytes to the table.  Called once
+   the countdown went below zero. */
+static void
+sample_allocation(size_t size)
+{
+    PyThreadState *tstate;
+    _PyInterpreterFrame *frame;
+    sample_frame stack[64];
+    sample_frame *frames;
+    sample_stack *entry;
+    Py_uhash_t hash = 0;
+    size_t npoints = 0, mask, i;
+    int nframes = 0;
+
+    while (sampler.countdown < 0) {
+        sampler.countdown += sample_interval();
+        npoints++;
+    }
+    if (sampler.busy)
+        return;
+    sampler.nsamples += npoints;
+
+    tstate = PyThreadState_GET();
+    frame = tstate != NULL ? tstate->frame : NULL;
+    for (; frame != NULL && nframes < sampler.max_frames;
+           frame = frame->f_previous) {
+        stack[nframes].code = frame->f_code;
+        stack[nframes].lineno = _PyFrame_GetLineNumber(frame);
+        hash = (hash ^ _Py_HashPointer(frame->f_code)) * 1000003;
+        hash = (hash ^ (Py_uhash_t)stack[nframes].lineno) * 1000003;
+        nframes++;
+    }
+
+    mask = sampler.table_size - 1;
+    for (i = (size_t)hash & mask; ; i = (i + 1) & mask) {
+        int j;
+
+        entry = &sampler.stacks[i];
+        frames = &sampler.frames[i * sampler.max_frames];
+        if (!entry->used)
+            break;
+        if (entry->hash != hash || entry->nframes != nframes)
+            continue;
+        /* Frame by frame:  a memcmp() would compare the padding */
+        for (j = 0; j < nframes; j++) {
+            if (frames[j].code != stack[j].code ||
+                frames[j].lineno != stack[j].lineno)
+                break;
+        }
+        if (j == nframes)
+            goto found;
+    }
+    if (sampler.nstacks >= sampler.max_stacks) {
+        sampler.nlost += npoints;
+        return;
+    }
+    sampler.nstacks++;
+    entry->used = 1;
+    entry->hash = hash;
+    entry->nframes = nframes;
+    for (i = 0; i < (size_t)nframes; i++) {
+        Py_INCREF(stack[i].code);
+        frames[i] = stack[i];
+    }
+
+found:
+    entry->nsamples += npoints;
+    entry->nallocs++;
+    entry->nbytes += size;
+}
+
+/* The hooks.  CTX is the allocator they were installed on top of. */
+
+#define SAMPLE(size) \
+    if ((sampler.countdown -= (Py_ssize_t)(size)) < 0) \
+        sample_allocation(size)
+
+static void *
+sampler_malloc(void *ctx, size_t size)
+{
+    PyMemAllocatorEx *alloc = (PyMemAllocatorEx *)ctx;
+    SAMPLE(size);
+    return alloc->malloc(alloc->ctx, size);
+}
+
+static void *
+sampler_calloc(void *ctx, size_t nelem, size_t elsize)
+{
+    PyMemAllocatorEx *alloc = (PyMemAllocatorEx *)ctx;
+    SAMPLE(nelem * elsize);
+    return alloc->calloc(alloc->ctx, nelem, elsize);
+}
+
+static void *
+sampler_realloc(void *ctx, void *ptr, size_t new_size)
+{
+    PyMemAllocatorEx *alloc = (PyMemAllocatorEx *)ctx;
+    SAMPLE(new_size);
+    return alloc->realloc(alloc->ctx, ptr, new_size);
+}
+
+static void
+sampler_free(void *ctx, void *ptr)
+{
+    PyMemAllocatorEx *alloc = (PyMemAllocatorEx *)ctx;
+    alloc->free(alloc->ctx, ptr);
+}
+
+#undef SAMPLE
+
+int
+_PyMem_StartSampling(size_t sample_bytes, int max_frames, size_t max_stacks)
+{
+    PyMemAllocatorEx alloc;
+    size_t n;
+
+    if (sampler.running) {
+        PyErr_SetString(PyExc_RuntimeError, "sampling already started");
+        return -1;
+    }
+    if (sample_bytes < 1 || max_frames < 1 || max_frames > 64 ||
+        max_stacks < 1) {
+        PyErr_SetString(PyExc_ValueError, "invalid sampling parameters");
+        return -1;
+    }
+    /* Round up to a power of two, with room for max_stacks at 3/4 full */
+    for (n = 4; n / 4 * 3 < max_stacks; n <<= 1) {
+        if (n > PY_SSIZE_T_MAX / 2 /
+                (sizeof(sample_stack) + max_frames * sizeof(sample_frame))) {
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+
+    _PyMem_ClearSamples();
+    PyMem_RawFree(sampler.stacks);
+    PyMem_RawFree(sampler.frames);
+    sampler.stacks = (sample_stack *)PyMem_RawCalloc(n, sizeof(sample_stack));
+    sampler.frames = (sample_frame *)PyMem_RawMalloc(
+                         n * max_frames * sizeof(sample_frame));
+    if (sampler.stacks == NULL || sampler.frames == NULL) {
+        PyMem_RawFree(sampler.stacks);
+        PyMem_RawFree(sampler.frames);
+        sampler.stacks = NULL;
+        sampler.frames = NULL;
+        sampler.table_size = 0;
+        PyErr_NoMemory();
+        return -1;
+    }
+    sampler.table_size = n;
+    sampler.max_stacks = max_stacks;
+    sampler.max_frames = max_frames;
+    sampler.sample_bytes = sample_bytes;
+    if (sampler.rng == 0)
+        sampler.rng = (unsigned long)_Py_HashPointer(&sampler) | 1;
+    sampler.countdown = sample_interval();
+
+    alloc.malloc = sampler_malloc;
+    alloc.calloc = sampler_calloc;
+    alloc.realloc = sampler_realloc;
+    alloc.free = sampler_free;
+
+    PyMem_GetAllocator(PYMEM_DOMAIN_MEM, &sampler.mem);
+    PyMem_GetAllocator(PYMEM_DOMAIN_OBJ, &sampler.obj);
+    alloc.ctx = &sampler.mem;
+    PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &alloc);
+    alloc.ctx = &sampler.obj;
+    PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &alloc);
+    sampler.running = 1;
+    return 0;
+}
+
+void
+_PyMem_StopSampling(void)
+{
+    if (!sampler.running)
+        return;
+    /* Assume nobody hooked the allocators on top of us in the meantime */
+    PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &sampler.mem);
+    PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &sampler.obj);
+    sampler.running = 0;
+}
+
+void
+_PyMem_ClearSamples(void)
+{
+    size_t i;
+    int j;
+
+    /* Releasing code objects may free memory, never allocate it, but
+       keep the table out of reach anyway. */
+    sampler.busy++;
+    for (i = 0; i < sampler.table_size; i++) {
+        sample_stack *entry = &sampler.stacks[i];
+        if (!entry->used)
+            continue;
+        for (j = 0; j < entry->nframes; j++)
+            Py_DECREF(sampler.frames[i * sampler.max_frames + j].code);
+        memset(entry, 0, sizeof(*entry));
+    }
+    sampler.nstacks = 0;
+    sampler.nsamples = 0;
+    sampler.nlost = 0;
+    sampler.busy--;
+}
+
+static int
+compare_stacks(const void *a, const void *b)
+{
+    const sample_stack *x = *(const sample_stack * const *)a;
+    const sample_stack *y = *(const sample_stack * const *)b;
+    if (x->nsamples != y->nsamples)
+        return x->nsamples < y->nsamples ? 1 : -1;
+    return 0;
+}
+
+static const char *
+utf8_or(PyObject *str, const char *fallback)
+{
+    const char *s = NULL;
+    if (str != NULL && PyUnicode_Check(str)) {
+        s = PyUnicode_AsUTF8(str);
+        if (s == NULL)
+            PyErr_Clear();
+    }
+    return s != NULL ? s : fallback;
+}
+
+/* Write the stacks to "out", the ones with the most samples first. */
+void
+_PyMem_DumpSamples(FILE *out)
+{
+    sample_stack **sorted;
+    size_t i, n = 0;
+    int j;
+
+    sampler.busy++;
+    fprintf(out, "%" PY_FORMAT_SIZE_T "u samples, one per %"
+            PY_FORMAT_SIZE_T "u bytes, %" PY_FORMAT_SIZE_T "u stacks, %"
+            PY_FORMAT_SIZE_T "u samples lost\n",
+            sampler.nsamples, sampler.sample_bytes, sampler.nstacks,
+            sampler.nlost);
+    sorted = (sample_stack **)PyMem_RawMalloc(
+                 (sampler.nstacks + 1) * sizeof(sample_stack *));
+    if (sorted == NULL) {
+        fputs("no memory to sort the stacks\n", out);
+        sampler.busy--;
+        return;
+    }
+    for (i = 0; i < sampler.table_size; i++) {
+        if (sampler.stacks[i].used)
+            sorted[n++] = &sampler.stacks[i];
+    }
+    qsort(sorted, n, sizeof(sample_stack *), compare_stacks);
+
+    for (i = 0; i < n; i++) {
+        sample_stack *entry = sorted[i];
+        sample_frame *frames =
+            &sampler.frames[(entry - sampler.stacks) * sampler.max_frames];
+
+        fprintf(out, "\n%.1f%%: ~%" PY_FORMAT_SIZE_T "u bytes in %"
+                PY_FORMAT_SIZE_T "u sampled allocations, %"
+                PY_FORMAT_SIZE_T "u bytes on average\n",
+                100.0 * entry->nsamples / sampler.nsamples,
+                entry->nsamples * sampler.sample_bytes,
+                entry->nallocs, entry->nbytes / entry->nallocs);
+        if (entry->nframes == 0)
+            fputs("  <no Python frame>\n", out);
+        for (j = 0; j < entry->nframes; j++) {
+            fprintf(out, "  File \"%s\", line %d, in %s\n",
+                    utf8_or(frames[j].code->co_filename, "???"),
+                    frames[j].lineno,
+                    utf8_or(frames[j].code->co_name, "???"));
+        }
+    }
+    PyMem_RawFree(sorted);
+    sampler.busy--;
+}
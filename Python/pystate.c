@@ -2,6 +2,7 @@
 /* Thread and interpreter state structures and their interfaces */
 
 #include "Python.h"
+#include "frameobject.h"
 
 /* --------------------------------------------------------------------------
 CAUTION
@@ -86,9 +87,6 @@ PyInterpreterState_New(void)
 #else
         interp->dlopenflags = RTLD_LAZY;
 #endif
-#endif
-#ifdef WITH_TSC
-        interp->tscdump = 0;
 #endif
 
         HEAD_LOCK();
@@ -164,7 +162,14 @@ PyInterpreterState_Delete(PyInterpreterState *interp)
 static struct _frame *
 threadstate_getframe(PyThreadState *self)
 {
-    return self->frame;
+    PyFrameObject *f;
+
+    if (self->frame == NULL)
+        return NULL;
+    f = _PyFrame_GetFrameObject(self->frame);
+    if (f == NULL)
+        PyErr_Clear();
+    return f;
 }
 
 static PyThreadState *
@@ -206,6 +211,10 @@ new_threadstate(PyInterpreterState *interp, int init)
         tstate->c_tracefunc = NULL;
         tstate->c_profileobj = NULL;
         tstate->c_traceobj = NULL;
+        tstate->c_instrfunc = NULL;
+        tstate->c_instrobj = NULL;
+        tstate->opcode_profile = NULL;
+        tstate->opcode_countdown = INT_MAX;
 
         tstate->trash_delete_nesting = 0;
         tstate->trash_delete_later = NULL;
@@ -215,6 +224,12 @@ new_threadstate(PyInterpreterState *interp, int init)
         tstate->coroutine_wrapper = NULL;
         tstate->in_coroutine_wrapper = 0;
 
+        tstate->obmalloc_tcache = NULL;
+        tstate->obmalloc_region = NULL;
+        tstate->frame_chunk = NULL;
+        tstate->frame_top = NULL;
+        tstate->frame_limit = NULL;
+
         if (init)
             _PyThreadState_Init(tstate);
 
@@ -373,7 +388,7 @@ PyThreadState_Clear(PyThreadState *tstate)
         fprintf(stderr,
           "PyThreadState_Clear: warning: thread still has a frame\n");
 
-    Py_CLEAR(tstate->frame);
+    tstate->frame = NULL;
 
     Py_CLEAR(tstate->dict);
     Py_CLEAR(tstate->async_exc);
@@ -390,8 +405,14 @@ PyThreadState_Clear(PyThreadState *tstate)
     tstate->c_tracefunc = NULL;
     Py_CLEAR(tstate->c_profileobj);
     Py_CLEAR(tstate->c_traceobj);
+    tstate->c_instrfunc = NULL;
+    Py_CLEAR(tstate->c_instrobj);
+    _PyEval_ClearOpcodeProfile(tstate);
 
     Py_CLEAR(tstate->coroutine_wrapper);
+
+    _PyFrame_ClearThreadStack(tstate);
+    _PyObject_ClearThreadCache(tstate);
 }
 
 
@@ -416,6 +437,8 @@ tstate_delete_common(PyThreadState *tstate)
     if (tstate->on_delete != NULL) {
         tstate->on_delete(tstate->on_delete_data);
     }
+    _PyFrame_ClearThreadStack(tstate);
+    _PyObject_ClearThreadCache(tstate);
     PyMem_RawFree(tstate);
 }
 
@@ -645,9 +668,12 @@ _PyThread_CurrentFrames(void)
         for (t = i->tstate_head; t != NULL; t = t->next) {
             PyObject *id;
             int stat;
-            struct _frame *frame = t->frame;
-            if (frame == NULL)
+            struct _frame *frame;
+            if (t->frame == NULL)
                 continue;
+            frame = _PyFrame_GetFrameObject(t->frame);
+            if (frame == NULL)
+                goto Fail;
             id = PyLong_FromLong(t->thread_id);
             if (id == NULL)
                 goto Fail;
@@ -122,7 +122,7 @@ newtracebackobject(PyTracebackObject *next, PyFrameObject *frame)
         tb->tb_next = next;
         Py_XINCREF(frame);
         tb->tb_frame = frame;
-        tb->tb_lasti = frame->f_lasti;
+        tb->tb_lasti = frame->f_frame->f_lasti;
         tb->tb_lineno = PyFrame_GetLineNumber(frame);
         PyObject_GC_Track(tb);
     }
@@ -164,7 +164,7 @@ void _PyTraceback_Add(const char *funcname, const char *filename, int lineno)
     frame = PyFrame_New(PyThreadState_Get(), code, globals, NULL);
     if (!frame)
         goto done;
-    frame->f_lineno = lineno;
+    frame->f_frame->f_lineno = lineno;
 
     PyErr_Restore(exception, value, tb);
     PyTraceBack_Here(frame);
@@ -420,9 +420,9 @@ tb_printinternal(PyTracebackObject *tb, PyObject *f, long limit)
     while (tb != NULL && err == 0) {
         if (depth <= limit) {
             err = tb_displayline(f,
-                                 tb->tb_frame->f_code->co_filename,
+                                 tb->tb_frame->f_frame->f_code->co_filename,
                                  tb->tb_lineno,
-                                 tb->tb_frame->f_code->co_name);
+                                 tb->tb_frame->f_frame->f_code->co_name);
         }
         depth--;
         tb = tb->tb_next;
@@ -609,7 +609,7 @@ dump_ascii(int fd, PyObject *text)
    This function is signal safe. */
 
 static void
-dump_frame(int fd, PyFrameObject *frame)
+dump_frame(int fd, _PyInterpreterFrame *frame)
 {
     PyCodeObject *code;
     int lineno;
@@ -644,13 +644,14 @@ dump_frame(int fd, PyFrameObject *frame)
 static void
 dump_traceback(int fd, PyThreadState *tstate, int write_header)
 {
-    PyFrameObject *frame;
+    _PyInterpreterFrame *frame;
     unsigned int depth;
 
     if (write_header)
         PUTS(fd, "Stack (most recent call first):\n");
 
-    frame = _PyThreadState_GetFrame(tstate);
+    /* Walk the frame stack itself:  making frame objects allocates */
+    frame = tstate->frame;
     if (frame == NULL)
         return;
 
@@ -660,10 +661,8 @@ dump_traceback(int fd, PyThreadState *tstate, int write_header)
             PUTS(fd, "  ...\n");
             break;
         }
-        if (!PyFrame_Check(frame))
-            break;
         dump_frame(fd, frame);
-        frame = frame->f_back;
+        frame = frame->f_previous;
         depth++;
     }
 }